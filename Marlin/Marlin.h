@@ -236,8 +236,29 @@ bool enqueue_and_echo_command(const char* cmd);           // Add a single comman
 void enqueue_and_echo_commands_P(const char * const cmd); // Set one or more commands to be prioritized over the next Serial/SD command.
 void clear_command_queue();
 
+/**
+ * The command queue holds BUFSIZE commands of MAX_CMD_SIZE, or with
+ * COMMAND_QUEUE_ARENA up to BUFSIZE commands packed into its bytes.
+ * QUEUED_COMMAND gives the text of a command at an index of a queue
+ * and NEXT_QUEUED_COMMAND the index of the one after it.
+ */
+#if ENABLED(COMMAND_QUEUE_ARENA)
+  typedef uint16_t cmd_queue_index_t;
+  cmd_queue_index_t next_queued_command(const char * const queue, const cmd_queue_index_t i);
+  #define QUEUED_COMMAND(Q, I) (&(Q)[(I) + 1]) // After the flags
+  #define NEXT_QUEUED_COMMAND(Q, I) next_queued_command(Q, I)
+#else
+  typedef uint8_t cmd_queue_index_t;
+  #define QUEUED_COMMAND(Q, I) ((Q)[I])
+  #define NEXT_QUEUED_COMMAND(Q, I) ((I) + 1 < BUFSIZE ? (I) + 1 : 0)
+#endif
+
 #if ENABLED(M100_FREE_MEMORY_WATCHER) || ENABLED(POWER_LOSS_RECOVERY)
-  extern char command_queue[BUFSIZE][MAX_CMD_SIZE];
+  #if ENABLED(COMMAND_QUEUE_ARENA)
+    extern char command_queue[COMMAND_QUEUE_ARENA_SIZE];
+  #else
+    extern char command_queue[BUFSIZE][MAX_CMD_SIZE];
+  #endif
 #endif
 
 #define HAS_LCD_QUEUE_NOW (ENABLED(MALYAN_LCD) || (ENABLED(ULTIPANEL) && (ENABLED(AUTO_BED_LEVELING_UBL) || ENABLED(PID_AUTOTUNE_MENU) || ENABLED(ADVANCED_PAUSE_FEATURE))))
@@ -431,6 +452,10 @@ void report_current_position();
   void forward_kinematics_SCARA(const float &a, const float &b);
 #endif
 
+#if ENABLED(ADAPTIVE_SEGMENTATION)
+  extern float segment_chord_tolerance;
+#endif
+
 #if ENABLED(G26_MESH_VALIDATION)
   extern bool g26_debug_flag;
 #elif ENABLED(AUTO_BED_LEVELING_UBL)
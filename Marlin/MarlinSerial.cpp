@@ -84,6 +84,21 @@
     ring_buffer_pos_t rx_max_enqueued = 0;
   #endif
 
+  #if ENABLED(SERIAL_CREDITS)
+    uint16_t rx_consumed = 0;
+  #endif
+
+  #if ENABLED(SERIAL_STATS_TX_BLOCKED)
+    uint32_t tx_blocked_us = 0;
+    uint32_t tx_blocked_waits = 0;
+    // Time a wait for room to queue output
+    #define TX_WAIT_START() const uint32_t tx_wait_start = micros()
+    #define TX_WAIT_END() do{ tx_blocked_us += micros() - tx_wait_start; tx_blocked_waits++; }while(0)
+  #else
+    #define TX_WAIT_START() NOOP
+    #define TX_WAIT_END() NOOP
+  #endif
+
   // A SW memory barrier, to ensure GCC does not overoptimize loops
   #define sw_barrier() asm volatile("": : :"memory");
 
@@ -368,6 +383,113 @@
       ISR(M_USARTx_UDRE_vect) { _tx_udr_empty_irq(); }
     #endif
 
+    #if ENABLED(SERIAL_DEFERRED_TX)
+
+      /**
+       * Deferred output is queued as records of a tag byte and a raw value,
+       * and pump() formats them into the TX buffer only as it has room.
+       * Only the main thread uses this ring. Output from an ISR goes directly
+       * to the TX buffer. The stepper and temperature ISRs run with interrupts
+       * enabled, so they count themselves in serial_isr_depth.
+       */
+      enum DeferredTag : uint8_t { DEFER_CHAR, DEFER_PGM, DEFER_LONG, DEFER_ULONG, DEFER_FLOAT }; // Float digits in bits 3-7
+
+      static uint8_t defer_buffer[SERIAL_DEFERRED_TX_SIZE], defer_head, defer_tail;
+      static uint16_t defer_sent; // Characters of the record at the tail already sent
+
+      volatile uint8_t serial_isr_depth; // = 0
+
+      #define DEFER_NEXT(i) (uint8_t)(((i) + 1) & (SERIAL_DEFERRED_TX_SIZE - 1))
+
+      FORCE_INLINE bool in_main_thread() { return ISRS_ENABLED() && !serial_isr_depth; }
+
+      FORCE_INLINE uint8_t defer_room() { return (uint8_t)(defer_tail - defer_head - 1) & (SERIAL_DEFERRED_TX_SIZE - 1); }
+      FORCE_INLINE uint8_t tx_room() { return (uint8_t)(tx_buffer.tail - tx_buffer.head - 1) & (TX_BUFFER_SIZE - 1); }
+
+      // Put a character in the TX buffer if it has room. ISRs may write to it at any
+      // time, so the room is checked and the head moved with interrupts disabled.
+      FORCE_INLINE bool tx_put(const uint8_t c) {
+        CRITICAL_SECTION_START;
+        const uint8_t h = tx_buffer.head, i = (h + 1) & (TX_BUFFER_SIZE - 1);
+        const bool room = i != tx_buffer.tail;
+        if (room) {
+          tx_buffer.buffer[h] = c;
+          tx_buffer.head = i;
+        }
+        CRITICAL_SECTION_END;
+        return room;
+      }
+
+      // Queue a record, waiting for pump() to make room if the ring is full
+      static void defer(const uint8_t tag, const void *value, const uint8_t size) {
+        if (defer_room() <= size) {
+          TX_WAIT_START();
+          do { MarlinSerial::pump(); sw_barrier(); } while (defer_room() <= size);
+          TX_WAIT_END();
+        }
+        uint8_t h = defer_head;
+        defer_buffer[h] = tag;
+        for (uint8_t i = 0; i < size; i++) {
+          h = DEFER_NEXT(h);
+          defer_buffer[h] = ((const uint8_t*)value)[i];
+        }
+        defer_head = DEFER_NEXT(h);
+        _written = true;
+      }
+
+      // Format a number record the way print() does. Returns its length.
+      static uint8_t format_record(const uint8_t tag, const uint8_t value[4], char *buf) {
+        union { int32_t l; uint32_t u; float f; uint8_t b[4]; } v;
+        for (uint8_t i = 0; i < 4; i++) v.b[i] = value[i];
+
+        char *p = buf;
+        unsigned long n;
+        uint8_t digits = 0;
+        double remainder = 0.0;
+        switch (tag & 0x07) {
+          case DEFER_LONG:
+            if (v.l < 0) { *p++ = '-'; n = 0UL - (uint32_t)v.l; }
+            else n = v.l;
+            break;
+          case DEFER_ULONG:
+            n = v.u;
+            break;
+          default: {
+            // Round as printFloat() does, so 1.999 with 2 digits is "2.00"
+            double number = v.f;
+            if (number < 0.0) { *p++ = '-'; number = -number; }
+            digits = tag >> 3;
+            double rounding = 0.5;
+            for (uint8_t i = 0; i < digits; ++i) rounding *= 0.1;
+            number += rounding;
+            n = (unsigned long)number;
+            remainder = number - (double)n;
+          }
+        }
+
+        // Integer digits come out lowest first, so swap them around
+        char *first = p;
+        do { *p++ = '0' + n % 10; n /= 10; } while (n);
+        for (char *last = p - 1; first < last; first++, last--) {
+          const char c = *first;
+          *first = *last;
+          *last = c;
+        }
+
+        if (digits) {
+          *p++ = '.';
+          while (digits--) {
+            remainder *= 10.0;
+            const uint8_t d = uint8_t(remainder);
+            *p++ = '0' + d;
+            remainder -= d;
+          }
+        }
+        return p - buf;
+      }
+
+    #endif // SERIAL_DEFERRED_TX
+
   #endif // TX_BUFFER_SIZE
 
   #ifdef M_USARTx_RX_vect
@@ -438,6 +560,10 @@
     // if it interrupts the writing of the value of that variable in the middle.
     atomic_set_rx_tail(t);
 
+    #if ENABLED(SERIAL_CREDITS)
+      rx_consumed++;
+    #endif
+
     #if ENABLED(SERIAL_XON_XOFF)
       // If the XOFF char was sent, or about to be sent...
       if ((xon_xoff_state & XON_XOFF_CHAR_MASK) == XOFF_CHAR) {
@@ -473,7 +599,14 @@
     //  - Read the RX head index in a safe way. (See atomic_read_rx_head.)
     //  - Set the tail, making sure the RX ISR will always get a stable value, even
     //    if it interrupts the writing of the value of that variable in the middle.
-    atomic_set_rx_tail(atomic_read_rx_head());
+    #if ENABLED(SERIAL_CREDITS)
+      // Count the dropped bytes as taken, since they no longer hold space
+      const ring_buffer_pos_t h = atomic_read_rx_head();
+      rx_consumed += (ring_buffer_pos_t)(h - rx_buffer.tail) & (ring_buffer_pos_t)(RX_BUFFER_SIZE - 1);
+      atomic_set_rx_tail(h);
+    #else
+      atomic_set_rx_tail(atomic_read_rx_head());
+    #endif
 
     #if ENABLED(SERIAL_XON_XOFF)
       // If the XOFF char was sent, or about to be sent...
@@ -495,6 +628,19 @@
 
   #if TX_BUFFER_SIZE > 0
     void MarlinSerial::write(const uint8_t c) {
+      #if ENABLED(SERIAL_DEFERRED_TX)
+        // Keep the order behind deferred output, and queue rather than wait for room
+        if (in_main_thread()) {
+          if (defer_head == defer_tail && tx_put(c)) {
+            _written = true;
+            SBI(M_UCSRxB, M_UDRIEx);
+          }
+          else
+            defer(DEFER_CHAR, &c, 1);
+          return;
+        }
+      #endif
+
       _written = true;
 
       // If the TX interrupts are disabled and the data register
@@ -529,9 +675,11 @@
           sw_barrier();
         }
       }
-      else {
+      else if (i == tx_buffer.tail) {
         // Interrupts are enabled, just wait until there is space
+        TX_WAIT_START();
         while (i == tx_buffer.tail) { sw_barrier(); }
+        TX_WAIT_END();
       }
 
       // Store new char. head is always safe to move
@@ -547,6 +695,13 @@
       // no way to force the TXC (transmit complete) bit to 1 during initialization.
       if (!_written) return;
 
+      #if ENABLED(SERIAL_DEFERRED_TX)
+        // Format all deferred output first. An ISR (as in kill() for a heater
+        // error) leaves it alone, since the main thread may be in the middle of it.
+        if (in_main_thread())
+          while (defer_head != defer_tail) { pump(); sw_barrier(); }
+      #endif
+
       // If global interrupts are disabled (as the result of being called from an ISR)...
       if (!ISRS_ENABLED()) {
 
@@ -563,18 +718,81 @@
       }
       else {
         // Wait until everything was transmitted
+        TX_WAIT_START();
         while (tx_buffer.head != tx_buffer.tail || !TEST(M_UCSRxA, M_TXCx)) sw_barrier();
+        TX_WAIT_END();
       }
 
       // At this point nothing is queued anymore (DRIE is disabled) and
       // the hardware finished transmission (TXC is set).
     }
 
+    #if ENABLED(SERIAL_DEFERRED_TX)
+
+      void MarlinSerial::printPGM(const char* str) {
+        if (in_main_thread())
+          defer(DEFER_PGM, &str, sizeof(str));
+        else
+          while (char ch = pgm_read_byte(str++)) write(ch);
+      }
+
+      void MarlinSerial::pump(void) {
+        bool queued = false;
+        while (defer_tail != defer_head && tx_room()) {
+          uint8_t t = defer_tail;
+          const uint8_t tag = defer_buffer[t];
+          t = DEFER_NEXT(t);
+          bool done = true;
+
+          if (tag == DEFER_CHAR) {
+            done = tx_put(defer_buffer[t]);
+            t = DEFER_NEXT(t);
+          }
+          else {
+            uint8_t value[MAX(sizeof(const char*), 4U)];
+            const uint8_t size = tag == DEFER_PGM ? sizeof(const char*) : 4;
+            for (uint8_t i = 0; i < size; i++) {
+              value[i] = defer_buffer[t];
+              t = DEFER_NEXT(t);
+            }
+            if (tag == DEFER_PGM) {
+              const char *str;
+              memcpy(&str, value, sizeof(str));
+              str += defer_sent;
+              while (const char ch = pgm_read_byte(str++)) {
+                if (!tx_put(ch)) { done = false; break; }
+                defer_sent++;
+              }
+            }
+            else {
+              char buf[44]; // Sign, 10 digits, point and up to 31 decimals
+              const uint8_t len = format_record(tag, value, buf);
+              while (defer_sent < len && tx_put(buf[defer_sent])) defer_sent++;
+              done = defer_sent == len;
+            }
+          }
+
+          queued = true;
+          if (!done) break;
+          defer_sent = 0;
+          defer_tail = t;
+        }
+
+        // Enable TX ISR - Non atomic, but it will eventually enable TX ISR
+        if (queued) SBI(M_UCSRxB, M_UDRIEx);
+      }
+
+    #endif // SERIAL_DEFERRED_TX
+
   #else // TX_BUFFER_SIZE == 0
 
     void MarlinSerial::write(const uint8_t c) {
       _written = true;
-      while (!TEST(M_UCSRxA, M_UDREx)) sw_barrier();
+      if (!TEST(M_UCSRxA, M_UDREx)) {
+        TX_WAIT_START();
+        while (!TEST(M_UCSRxA, M_UDREx)) sw_barrier();
+        TX_WAIT_END();
+      }
       M_UDRx = c;
     }
 
@@ -614,6 +832,9 @@
   void MarlinSerial::print(long n, int base) {
     if (base == 0) write(n);
     else if (base == 10) {
+      #if ENABLED(SERIAL_DEFERRED_TX)
+        if (in_main_thread()) { const int32_t v = n; defer(DEFER_LONG, &v, sizeof(v)); return; }
+      #endif
       if (n < 0) { print('-'); n = -n; }
       printNumber(n, 10);
     }
@@ -623,10 +844,20 @@
 
   void MarlinSerial::print(unsigned long n, int base) {
     if (base == 0) write(n);
+    #if ENABLED(SERIAL_DEFERRED_TX)
+      else if (base == 10 && in_main_thread()) { const uint32_t v = n; defer(DEFER_ULONG, &v, sizeof(v)); }
+    #endif
     else printNumber(n, base);
   }
 
   void MarlinSerial::print(double n, int digits) {
+    #if ENABLED(SERIAL_DEFERRED_TX)
+      if (in_main_thread()) {
+        const float f = n;
+        defer(DEFER_FLOAT | constrain(digits, 0, 31) << 3, &f, sizeof(f));
+        return;
+      }
+    #endif
     printFloat(n, digits);
   }
 
@@ -113,6 +113,20 @@
     extern ring_buffer_pos_t rx_max_enqueued;
   #endif
 
+  #if ENABLED(SERIAL_CREDITS)
+    extern uint16_t rx_consumed;
+  #endif
+
+  #if ENABLED(SERIAL_STATS_TX_BLOCKED)
+    extern uint32_t tx_blocked_us;
+    extern uint32_t tx_blocked_waits;
+  #endif
+
+  #if ENABLED(SERIAL_DEFERRED_TX)
+    // ISRs that run with interrupts enabled count themselves in, so their output isn't deferred
+    extern volatile uint8_t serial_isr_depth;
+  #endif
+
   class MarlinSerial {
 
     public:
@@ -142,6 +156,23 @@
         FORCE_INLINE static ring_buffer_pos_t rxMaxEnqueued() { return rx_max_enqueued; }
       #endif
 
+      #if ENABLED(SERIAL_CREDITS)
+        // Bytes read or flushed from the RX buffer, modulo 65536
+        FORCE_INLINE static uint16_t consumed() { return rx_consumed; }
+      #endif
+
+      #if ENABLED(SERIAL_STATS_TX_BLOCKED)
+        // Time the main loop waited for room to queue output, and the number of waits
+        FORCE_INLINE static uint32_t txBlockedMicros() { return tx_blocked_us; }
+        FORCE_INLINE static uint32_t txBlockedWaits() { return tx_blocked_waits; }
+        FORCE_INLINE static void resetTxBlocked() { tx_blocked_us = 0; tx_blocked_waits = 0; }
+      #endif
+
+      #if ENABLED(SERIAL_DEFERRED_TX)
+        static void printPGM(const char* str);  // Queue a PROGMEM string
+        static void pump(void);                 // Format queued output into the TX buffer while it has room
+      #endif
+
       FORCE_INLINE static void write(const char* str) { while (*str) write(*str++); }
       FORCE_INLINE static void write(const uint8_t* buffer, size_t size) { while (size--) write(*buffer++); }
       FORCE_INLINE static void print(const String& s) { for (int i = 0; i < (int)s.length(); i++) write(s[i]); }
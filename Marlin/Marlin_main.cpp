@@ -52,6 +52,7 @@
  * G4   - Dwell S<seconds> or P<milliseconds>
  * G5   - Cubic B-spline with XYZE destination and IJPQ offsets
  * G6   - Direct stepper move (Requires UNREGISTERED_MOVE_SUPPORT). Hangprinter defaults to relative moves. Others default to absolute moves.
+ *        G6 S3 plays a binary step stream from the host (Requires STEP_STREAM)
  * G10  - Retract filament according to settings of M207 (Requires FWRETRACT)
  * G11  - Retract recover filament according to settings of M208 (Requires FWRETRACT)
  * G12  - Clean tool (Requires NOZZLE_CLEAN_FEATURE)
@@ -207,6 +208,7 @@
  * M502 - Revert to the default "factory settings". ** Does not write them to EEPROM! **
  * M503 - Print the current settings (in memory): "M503 S<verbose>". S0 specifies compact output.
  * M540 - Enable/disable SD card abort on endstop hit: "M540 S<state>". (Requires ABORT_ON_ENDSTOP_HIT_FEATURE_ENABLED)
+ * M593 - Set input shaping: "M593 [X|Y] T<type> F<frequency> D<damping>". (Requires INPUT_SHAPING)
  * M600 - Pause for filament change: "M600 X<pos> Y<pos> Z<raise> E<first_retract> L<later_retract>". (Requires ADVANCED_PAUSE_FEATURE)
  * M603 - Configure filament change: "M603 T<tool> U<unload_length> L<load_length>". (Requires ADVANCED_PAUSE_FEATURE)
  * M605 - Set Dual X-Carriage movement mode: "M605 S<mode> [X<x_offset>] [R<temp_offset>]". (Requires DUAL_X_CARRIAGE)
@@ -246,6 +248,13 @@
  *
  * ************ Custom codes - This can change to suit future G-code regulations
  * M928 - Start SD logging: "M928 filename.gco". Stop with M29. (Requires SDSUPPORT)
+ * M930 - Report motion statistics. "M930 R" to also reset them. (Requires MOTION_STATS)
+ * M931 - Report SD card statistics. "M931 R" to also reset them. (Requires SD_READ_AHEAD or SD_BLOCK_CACHE)
+ * M932 - Report the time spent waiting to send serial output. "M932 R" to also reset it. (Requires SERIAL_STATS_TX_BLOCKED)
+ * M933 - Report the time spent in each phase of the stepper ISR. "M933 R" to also reset it. (Requires STEPPER_ISR_PROFILE)
+ * M940 - Switch the serial port to binary frames with "M940 S1", or back to text with "M940 S0". (Requires BINARY_GCODE)
+ * M941 - Report the bytes taken from the RX buffer in "ok" and "Resend:" with "M941 S1", for credit-based streaming. (Requires SERIAL_CREDITS)
+ * M942 - Send binary telemetry frames every S<seconds> or P<ms>. "M942 S0" to stop. (Requires BINARY_TELEMETRY)
  * M999 - Restart after being stopped by error
  *
  * "T" Codes
@@ -419,12 +428,28 @@ static long gcode_N, gcode_LastN, Stopped_gcode_LastN = 0;
  * (immediate, serial, sd card) and they are processed sequentially by
  * the main loop. The process_next_command function parses the next
  * command and hands off execution to individual handler functions.
+ *
+ * With COMMAND_QUEUE_ARENA the indexes are byte offsets into one arena,
+ * where each command is a flags byte followed by its nul-terminated text.
+ * A command is started only where it could grow to MAX_CMD_SIZE, and
+ * the first one that can't start before the end of the arena starts at
+ * the beginning instead, after a CMD_QUEUE_WRAP flags byte.
  */
-uint8_t commands_in_queue = 0, // Count of commands in the queue
-        cmd_queue_index_r = 0, // Ring buffer read (out) position
-        cmd_queue_index_w = 0; // Ring buffer write (in) position
-
-char command_queue[BUFSIZE][MAX_CMD_SIZE];
+uint8_t commands_in_queue = 0;          // Count of commands in the queue
+cmd_queue_index_t cmd_queue_index_r = 0, // Ring buffer read (out) position
+                  cmd_queue_index_w = 0; // Ring buffer write (in) position
+
+#if ENABLED(COMMAND_QUEUE_ARENA)
+  char command_queue[COMMAND_QUEUE_ARENA_SIZE];
+  #define CMD_QUEUE_RECORD (MAX_CMD_SIZE + 1) // Flags and the longest text
+  #define CMD_QUEUE_WRAP 0xFF                 // Flags of the place after the last command before the end
+  #define SEND_OK(I) (command_queue[I] == 1)
+#else
+  char command_queue[BUFSIZE][MAX_CMD_SIZE];
+  #define SEND_OK(I) send_ok[I]
+#endif
+#define QUEUE_R QUEUED_COMMAND(command_queue, cmd_queue_index_r)
+#define QUEUE_W QUEUED_COMMAND(command_queue, cmd_queue_index_w)
 
 /**
  * Next Injected Command pointer. NULL if no commands are being injected.
@@ -651,6 +676,10 @@ uint8_t target_extruder;
 
 #endif
 
+#if ENABLED(ADAPTIVE_SEGMENTATION)
+  float segment_chord_tolerance; // Initialized by settings.load()
+#endif
+
 #if ENABLED(AUTO_BED_LEVELING_BILINEAR)
   int bilinear_grid_spacing[2], bilinear_start[2];
   float bilinear_grid_factor[2],
@@ -704,7 +733,92 @@ float cartes[XYZ] = { 0 };
   #endif
 #endif
 
-static bool send_ok[BUFSIZE];
+#if DISABLED(COMMAND_QUEUE_ARENA)
+  static bool send_ok[BUFSIZE];
+#endif
+
+#if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+  /**
+   * Serial lines are assembled in the free slot at cmd_queue_index_w and
+   * committed only when they are valid. Each slot keeps the number of
+   * parameter letters, or PARAMS_UNKNOWN, followed by their offsets.
+   */
+  #define PARAMS_UNKNOWN 0xFF
+  static uint8_t command_params[BUFSIZE][QUEUED_PARAM_OFFSETS + 1];
+
+  enum SerialLineState : uint8_t {
+    SERIAL_LINE_START,       // Leading spaces
+    SERIAL_LINE_NUMBER,      // N and the line number
+    SERIAL_LINE_NUMBER_END,  // Spaces after the line number
+    SERIAL_LINE_CODE,        // The command letter
+    SERIAL_LINE_CODE_NUM,    // The command number
+    SERIAL_LINE_SUBCODE,     // The command subcode
+    SERIAL_LINE_PARAM,       // Spaces before a parameter letter
+    SERIAL_LINE_LETTER,      // A parameter letter and the spaces after it
+    SERIAL_LINE_VALUE,       // A parameter value
+    SERIAL_LINE_TEXT,        // Anything else, left to the parser
+    SERIAL_LINE_CHECKSUM     // After a '*'
+  };
+  static SerialLineState serial_state; // = SERIAL_LINE_START
+  static uint8_t serial_start,         // Offset of the first character after leading spaces
+                 serial_xor,           // XOR of the characters from serial_start on
+                 serial_star_xor,      // XOR of the characters before the last '*'
+                 serial_m110;          // Characters of "M110" matched so far
+  static uint16_t serial_checksum;     // Value after the last '*'
+  static bool serial_checksum_done;    // A character ended the checksum
+  static long serial_N;                // Value of the line number
+  static bool serial_N_negative;
+  static char serial_sign;             // Sign of the line number or checksum, or 0
+  static bool serial_digits;           // Digits of the line number or checksum were read
+  #define STRTOL_SPACE(c) ((c) == ' ' || WITHIN(c, '\t', '\r'))
+
+  // Other sources need a second free slot while a serial line is in the first
+  #define QUEUE_HAS_ROOM() (commands_in_queue < BUFSIZE - (serial_count ? 1 : 0))
+
+  /**
+   * Move a partial serial line to another free slot
+   */
+  static void move_serial_line(const uint8_t to) {
+    if (!serial_count || to == cmd_queue_index_w) return;
+    memcpy(command_queue[to], command_queue[cmd_queue_index_w], serial_count);
+    COPY(command_params[to], command_params[cmd_queue_index_w]);
+  }
+#elif ENABLED(COMMAND_QUEUE_ARENA)
+
+  /**
+   * Index of the command after the one at i in a queue arena
+   */
+  cmd_queue_index_t next_queued_command(const char * const queue, const cmd_queue_index_t i) {
+    const cmd_queue_index_t n = i + 2 + strlen(&queue[i + 1]); // Flags, text and nul
+    return n >= COMMAND_QUEUE_ARENA_SIZE || uint8_t(queue[n]) == CMD_QUEUE_WRAP ? 0 : n;
+  }
+
+  /**
+   * Return whether a command of up to MAX_CMD_SIZE can start at cmd_queue_index_w.
+   * The first command of an empty queue starts at 0, and one that doesn't fit
+   * before the end of the arena starts at 0 when the commands there are done.
+   * Nothing moves while a command is being written, so this may be called again.
+   */
+  static bool queue_has_room() {
+    if (commands_in_queue >= BUFSIZE) return false;
+    if (!commands_in_queue) cmd_queue_index_r = cmd_queue_index_w = 0;
+
+    // Free bytes are between the last command and the first
+    if (cmd_queue_index_w < cmd_queue_index_r || (commands_in_queue && cmd_queue_index_w == cmd_queue_index_r))
+      return cmd_queue_index_r - cmd_queue_index_w >= CMD_QUEUE_RECORD;
+
+    // Free bytes are after the last command and before the first
+    if (COMMAND_QUEUE_ARENA_SIZE - cmd_queue_index_w >= CMD_QUEUE_RECORD) return true;
+    if (cmd_queue_index_r < CMD_QUEUE_RECORD) return false;
+    if (cmd_queue_index_w < COMMAND_QUEUE_ARENA_SIZE) command_queue[cmd_queue_index_w] = CMD_QUEUE_WRAP;
+    cmd_queue_index_w = 0;
+    return true;
+  }
+  #define QUEUE_HAS_ROOM() queue_has_room()
+
+#else
+  #define QUEUE_HAS_ROOM() (commands_in_queue < BUFSIZE)
+#endif
 
 #if HAS_SERVOS
   Servo servo[NUM_SERVOS];
@@ -880,15 +994,30 @@ void enqueue_and_echo_commands_P(const char * const pgcode) {
  * Clear the Marlin command queue
  */
 void clear_command_queue() {
+  #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+    move_serial_line(0);
+  #endif
   cmd_queue_index_r = cmd_queue_index_w = commands_in_queue = 0;
 }
 
 /**
  * Once a new command is in the ring buffer, call this to commit it
  */
-inline void _commit_command(bool say_ok) {
-  send_ok[cmd_queue_index_w] = say_ok;
-  if (++cmd_queue_index_w >= BUFSIZE) cmd_queue_index_w = 0;
+inline void _commit_command(bool say_ok
+  #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+    , const bool has_params=false
+  #endif
+) {
+  #if ENABLED(COMMAND_QUEUE_ARENA)
+    command_queue[cmd_queue_index_w] = say_ok;
+    cmd_queue_index_w += 2 + strlen(QUEUE_W); // The next command may wrap in queue_has_room()
+  #else
+    send_ok[cmd_queue_index_w] = say_ok;
+    #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+      if (!has_params) command_params[cmd_queue_index_w][0] = PARAMS_UNKNOWN;
+    #endif
+    if (++cmd_queue_index_w >= BUFSIZE) cmd_queue_index_w = 0;
+  #endif
   commands_in_queue++;
 }
 
@@ -898,8 +1027,11 @@ inline void _commit_command(bool say_ok) {
  * Return false for a full buffer, or if the 'command' is a comment.
  */
 inline bool _enqueuecommand(const char* cmd, bool say_ok=false) {
-  if (*cmd == ';' || commands_in_queue >= BUFSIZE) return false;
-  strcpy(command_queue[cmd_queue_index_w], cmd);
+  if (*cmd == ';' || !QUEUE_HAS_ROOM()) return false;
+  #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+    move_serial_line(cmd_queue_index_w + 1 < BUFSIZE ? cmd_queue_index_w + 1 : 0);
+  #endif
+  strcpy(QUEUE_W, cmd);
   _commit_command(say_ok);
   return true;
 }
@@ -1009,6 +1141,10 @@ void servo_init() {
 
 #endif
 
+#if ENABLED(SERIAL_CREDITS)
+  static bool serial_credits; // = false. Set by M941 S1
+#endif
+
 void gcode_line_error(const char* err, bool doFlush = true) {
   SERIAL_ERROR_START();
   serialprintPGM(err);
@@ -1018,13 +1154,417 @@ void gcode_line_error(const char* err, bool doFlush = true) {
   serial_count = 0;
 }
 
+#if ENABLED(BINARY_GCODE)
+
+  /**
+   * Binary G-code transport (M940 S1)
+   *
+   * Frame: 0xB5, sequence, payload length, payload, CRC-16 of sequence to payload (LE)
+   * Command: length of the rest, letter, code number (u16 LE), parameters
+   * Parameter: type << 5 | letter - 'A', then a value of the given type
+   *   0: no value       1: int8           2: int16 (LE)
+   *   3: int24 / 1000   4: int32 / 100000
+   *   7: raw text, prefixed with its length (the letter bits are ignored)
+   *
+   * Frames are acknowledged with "ok F<seq>" once all their commands are queued.
+   * A frame with no payload returns to text.
+   */
+
+  #define BINARY_SYNC 0xB5
+
+  static bool binary_gcode_mode; // = false
+  static uint8_t binary_seq;     // Sequence number of the next frame
+
+  // Append a fixed point number, returning NULL if it doesn't fit
+  static char* binary_number(char *out, const char * const end, const int32_t v, const uint8_t decimals) {
+    char digits[11];
+    uint8_t n = 0;
+    uint32_t u = v < 0 ? 0UL - uint32_t(v) : v;
+    do { digits[n++] = '0' + u % 10; u /= 10; } while (u || n <= decimals);
+    if (out + (v < 0) + n + (decimals != 0) > end) return NULL;
+    if (v < 0) *out++ = '-';
+    while (n) {
+      if (n-- == decimals) *out++ = '.';
+      *out++ = digits[n];
+    }
+    return out;
+  }
+
+  /**
+   * Decode one command of a binary frame into the command queue as text.
+   * Return the number of payload bytes used, or 0 for a malformed command.
+   */
+  static uint8_t decode_binary_command(const uint8_t *p, const uint8_t left) {
+    const uint8_t len = p[0];
+    if (len < 3 || len >= left) return 0;
+
+    const uint8_t *q = p + 4, * const stop = p + 1 + len;
+    char *out = QUEUE_W;
+    const char * const end = out + MAX_CMD_SIZE - 1;
+    *out++ = p[1];
+    out = binary_number(out, end, p[2] | p[3] << 8, 0);
+
+    while (q < stop) {
+      if (!out) return 0;
+      const uint8_t tag = *q++, type = tag >> 5;
+      if (type == 7) {
+        if (q >= stop || q + 1 + *q > stop || out + 1 + *q > end) return 0;
+        *out++ = ' ';
+        for (uint8_t n = *q++; n--;) *out++ = *q++;
+        continue;
+      }
+      if (out + 2 > end) return 0;
+      *out++ = ' ';
+      *out++ = 'A' + (tag & 0x1F);
+
+      uint8_t size, decimals = 0;
+      switch (type) {
+        case 0: continue;
+        case 1: size = 1; break;
+        case 2: size = 2; break;
+        case 3: size = 3; decimals = 3; break;
+        case 4: size = 4; decimals = 5; break;
+        default: return 0;
+      }
+      if (q + size > stop) return 0;
+      int32_t v = 0;
+      for (uint8_t i = size; i--;) v = (v << 8) | q[i];
+      if (size < 4 && TEST(q[size - 1], 7)) v -= 1L << (size * 8); // Sign extend
+      q += size;
+      out = binary_number(out, end, v, decimals);
+    }
+    if (!out) return 0;
+    *out = '\0';
+    return len + 1;
+  }
+
+  /**
+   * Read binary frames and queue their commands. A frame is only
+   * acknowledged when all of its commands have found a place in the queue,
+   * so the host may keep as many frames in flight as fit in the RX buffer.
+   *
+   * A malformed command ends the frame with "Error:Bad binary command F<seq> Q<n>",
+   * where n commands of the frame were queued. The sequence number doesn't move
+   * on, so the host sends the rest of the frame again under the same number.
+   */
+  inline void get_binary_commands() {
+    static uint8_t frame[BINARY_FRAME_SIZE + 4], // Sequence, length, payload, CRC
+                   count,                        // Bytes received, 0 while looking for a frame
+                   pos,                          // Command being queued, 0 if none
+                   queued;                       // Commands of the frame queued so far
+    static bool resend_sent;                     // A resend was requested for the next frame
+
+    for (;;) {
+      if (pos) {
+        // Queue the commands of a checked frame as space allows
+        while (pos < frame[1] + 2) {
+          if (!QUEUE_HAS_ROOM()) return;
+          const uint8_t used = decode_binary_command(frame + pos, frame[1] + 2 - pos);
+          if (!used) break;
+          _commit_command(false);
+          pos += used;
+          queued++;
+        }
+        if (pos < frame[1] + 2) {
+          // Never acknowledge a partly queued frame. The frames in flight behind
+          // it are dropped without asking for a resend, as the error asks for it.
+          SERIAL_ERROR_START();
+          SERIAL_ERRORPGM(MSG_ERR_BINARY_COMMAND " F");
+          SERIAL_ERROR(int(frame[0]));
+          SERIAL_ERRORPGM(" Q");
+          SERIAL_ERRORLN(int(queued));
+          pos = 0;
+          resend_sent = true;
+          continue;
+        }
+        pos = 0;
+        binary_seq++;
+        resend_sent = false;
+        SERIAL_PROTOCOLPGM(MSG_OK " F");
+        SERIAL_PROTOCOLLN(int(frame[0]));
+        if (!frame[1]) {
+          binary_gcode_mode = false;
+          return;
+        }
+        continue;
+      }
+
+      const int c = MYSERIAL0.read();
+      if (c < 0) return;
+      if (!count) {
+        if (c == BINARY_SYNC) count = 1;
+        continue;
+      }
+      frame[count++ - 1] = c;
+      if (count == 3 && frame[1] > BINARY_FRAME_SIZE) count = 0; // Not a frame, look for the next one
+      if (count < 5 || count < frame[1] + 5) continue;
+      count = 0;
+
+      const uint8_t len = frame[1];
+      uint16_t crc = 0;
+      crc16(&crc, frame, len + 2);
+      if (crc == (frame[len + 2] | frame[len + 3] << 8)) {
+        if (frame[0] == binary_seq) {
+          pos = 2;
+          queued = 0;
+          continue;
+        }
+        if (uint8_t(frame[0] + 1) == binary_seq) {
+          // The acknowledgement got lost, so repeat it
+          SERIAL_PROTOCOLPGM(MSG_OK " F");
+          SERIAL_PROTOCOLLN(int(frame[0]));
+          continue;
+        }
+      }
+
+      // Ask once for the frame that was expected, ignoring the ones already in flight
+      if (!resend_sent) {
+        SERIAL_PROTOCOLPGM(MSG_RESEND "F");
+        SERIAL_PROTOCOLLN(int(binary_seq));
+        resend_sent = true;
+      }
+    }
+  }
+
+#endif // BINARY_GCODE
+
+#if ENABLED(BINARY_TELEMETRY)
+
+  /**
+   * Binary telemetry (M942)
+   *
+   * Frame: 0xB6, sequence, payload length, payload, CRC-16 of sequence to payload (LE)
+   * Payload: time in ms (u32), group mask (u8), then each group of the mask:
+   *          its length (u8) and fields. All fields are little-endian.
+   *   0: Temperature * 10 (i16) and target (i16) of each hotend
+   *   1: Heater PWM (u8) of each hotend
+   *   2: Bed temperature * 10 (i16), target (i16) and PWM (u8)
+   *   3: Planned moves (u8), queued commands (u8)
+   *   4: Position of X, Y, Z and E in microns (i32)
+   *   5: SD file position (u32) and size (u32), zero with no file open
+   *   6: Speed (u8) of each fan
+   *
+   * Bit 7 of the mask marks a key frame, which holds every group. Other frames
+   * only hold the groups that changed since the frame before, so after a lost
+   * frame the host waits for the next key frame.
+   */
+
+  #define TELEMETRY_SYNC 0xB6
+  #define TELEMETRY_GROUPS 7
+  #define TELEMETRY_FIELD_BYTES (HOTENDS * 5 + 5 + 2 + 4 * 4 + 8 + FAN_COUNT)
+
+  static uint16_t telemetry_interval_ms;   // = 0 (off). Set by M942.
+  static millis_t next_telemetry_ms;
+  static uint8_t telemetry_seq,            // Sequence number of the next frame
+                 telemetry_key_countdown;  // Frames to send before the next key frame
+
+  // Append a little-endian field
+  static uint8_t* telemetry_field(uint8_t *p, uint32_t v, uint8_t size) {
+    while (size--) { *p++ = v; v >>= 8; }
+    return p;
+  }
+
+  /**
+   * Send a telemetry frame when one is due. The fields are only copied from
+   * the printer state, with no formatting, and the frame is written at once
+   * so other output can't split it.
+   */
+  static void report_telemetry() {
+    const millis_t ms = millis();
+    if (!telemetry_interval_ms || PENDING(ms, next_telemetry_ms)) return;
+    next_telemetry_ms = ms + telemetry_interval_ms;
+
+    static uint8_t frame[3 + 5 + TELEMETRY_GROUPS + TELEMETRY_FIELD_BYTES + 2],
+                   last[TELEMETRY_FIELD_BYTES]; // Fields of the groups last sent
+
+    const bool key = !telemetry_key_countdown;
+    telemetry_key_countdown = key ? TELEMETRY_KEY_FRAMES - 1 : telemetry_key_countdown - 1;
+
+    uint8_t *p = telemetry_field(frame + 3, ms, 4), * const mask = p++, *l = last;
+    *mask = key ? 0x80 : 0;
+    for (uint8_t g = 0; g < TELEMETRY_GROUPS; g++) {
+      uint8_t * const fields = p + 1, *q = fields;
+      switch (g) {
+        case 0:
+          HOTEND_LOOP() {
+            q = telemetry_field(q, int16_t(thermalManager.degHotend(e) * 10), 2);
+            q = telemetry_field(q, thermalManager.degTargetHotend(e), 2);
+          }
+          break;
+        case 1:
+          HOTEND_LOOP() *q++ = thermalManager.getHeaterPower(e);
+          break;
+        case 2:
+          #if HAS_HEATED_BED
+            q = telemetry_field(q, int16_t(thermalManager.degBed() * 10), 2);
+            q = telemetry_field(q, thermalManager.degTargetBed(), 2);
+            *q++ = thermalManager.getHeaterPower(-1);
+          #endif
+          break;
+        case 3:
+          *q++ = planner.movesplanned();
+          *q++ = commands_in_queue;
+          break;
+        case 4:
+          LOOP_XYZE(i) q = telemetry_field(q, LROUND(current_position[i] * 1000), 4);
+          break;
+        case 5:
+          #if ENABLED(SDSUPPORT)
+            q = telemetry_field(q, card.isFileOpen() ? card.getIndex() : 0, 4);
+            q = telemetry_field(q, card.isFileOpen() ? card.getFileSize() : 0, 4);
+          #endif
+          break;
+        case 6:
+          #if FAN_COUNT > 0
+            for (uint8_t i = 0; i < FAN_COUNT; i++) *q++ = MIN(fanSpeeds[i], 255);
+          #endif
+          break;
+      }
+      // The groups in this build always have the same length
+      const uint8_t len = q - fields;
+      if (!len) continue;
+      if (key || memcmp(fields, l, len)) {
+        memcpy(l, fields, len);
+        *p = len;
+        p = q;
+        SBI(*mask, g);
+      }
+      l += len;
+    }
+
+    frame[0] = TELEMETRY_SYNC;
+    frame[1] = telemetry_seq++;
+    frame[2] = p - (frame + 3);
+    uint16_t crc = 0;
+    crc16(&crc, frame + 1, p - (frame + 1));
+    *p++ = crc & 0xFF;
+    *p++ = crc >> 8;
+    for (const uint8_t *b = frame; b < p; b++) MYSERIAL0.write(*b);
+  }
+
+#endif // BINARY_TELEMETRY
+
 /**
  * Get all commands waiting on the serial port and queue them.
  * Exit when the buffer is full or when no more characters are
  * left on the serial port.
  */
+#if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+
+  inline void serial_line_reset() {
+    serial_count = 0;
+    serial_state = SERIAL_LINE_START;
+  }
+
+  /**
+   * Store a character of the serial line in the free queue slot, and
+   * follow the line number, checksum, and parameter letters as it goes
+   */
+  static void serial_line_char(const char c) {
+    const uint8_t i = serial_count++;
+    command_queue[cmd_queue_index_w][i] = c;
+    uint8_t * const params = command_params[cmd_queue_index_w];
+
+    if (serial_state == SERIAL_LINE_START) {
+      if (!i) { serial_start = 0; params[0] = 0; }
+      if (c == ' ') { serial_start = i + 1; return; }   // Leading spaces aren't checksummed
+      serial_xor = serial_m110 = 0;
+      serial_N = 0;
+      serial_N_negative = false;
+      serial_sign = 0;
+      serial_digits = false;
+      serial_state = c == 'N' ? SERIAL_LINE_NUMBER : SERIAL_LINE_CODE;
+    }
+    else if (c == '*') {                                // The checksum follows the last '*'
+      serial_star_xor = serial_xor;
+      serial_checksum = 0;
+      serial_checksum_done = false;
+      serial_sign = 0;
+      serial_digits = false;
+      serial_state = SERIAL_LINE_CHECKSUM;
+    }
+    else {
+      switch (serial_state) {
+        // The line number is read as strtol() would, and the parser skips N[-+0-9][0-9]* and spaces
+        case SERIAL_LINE_NUMBER:
+          if (NUMERIC(c)) {
+            serial_N = MIN(serial_N, 100000000L) * 10 + (c - '0');
+            serial_digits = true;
+            break;
+          }
+          if (!serial_digits && !serial_sign) {
+            if (c == '-' || c == '+') { serial_sign = c; serial_N_negative = c == '-'; break; }
+            if (STRTOL_SPACE(c)) { params[0] = PARAMS_UNKNOWN; break; } // The parser won't skip "N "
+          }
+          serial_state = c == ' ' ? SERIAL_LINE_NUMBER_END : SERIAL_LINE_CODE;
+          break;
+
+        case SERIAL_LINE_NUMBER_END:
+          if (c != ' ') serial_state = SERIAL_LINE_CODE;
+          break;
+
+        case SERIAL_LINE_CODE:
+          if (NUMERIC(c)) serial_state = SERIAL_LINE_CODE_NUM;
+          else if (c != ' ') serial_state = SERIAL_LINE_TEXT;
+          break;
+
+        // Find the parameter letters where the parser's loop would
+        case SERIAL_LINE_CODE_NUM:
+        case SERIAL_LINE_SUBCODE:
+        case SERIAL_LINE_VALUE:
+          if (serial_state == SERIAL_LINE_VALUE ? DECIMAL_SIGNED(c) : NUMERIC(c)) break;
+          #if USE_GCODE_SUBCODES
+            if (c == '.' && serial_state == SERIAL_LINE_CODE_NUM) { serial_state = SERIAL_LINE_SUBCODE; break; }
+          #endif
+          if (c == ' ') { serial_state = SERIAL_LINE_PARAM; break; }
+          // fall through
+
+        case SERIAL_LINE_PARAM:
+        case SERIAL_LINE_LETTER:
+          if (WITHIN(c, 'A', 'Z')) {
+            if (params[0] < QUEUED_PARAM_OFFSETS) {
+              params[++params[0]] = i;
+              serial_state = SERIAL_LINE_LETTER;
+            }
+            else
+              serial_state = SERIAL_LINE_TEXT;
+          }
+          else if (serial_state == SERIAL_LINE_LETTER && DECIMAL_SIGNED(c))
+            serial_state = SERIAL_LINE_VALUE;
+          else if (c != ' ')                            // A string, left to the parser
+            serial_state = SERIAL_LINE_TEXT;
+          break;
+
+        case SERIAL_LINE_CHECKSUM:                      // Also read as strtol() would
+          if (serial_checksum_done) break;
+          if (NUMERIC(c)) {
+            serial_checksum = MIN(serial_checksum, 256) * 10 + (c - '0');
+            serial_digits = true;
+          }
+          else if (serial_digits || serial_sign || !(STRTOL_SPACE(c) || c == '-' || c == '+'))
+            serial_checksum_done = true;
+          else if (c == '-' || c == '+')
+            serial_sign = c;
+          break;
+
+        default: break;
+      }
+      if (serial_state == SERIAL_LINE_TEXT) params[0] = PARAMS_UNKNOWN;
+    }
+
+    serial_xor ^= c;
+    if (serial_m110 < 4) {                              // Look for "M110" anywhere in the line
+      const char m110 = serial_m110 ? (serial_m110 < 3 ? '1' : '0') : 'M';
+      serial_m110 = c == m110 ? serial_m110 + 1 : (c == 'M');
+    }
+  }
+
+#endif // ZERO_COPY_COMMAND_QUEUE
+
 inline void get_serial_commands() {
-  static char serial_line_buffer[MAX_CMD_SIZE];
+  #if DISABLED(ZERO_COPY_COMMAND_QUEUE)
+    static char serial_line_buffer[MAX_CMD_SIZE];
+  #endif
   static bool serial_comment_mode = false;
 
   // If the command buffer is empty for too long,
@@ -1038,11 +1578,22 @@ inline void get_serial_commands() {
     }
   #endif
 
+  #if ENABLED(BINARY_GCODE)
+    if (binary_gcode_mode) return get_binary_commands();
+  #endif
+
   /**
    * Loop while serial characters are incoming and the queue is not full
    */
   int c;
-  while (commands_in_queue < BUFSIZE && (c = MYSERIAL0.read()) >= 0) {
+  while (
+    #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+      commands_in_queue < BUFSIZE // The line is already in the free slot
+    #else
+      QUEUE_HAS_ROOM()
+    #endif
+    && (c = MYSERIAL0.read()) >= 0
+  ) {
 
     char serial_char = c;
 
@@ -1056,66 +1607,79 @@ inline void get_serial_commands() {
       // Skip empty lines and comments
       if (!serial_count) { thermalManager.manage_heater(); continue; }
 
-      serial_line_buffer[serial_count] = 0;             // Terminate string
-      serial_count = 0;                                 // Reset buffer
+      #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+        command_queue[cmd_queue_index_w][serial_count] = 0; // Terminate string
+        char* command = command_queue[cmd_queue_index_w] + serial_start; // Skip leading spaces
+        const bool has_checksum = serial_state == SERIAL_LINE_CHECKSUM;
+        serial_line_reset();
+      #else
+        serial_line_buffer[serial_count] = 0;             // Terminate string
+        serial_count = 0;                                 // Reset buffer
 
-      char* command = serial_line_buffer;
+        char* command = serial_line_buffer;
 
-      while (*command == ' ') command++;                // Skip leading spaces
+        while (*command == ' ') command++;                // Skip leading spaces
+      #endif
       char *npos = (*command == 'N') ? command : NULL;  // Require the N parameter to start the line
 
       if (npos) {
 
-        bool M110 = strstr_P(command, PSTR("M110")) != NULL;
+        #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
 
-        if (M110) {
-          char* n2pos = strchr(command + 4, 'N');
-          if (n2pos) npos = n2pos;
-        }
+          // The line number and checksum were read with the characters
+          const bool M110 = serial_m110 == 4;
 
-        gcode_N = strtol(npos + 1, NULL, 10);
+          gcode_N = serial_N_negative ? -serial_N : serial_N;
+          if (M110) {
+            char* n2pos = strchr(command + 4, 'N');
+            if (n2pos) gcode_N = strtol(n2pos + 1, NULL, 10);
+          }
 
-        if (gcode_N != gcode_LastN + 1 && !M110)
-          return gcode_line_error(PSTR(MSG_ERR_LINE_NO));
+          if (gcode_N != gcode_LastN + 1 && !M110)
+            return gcode_line_error(PSTR(MSG_ERR_LINE_NO));
 
-        char *apos = strrchr(command, '*');
-        if (apos) {
-          uint8_t checksum = 0, count = uint8_t(apos - command);
-          while (count) checksum ^= command[--count];
-          if (strtol(apos + 1, NULL, 10) != checksum)
+          if (!has_checksum)
+            return gcode_line_error(PSTR(MSG_ERR_NO_CHECKSUM));
+          if (serial_checksum != serial_star_xor || (serial_sign == '-' && serial_checksum))
             return gcode_line_error(PSTR(MSG_ERR_CHECKSUM_MISMATCH));
-        }
-        else
-          return gcode_line_error(PSTR(MSG_ERR_NO_CHECKSUM));
+
+        #else
+
+          bool M110 = strstr_P(command, PSTR("M110")) != NULL;
+
+          if (M110) {
+            char* n2pos = strchr(command + 4, 'N');
+            if (n2pos) npos = n2pos;
+          }
+
+          gcode_N = strtol(npos + 1, NULL, 10);
+
+          if (gcode_N != gcode_LastN + 1 && !M110)
+            return gcode_line_error(PSTR(MSG_ERR_LINE_NO));
+
+          char *apos = strrchr(command, '*');
+          if (apos) {
+            uint8_t checksum = 0, count = uint8_t(apos - command);
+            while (count) checksum ^= command[--count];
+            if (strtol(apos + 1, NULL, 10) != checksum)
+              return gcode_line_error(PSTR(MSG_ERR_CHECKSUM_MISMATCH));
+          }
+          else
+            return gcode_line_error(PSTR(MSG_ERR_NO_CHECKSUM));
+
+        #endif
 
         gcode_LastN = gcode_N;
       }
+      #if ENABLED(SERIAL_CREDITS)
+        else if (serial_credits) // Streamed lines must have numbers, so the rest of a flushed line won't run
+          return gcode_line_error(PSTR(MSG_ERR_NO_CHECKSUM));
+      #endif
       #if ENABLED(SDSUPPORT)
         else if (card.saving && strcmp(command, "M29") != 0) // No line number with M29 in Pronterface
           return gcode_line_error(PSTR(MSG_ERR_NO_CHECKSUM));
       #endif
 
-      // Movement commands alert when stopped
-      if (IsStopped()) {
-        char* gpos = strchr(command, 'G');
-        if (gpos) {
-          switch (strtol(gpos + 1, NULL, 10)) {
-            case 0:
-            case 1:
-            #if ENABLED(ARC_SUPPORT)
-              case 2:
-              case 3:
-            #endif
-            #if ENABLED(BEZIER_CURVE_SUPPORT)
-              case 5:
-            #endif
-              SERIAL_ERRORLNPGM(MSG_ERR_STOPPED);
-              LCD_MESSAGEPGM(MSG_STOPPED);
-              break;
-          }
-        }
-      }
-
       #if DISABLED(EMERGENCY_PARSER)
         // Process critical commands early
         if (strcmp(command, "M108") == 0) {
@@ -1133,7 +1697,11 @@ inline void get_serial_commands() {
       #endif
 
       // Add the command to the queue
-      _enqueuecommand(serial_line_buffer, true);
+      #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+        _commit_command(true, true);
+      #else
+        _enqueuecommand(serial_line_buffer, true);
+      #endif
     }
     else if (serial_count >= MAX_CMD_SIZE - 1) {
       // Keep fetching, but ignore normal characters beyond the max length
@@ -1141,12 +1709,21 @@ inline void get_serial_commands() {
     }
     else if (serial_char == '\\') {   // Handle escapes
       if ((c = MYSERIAL0.read()) >= 0 && !serial_comment_mode) // if we have one more character, copy it over
-        serial_line_buffer[serial_count++] = (char)c;
+        #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+          serial_line_char((char)c);
+        #else
+          serial_line_buffer[serial_count++] = (char)c;
+        #endif
       // otherwise do nothing
     }
     else { // it's not a newline, carriage return or escape char
       if (serial_char == ';') serial_comment_mode = true;
-      if (!serial_comment_mode) serial_line_buffer[serial_count++] = serial_char;
+      if (!serial_comment_mode)
+        #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+          serial_line_char(serial_char);
+        #else
+          serial_line_buffer[serial_count++] = serial_char;
+        #endif
     }
 
   } // queue has space, serial has data
@@ -1180,7 +1757,7 @@ inline void get_serial_commands() {
 
     uint16_t sd_count = 0;
     bool card_eof = card.eof();
-    while (commands_in_queue < BUFSIZE && !card_eof && !stop_buffering) {
+    while (QUEUE_HAS_ROOM() && !card_eof && !stop_buffering) {
       const int16_t n = card.get();
       char sd_char = (char)n;
       card_eof = card.eof();
@@ -1226,7 +1803,7 @@ inline void get_serial_commands() {
         // Skip empty lines and comments
         if (!sd_count) { thermalManager.manage_heater(); continue; }
 
-        command_queue[cmd_queue_index_w][sd_count] = '\0'; // terminate string
+        QUEUE_W[sd_count] = '\0'; // terminate string
         sd_count = 0; // clear sd line buffer
 
         _commit_command(false);
@@ -1239,7 +1816,12 @@ inline void get_serial_commands() {
       }
       else {
         if (sd_char == ';') sd_comment_mode = true;
-        if (!sd_comment_mode) command_queue[cmd_queue_index_w][sd_count++] = sd_char;
+        if (!sd_comment_mode) {
+          #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+            if (!sd_count) move_serial_line(cmd_queue_index_w + 1 < BUFSIZE ? cmd_queue_index_w + 1 : 0);
+          #endif
+          QUEUE_W[sd_count++] = sd_char;
+        }
       }
     }
   }
@@ -1247,10 +1829,19 @@ inline void get_serial_commands() {
   #if ENABLED(POWER_LOSS_RECOVERY)
 
     inline bool drain_job_recovery_commands() {
-      static uint8_t job_recovery_commands_index = 0; // Resets on reboot
+      #if ENABLED(COMMAND_QUEUE_ARENA)
+        static char *cmd = job_recovery_commands; // Packed one after another, resets on reboot
+      #else
+        static uint8_t job_recovery_commands_index = 0; // Resets on reboot
+        char * const cmd = job_recovery_commands[job_recovery_commands_index];
+      #endif
       if (job_recovery_commands_count) {
-        if (_enqueuecommand(job_recovery_commands[job_recovery_commands_index])) {
-          ++job_recovery_commands_index;
+        if (_enqueuecommand(cmd)) {
+          #if ENABLED(COMMAND_QUEUE_ARENA)
+            cmd += strlen(cmd) + 1;
+          #else
+            ++job_recovery_commands_index;
+          #endif
           if (!--job_recovery_commands_count) job_recovery_phase = JOB_RECOVERY_DONE;
         }
         return true;
@@ -3339,7 +3930,11 @@ static void homeaxis(const AxisEnum axis) {
 void gcode_get_destination() {
   LOOP_XYZE(i) {
     if (parser.seen(axis_codes[i])) {
-      const float v = parser.value_axis_units((AxisEnum)i);
+      const float v =
+        #if ENABLED(GCODE_G1_FAST_PATH)
+          parser.fast_move ? parser.move_value[i] :
+        #endif
+        parser.value_axis_units((AxisEnum)i);
       destination[i] = (axis_relative_modes[i] || relative_mode)
         ? current_position[i] + v
         : (i == E_CART) ? v : LOGICAL_TO_NATIVE(v, i);
@@ -3348,6 +3943,12 @@ void gcode_get_destination() {
       destination[i] = current_position[i];
   }
 
+  #if ENABLED(GCODE_G1_FAST_PATH)
+    if (parser.fast_move) {
+      if (parser.move_value[XYZE] > 0) feedrate_mm_s = MMM_TO_MMS(parser.move_value[XYZE]);
+    }
+    else
+  #endif
   if (parser.linearval('F') > 0)
     feedrate_mm_s = MMM_TO_MMS(parser.value_feedrate());
 
@@ -3414,7 +4015,7 @@ inline void gcode_G0_G1(
     bool fast_move=false
   #endif
 ) {
-  if (IsRunning() && G0_G1_CONDITION) {
+  if (G0_G1_CONDITION) { // The dispatcher refuses G0/G1 while Stopped
     gcode_get_destination(); // For X Y Z E F
 
     #if ENABLED(FWRETRACT)
@@ -3624,8 +4225,112 @@ inline void gcode_G4() {
    *   S1 for absolute moves
    *   S2 for saving recording new line length after unregistered move
    *        (typically used while tuning LINE_BUILDUP_COMPENSATION_FEATURE parameters)
+   *   S3 for a binary step stream played directly by the stepper ISR (STEP_STREAM)
    */
 
+  #if ENABLED(STEP_STREAM)
+
+    /**
+     * G6 S3: Binary step stream
+     *
+     * After "STREAM" the host sends 8-byte frames:
+     *   0: 0xA0 | dir << 3 | axis, 0xFE to start playback, 0xFF to end the stream
+     *   1-2: interval, ticks from the previous step of the axis (little endian)
+     *   3-4: count, number of steps (0 for a pure delay)
+     *   5-6: add, signed change of the interval after each step
+     *   7: XOR of bytes 0-6
+     * Each frame is answered with ACK (0x06) once queued, or NAK (0x15), which aborts
+     * the stream. Playback also starts when a queue fills up. At the end the steppers
+     * are known to be where the stream left them.
+     */
+    #define STREAM_ACK  0x06
+    #define STREAM_NAK  0x15
+    #define STREAM_TIMEOUT 2000UL // (ms) Longest pause between bytes
+
+    inline void gcode_G6_stream() {
+      planner.synchronize();
+      enable_all_steppers();
+
+      // Keep busy messages and auto reports out of the binary stream
+      #if HAS_AUTO_REPORTING || ENABLED(HOST_KEEPALIVE_FEATURE)
+        const bool was_suspended = suspend_auto_report;
+        suspend_auto_report = true;
+      #endif
+
+      SERIAL_ECHOLNPGM("STREAM");
+
+      uint8_t frame[8], got = 0;
+      bool ok = true;
+      millis_t timeout = millis() + STREAM_TIMEOUT;
+      for (;;) {
+        idle();
+        previous_move_ms = millis(); // Keep the steppers powered
+
+        const int c = MYSERIAL0.read();
+        if (c < 0) {
+          if (ELAPSED(millis(), timeout)) { ok = false; break; }
+          continue;
+        }
+        timeout = millis() + STREAM_TIMEOUT;
+        frame[got++] = c;
+        if (got < COUNT(frame)) continue;
+        got = 0;
+
+        uint8_t sum = 0;
+        for (uint8_t i = 0; i < COUNT(frame) - 1; i++) sum ^= frame[i];
+        const uint8_t axis = frame[0] & 0x07;
+        if (sum != frame[7] || (frame[0] < 0xFE && ((frame[0] & 0xF0) != 0xA0 || axis >= NUM_AXIS))) {
+          SERIAL_CHAR(STREAM_NAK);
+          ok = false;
+          break;
+        }
+
+        if (frame[0] == 0xFF) {
+          SERIAL_CHAR(STREAM_ACK);
+          break;
+        }
+        if (frame[0] == 0xFE)
+          stepper.stream_start();
+        else {
+          const stream_chunk_t chunk = {
+            uint16_t(frame[1] | frame[2] << 8),
+            uint16_t(frame[3] | frame[4] << 8),
+            int16_t(frame[5] | frame[6] << 8),
+            TEST(frame[0], 3)
+          };
+          while (!stepper.stream_push((AxisEnum)axis, chunk)) {
+            // A full queue means the host has buffered enough to begin
+            stepper.stream_start();
+            idle();
+            previous_move_ms = millis();
+          }
+        }
+        SERIAL_CHAR(STREAM_ACK);
+      }
+
+      if (ok) {
+        stepper.stream_start();
+        while (stepper.stream_busy()) {
+          idle();
+          previous_move_ms = millis();
+        }
+      }
+      stepper.stream_stop();
+
+      // The stream moved the steppers behind the planner's back
+      set_current_from_steppers_for_axis(ALL_AXES);
+      SYNC_PLAN_POSITION_KINEMATIC();
+
+      #if HAS_AUTO_REPORTING || ENABLED(HOST_KEEPALIVE_FEATURE)
+        suspend_auto_report = was_suspended;
+      #endif
+
+      if (!ok) SERIAL_ERROR_START();
+      SERIAL_ECHOLNPAIR("STREAM END underruns:", stepper.stream_underruns);
+    }
+
+  #endif // STEP_STREAM
+
   /**
    * G6: Direct Stepper Move
    */
@@ -3634,6 +4339,12 @@ inline void gcode_G4() {
     #if ENABLED(NO_MOTION_BEFORE_HOMING)
       if (axis_unhomed_error()) return;
     #endif
+    #if ENABLED(STEP_STREAM)
+      if (parser.byteval('S') == 3) {
+        if (IsRunning()) gcode_G6_stream();
+        return;
+      }
+    #endif
     if (IsRunning()) {
       float go[MOV_AXIS] = { 0.0 },
             tmp_fr_mm_s = 0.0;
@@ -9281,6 +9992,34 @@ inline void gcode_M115() {
       #endif
     );
 
+    // BINARY_GCODE (M940)
+    cap_line(PSTR("BINARY_GCODE")
+      #if ENABLED(BINARY_GCODE)
+        , true
+      #endif
+    );
+
+    // SERIAL_CREDITS (M941)
+    cap_line(PSTR("SERIAL_CREDITS")
+      #if ENABLED(SERIAL_CREDITS)
+        , true
+      #endif
+    );
+
+    // BINARY_TELEMETRY (M942)
+    cap_line(PSTR("BINARY_TELEMETRY")
+      #if ENABLED(BINARY_TELEMETRY)
+        , true
+      #endif
+    );
+
+    // INPUT_SHAPING (M593)
+    cap_line(PSTR("INPUT_SHAPING")
+      #if ENABLED(INPUT_SHAPING)
+        , true
+      #endif
+    );
+
   #endif // EXTENDED_CAPABILITIES_REPORT
 }
 
@@ -9601,6 +10340,7 @@ inline void gcode_M205() {
    *    L = diagonal rod
    *    R = delta radius
    *    S = segments per second
+   *    C = segment chord tolerance (ADAPTIVE_SEGMENTATION)
    *    B = delta calibration radius
    *    X = Alpha (Tower 1) angle trim
    *    Y = Beta (Tower 2) angle trim
@@ -9611,6 +10351,9 @@ inline void gcode_M205() {
     if (parser.seen('L')) delta_diagonal_rod             = parser.value_linear_units();
     if (parser.seen('R')) delta_radius                   = parser.value_linear_units();
     if (parser.seen('S')) delta_segments_per_second      = parser.value_float();
+    #if ENABLED(ADAPTIVE_SEGMENTATION)
+      if (parser.seen('C')) segment_chord_tolerance      = MAX(parser.value_linear_units(), 0.001f);
+    #endif
     if (parser.seen('B')) delta_calibration_radius       = parser.value_float();
     if (parser.seen('X')) delta_tower_angle_trim[A_AXIS] = parser.value_float();
     if (parser.seen('Y')) delta_tower_angle_trim[B_AXIS] = parser.value_float();
@@ -9699,6 +10442,7 @@ inline void gcode_M205() {
    *   O[anchor_C_z] - C-anchor's z coordinate (see note)
    *   P[anchor_D_z] - D-anchor's z coordinate (see note)
    *   S[segments-per-second] - Segments-per-second
+   *   C[chord-tolerance]     - Segment chord tolerance (ADAPTIVE_SEGMENTATION)
    *
    * Note: All xyz coordinates are measured relative to the line's pivot point in the mover,
    *         when it is at its home position (nozzle in (0,0,0), and lines tight).
@@ -9716,6 +10460,9 @@ inline void gcode_M205() {
     if (parser.seen('O')) anchor_C_z                = parser.value_float();
     if (parser.seen('P')) anchor_D_z                = parser.value_float();
     if (parser.seen('S')) delta_segments_per_second = parser.value_float();
+    #if ENABLED(ADAPTIVE_SEGMENTATION)
+      if (parser.seen('C')) segment_chord_tolerance = MAX(parser.value_linear_units(), 0.001f);
+    #endif
     recalc_hangprinter_settings();
   }
 
@@ -10849,17 +11596,78 @@ inline void gcode_M502() {
 
 #endif // ABORT_ON_ENDSTOP_HIT_FEATURE_ENABLED
 
-#if HAS_BED_PROBE
+#if ENABLED(INPUT_SHAPING)
 
-  inline void gcode_M851() {
-    if (parser.seenval('Z')) {
-      const float value = parser.value_linear_units();
-      if (WITHIN(value, Z_PROBE_OFFSET_RANGE_MIN, Z_PROBE_OFFSET_RANGE_MAX))
-        zprobe_zoffset = value;
-      else {
-        SERIAL_ERROR_START();
-        SERIAL_ERRORLNPGM("?Z out of range (" STRINGIFY(Z_PROBE_OFFSET_RANGE_MIN) " to " STRINGIFY(Z_PROBE_OFFSET_RANGE_MAX) ")");
-      }
+  /**
+   * M593: Get or set the input shaping of X and Y. Reports the settings with no arguments.
+   *
+   *  X / Y       - Set only this axis (default both)
+   *  T<type>     - Shaper: 0=ZV 1=ZVD 2=MZV
+   *  F<freq>     - Ringing frequency in Hz (5-200), 0 to disable
+   *  D<zeta>     - Damping ratio (0-0.99)
+   */
+  inline void gcode_M593() {
+    const bool seen_x = parser.seen('X'), seen_y = parser.seen('Y');
+    bool set = false;
+
+    uint8_t type[SHAPING_AXES];
+    float freq[SHAPING_AXES], zeta[SHAPING_AXES];
+    for (uint8_t a = 0; a < SHAPING_AXES; a++) {
+      type[a] = stepper.shaping_type[a];
+      freq[a] = stepper.shaping_frequency[a];
+      zeta[a] = stepper.shaping_zeta[a];
+    }
+
+    #define M593_SET(A, V) for (uint8_t a = 0; a < SHAPING_AXES; a++) if ((a ? seen_y : seen_x) || !(seen_x || seen_y)) A[a] = V
+
+    if (parser.seenval('T')) {
+      const uint8_t t = parser.value_byte();
+      if (t <= SHAPER_MZV) { M593_SET(type, t); set = true; }
+      else { SERIAL_PROTOCOLLNPGM("?T value out of range (0-2)."); return; }
+    }
+    if (parser.seenval('F')) {
+      const float f = parser.value_float();
+      if (!f || WITHIN(f, 5, 200)) { M593_SET(freq, f); set = true; }
+      else { SERIAL_PROTOCOLLNPGM("?F value out of range (5-200)."); return; }
+    }
+    if (parser.seenval('D')) {
+      const float d = parser.value_float();
+      if (WITHIN(d, 0, 0.99)) { M593_SET(zeta, d); set = true; }
+      else { SERIAL_PROTOCOLLNPGM("?D value out of range (0-0.99)."); return; }
+    }
+
+    if (set) {
+      // Let the pending echoes play out with the impulses they started with
+      planner.synchronize();
+      for (uint8_t a = 0; a < SHAPING_AXES; a++) {
+        stepper.shaping_type[a] = type[a];
+        stepper.shaping_frequency[a] = freq[a];
+        stepper.shaping_zeta[a] = zeta[a];
+      }
+      stepper.refresh_shaping();
+    }
+    else for (uint8_t a = 0; a < SHAPING_AXES; a++) {
+      SERIAL_ECHO_START();
+      SERIAL_ECHOPAIR("Input shaping ", axis_codes[a]);
+      SERIAL_ECHOPAIR(" T", int(type[a]));
+      SERIAL_ECHOPAIR(" F", freq[a]);
+      SERIAL_ECHOLNPAIR(" D", zeta[a]);
+    }
+  }
+
+#endif // INPUT_SHAPING
+
+#if HAS_BED_PROBE
+
+  inline void gcode_M851() {
+    if (parser.seenval('Z')) {
+      const float value = parser.value_linear_units();
+      if (WITHIN(value, Z_PROBE_OFFSET_RANGE_MIN, Z_PROBE_OFFSET_RANGE_MAX))
+        zprobe_zoffset = value;
+      else {
+        SERIAL_ERROR_START();
+        SERIAL_ERRORLNPGM("?Z out of range (" STRINGIFY(Z_PROBE_OFFSET_RANGE_MIN) " to " STRINGIFY(Z_PROBE_OFFSET_RANGE_MAX) ")");
+      }
       return;
     }
     SERIAL_ECHO_START();
@@ -12083,6 +12891,247 @@ inline void gcode_M355() {
 
 #endif // MIXING_EXTRUDER
 
+#if ENABLED(MOTION_STATS)
+  /**
+   * M930: Report motion statistics gathered since the last reset
+   *
+   *  R   Reset the counters after reporting
+   *
+   * The planner capacity is how many blocks per second the planner could
+   * queue if it did nothing else, evals per block counts the junction and
+   * trapezoid evaluations recalculate() needed for each, and ISR ticks per
+   * step event measures the stepper ISR cost in stepper timer ticks
+   * (STEPPER_TIMER_RATE). Starved counts the times the stepper ran out of
+   * blocks and the next move came within half a second, leaving out the
+   * waits of planner.synchronize(). With ADAPTIVE_MULTISTEPPING, the count
+   * of blocks run at each multiplier follows.
+   */
+  inline void gcode_M930() {
+    const bool reset = parser.seen('R');
+
+    uint32_t isr_ticks, step_events;
+    uint16_t starved;
+    stepper.get_stats(isr_ticks, step_events, starved, reset);
+
+    const uint32_t blocks = planner.stats_blocks,
+                   plan_us = planner.stats_plan_us,
+                   elapsed_ms = millis() - planner.stats_since_ms;
+
+    SERIAL_ECHO_START();
+    SERIAL_ECHOPAIR("Planner blocks:", blocks);
+    SERIAL_ECHOPAIR(" in ", elapsed_ms);
+    SERIAL_ECHOPAIR("ms avg:", blocks ? plan_us / blocks : 0UL);
+    SERIAL_ECHOPAIR("us max:", planner.stats_plan_us_max);
+    SERIAL_ECHOPAIR("us capacity:", plan_us ? float(blocks) * 1000000.0f / float(plan_us) : 0.0f);
+    SERIAL_ECHOPGM(" blk/s");
+    SERIAL_ECHOPAIR(" evals/blk:", blocks ? float(planner.stats_evals) / float(blocks) : 0.0f);
+    #if ENABLED(BLOCK_MERGING)
+      SERIAL_ECHOPAIR(" merged:", planner.stats_merged);
+    #endif
+    SERIAL_EOL();
+
+    SERIAL_ECHO_START();
+    SERIAL_ECHOPAIR("Stepper events:", step_events);
+    SERIAL_ECHOPAIR(" ISR ticks/event:", step_events ? float(isr_ticks) / float(step_events) : 0.0f);
+    SERIAL_ECHOLNPAIR(" starved:", starved);
+
+    #if ENABLED(ADAPTIVE_MULTISTEPPING)
+      uint16_t multistep[8];
+      stepper.get_multistep_stats(multistep, reset);
+      SERIAL_ECHO_START();
+      SERIAL_ECHOPGM("Multistep blocks");
+      for (uint8_t i = 0; i < 8; i++) {
+        SERIAL_CHAR(' ');
+        SERIAL_ECHO(int(_BV(i)));
+        SERIAL_ECHOPAIR("x:", multistep[i]);
+      }
+      SERIAL_EOL();
+    #endif
+
+    if (reset) planner.reset_stats();
+  }
+#endif
+
+#if ENABLED(SD_READ_AHEAD) || ENABLED(SD_BLOCK_CACHE)
+  /**
+   * M931: Report SD card statistics gathered since the last reset
+   *
+   *  R   Reset the counters after reporting
+   *
+   * With SD_READ_AHEAD, stalls are the times the SD reader found no block
+   * read ahead and waited for the card, with their total and longest time.
+   * With SD_BLOCK_CACHE, the hits and misses of the data and FAT caches
+   * and the changed blocks written back.
+   */
+  inline void gcode_M931() {
+    #if ENABLED(SD_READ_AHEAD)
+      const millis_t elapsed_ms = millis() - card.ahead_since_ms;
+      SERIAL_ECHO_START();
+      SERIAL_ECHOPAIR("SD blocks:", card.ahead_blocks);
+      SERIAL_ECHOPAIR(" in ", elapsed_ms);
+      SERIAL_ECHOPAIR("ms rate:", elapsed_ms ? float(card.ahead_blocks) * 1000.0f / float(elapsed_ms) : 0.0f);
+      SERIAL_ECHOPAIR(" blk/s stalls:", card.ahead_stalls);
+      SERIAL_ECHOPAIR(" stalled:", card.ahead_stall_us / 1000UL);
+      SERIAL_ECHOPAIR("ms max:", card.ahead_stall_us_max);
+      SERIAL_ECHOLNPGM("us");
+      if (parser.seen('R')) card.reset_read_ahead_stats();
+    #endif
+    #if ENABLED(SD_BLOCK_CACHE)
+      SERIAL_ECHO_START();
+      SERIAL_ECHOPAIR("SD cache hits:", SdVolume::cacheHits);
+      SERIAL_ECHOPAIR(" misses:", SdVolume::cacheMisses);
+      SERIAL_ECHOPAIR(" FAT hits:", SdVolume::fatHits);
+      SERIAL_ECHOPAIR(" misses:", SdVolume::fatMisses);
+      SERIAL_ECHOLNPAIR(" writes:", SdVolume::cacheWrites);
+      if (parser.seen('R')) SdVolume::resetCacheStats();
+    #endif
+  }
+#endif
+
+#if ENABLED(SERIAL_STATS_TX_BLOCKED)
+  /**
+   * M932: Report serial output statistics gathered since the last reset
+   *
+   *  R   Reset the counters after reporting
+   *
+   * Blocked is the time the main loop waited for room in the TX buffer
+   * (or with SERIAL_DEFERRED_TX, the deferred output ring) and for flushes.
+   */
+  inline void gcode_M932() {
+    SERIAL_ECHO_START();
+    SERIAL_ECHOPAIR("Serial TX blocked:", MYSERIAL0.txBlockedMicros() / 1000UL);
+    SERIAL_ECHOPAIR("ms waits:", MYSERIAL0.txBlockedWaits());
+    SERIAL_EOL();
+    if (parser.seen('R')) MYSERIAL0.resetTxBlocked();
+  }
+#endif
+
+#if ENABLED(STEPPER_ISR_PROFILE)
+  /**
+   * M933: Report the stepper ISR profile gathered since the last reset
+   *
+   *  R   Reset the profile after reporting
+   *
+   * Each phase of the stepper ISR, and the temperature ISR, with its run count
+   * and min/avg/max time in stepper timer ticks (STEPPER_TIMER_RATE), then a
+   * histogram of runs under 16 ticks, under 32, and so on to 1024 and over.
+   * Latency is the time from the timer compare match to the ISR code. Late
+   * ISRs were held off longer than the 8us the scheduler allows for, and
+   * overruns ran 10 loops and gave up on pulse timing to catch up.
+   */
+  inline void gcode_M933() {
+    const bool reset = parser.seen('R');
+
+    uint32_t isrs, late;
+    uint16_t overruns;
+    stepper.get_profile_counts(isrs, late, overruns, reset);
+    SERIAL_ECHO_START();
+    SERIAL_ECHOPAIR("Stepper ISRs:", isrs);
+    SERIAL_ECHOPAIR(" late:", late);
+    SERIAL_ECHOLNPAIR(" overruns:", overruns);
+
+    // The names of the ISRPhase entries, in order
+    static const char phase_names[] PROGMEM = "latency\0" "pulse\0" "block\0"
+      #if ENABLED(LIN_ADVANCE)
+        "advance\0"
+      #endif
+      #if ENABLED(STEP_STREAM)
+        "stream\0"
+      #endif
+      #if ENABLED(INPUT_SHAPING)
+        "shaping\0"
+      #endif
+      #if ENABLED(PER_AXIS_STEP_TIMING)
+        "timed\0"
+      #endif
+      "temperature";
+
+    const char *name = phase_names;
+    for (uint8_t i = 0; i < ISR_PHASES; i++) {
+      isr_profile_t p;
+      stepper.get_profile((ISRPhase)i, p, reset);
+      SERIAL_ECHO_START();
+      serialprintPGM(name);
+      SERIAL_ECHOPAIR(" n:", p.count);
+      SERIAL_ECHOPAIR(" min:", p.count ? p.min : 0);
+      SERIAL_ECHOPAIR(" avg:", p.count ? p.total / p.count : 0UL);
+      SERIAL_ECHOPAIR(" max:", p.max);
+      SERIAL_ECHOPGM(" hist:");
+      for (uint8_t b = 0; b < ISR_PROFILE_BUCKETS; b++) {
+        if (b) SERIAL_CHAR(',');
+        SERIAL_ECHO(p.hist[b]);
+      }
+      SERIAL_EOL();
+      name += strlen_P(name) + 1;
+    }
+  }
+#endif
+
+#if ENABLED(SERIAL_CREDITS)
+  /**
+   * M941: Credit-based flow control
+   *
+   *  S1  Add R<bytes> to "ok" and "Resend:" lines
+   *  S0  Plain replies
+   *
+   * R is the count of bytes read or flushed from the RX buffer, modulo 65536.
+   * The host may send while its count of bytes sent, less R, stays within
+   * the window reported here. Lines must then have line numbers.
+   */
+  inline void gcode_M941() {
+    if (parser.seen('S')) serial_credits = parser.value_bool();
+    SERIAL_ECHO_START();
+    SERIAL_ECHOPAIR("Credits W", RX_BUFFER_SIZE - 1);
+    SERIAL_ECHOPAIR(" B", BUFSIZE);
+    SERIAL_ECHOLNPAIR(" S", int(serial_credits));
+  }
+#endif
+
+#if ENABLED(BINARY_TELEMETRY)
+  /**
+   * M942: Binary telemetry
+   *
+   *  S<seconds>  Send a frame at this interval, up to 60. S0 to stop.
+   *  P<ms>       The interval in milliseconds, from 100 to 60000. P0 to stop.
+   *
+   * The next frame is a key frame. Reports the interval in ms.
+   * Decode with buildroot/share/scripts/telemetryDecode.py
+   */
+  inline void gcode_M942() {
+    if (parser.seenval('S'))
+      telemetry_interval_ms = 1000U * MIN(parser.value_byte(), 60);
+    else if (parser.seenval('P')) {
+      const uint16_t ms = parser.value_ushort();
+      telemetry_interval_ms = ms ? constrain(ms, 100, 60000) : 0;
+    }
+    next_telemetry_ms = millis();
+    telemetry_key_countdown = 0;
+    SERIAL_ECHO_START();
+    SERIAL_ECHOLNPAIR("Telemetry P", telemetry_interval_ms);
+  }
+#endif
+
+#if ENABLED(BINARY_GCODE)
+  /**
+   * M940: Select the serial transport
+   *
+   *  S1  Binary frames, starting with sequence number 0
+   *  S0  Text lines
+   *
+   * The switch happens after the "ok" of this command, so the host must wait for it.
+   */
+  inline void gcode_M940() {
+    binary_gcode_mode = parser.boolval('S');
+    binary_seq = 0;
+    // Drop any partial text line
+    #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+      serial_line_reset();
+    #else
+      serial_count = 0;
+    #endif
+  }
+#endif
+
 /**
  * M999: Restart after being stopped
  *
@@ -12640,478 +13689,555 @@ inline void gcode_T(const uint8_t tmp_extruder) {
 }
 
 /**
- * Process the parsed command and dispatch it to its handler
- */
-void process_parsed_command() {
-  KEEPALIVE_STATE(IN_HANDLER);
-
-  // Handle a known G, M, or T
-  switch (parser.command_letter) {
-    case 'G': switch (parser.codenum) {
-
-      case 0: case 1: gcode_G0_G1(                                // G0: Fast Move, G1: Linear Move
-                        #if IS_SCARA
-                          parser.codenum == 0
-                        #endif
-                      ); break;
-
-      #if ENABLED(ARC_SUPPORT) && DISABLED(SCARA)
-        case 2: case 3: gcode_G2_G3(parser.codenum == 2); break;  // G2: CW ARC, G3: CCW ARC
-      #endif
-
-      case 4: gcode_G4(); break;                                  // G4: Dwell
-
-      #if ENABLED(BEZIER_CURVE_SUPPORT)
-        case 5: gcode_G5(); break;                                // G5: Cubic B_spline
-      #endif
-
-      #if ENABLED(UNREGISTERED_MOVE_SUPPORT)
-        case 6: gcode_G6(); break;                                // G6: Direct stepper move
-      #endif
-
-      #if ENABLED(FWRETRACT)
-        case 10: gcode_G10(); break;                              // G10: Retract
-        case 11: gcode_G11(); break;                              // G11: Prime
-      #endif
-
-      #if ENABLED(NOZZLE_CLEAN_FEATURE)
-        case 12: gcode_G12(); break;                              // G12: Clean Nozzle
-      #endif
-
-      #if ENABLED(CNC_WORKSPACE_PLANES)
-        case 17: gcode_G17(); break;                              // G17: Select Plane XY
-        case 18: gcode_G18(); break;                              // G18: Select Plane ZX
-        case 19: gcode_G19(); break;                              // G19: Select Plane YZ
-      #endif
-
-      #if ENABLED(INCH_MODE_SUPPORT)
-        case 20: gcode_G20(); break;                              // G20: Inch Units
-        case 21: gcode_G21(); break;                              // G21: Millimeter Units
-      #endif
-
-      #if ENABLED(G26_MESH_VALIDATION)
-        case 26: gcode_G26(); break;                              // G26: Mesh Validation Pattern
-      #endif
-
-      #if ENABLED(NOZZLE_PARK_FEATURE)
-        case 27: gcode_G27(); break;                              // G27: Park Nozzle
-      #endif
-
-      case 28: gcode_G28(false); break;                           // G28: Home one or more axes
-
-      #if HAS_LEVELING
-        case 29: gcode_G29(); break;                              // G29: Detailed Z probe
-      #endif
-
-      #if HAS_BED_PROBE
-        case 30: gcode_G30(); break;                              // G30: Single Z probe
-      #endif
-
-      #if ENABLED(Z_PROBE_SLED)
-        case 31: gcode_G31(); break;                              // G31: Dock sled
-        case 32: gcode_G32(); break;                              // G32: Undock sled
-      #endif
-
-      #if ENABLED(DELTA_AUTO_CALIBRATION)
-        case 33: gcode_G33(); break;                              // G33: Delta Auto-Calibration
-      #endif
-
-      #if ENABLED(G38_PROBE_TARGET)
-        case 38:
-          if (parser.subcode == 2 || parser.subcode == 3)
-            gcode_G38(parser.subcode == 2);                       // G38.2, G38.3: Probe towards object
-          break;
-      #endif
-
-      #if HAS_MESH
-        case 42: gcode_G42(); break;                              // G42: Move to mesh point
-      #endif
-
-      case 90: relative_mode = false; break;                      // G90: Absolute coordinates
-      case 91: relative_mode = true; break;                       // G91: Relative coordinates
-
-      case 92: gcode_G92(); break;                                // G92: Set Position
-      #if ENABLED(MECHADUINO_I2C_COMMANDS)
-        case 95: gcode_G95(); break;                                // G95: Set torque mode
-        case 96: gcode_G96(); break;                                // G96: Mark encoder reference point
-      #endif
-
-      #if ENABLED(DEBUG_GCODE_PARSER)
-        case 800: parser.debug(); break;                          // G800: GCode Parser Test for G
-      #endif
-
-      default: parser.unknown_command_error();
-    }
-    break;
-
-    case 'M': switch (parser.codenum) {
-      #if HAS_RESUME_CONTINUE
-        case 0: case 1: gcode_M0_M1(); break;                     // M0: Unconditional stop, M1: Conditional stop
-      #endif
-
-      #if ENABLED(SPINDLE_LASER_ENABLE)
-        case 3: gcode_M3_M4(true); break;                         // M3: Laser/CW-Spindle Power
-        case 4: gcode_M3_M4(false); break;                        // M4: Laser/CCW-Spindle Power
-        case 5: gcode_M5(); break;                                // M5: Laser/Spindle OFF
-      #endif
-
-      case 17: gcode_M17(); break;                                // M17: Enable all steppers
-
-      #if ENABLED(SDSUPPORT)
-        case 20: gcode_M20(); break;                              // M20: List SD Card
-        case 21: gcode_M21(); break;                              // M21: Init SD Card
-        case 22: gcode_M22(); break;                              // M22: Release SD Card
-        case 23: gcode_M23(); break;                              // M23: Select File
-        case 24: gcode_M24(); break;                              // M24: Start SD Print
-        case 25: gcode_M25(); break;                              // M25: Pause SD Print
-        case 26: gcode_M26(); break;                              // M26: Set SD Index
-        case 27: gcode_M27(); break;                              // M27: Get SD Status
-        case 28: gcode_M28(); break;                              // M28: Start SD Write
-        case 29: gcode_M29(); break;                              // M29: Stop SD Write
-        case 30: gcode_M30(); break;                              // M30: Delete File
-        case 32: gcode_M32(); break;                              // M32: Select file, Start SD Print
-        #if ENABLED(LONG_FILENAME_HOST_SUPPORT)
-          case 33: gcode_M33(); break;                            // M33: Report longname path
-        #endif
-        #if ENABLED(SDCARD_SORT_ALPHA) && ENABLED(SDSORT_GCODE)
-          case 34: gcode_M34(); break;                            // M34: Set SD card sorting options
-        #endif
-        case 928: gcode_M928(); break;                            // M928: Start SD write
-      #endif // SDSUPPORT
-
-      case 31: gcode_M31(); break;                                // M31: Report print job elapsed time
-
-      case 42: gcode_M42(); break;                                // M42: Change pin state
-      #if ENABLED(PINS_DEBUGGING)
-        case 43: gcode_M43(); break;                              // M43: Read/monitor pin and endstop states
-      #endif
-
-      #if ENABLED(Z_MIN_PROBE_REPEATABILITY_TEST)
-        case 48: gcode_M48(); break;                              // M48: Z probe repeatability test
-      #endif
-      #if ENABLED(G26_MESH_VALIDATION)
-        case 49: gcode_M49(); break;                              // M49: Toggle the G26 Debug Flag
-      #endif
-
-      #if ENABLED(ULTRA_LCD) && ENABLED(LCD_SET_PROGRESS_MANUALLY)
-        case 73: gcode_M73(); break;                              // M73: Set Print Progress %
-      #endif
-      case 75: gcode_M75(); break;                                // M75: Start Print Job Timer
-      case 76: gcode_M76(); break;                                // M76: Pause Print Job Timer
-      case 77: gcode_M77(); break;                                // M77: Stop Print Job Timer
-      #if ENABLED(PRINTCOUNTER)
-        case 78: gcode_M78(); break;                              // M78: Report Print Statistics
-      #endif
-
-      #if ENABLED(M100_FREE_MEMORY_WATCHER)
-        case 100: gcode_M100(); break;                            // M100: Free Memory Report
-      #endif
-
-      case 104: gcode_M104(); break;                              // M104: Set Hotend Temperature
-      case 110: gcode_M110(); break;                              // M110: Set Current Line Number
-      case 111: gcode_M111(); break;                              // M111: Set Debug Flags
-
-      #if DISABLED(EMERGENCY_PARSER)
-        case 108: gcode_M108(); break;                            // M108: Cancel Waiting
-        case 112: gcode_M112(); break;                            // M112: Emergency Stop
-        case 410: gcode_M410(); break;                            // M410: Quickstop. Abort all planned moves
-      #else
-        case 108: case 112: case 410: break;                      // Silently drop as handled by emergency parser
-      #endif
-
-      #if ENABLED(HOST_KEEPALIVE_FEATURE)
-        case 113: gcode_M113(); break;                            // M113: Set Host Keepalive Interval
-      #endif
-
-      case 105: gcode_M105(); KEEPALIVE_STATE(NOT_BUSY); return;  // M105: Report Temperatures (and say "ok")
-
-      #if ENABLED(AUTO_REPORT_TEMPERATURES)
-        case 155: gcode_M155(); break;                            // M155: Set Temperature Auto-report Interval
-      #endif
-
-      case 109: gcode_M109(); break;                              // M109: Set Hotend Temperature. Wait for target.
-
-      #if HAS_HEATED_BED
-        case 140: gcode_M140(); break;                            // M140: Set Bed Temperature
-        case 190: gcode_M190(); break;                            // M190: Set Bed Temperature. Wait for target.
-      #endif
-
-      #if FAN_COUNT > 0
-        case 106: gcode_M106(); break;                            // M106: Set Fan Speed
-        case 107: gcode_M107(); break;                            // M107: Fan Off
-      #endif
-
-      #if ENABLED(PARK_HEAD_ON_PAUSE)
-        case 125: gcode_M125(); break;                            // M125: Park (for Filament Change)
-      #endif
-
-      #if ENABLED(BARICUDA)
-        #if HAS_HEATER_1
-          case 126: gcode_M126(); break;                          // M126: Valve 1 Open
-          case 127: gcode_M127(); break;                          // M127: Valve 1 Closed
-        #endif
-        #if HAS_HEATER_2
-          case 128: gcode_M128(); break;                          // M128: Valve 2 Open
-          case 129: gcode_M129(); break;                          // M129: Valve 2 Closed
-        #endif
-      #endif
-
-      #if HAS_POWER_SWITCH
-        case 80: gcode_M80(); break;                              // M80: Turn on Power Supply
-      #endif
-      case 81: gcode_M81(); break;                                // M81: Turn off Power and Power Supply
-
-      case 82: gcode_M82(); break;                                // M82: Disable Relative E-Axis
-      case 83: gcode_M83(); break;                                // M83: Set Relative E-Axis
-      case 18: case 84: gcode_M18_M84(); break;                   // M18/M84: Disable Steppers / Set Timeout
-      case 85: gcode_M85(); break;                                // M85: Set inactivity stepper shutdown timeout
-      case 92: gcode_M92(); break;                                // M92: Set steps-per-unit
-      case 114: gcode_M114(); break;                              // M114: Report Current Position
-      case 115: gcode_M115(); break;                              // M115: Capabilities Report
-      case 117: gcode_M117(); break;                              // M117: Set LCD message text
-      case 118: gcode_M118(); break;                              // M118: Print a message in the host console
-      case 119: gcode_M119(); break;                              // M119: Report Endstop states
-      case 120: gcode_M120(); break;                              // M120: Enable Endstops
-      case 121: gcode_M121(); break;                              // M121: Disable Endstops
-
-      #if ENABLED(ULTIPANEL)
-        case 145: gcode_M145(); break;                            // M145: Set material heatup parameters
-      #endif
-
-      #if ENABLED(TEMPERATURE_UNITS_SUPPORT)
-        case 149: gcode_M149(); break;                            // M149: Set Temperature Units, C F K
-      #endif
-
-      #if HAS_COLOR_LEDS
-        case 150: gcode_M150(); break;                            // M150: Set Status LED Color
-      #endif
-
-      #if ENABLED(MIXING_EXTRUDER)
-        case 163: gcode_M163(); break;                            // M163: Set Mixing Component
-        #if MIXING_VIRTUAL_TOOLS > 1
-          case 164: gcode_M164(); break;                          // M164: Save Current Mix
-        #endif
-        #if ENABLED(DIRECT_MIXING_IN_G1)
-          case 165: gcode_M165(); break;                          // M165: Set Multiple Mixing Components
-        #endif
-      #endif
-
-      #if DISABLED(NO_VOLUMETRICS)
-        case 200: gcode_M200(); break;                            // M200: Set Filament Diameter, Volumetric Extrusion
-      #endif
-
-      case 201: gcode_M201(); break;                              // M201: Set Max Printing Acceleration (units/sec^2)
-      #if 0
-        case 202: gcode_M202(); break;                            // M202: Not used for Sprinter/grbl gen6
-      #endif
-      case 203: gcode_M203(); break;                              // M203: Set Max Feedrate (units/sec)
-      case 204: gcode_M204(); break;                              // M204: Set Acceleration
-      case 205: gcode_M205(); break;                              // M205: Set Advanced settings
-
-      #if HAS_M206_COMMAND
-        case 206: gcode_M206(); break;                            // M206: Set Home Offsets
-        case 428: gcode_M428(); break;                            // M428: Set Home Offsets based on current position
-      #endif
-
-      #if ENABLED(FWRETRACT)
-        case 207: gcode_M207(); break;                            // M207: Set Retract Length, Feedrate, Z lift
-        case 208: gcode_M208(); break;                            // M208: Set Additional Prime Length and Feedrate
-        case 209:
-          if (MIN_AUTORETRACT <= MAX_AUTORETRACT) gcode_M209();   // M209: Turn Auto-Retract on/off
-          break;
-      #endif
-
-      case 211: gcode_M211(); break;                              // M211: Enable/Disable/Report Software Endstops
-
-      #if HOTENDS > 1
-        case 218: gcode_M218(); break;                            // M218: Set Tool Offset
-      #endif
-
-      case 220: gcode_M220(); break;                              // M220: Set Feedrate Percentage
-      case 221: gcode_M221(); break;                              // M221: Set Flow Percentage
-      case 226: gcode_M226(); break;                              // M226: Wait for Pin State
-
-      #if defined(CHDK) || HAS_PHOTOGRAPH
-        case 240: gcode_M240(); break;                            // M240: Trigger Camera
-      #endif
-
-      #if HAS_LCD_CONTRAST
-        case 250: gcode_M250(); break;                            // M250: Set LCD Contrast
-      #endif
-
-      #if ENABLED(EXPERIMENTAL_I2CBUS)
-        case 260: gcode_M260(); break;                            // M260: Send Data to i2c slave
-        case 261: gcode_M261(); break;                            // M261: Request Data from i2c slave
-      #endif
-
-      #if HAS_SERVOS
-        case 280: gcode_M280(); break;                            // M280: Set Servo Position
-      #endif
-
-      #if ENABLED(BABYSTEPPING)
-        case 290: gcode_M290(); break;                            // M290: Babystepping
-      #endif
-
-      #if HAS_BUZZER
-        case 300: gcode_M300(); break;                            // M300: Add Tone/Buzz to Queue
-      #endif
-
-      #if ENABLED(PIDTEMP)
-        case 301: gcode_M301(); break;                            // M301: Set Hotend PID parameters
-      #endif
-
-      #if ENABLED(PREVENT_COLD_EXTRUSION)
-        case 302: gcode_M302(); break;                            // M302: Set Minimum Extrusion Temp
-      #endif
-
-      case 303: gcode_M303(); break;                              // M303: PID Autotune
-
-      #if ENABLED(PIDTEMPBED)
-        case 304: gcode_M304(); break;                            // M304: Set Bed PID parameters
-      #endif
-
-      #if HAS_MICROSTEPS
-        case 350: gcode_M350(); break;                            // M350: Set microstepping mode. Warning: Steps per unit remains unchanged. S code sets stepping mode for all drivers.
-        case 351: gcode_M351(); break;                            // M351: Toggle MS1 MS2 pins directly, S# determines MS1 or MS2, X# sets the pin high/low.
-      #endif
-
-      case 355: gcode_M355(); break;                              // M355: Set Case Light brightness
-
-      #if ENABLED(MORGAN_SCARA)
-        case 360: if (gcode_M360()) return; break;                // M360: SCARA Theta pos1
-        case 361: if (gcode_M361()) return; break;                // M361: SCARA Theta pos2
-        case 362: if (gcode_M362()) return; break;                // M362: SCARA Psi pos1
-        case 363: if (gcode_M363()) return; break;                // M363: SCARA Psi pos2
-        case 364: if (gcode_M364()) return; break;                // M364: SCARA Psi pos3 (90 deg to Theta)
-      #endif
-
-      case 400: gcode_M400(); break;                              // M400: Synchronize. Wait for moves to finish.
-
-      #if HAS_BED_PROBE
-        case 401: gcode_M401(); break;                            // M401: Deploy Probe
-        case 402: gcode_M402(); break;                            // M402: Stow Probe
-      #endif
-
-      #if ENABLED(FILAMENT_WIDTH_SENSOR)
-        case 404: gcode_M404(); break;                            // M404: Set/Report Nominal Filament Width
-        case 405: gcode_M405(); break;                            // M405: Enable Filament Width Sensor
-        case 406: gcode_M406(); break;                            // M406: Disable Filament Width Sensor
-        case 407: gcode_M407(); break;                            // M407: Report Measured Filament Width
-      #endif
-
-      #if HAS_LEVELING
-        case 420: gcode_M420(); break;                            // M420: Set Bed Leveling Enabled / Fade
-      #endif
-
-      #if HAS_MESH
-        case 421: gcode_M421(); break;                            // M421: Set a Mesh Z value
-      #endif
-
-      case 500: gcode_M500(); break;                              // M500: Store Settings in EEPROM
-      case 501: gcode_M501(); break;                              // M501: Read Settings from EEPROM
-      case 502: gcode_M502(); break;                              // M502: Revert Settings to defaults
-      #if DISABLED(DISABLE_M503)
-        case 503: gcode_M503(); break;                            // M503: Report Settings (in SRAM)
-      #endif
-      #if ENABLED(EEPROM_SETTINGS)
-        case 504: gcode_M504(); break;                            // M504: Validate EEPROM
-      #endif
-
-      #if ENABLED(ABORT_ON_ENDSTOP_HIT_FEATURE_ENABLED)
-        case 540: gcode_M540(); break;                            // M540: Set Abort on Endstop Hit for SD Printing
-      #endif
+ * Wrappers for the handlers that take arguments or need a condition
+ */
+inline void dispatch_G0() {
+  gcode_G0_G1(
+    #if IS_SCARA
+      true
+    #endif
+  );
+}
+inline void dispatch_G1() { gcode_G0_G1(); }
+#if ENABLED(ARC_SUPPORT) && DISABLED(SCARA)
+  inline void dispatch_G2() { gcode_G2_G3(true); }
+  inline void dispatch_G3() { gcode_G2_G3(false); }
+#endif
+inline void dispatch_G28() { gcode_G28(false); }
+#if ENABLED(G38_PROBE_TARGET)
+  inline void dispatch_G38() { if (parser.subcode == 2 || parser.subcode == 3) gcode_G38(parser.subcode == 2); }
+#endif
+inline void dispatch_G90() { relative_mode = false; }
+inline void dispatch_G91() { relative_mode = true; }
+#if ENABLED(SPINDLE_LASER_ENABLE)
+  inline void dispatch_M3() { gcode_M3_M4(true); }
+  inline void dispatch_M4() { gcode_M3_M4(false); }
+#endif
+#if ENABLED(FWRETRACT)
+  inline void dispatch_M209() { if (MIN_AUTORETRACT <= MAX_AUTORETRACT) gcode_M209(); }
+#endif
+#if ENABLED(MORGAN_SCARA)
+  inline void dispatch_M360() { if (!gcode_M360()) ok_to_send(); }
+  inline void dispatch_M361() { if (!gcode_M361()) ok_to_send(); }
+  inline void dispatch_M362() { if (!gcode_M362()) ok_to_send(); }
+  inline void dispatch_M363() { if (!gcode_M363()) ok_to_send(); }
+  inline void dispatch_M364() { if (!gcode_M364()) ok_to_send(); }
+#endif
+#if ENABLED(EMERGENCY_PARSER)
+  inline void dispatch_none() {}
+#endif
+inline void dispatch_T() { gcode_T(parser.codenum); }
+inline void dispatch_unknown() { parser.unknown_command_error(); }
 
-      #if ENABLED(ADVANCED_PAUSE_FEATURE)
-        case 600: gcode_M600(); break;                            // M600: Pause for Filament Change
-        case 603: gcode_M603(); break;                            // M603: Configure Filament Change
-      #endif
+typedef void (*gcode_handler_t)();
 
-      #if ENABLED(DUAL_X_CARRIAGE) || ENABLED(DUAL_NOZZLE_DUPLICATION_MODE)
-        case 605: gcode_M605(); break;                            // M605: Set Dual X Carriage movement mode
-      #endif
+enum GCodeFlag : uint8_t {
+  GCODE_MOVES  = _BV(0),    // Moves the machine, so it is refused while Stopped
+  GCODE_SYNC   = _BV(1),    // Needs the planner emptied before it runs
+  GCODE_SAFE   = _BV(2),    // Safe during a print: doesn't move, wait, or change the position
+  GCODE_OWN_OK = _BV(3)     // The handler sends its own "ok"
+};
 
-      #if ENABLED(DELTA) || ENABLED(HANGPRINTER)
-        case 665: gcode_M665(); break;                            // M665: Delta / Hangprinter Configuration
-      #endif
-      #if ENABLED(DELTA) || ENABLED(X_DUAL_ENDSTOPS) || ENABLED(Y_DUAL_ENDSTOPS) || ENABLED(Z_DUAL_ENDSTOPS)
-        case 666: gcode_M666(); break;                            // M666: DELTA/Dual Endstop Adjustment
-      #endif
+typedef struct {
+  gcode_handler_t handler;
+  uint8_t flags;            // GCodeFlag bits
+  uint16_t key;             // GCODE_KEY() of the command
+} gcode_entry_t;
 
-      #if ENABLED(FILAMENT_LOAD_UNLOAD_GCODES)
-        case 701: gcode_M701(); break;                            // M701: Load Filament
-        case 702: gcode_M702(); break;                            // M702: Unload Filament
-      #endif
+#define GCODE_KEY(L,N) ((L) == 'M' ? 0x8000U | (N) : (N))
+#define G_ENTRY(N,H,F) { H, F, GCODE_KEY('G', N) }
+#define M_ENTRY(N,H,F) { H, F, GCODE_KEY('M', N) }
 
-      #if ENABLED(MAX7219_GCODE)
-        case 7219: gcode_M7219(); break;                          // M7219: Set LEDs, columns, and rows
-      #endif
+/**
+ * G and M codes sorted by GCODE_KEY() for a binary search.
+ * New entries must keep the order, which is checked at compile time.
+ * The last entry takes every code that isn't in the table.
+ */
+constexpr gcode_entry_t gcode_table[] PROGMEM = {
+  G_ENTRY(0, dispatch_G0, GCODE_MOVES),                               // G0: Fast Move
+  G_ENTRY(1, dispatch_G1, GCODE_MOVES),                               // G1: Linear Move
+  #if ENABLED(ARC_SUPPORT) && DISABLED(SCARA)
+    G_ENTRY(2, dispatch_G2, GCODE_MOVES),                             // G2: CW ARC
+    G_ENTRY(3, dispatch_G3, GCODE_MOVES),                             // G3: CCW ARC
+  #endif
+  G_ENTRY(4, gcode_G4, GCODE_SYNC),                                   // G4: Dwell
+  #if ENABLED(BEZIER_CURVE_SUPPORT)
+    G_ENTRY(5, gcode_G5, GCODE_MOVES),                                // G5: Cubic B_spline
+  #endif
+  #if ENABLED(UNREGISTERED_MOVE_SUPPORT)
+    G_ENTRY(6, gcode_G6, GCODE_MOVES),                                // G6: Direct stepper move
+  #endif
+  #if ENABLED(FWRETRACT)
+    G_ENTRY(10, gcode_G10, GCODE_MOVES),                              // G10: Retract
+    G_ENTRY(11, gcode_G11, GCODE_MOVES),                              // G11: Prime
+  #endif
+  #if ENABLED(NOZZLE_CLEAN_FEATURE)
+    G_ENTRY(12, gcode_G12, GCODE_MOVES),                              // G12: Clean Nozzle
+  #endif
+  #if ENABLED(CNC_WORKSPACE_PLANES)
+    G_ENTRY(17, gcode_G17, 0),                                        // G17: Select Plane XY
+    G_ENTRY(18, gcode_G18, 0),                                        // G18: Select Plane ZX
+    G_ENTRY(19, gcode_G19, 0),                                        // G19: Select Plane YZ
+  #endif
+  #if ENABLED(INCH_MODE_SUPPORT)
+    G_ENTRY(20, gcode_G20, 0),                                        // G20: Inch Units
+    G_ENTRY(21, gcode_G21, 0),                                        // G21: Millimeter Units
+  #endif
+  #if ENABLED(G26_MESH_VALIDATION)
+    G_ENTRY(26, gcode_G26, GCODE_MOVES),                              // G26: Mesh Validation Pattern
+  #endif
+  #if ENABLED(NOZZLE_PARK_FEATURE)
+    G_ENTRY(27, gcode_G27, GCODE_MOVES),                              // G27: Park Nozzle
+  #endif
+  G_ENTRY(28, dispatch_G28, GCODE_MOVES),                             // G28: Home one or more axes
+  #if HAS_LEVELING
+    G_ENTRY(29, gcode_G29, GCODE_MOVES),                              // G29: Detailed Z probe
+  #endif
+  #if HAS_BED_PROBE
+    G_ENTRY(30, gcode_G30, GCODE_MOVES),                              // G30: Single Z probe
+  #endif
+  #if ENABLED(Z_PROBE_SLED)
+    G_ENTRY(31, gcode_G31, GCODE_MOVES),                              // G31: Dock sled
+    G_ENTRY(32, gcode_G32, GCODE_MOVES),                              // G32: Undock sled
+  #endif
+  #if ENABLED(DELTA_AUTO_CALIBRATION)
+    G_ENTRY(33, gcode_G33, GCODE_MOVES),                              // G33: Delta Auto-Calibration
+  #endif
+  #if ENABLED(G38_PROBE_TARGET)
+    G_ENTRY(38, dispatch_G38, GCODE_MOVES),                           // G38.2, G38.3: Probe towards object
+  #endif
+  #if HAS_MESH
+    G_ENTRY(42, gcode_G42, GCODE_MOVES),                              // G42: Move to mesh point
+  #endif
+  G_ENTRY(90, dispatch_G90, 0),                                       // G90: Absolute coordinates
+  G_ENTRY(91, dispatch_G91, 0),                                       // G91: Relative coordinates
+  G_ENTRY(92, gcode_G92, 0),                                          // G92: Set Position
+  #if ENABLED(MECHADUINO_I2C_COMMANDS)
+    G_ENTRY(95, gcode_G95, 0),                                        // G95: Set torque mode
+    G_ENTRY(96, gcode_G96, 0),                                        // G96: Mark encoder reference point
+  #endif
+  #if ENABLED(DEBUG_GCODE_PARSER)
+    G_ENTRY(800, GCodeParser::debug, GCODE_SAFE),                     // G800: GCode Parser Test for G
+  #endif
 
-      #if ENABLED(DEBUG_GCODE_PARSER)
-        case 800: parser.debug(); break;                          // M800: GCode Parser Test for M
-      #endif
+  #if HAS_RESUME_CONTINUE
+    M_ENTRY(0, gcode_M0_M1, 0),                                       // M0: Unconditional stop
+    M_ENTRY(1, gcode_M0_M1, 0),                                       // M1: Conditional stop
+  #endif
+  #if ENABLED(SPINDLE_LASER_ENABLE)
+    M_ENTRY(3, dispatch_M3, GCODE_SYNC),                              // M3: Laser/CW-Spindle Power
+    M_ENTRY(4, dispatch_M4, GCODE_SYNC),                              // M4: Laser/CCW-Spindle Power
+    M_ENTRY(5, gcode_M5, GCODE_SYNC),                                 // M5: Laser/Spindle OFF
+  #endif
+  M_ENTRY(17, gcode_M17, 0),                                          // M17: Enable all steppers
+  M_ENTRY(18, gcode_M18_M84, 0),                                      // M18: Disable Steppers / Set Timeout
+  #if ENABLED(SDSUPPORT)
+    M_ENTRY(20, gcode_M20, 0),                                        // M20: List SD Card
+    M_ENTRY(21, gcode_M21, 0),                                        // M21: Init SD Card
+    M_ENTRY(22, gcode_M22, 0),                                        // M22: Release SD Card
+    M_ENTRY(23, gcode_M23, 0),                                        // M23: Select File
+    M_ENTRY(24, gcode_M24, 0),                                        // M24: Start SD Print
+    M_ENTRY(25, gcode_M25, 0),                                        // M25: Pause SD Print
+    M_ENTRY(26, gcode_M26, 0),                                        // M26: Set SD Index
+    M_ENTRY(27, gcode_M27, GCODE_SAFE),                               // M27: Get SD Status
+    M_ENTRY(28, gcode_M28, 0),                                        // M28: Start SD Write
+    M_ENTRY(29, gcode_M29, 0),                                        // M29: Stop SD Write
+    M_ENTRY(30, gcode_M30, 0),                                        // M30: Delete File
+  #endif
+  M_ENTRY(31, gcode_M31, GCODE_SAFE),                                 // M31: Report print job elapsed time
+  #if ENABLED(SDSUPPORT)
+    M_ENTRY(32, gcode_M32, 0),                                        // M32: Select file, Start SD Print
+    #if ENABLED(LONG_FILENAME_HOST_SUPPORT)
+      M_ENTRY(33, gcode_M33, 0),                                      // M33: Report longname path
+    #endif
+    #if ENABLED(SDCARD_SORT_ALPHA) && ENABLED(SDSORT_GCODE)
+      M_ENTRY(34, gcode_M34, 0),                                      // M34: Set SD card sorting options
+    #endif
+  #endif
+  M_ENTRY(42, gcode_M42, 0),                                          // M42: Change pin state
+  #if ENABLED(PINS_DEBUGGING)
+    M_ENTRY(43, gcode_M43, 0),                                        // M43: Read/monitor pin and endstop states
+  #endif
+  #if ENABLED(Z_MIN_PROBE_REPEATABILITY_TEST)
+    M_ENTRY(48, gcode_M48, GCODE_MOVES),                              // M48: Z probe repeatability test
+  #endif
+  #if ENABLED(G26_MESH_VALIDATION)
+    M_ENTRY(49, gcode_M49, GCODE_SAFE),                               // M49: Toggle the G26 Debug Flag
+  #endif
+  #if ENABLED(ULTRA_LCD) && ENABLED(LCD_SET_PROGRESS_MANUALLY)
+    M_ENTRY(73, gcode_M73, GCODE_SAFE),                               // M73: Set Print Progress %
+  #endif
+  M_ENTRY(75, gcode_M75, GCODE_SAFE),                                 // M75: Start Print Job Timer
+  M_ENTRY(76, gcode_M76, GCODE_SAFE),                                 // M76: Pause Print Job Timer
+  M_ENTRY(77, gcode_M77, GCODE_SAFE),                                 // M77: Stop Print Job Timer
+  #if ENABLED(PRINTCOUNTER)
+    M_ENTRY(78, gcode_M78, GCODE_SAFE),                               // M78: Report Print Statistics
+  #endif
+  #if HAS_POWER_SWITCH
+    M_ENTRY(80, gcode_M80, 0),                                        // M80: Turn on Power Supply
+  #endif
+  M_ENTRY(81, gcode_M81, 0),                                          // M81: Turn off Power and Power Supply
+  M_ENTRY(82, gcode_M82, 0),                                          // M82: Disable Relative E-Axis
+  M_ENTRY(83, gcode_M83, 0),                                          // M83: Set Relative E-Axis
+  M_ENTRY(84, gcode_M18_M84, 0),                                      // M84: Disable Steppers / Set Timeout
+  M_ENTRY(85, gcode_M85, GCODE_SAFE),                                 // M85: Set inactivity stepper shutdown timeout
+  M_ENTRY(92, gcode_M92, 0),                                          // M92: Set steps-per-unit
+  #if ENABLED(M100_FREE_MEMORY_WATCHER)
+    M_ENTRY(100, gcode_M100, GCODE_SAFE),                             // M100: Free Memory Report
+  #endif
+  M_ENTRY(104, gcode_M104, GCODE_SAFE),                               // M104: Set Hotend Temperature
+  M_ENTRY(105, gcode_M105, GCODE_SAFE | GCODE_OWN_OK),                // M105: Report Temperatures (and say "ok")
+  #if FAN_COUNT > 0
+    M_ENTRY(106, gcode_M106, GCODE_SAFE),                             // M106: Set Fan Speed
+    M_ENTRY(107, gcode_M107, GCODE_SAFE),                             // M107: Fan Off
+  #endif
+  #if DISABLED(EMERGENCY_PARSER)
+    M_ENTRY(108, gcode_M108, GCODE_SAFE),                             // M108: Cancel Waiting
+  #else
+    M_ENTRY(108, dispatch_none, GCODE_SAFE),                          // M108: Handled by the emergency parser
+  #endif
+  M_ENTRY(109, gcode_M109, 0),                                        // M109: Set Hotend Temperature. Wait for target.
+  M_ENTRY(110, gcode_M110, GCODE_SAFE),                               // M110: Set Current Line Number
+  M_ENTRY(111, gcode_M111, GCODE_SAFE),                               // M111: Set Debug Flags
+  #if DISABLED(EMERGENCY_PARSER)
+    M_ENTRY(112, gcode_M112, 0),                                      // M112: Emergency Stop
+  #else
+    M_ENTRY(112, dispatch_none, GCODE_SAFE),                          // M112: Handled by the emergency parser
+  #endif
+  #if ENABLED(HOST_KEEPALIVE_FEATURE)
+    M_ENTRY(113, gcode_M113, GCODE_SAFE),                             // M113: Set Host Keepalive Interval
+  #endif
+  M_ENTRY(114, gcode_M114, 0),                                        // M114: Report Current Position
+  M_ENTRY(115, gcode_M115, GCODE_SAFE),                               // M115: Capabilities Report
+  M_ENTRY(117, gcode_M117, GCODE_SAFE),                               // M117: Set LCD message text
+  M_ENTRY(118, gcode_M118, GCODE_SAFE),                               // M118: Print a message in the host console
+  M_ENTRY(119, gcode_M119, GCODE_SAFE),                               // M119: Report Endstop states
+  M_ENTRY(120, gcode_M120, 0),                                        // M120: Enable Endstops
+  M_ENTRY(121, gcode_M121, 0),                                        // M121: Disable Endstops
+  #if (HAS_DRIVER(TMC2130) || HAS_DRIVER(TMC2208)) && ENABLED(TMC_DEBUG)
+    M_ENTRY(122, gcode_M122, GCODE_SAFE),                             // M122: Debug TMC steppers
+  #endif
+  #if ENABLED(PARK_HEAD_ON_PAUSE)
+    M_ENTRY(125, gcode_M125, GCODE_MOVES),                            // M125: Park (for Filament Change)
+  #endif
+  #if ENABLED(BARICUDA)
+    #if HAS_HEATER_1
+      M_ENTRY(126, gcode_M126, 0),                                    // M126: Valve 1 Open
+      M_ENTRY(127, gcode_M127, 0),                                    // M127: Valve 1 Closed
+    #endif
+    #if HAS_HEATER_2
+      M_ENTRY(128, gcode_M128, 0),                                    // M128: Valve 2 Open
+      M_ENTRY(129, gcode_M129, 0),                                    // M129: Valve 2 Closed
+    #endif
+  #endif
+  #if HAS_HEATED_BED
+    M_ENTRY(140, gcode_M140, GCODE_SAFE),                             // M140: Set Bed Temperature
+  #endif
+  #if ENABLED(ULTIPANEL)
+    M_ENTRY(145, gcode_M145, GCODE_SAFE),                             // M145: Set material heatup parameters
+  #endif
+  #if ENABLED(TEMPERATURE_UNITS_SUPPORT)
+    M_ENTRY(149, gcode_M149, 0),                                      // M149: Set Temperature Units, C F K
+  #endif
+  #if HAS_COLOR_LEDS
+    M_ENTRY(150, gcode_M150, GCODE_SAFE),                             // M150: Set Status LED Color
+  #endif
+  #if ENABLED(AUTO_REPORT_TEMPERATURES)
+    M_ENTRY(155, gcode_M155, GCODE_SAFE),                             // M155: Set Temperature Auto-report Interval
+  #endif
+  #if ENABLED(MIXING_EXTRUDER)
+    M_ENTRY(163, gcode_M163, 0),                                      // M163: Set Mixing Component
+    #if MIXING_VIRTUAL_TOOLS > 1
+      M_ENTRY(164, gcode_M164, 0),                                    // M164: Save Current Mix
+    #endif
+    #if ENABLED(DIRECT_MIXING_IN_G1)
+      M_ENTRY(165, gcode_M165, 0),                                    // M165: Set Multiple Mixing Components
+    #endif
+  #endif
+  #if HAS_HEATED_BED
+    M_ENTRY(190, gcode_M190, 0),                                      // M190: Set Bed Temperature. Wait for target.
+  #endif
+  #if DISABLED(NO_VOLUMETRICS)
+    M_ENTRY(200, gcode_M200, 0),                                      // M200: Set Filament Diameter, Volumetric Extrusion
+  #endif
+  M_ENTRY(201, gcode_M201, GCODE_SAFE),                               // M201: Set Max Printing Acceleration (units/sec^2)
+  M_ENTRY(203, gcode_M203, GCODE_SAFE),                               // M203: Set Max Feedrate (units/sec)
+  M_ENTRY(204, gcode_M204, GCODE_SAFE),                               // M204: Set Acceleration
+  M_ENTRY(205, gcode_M205, GCODE_SAFE),                               // M205: Set Advanced settings
+  #if HAS_M206_COMMAND
+    M_ENTRY(206, gcode_M206, 0),                                      // M206: Set Home Offsets
+  #endif
+  #if ENABLED(FWRETRACT)
+    M_ENTRY(207, gcode_M207, 0),                                      // M207: Set Retract Length, Feedrate, Z lift
+    M_ENTRY(208, gcode_M208, 0),                                      // M208: Set Additional Prime Length and Feedrate
+    M_ENTRY(209, dispatch_M209, 0),                                   // M209: Turn Auto-Retract on/off
+  #endif
+  M_ENTRY(211, gcode_M211, 0),                                        // M211: Enable/Disable/Report Software Endstops
+  #if HOTENDS > 1
+    M_ENTRY(218, gcode_M218, 0),                                      // M218: Set Tool Offset
+  #endif
+  M_ENTRY(220, gcode_M220, GCODE_SAFE),                               // M220: Set Feedrate Percentage
+  M_ENTRY(221, gcode_M221, GCODE_SAFE),                               // M221: Set Flow Percentage
+  M_ENTRY(226, gcode_M226, 0),                                        // M226: Wait for Pin State
+  #if defined(CHDK) || HAS_PHOTOGRAPH
+    M_ENTRY(240, gcode_M240, 0),                                      // M240: Trigger Camera
+  #endif
+  #if HAS_LCD_CONTRAST
+    M_ENTRY(250, gcode_M250, GCODE_SAFE),                             // M250: Set LCD Contrast
+  #endif
+  #if ENABLED(EXPERIMENTAL_I2CBUS)
+    M_ENTRY(260, gcode_M260, 0),                                      // M260: Send Data to i2c slave
+    M_ENTRY(261, gcode_M261, 0),                                      // M261: Request Data from i2c slave
+  #endif
+  #if HAS_SERVOS
+    M_ENTRY(280, gcode_M280, 0),                                      // M280: Set Servo Position
+  #endif
+  #if ENABLED(BABYSTEPPING)
+    M_ENTRY(290, gcode_M290, GCODE_SAFE),                             // M290: Babystepping
+  #endif
+  #if HAS_BUZZER
+    M_ENTRY(300, gcode_M300, GCODE_SAFE),                             // M300: Add Tone/Buzz to Queue
+  #endif
+  #if ENABLED(PIDTEMP)
+    M_ENTRY(301, gcode_M301, GCODE_SAFE),                             // M301: Set Hotend PID parameters
+  #endif
+  #if ENABLED(PREVENT_COLD_EXTRUSION)
+    M_ENTRY(302, gcode_M302, 0),                                      // M302: Set Minimum Extrusion Temp
+  #endif
+  M_ENTRY(303, gcode_M303, 0),                                        // M303: PID Autotune
+  #if ENABLED(PIDTEMPBED)
+    M_ENTRY(304, gcode_M304, GCODE_SAFE),                             // M304: Set Bed PID parameters
+  #endif
+  #if HAS_MICROSTEPS
+    M_ENTRY(350, gcode_M350, 0),                                      // M350: Set microstepping mode
+    M_ENTRY(351, gcode_M351, 0),                                      // M351: Toggle MS1 MS2 pins directly
+  #endif
+  M_ENTRY(355, gcode_M355, GCODE_SAFE),                               // M355: Set Case Light brightness
+  #if ENABLED(MORGAN_SCARA)
+    M_ENTRY(360, dispatch_M360, GCODE_MOVES | GCODE_OWN_OK),          // M360: SCARA Theta pos1
+    M_ENTRY(361, dispatch_M361, GCODE_MOVES | GCODE_OWN_OK),          // M361: SCARA Theta pos2
+    M_ENTRY(362, dispatch_M362, GCODE_MOVES | GCODE_OWN_OK),          // M362: SCARA Psi pos1
+    M_ENTRY(363, dispatch_M363, GCODE_MOVES | GCODE_OWN_OK),          // M363: SCARA Psi pos2
+    M_ENTRY(364, dispatch_M364, GCODE_MOVES | GCODE_OWN_OK),          // M364: SCARA Psi pos3 (90 deg to Theta)
+  #endif
+  M_ENTRY(400, gcode_M400, GCODE_SYNC),                               // M400: Synchronize. Wait for moves to finish.
+  #if HAS_BED_PROBE
+    M_ENTRY(401, gcode_M401, GCODE_MOVES),                            // M401: Deploy Probe
+    M_ENTRY(402, gcode_M402, GCODE_MOVES),                            // M402: Stow Probe
+  #endif
+  #if ENABLED(FILAMENT_WIDTH_SENSOR)
+    M_ENTRY(404, gcode_M404, 0),                                      // M404: Set/Report Nominal Filament Width
+    M_ENTRY(405, gcode_M405, 0),                                      // M405: Enable Filament Width Sensor
+    M_ENTRY(406, gcode_M406, 0),                                      // M406: Disable Filament Width Sensor
+    M_ENTRY(407, gcode_M407, 0),                                      // M407: Report Measured Filament Width
+  #endif
+  #if DISABLED(EMERGENCY_PARSER)
+    M_ENTRY(410, gcode_M410, 0),                                      // M410: Quickstop. Abort all planned moves
+  #else
+    M_ENTRY(410, dispatch_none, GCODE_SAFE),                          // M410: Handled by the emergency parser
+  #endif
+  #if HAS_LEVELING
+    M_ENTRY(420, gcode_M420, 0),                                      // M420: Set Bed Leveling Enabled / Fade
+  #endif
+  #if HAS_MESH
+    M_ENTRY(421, gcode_M421, 0),                                      // M421: Set a Mesh Z value
+  #endif
+  #if HAS_M206_COMMAND
+    M_ENTRY(428, gcode_M428, 0),                                      // M428: Set Home Offsets based on current position
+  #endif
+  M_ENTRY(500, gcode_M500, 0),                                        // M500: Store Settings in EEPROM
+  M_ENTRY(501, gcode_M501, 0),                                        // M501: Read Settings from EEPROM
+  M_ENTRY(502, gcode_M502, 0),                                        // M502: Revert Settings to defaults
+  #if DISABLED(DISABLE_M503)
+    M_ENTRY(503, gcode_M503, GCODE_SAFE),                             // M503: Report Settings (in SRAM)
+  #endif
+  #if ENABLED(EEPROM_SETTINGS)
+    M_ENTRY(504, gcode_M504, GCODE_SAFE),                             // M504: Validate EEPROM
+  #endif
+  #if ENABLED(ABORT_ON_ENDSTOP_HIT_FEATURE_ENABLED)
+    M_ENTRY(540, gcode_M540, GCODE_SAFE),                             // M540: Set Abort on Endstop Hit for SD Printing
+  #endif
+  #if ENABLED(INPUT_SHAPING)
+    M_ENTRY(593, gcode_M593, 0),                                      // M593: Set Input Shaping
+  #endif
+  #if ENABLED(ADVANCED_PAUSE_FEATURE)
+    M_ENTRY(600, gcode_M600, GCODE_MOVES),                            // M600: Pause for Filament Change
+    M_ENTRY(603, gcode_M603, 0),                                      // M603: Configure Filament Change
+  #endif
+  #if ENABLED(DUAL_X_CARRIAGE) || ENABLED(DUAL_NOZZLE_DUPLICATION_MODE)
+    M_ENTRY(605, gcode_M605, GCODE_SYNC),                             // M605: Set Dual X Carriage movement mode
+  #endif
+  #if ENABLED(DELTA) || ENABLED(HANGPRINTER)
+    M_ENTRY(665, gcode_M665, 0),                                      // M665: Delta / Hangprinter Configuration
+  #endif
+  #if ENABLED(DELTA) || ENABLED(X_DUAL_ENDSTOPS) || ENABLED(Y_DUAL_ENDSTOPS) || ENABLED(Z_DUAL_ENDSTOPS)
+    M_ENTRY(666, gcode_M666, 0),                                      // M666: DELTA/Dual Endstop Adjustment
+  #endif
+  #if ENABLED(FILAMENT_LOAD_UNLOAD_GCODES)
+    M_ENTRY(701, gcode_M701, GCODE_MOVES),                            // M701: Load Filament
+    M_ENTRY(702, gcode_M702, GCODE_MOVES),                            // M702: Unload Filament
+  #endif
+  #if ENABLED(DEBUG_GCODE_PARSER)
+    M_ENTRY(800, GCodeParser::debug, GCODE_SAFE),                     // M800: GCode Parser Test for M
+  #endif
+  #if HAS_BED_PROBE
+    M_ENTRY(851, gcode_M851, 0),                                      // M851: Set Z Probe Z Offset
+  #endif
+  #if ENABLED(SKEW_CORRECTION_GCODE)
+    M_ENTRY(852, gcode_M852, 0),                                      // M852: Set Skew factors
+  #endif
+  #if ENABLED(I2C_POSITION_ENCODERS)
+    M_ENTRY(860, gcode_M860, GCODE_SAFE),                             // M860: Report encoder module position
+    M_ENTRY(861, gcode_M861, GCODE_SAFE),                             // M861: Report encoder module status
+    M_ENTRY(862, gcode_M862, GCODE_MOVES),                            // M862: Perform axis test
+    M_ENTRY(863, gcode_M863, GCODE_MOVES),                            // M863: Calibrate steps/mm
+    M_ENTRY(864, gcode_M864, 0),                                      // M864: Change module address
+    M_ENTRY(865, gcode_M865, GCODE_SAFE),                             // M865: Check module firmware version
+    M_ENTRY(866, gcode_M866, GCODE_SAFE),                             // M866: Report axis error count
+    M_ENTRY(867, gcode_M867, 0),                                      // M867: Toggle error correction
+    M_ENTRY(868, gcode_M868, 0),                                      // M868: Set error correction threshold
+    M_ENTRY(869, gcode_M869, GCODE_SAFE),                             // M869: Report axis error
+  #endif
+  #if ENABLED(LIN_ADVANCE)
+    M_ENTRY(900, gcode_M900, 0),                                      // M900: Set Linear Advance K factor
+  #endif
+  #if HAS_DRIVER(TMC2130) || HAS_DRIVER(TMC2208)
+    M_ENTRY(906, gcode_M906, 0),                                      // M906: Set motor current in milliamps
+  #endif
+  M_ENTRY(907, gcode_M907, 0),                                        // M907: Set Digital Trimpot Motor Current using axis codes.
+  #if HAS_DIGIPOTSS || ENABLED(DAC_STEPPER_CURRENT)
+    M_ENTRY(908, gcode_M908, 0),                                      // M908: Direct Control Digital Trimpot
+    #if ENABLED(DAC_STEPPER_CURRENT)
+      M_ENTRY(909, gcode_M909, GCODE_SAFE),                           // M909: Print Digipot/DAC current value
+      M_ENTRY(910, gcode_M910, 0),                                    // M910: Commit Digipot/DAC value to External EEPROM
+    #endif
+  #endif
+  #if HAS_DRIVER(TMC2130) || HAS_DRIVER(TMC2208)
+    M_ENTRY(911, gcode_M911, GCODE_SAFE),                             // M911: Report TMC prewarn triggered flags
+    M_ENTRY(912, gcode_M912, GCODE_SAFE),                             // M912: Clear TMC prewarn triggered flags
+    #if ENABLED(HYBRID_THRESHOLD)
+      M_ENTRY(913, gcode_M913, 0),                                    // M913: Set HYBRID_THRESHOLD speed.
+    #endif
+    #if ENABLED(SENSORLESS_HOMING)
+      M_ENTRY(914, gcode_M914, 0),                                    // M914: Set SENSORLESS_HOMING sensitivity.
+    #endif
+    #if ENABLED(TMC_Z_CALIBRATION)
+      M_ENTRY(915, gcode_M915, GCODE_MOVES),                          // M915: TMC Z axis calibration routine
+    #endif
+  #endif
+  #if ENABLED(SDSUPPORT)
+    M_ENTRY(928, gcode_M928, 0),                                      // M928: Start SD write
+  #endif
+  #if ENABLED(MOTION_STATS)
+    M_ENTRY(930, gcode_M930, GCODE_SAFE),                             // M930: Report motion statistics
+  #endif
+  #if ENABLED(SD_READ_AHEAD) || ENABLED(SD_BLOCK_CACHE)
+    M_ENTRY(931, gcode_M931, GCODE_SAFE),                             // M931: Report SD card statistics
+  #endif
+  #if ENABLED(SERIAL_STATS_TX_BLOCKED)
+    M_ENTRY(932, gcode_M932, GCODE_SAFE),                             // M932: Report serial output statistics
+  #endif
+  #if ENABLED(STEPPER_ISR_PROFILE)
+    M_ENTRY(933, gcode_M933, GCODE_SAFE),                             // M933: Report the stepper ISR profile
+  #endif
+  #if ENABLED(BINARY_GCODE)
+    M_ENTRY(940, gcode_M940, 0),                                      // M940: Select the serial transport
+  #endif
+  #if ENABLED(SERIAL_CREDITS)
+    M_ENTRY(941, gcode_M941, 0),                                      // M941: Credit-based flow control
+  #endif
+  #if ENABLED(BINARY_TELEMETRY)
+    M_ENTRY(942, gcode_M942, GCODE_SAFE),                             // M942: Binary telemetry
+  #endif
+  M_ENTRY(999, gcode_M999, 0),                                        // M999: Restart after being Stopped
+  #if ENABLED(MAX7219_GCODE)
+    M_ENTRY(7219, gcode_M7219, GCODE_SAFE),                           // M7219: Set LEDs, columns, and rows
+  #endif
+  { dispatch_unknown, 0, 0xFFFFU }                                    // Unknown command
+};
 
-      #if HAS_BED_PROBE
-        case 851: gcode_M851(); break;                            // M851: Set Z Probe Z Offset
-      #endif
+constexpr gcode_entry_t gcode_T_entry PROGMEM = { dispatch_T, 0, 0 }; // T: Tool Select
 
-      #if ENABLED(SKEW_CORRECTION_GCODE)
-        case 852: gcode_M852(); break;                            // M852: Set Skew factors
-      #endif
+#define GCODE_UNKNOWN (&gcode_table[COUNT(gcode_table) - 1])
 
-      #if ENABLED(I2C_POSITION_ENCODERS)
-        case 860: gcode_M860(); break;                            // M860: Report encoder module position
-        case 861: gcode_M861(); break;                            // M861: Report encoder module status
-        case 862: gcode_M862(); break;                            // M862: Perform axis test
-        case 863: gcode_M863(); break;                            // M863: Calibrate steps/mm
-        case 864: gcode_M864(); break;                            // M864: Change module address
-        case 865: gcode_M865(); break;                            // M865: Check module firmware version
-        case 866: gcode_M866(); break;                            // M866: Report axis error count
-        case 867: gcode_M867(); break;                            // M867: Toggle error correction
-        case 868: gcode_M868(); break;                            // M868: Set error correction threshold
-        case 869: gcode_M869(); break;                            // M869: Report axis error
-      #endif
+#undef G_ENTRY
+#undef M_ENTRY
 
-      #if ENABLED(LIN_ADVANCE)
-        case 900: gcode_M900(); break;                            // M900: Set Linear Advance K factor
-      #endif
+constexpr bool gcode_table_sorted(const uint8_t i) {
+  return i + 1U >= COUNT(gcode_table) || (gcode_table[i].key < gcode_table[i + 1].key && gcode_table_sorted(i + 1));
+}
+static_assert(COUNT(gcode_table) <= 255, "The G-code dispatch table is limited to 255 entries.");
+static_assert(gcode_table_sorted(0), "The G-code dispatch table must be sorted by letter and number.");
 
-      case 907: gcode_M907(); break;                              // M907: Set Digital Trimpot Motor Current using axis codes.
+/**
+ * Index of the table entry for a code, worked out by the compiler
+ */
+constexpr uint8_t gcode_index(const uint16_t key, const uint8_t lo=0, const uint8_t hi=COUNT(gcode_table)) {
+  return lo >= hi ? COUNT(gcode_table) - 1
+       : gcode_table[(lo + hi) / 2].key == key ? (lo + hi) / 2
+       : gcode_table[(lo + hi) / 2].key < key ? gcode_index(key, (lo + hi) / 2 + 1, hi)
+       : gcode_index(key, lo, (lo + hi) / 2);
+}
 
-      #if HAS_DIGIPOTSS || ENABLED(DAC_STEPPER_CURRENT)
-        case 908: gcode_M908(); break;                            // M908: Direct Control Digital Trimpot
-        #if ENABLED(DAC_STEPPER_CURRENT)
-          case 909: gcode_M909(); break;                          // M909: Print Digipot/DAC current value (As with Printrbot RevF)
-          case 910: gcode_M910(); break;                          // M910: Commit Digipot/DAC value to External EEPROM (As with Printrbot RevF)
-        #endif
-      #endif
+#define _GI1(L,N)  gcode_index(GCODE_KEY(L, N))
+#define _GI10(L,N) _GI1(L,N), _GI1(L,N+1), _GI1(L,N+2), _GI1(L,N+3), _GI1(L,N+4), _GI1(L,N+5), _GI1(L,N+6), _GI1(L,N+7), _GI1(L,N+8), _GI1(L,N+9)
+#define _GI50(L,N) _GI10(L,N), _GI10(L,N+10), _GI10(L,N+20), _GI10(L,N+30), _GI10(L,N+40)
 
-      #if HAS_DRIVER(TMC2130) || HAS_DRIVER(TMC2208)
-        #if ENABLED(TMC_DEBUG)
-          case 122: gcode_M122(); break;                          // M122: Debug TMC steppers
-        #endif
-        case 906: gcode_M906(); break;                            // M906: Set motor current in milliamps using axis codes X, Y, Z, E
-        case 911: gcode_M911(); break;                            // M911: Report TMC prewarn triggered flags
-        case 912: gcode_M912(); break;                            // M911: Clear TMC prewarn triggered flags
-        #if ENABLED(HYBRID_THRESHOLD)
-          case 913: gcode_M913(); break;                          // M913: Set HYBRID_THRESHOLD speed.
-        #endif
-        #if ENABLED(SENSORLESS_HOMING)
-          case 914: gcode_M914(); break;                          // M914: Set SENSORLESS_HOMING sensitivity.
-        #endif
-        #if ENABLED(TMC_Z_CALIBRATION)
-          case 915: gcode_M915(); break;                          // M915: TMC Z axis calibration routine
-        #endif
-      #endif
+/**
+ * Direct index of G0-G99 and M0-M299, which hold nearly every command of a
+ * sliced file. The other codes are found by a binary search of the table.
+ */
+const uint8_t gcode_index_G[100] PROGMEM = { _GI50('G', 0), _GI50('G', 50) },
+              gcode_index_M[300] PROGMEM = { _GI50('M', 0), _GI50('M', 50), _GI50('M', 100), _GI50('M', 150), _GI50('M', 200), _GI50('M', 250) };
 
-      case 999: gcode_M999(); break;                              // M999: Restart after being Stopped
+#undef _GI1
+#undef _GI10
+#undef _GI50
 
-      default: parser.unknown_command_error();
+/**
+ * Look up a command in the direct index, or else by a binary search of the table
+ */
+static const gcode_entry_t* gcode_lookup(const char letter, const uint16_t codenum) {
+  if (letter == 'G') {
+    if (codenum < COUNT(gcode_index_G)) return &gcode_table[pgm_read_byte(&gcode_index_G[codenum])];
+  }
+  else if (letter == 'M') {
+    if (codenum < COUNT(gcode_index_M)) return &gcode_table[pgm_read_byte(&gcode_index_M[codenum])];
+  }
+  else
+    return letter == 'T' ? &gcode_T_entry : GCODE_UNKNOWN;
+
+  if (codenum <= 0x7FFF) {
+    const uint16_t key = GCODE_KEY(letter, codenum);
+    uint8_t lo = 0, hi = COUNT(gcode_table);
+    while (lo < hi) {
+      const uint8_t mid = (lo + hi) >> 1;
+      const uint16_t k = pgm_read_word(&gcode_table[mid].key);
+      if (k == key) return &gcode_table[mid];
+      if (k < key) lo = mid + 1; else hi = mid;
     }
-    break;
+  }
+  return GCODE_UNKNOWN;
+}
 
-    case 'T': gcode_T(parser.codenum); break;                     // T: Tool Select
+/**
+ * Process the parsed command and dispatch it to its handler
+ */
+void process_parsed_command() {
+  const gcode_entry_t * const entry = gcode_lookup(parser.command_letter, parser.codenum);
+  const uint8_t flags = pgm_read_byte(&entry->flags);
 
-    default: parser.unknown_command_error();
+  if (IsStopped() && (flags & GCODE_MOVES)) {
+    SERIAL_ERROR_START();
+    SERIAL_ERRORLNPGM(MSG_ERR_STOPPED);
+    LCD_MESSAGEPGM(MSG_STOPPED);
+  }
+  else {
+    // Safe commands return at once, so they leave the host keepalive alone
+    if (!(flags & GCODE_SAFE)) KEEPALIVE_STATE(IN_HANDLER);
+    if (flags & GCODE_SYNC) planner.synchronize();
+    ((gcode_handler_t)pgm_read_ptr(&entry->handler))();
+    if (flags & GCODE_OWN_OK) { KEEPALIVE_STATE(NOT_BUSY); return; }
   }
 
   KEEPALIVE_STATE(NOT_BUSY);
@@ -13119,7 +14245,7 @@ void process_parsed_command() {
 }
 
 void process_next_command() {
-  char * const current_command = command_queue[cmd_queue_index_r];
+  char * const current_command = QUEUE_R;
 
   if (DEBUGGING(ECHO)) {
     SERIAL_ECHO_START();
@@ -13131,7 +14257,12 @@ void process_next_command() {
   }
 
   // Parse the next command in the queue
-  parser.parse(current_command);
+  #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+    const uint8_t * const params = command_params[cmd_queue_index_r];
+    parser.parse(current_command, params[0] == PARAMS_UNKNOWN ? NULL : params);
+  #else
+    parser.parse(current_command);
+  #endif
   process_parsed_command();
 }
 
@@ -13143,7 +14274,15 @@ void flush_and_request_resend() {
   //char command_queue[cmd_queue_index_r][100]="Resend:";
   SERIAL_FLUSH();
   SERIAL_PROTOCOLPGM(MSG_RESEND);
-  SERIAL_PROTOCOLLN(gcode_LastN + 1);
+  SERIAL_PROTOCOL(gcode_LastN + 1);
+  #if ENABLED(SERIAL_CREDITS)
+    if (serial_credits) {
+      // The host counts its own lines in flight, so no "ok" follows
+      SERIAL_PROTOCOLPGM(" R"); SERIAL_PROTOCOLLN(MYSERIAL0.consumed());
+      return;
+    }
+  #endif
+  SERIAL_EOL();
   ok_to_send();
 }
 
@@ -13155,12 +14294,21 @@ void flush_and_request_resend() {
  *   N<int>  Line number of the command, if any
  *   P<int>  Planner space remaining
  *   B<int>  Block queue space remaining
+ *
+ * After M941 S1 (SERIAL_CREDITS) also include:
+ *   R<int>  Bytes taken from the RX buffer, modulo 65536
  */
 void ok_to_send() {
-  if (!send_ok[cmd_queue_index_r]) return;
+  // An empty arena has no flags for the line being answered
+  if (
+    #if ENABLED(COMMAND_QUEUE_ARENA)
+      commands_in_queue &&
+    #endif
+    !SEND_OK(cmd_queue_index_r)
+  ) return;
   SERIAL_PROTOCOLPGM(MSG_OK);
   #if ENABLED(ADVANCED_OK)
-    char* p = command_queue[cmd_queue_index_r];
+    char* p = QUEUE_R;
     if (*p == 'N') {
       SERIAL_PROTOCOL(' ');
       SERIAL_ECHO(*p++);
@@ -13170,6 +14318,9 @@ void ok_to_send() {
     SERIAL_PROTOCOLPGM(" P"); SERIAL_PROTOCOL(int(BLOCK_BUFFER_SIZE - planner.movesplanned() - 1));
     SERIAL_PROTOCOLPGM(" B"); SERIAL_PROTOCOL(BUFSIZE - commands_in_queue);
   #endif
+  #if ENABLED(SERIAL_CREDITS)
+    if (serial_credits) { SERIAL_PROTOCOLPGM(" R"); SERIAL_PROTOCOL(MYSERIAL0.consumed()); }
+  #endif
   SERIAL_EOL();
 }
 
@@ -13572,6 +14723,9 @@ void ok_to_send() {
    * Find y by inserting z into (I)
    *
    * Warning: truncation errors will typically be in the order of a few tens of microns.
+   *
+   * With HANGPRINTER_FK_LEAST_SQUARES the result is refined by a fixed number of
+   * Gauss-Newton iterations minimizing the squared errors of all four line lengths.
    */
   void forward_kinematics_HANGPRINTER(float a, float b, float c, float d){
     const float Asq =                  sq(anchor_A_y) + sq(anchor_A_z),
@@ -13588,6 +14742,43 @@ void ok_to_send() {
     cartes[Z_AXIS] = (k0b - k0c) / (k1c - k1b);
     cartes[X_AXIS] = k0c + k1c * cartes[Z_AXIS];
     cartes[Y_AXIS] = (Asq - Dsq - aa + dd) / (2.0 * anchor_A_y) + ((anchor_D_z - anchor_A_z) / anchor_A_y) * cartes[Z_AXIS];
+
+    #if ENABLED(HANGPRINTER_FK_LEAST_SQUARES)
+      const float anchor[ABCD][XYZ] = {
+        { 0,          anchor_A_y, anchor_A_z },
+        { anchor_B_x, anchor_B_y, anchor_B_z },
+        { anchor_C_x, anchor_C_y, anchor_C_z },
+        { 0,          0,          anchor_D_z }
+      },
+      len[ABCD] = { a, b, c, d };
+
+      for (uint8_t iter = HANGPRINTER_FK_ITERATIONS; iter--;) {
+        // Normal equations J'J * delta = J'r, J rows being the unit line directions
+        float xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0, rx = 0, ry = 0, rz = 0;
+        LOOP_MOV_AXIS(i) {
+          const float ex = cartes[X_AXIS] - anchor[i][X_AXIS],
+                      ey = cartes[Y_AXIS] - anchor[i][Y_AXIS],
+                      ez = cartes[Z_AXIS] - anchor[i][Z_AXIS],
+                      l = SQRT(sq(ex) + sq(ey) + sq(ez)),
+                      inv_l = 1.0f / l,
+                      ux = ex * inv_l, uy = ey * inv_l, uz = ez * inv_l,
+                      r = l - len[i];
+          xx += ux * ux; xy += ux * uy; xz += ux * uz;
+          yy += uy * uy; yz += uy * uz; zz += uz * uz;
+          rx += ux * r;  ry += uy * r;  rz += uz * r;
+        }
+
+        // Solve the symmetric 3x3 system by its adjugate
+        const float c00 = yy * zz - yz * yz, c01 = xz * yz - xy * zz, c02 = xy * yz - xz * yy,
+                    c11 = xx * zz - xz * xz, c12 = xy * xz - xx * yz, c22 = xx * yy - xy * xy,
+                    det = xx * c00 + xy * c01 + xz * c02;
+        if (!det) break;
+        const float inv_det = 1.0f / det;
+        cartes[X_AXIS] -= (c00 * rx + c01 * ry + c02 * rz) * inv_det;
+        cartes[Y_AXIS] -= (c01 * rx + c11 * ry + c12 * rz) * inv_det;
+        cartes[Z_AXIS] -= (c02 * rx + c12 * ry + c22 * rz) * inv_det;
+      }
+    #endif
   }
 #endif // HANGPRINTER
 
@@ -13879,6 +15070,108 @@ void set_current_from_steppers_for_axis(const AxisEnum axis) {
     #define SCARA_MIN_SEGMENT_LENGTH 0.5f
   #endif
 
+  #if ENABLED(INCREMENTAL_IK)
+    /**
+     * Inverse kinematics for the segments of a straight move.
+     *
+     * Along the move each squared rod or line length is a quadratic in the
+     * segment index, so it is advanced with forward differences. On resync
+     * the differences are recomputed from the segment position and step.
+     */
+    static void incremental_ik(const float (&raw)[XYZE], const float (&step)[XYZE], const bool resync) {
+      static float q[MOV_AXIS], dq[MOV_AXIS], ddq;
+
+      if (resync) {
+        #if ENABLED(HANGPRINTER)
+          const float anchor[ABCD][XYZ] = {
+            { 0,          anchor_A_y, anchor_A_z },
+            { anchor_B_x, anchor_B_y, anchor_B_z },
+            { anchor_C_x, anchor_C_y, anchor_C_z },
+            { 0,          0,          anchor_D_z }
+          };
+          ddq = 2 * (sq(step[X_AXIS]) + sq(step[Y_AXIS]) + sq(step[Z_AXIS]));
+          LOOP_MOV_AXIS(i) {
+            const float ex = raw[X_AXIS] - anchor[i][X_AXIS],
+                        ey = raw[Y_AXIS] - anchor[i][Y_AXIS],
+                        ez = raw[Z_AXIS] - anchor[i][Z_AXIS];
+            q[i] = sq(ex) + sq(ey) + sq(ez);
+            dq[i] = 2 * (step[X_AXIS] * ex + step[Y_AXIS] * ey + step[Z_AXIS] * ez) + 0.5f * ddq;
+          }
+        #else
+          ddq = -2 * (sq(step[X_AXIS]) + sq(step[Y_AXIS]));
+          LOOP_MOV_AXIS(i) {
+            float ex = raw[X_AXIS] - delta_tower[i][X_AXIS],
+                  ey = raw[Y_AXIS] - delta_tower[i][Y_AXIS];
+            #if HOTENDS > 1
+              ex -= hotend_offset[X_AXIS][active_extruder];
+              ey -= hotend_offset[Y_AXIS][active_extruder];
+            #endif
+            q[i] = delta_diagonal_rod_2_tower[i] - sq(ex) - sq(ey);
+            dq[i] = 0.5f * ddq - 2 * (step[X_AXIS] * ex + step[Y_AXIS] * ey);
+          }
+        #endif
+      }
+      else LOOP_MOV_AXIS(i) { q[i] += dq[i]; dq[i] += ddq; }
+
+      #if ENABLED(HANGPRINTER)
+        LOOP_MOV_AXIS(i) line_lengths[i] = SQRT(q[i]);
+      #else
+        LOOP_MOV_AXIS(i) delta[i] = raw[Z_AXIS] + SQRT(q[i]);
+      #endif
+    }
+  #endif
+
+  #if ENABLED(ADAPTIVE_SEGMENTATION)
+    /**
+     * Largest second derivative of the rod or line lengths with respect to
+     * the distance travelled along a unit direction, over a whole move.
+     * A chord of length h through such a curve deviates from it by about
+     * curvature * h^2 / 8.
+     */
+    static float kinematic_curvature(const float (&start)[XYZ], const float (&unit)[XYZ], const float &length) {
+      float curvature = 0;
+      #if ENABLED(HANGPRINTER)
+        const float anchor[ABCD][XYZ] = {
+          { 0,          anchor_A_y, anchor_A_z },
+          { anchor_B_x, anchor_B_y, anchor_B_z },
+          { anchor_C_x, anchor_C_y, anchor_C_z },
+          { 0,          0,          anchor_D_z }
+        };
+        LOOP_MOV_AXIS(i) {
+          const float ex = start[X_AXIS] - anchor[i][X_AXIS],
+                      ey = start[Y_AXIS] - anchor[i][Y_AXIS],
+                      ez = start[Z_AXIS] - anchor[i][Z_AXIS],
+                      c = unit[X_AXIS] * ex + unit[Y_AXIS] * ey + unit[Z_AXIS] * ez,
+                      d2 = sq(ex) + sq(ey) + sq(ez) - sq(c); // Squared distance of the anchor from the move
+          // The second derivative d^2 / L^3 peaks where the move passes closest to the anchor
+          const float c_near = c > 0 ? c : (c + length < 0 ? c + length : 0),
+                      l2 = d2 + sq(c_near);
+          if (l2 > 1) NOLESS(curvature, d2 / (l2 * SQRT(l2)));
+        }
+      #else
+        // The carriage height is Z + sqrt(q), with q a concave quadratic along the move
+        // and (a * q + c^2) constant. The second derivative peaks where q is least,
+        // which is at one end of the move.
+        const float a = sq(unit[X_AXIS]) + sq(unit[Y_AXIS]);
+        for (uint8_t end = 0; end < 2; end++) {
+          const float f = end ? length : 0;
+          LOOP_MOV_AXIS(i) {
+            float ex = start[X_AXIS] + unit[X_AXIS] * f - delta_tower[i][X_AXIS],
+                  ey = start[Y_AXIS] + unit[Y_AXIS] * f - delta_tower[i][Y_AXIS];
+            #if HOTENDS > 1
+              ex -= hotend_offset[X_AXIS][active_extruder];
+              ey -= hotend_offset[Y_AXIS][active_extruder];
+            #endif
+            const float q = delta_diagonal_rod_2_tower[i] - sq(ex) - sq(ey),
+                        c = unit[X_AXIS] * ex + unit[Y_AXIS] * ey;
+            if (q > 1) NOLESS(curvature, (a * q + sq(c)) / (q * SQRT(q)));
+          }
+        }
+      #endif
+      return curvature;
+    }
+  #endif
+
   /**
    * Prepare a linear move in a DELTA, SCARA or HANGPRINTER setup.
    *
@@ -13939,6 +15232,23 @@ void set_current_from_steppers_for_axis(const AxisEnum axis) {
       NOMORE(segments, cartesian_mm * (1.0f / float(SCARA_MIN_SEGMENT_LENGTH)));
     #endif
 
+    // Use fewer segments where the motor paths are nearly straight
+    #if ENABLED(ADAPTIVE_SEGMENTATION)
+      {
+        const float inv_mm = 1.0f / cartesian_mm,
+                    unit[XYZ] = { xdiff * inv_mm, ydiff * inv_mm, zdiff * inv_mm },
+                    start[XYZ] = { current_position[X_AXIS], current_position[Y_AXIS], current_position[Z_AXIS] };
+        // Segments needed for a chord error of curvature * h^2 / 8 within tolerance
+        float chord_segments = cartesian_mm * SQRT(kinematic_curvature(start, unit, cartesian_mm) * 0.125f / segment_chord_tolerance);
+        #if ENABLED(DELTA) && ENABLED(AUTO_BED_LEVELING_BILINEAR)
+          // The leveling offset is only applied at the segment ends, so keep them within a mesh cell of each other
+          if (planner.leveling_active)
+            NOLESS(chord_segments, HYPOT(xdiff, ydiff) / float(MIN(ABL_BG_SPACING(X_AXIS), ABL_BG_SPACING(Y_AXIS))));
+        #endif
+        if (chord_segments < segments) segments = uint16_t(chord_segments) + 1;
+      }
+    #endif
+
     // At least one segment is required
     NOLESS(segments, 1);
 
@@ -13999,6 +15309,10 @@ void set_current_from_steppers_for_axis(const AxisEnum axis) {
     float raw[XYZE];
     COPY(raw, current_position);
 
+    #if ENABLED(INCREMENTAL_IK)
+      uint8_t ik_countdown = 0;
+    #endif
+
     // Calculate and execute the segments
     while (--segments) {
 
@@ -14010,7 +15324,10 @@ void set_current_from_steppers_for_axis(const AxisEnum axis) {
       }
 
       LOOP_XYZE(i) raw[i] += segment_distance[i];
-      #if ENABLED(DELTA) && HOTENDS < 2
+      #if ENABLED(INCREMENTAL_IK)
+        incremental_ik(raw, segment_distance, !ik_countdown);
+        ik_countdown = (ik_countdown ? ik_countdown : INCREMENTAL_IK_RESYNC) - 1;
+      #elif ENABLED(DELTA) && HOTENDS < 2
         DELTA_IK(raw); // Delta can inline its kinematics
       #elif ENABLED(HANGPRINTER)
         HANGPRINTER_IK(raw); // Modifies line_lengths[ABCD]
@@ -14913,6 +16230,10 @@ void idle(
     max7219.idle_tasks();
   #endif
 
+  #if ENABLED(SERIAL_DEFERRED_TX)
+    MYSERIAL0.pump();
+  #endif
+
   lcd_update();
 
   host_keepalive();
@@ -14929,6 +16250,10 @@ void idle(
     print_job_timer.tick();
   #endif
 
+  #if ENABLED(SD_READ_AHEAD)
+    card.read_ahead();
+  #endif
+
   #if HAS_BUZZER && DISABLED(LCD_USE_I2C_BUZZER)
     buzzer.tick();
   #endif
@@ -14949,6 +16274,9 @@ void idle(
       #if ENABLED(AUTO_REPORT_SD_STATUS)
         card.auto_report_sd_status();
       #endif
+      #if ENABLED(BINARY_TELEMETRY)
+        report_telemetry();
+      #endif
     }
   #endif
 }
@@ -14970,6 +16298,10 @@ void kill(const char* lcd_msg) {
     UNUSED(lcd_msg);
   #endif
 
+  #if ENABLED(SERIAL_DEFERRED_TX)
+    SERIAL_FLUSHTX(); // Format the deferred output while interrupts still run
+  #endif
+
   _delay_ms(600); // Wait a short time (allows messages to get out before shutting down.
   cli(); // Stop interrupts
 
@@ -15095,7 +16427,9 @@ void setup() {
   SERIAL_ECHOLNPAIR(MSG_PLANNER_BUFFER_BYTES, int(sizeof(block_t))*(BLOCK_BUFFER_SIZE));
 
   // Send "ok" after commands by default
-  for (int8_t i = 0; i < BUFSIZE; i++) send_ok[i] = true;
+  #if DISABLED(COMMAND_QUEUE_ARENA)
+    for (int8_t i = 0; i < BUFSIZE; i++) send_ok[i] = true;
+  #endif
 
   // Load data from EEPROM if available (or use defaults)
   // This also updates variables in the planner, elsewhere
@@ -15327,7 +16661,7 @@ void loop() {
     #if ENABLED(SDSUPPORT)
 
       if (card.saving) {
-        char* command = command_queue[cmd_queue_index_r];
+        char* command = QUEUE_R;
         if (strstr_P(command, PSTR("M29"))) {
           // M29 closes the file
           card.closefile();
@@ -15369,7 +16703,7 @@ void loop() {
     // The queue may be reset by a command handler or by code invoked by idle() within a handler
     if (commands_in_queue) {
       --commands_in_queue;
-      if (++cmd_queue_index_r >= BUFSIZE) cmd_queue_index_r = 0;
+      cmd_queue_index_r = NEXT_QUEUED_COMMAND(command_queue, cmd_queue_index_r);
     }
   }
   endstops.event_handler();
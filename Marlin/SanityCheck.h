@@ -353,6 +353,10 @@
   #endif
 #elif ENABLED(SERIAL_XON_XOFF) || ENABLED(SERIAL_STATS_MAX_RX_QUEUED) || ENABLED(SERIAL_STATS_DROPPED_RX)
   #error "SERIAL_XON_XOFF and SERIAL_STATS_* features not supported on USB-native AVR devices."
+#elif ENABLED(SERIAL_CREDITS)
+  #error "SERIAL_CREDITS is not supported on USB-native AVR devices."
+#elif ENABLED(SERIAL_DEFERRED_TX) || ENABLED(SERIAL_STATS_TX_BLOCKED)
+  #error "SERIAL_DEFERRED_TX and SERIAL_STATS_TX_BLOCKED are not supported on USB-native AVR devices."
 #endif
 
 #if SERIAL_PORT > 7
@@ -616,6 +620,9 @@ static_assert(X_MAX_LENGTH >= X_BED_SIZE && Y_MAX_LENGTH >= Y_BED_SIZE,
     WITHIN(LIN_ADVANCE_K, 0, 10),
     "LIN_ADVANCE_K must be a value from 0 to 10 (Changed in LIN_ADVANCE v1.5, Marlin 1.1.9)."
   );
+  #if ENABLED(LIN_ADVANCE_SMOOTHING) && !WITHIN(LIN_ADVANCE_SMOOTH_TIME, 5, 200)
+    #error "LIN_ADVANCE_SMOOTH_TIME must be between 5 and 200 (ms)."
+  #endif
 #endif
 
 /**
@@ -753,6 +760,164 @@ static_assert(X_MAX_LENGTH >= X_BED_SIZE && Y_MAX_LENGTH >= Y_BED_SIZE,
   #error "LINE_BUILDUP_COMPENSATION_FEATURE is only compatible with HANGPRINTER."
 #endif
 
+#if ENABLED(HANGPRINTER_FK_LEAST_SQUARES)
+  #if DISABLED(HANGPRINTER)
+    #error "HANGPRINTER_FK_LEAST_SQUARES requires HANGPRINTER."
+  #elif !WITHIN(HANGPRINTER_FK_ITERATIONS, 1, 10)
+    #error "HANGPRINTER_FK_ITERATIONS must be between 1 and 10."
+  #endif
+#endif
+
+#if ENABLED(LINE_BUILDUP_INCREMENTAL)
+  #if DISABLED(LINE_BUILDUP_COMPENSATION_FEATURE)
+    #error "LINE_BUILDUP_INCREMENTAL requires LINE_BUILDUP_COMPENSATION_FEATURE."
+  #elif !WITHIN(LINE_BUILDUP_RESYNC, 1, 255)
+    #error "LINE_BUILDUP_RESYNC must be between 1 and 255."
+  #endif
+#endif
+
+#if ENABLED(INCREMENTAL_IK)
+  #if DISABLED(DELTA) && DISABLED(HANGPRINTER)
+    #error "INCREMENTAL_IK requires DELTA or HANGPRINTER."
+  #elif !WITHIN(INCREMENTAL_IK_RESYNC, 1, 255)
+    #error "INCREMENTAL_IK_RESYNC must be between 1 and 255."
+  #endif
+#endif
+
+#if ENABLED(ADAPTIVE_SEGMENTATION)
+  #if DISABLED(DELTA) && DISABLED(HANGPRINTER)
+    #error "ADAPTIVE_SEGMENTATION requires DELTA or HANGPRINTER."
+  #endif
+  static_assert(SEGMENT_CHORD_TOLERANCE > 0, "SEGMENT_CHORD_TOLERANCE must be greater than 0.");
+#endif
+
+#if ENABLED(BLOCK_MERGING)
+  #if IS_CORE
+    #error "BLOCK_MERGING is not compatible with CORE kinematics."
+  #elif ENABLED(MIXING_EXTRUDER)
+    #error "BLOCK_MERGING is not compatible with MIXING_EXTRUDER."
+  #elif ENABLED(FILAMENT_WIDTH_SENSOR)
+    #error "BLOCK_MERGING is not compatible with FILAMENT_WIDTH_SENSOR."
+  #elif defined(XY_FREQUENCY_LIMIT)
+    #error "BLOCK_MERGING is not compatible with XY_FREQUENCY_LIMIT."
+  #endif
+  static_assert(BLOCK_MERGE_MAX_DEVIATION >= 0, "BLOCK_MERGE_MAX_DEVIATION must be 0 or greater.");
+#endif
+
+#if ENABLED(STEP_RATE_INTERPOLATION)
+  #if ENABLED(S_CURVE_ACCELERATION)
+    #error "STEP_RATE_INTERPOLATION is not compatible with S_CURVE_ACCELERATION."
+  #elif !WITHIN(STEP_RATE_SEGMENT_SHIFT, 2, 6)
+    #error "STEP_RATE_SEGMENT_SHIFT must be between 2 and 6."
+  #endif
+#endif
+
+#if ENABLED(ADAPTIVE_MULTISTEPPING)
+  #if ENABLED(DISABLE_MULTI_STEPPING)
+    #error "ADAPTIVE_MULTISTEPPING is not compatible with DISABLE_MULTI_STEPPING."
+  #elif !WITHIN(ADAPTIVE_MULTISTEPPING_LOAD, 10, 90)
+    #error "ADAPTIVE_MULTISTEPPING_LOAD must be between 10 and 90."
+  #endif
+#endif
+
+#if ENABLED(STEP_STREAM)
+  #if DISABLED(UNREGISTERED_MOVE_SUPPORT)
+    #error "STEP_STREAM requires UNREGISTERED_MOVE_SUPPORT."
+  #elif ENABLED(MIXING_EXTRUDER)
+    #error "STEP_STREAM is not compatible with MIXING_EXTRUDER."
+  #elif ENABLED(EMERGENCY_PARSER)
+    #error "STEP_STREAM is not compatible with EMERGENCY_PARSER, which could act on the binary stream."
+  #elif !WITHIN(STEP_STREAM_QUEUE_SIZE, 2, 128) || (STEP_STREAM_QUEUE_SIZE & (STEP_STREAM_QUEUE_SIZE - 1))
+    #error "STEP_STREAM_QUEUE_SIZE must be a power of 2 from 2 to 128."
+  #endif
+#endif
+
+#if ENABLED(BINARY_GCODE)
+  #if ENABLED(EMERGENCY_PARSER)
+    #error "BINARY_GCODE is not compatible with EMERGENCY_PARSER, which could act on binary frames."
+  #elif !WITHIN(BINARY_FRAME_SIZE, 16, 250)
+    #error "BINARY_FRAME_SIZE must be between 16 and 250."
+  #endif
+#endif
+
+#if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+  #if DISABLED(FASTER_GCODE_PARSER)
+    #error "ZERO_COPY_COMMAND_QUEUE requires FASTER_GCODE_PARSER."
+  #elif MAX_CMD_SIZE > 255
+    #error "ZERO_COPY_COMMAND_QUEUE requires MAX_CMD_SIZE of 255 or less."
+  #elif !WITHIN(QUEUED_PARAM_OFFSETS, 1, 26)
+    #error "QUEUED_PARAM_OFFSETS must be between 1 and 26."
+  #endif
+#endif
+
+#if ENABLED(COMMAND_QUEUE_ARENA)
+  #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+    #error "COMMAND_QUEUE_ARENA is not compatible with ZERO_COPY_COMMAND_QUEUE."
+  #elif BUFSIZE > 255
+    #error "COMMAND_QUEUE_ARENA requires BUFSIZE of 255 or less."
+  #elif COMMAND_QUEUE_ARENA_SIZE < MAX_CMD_SIZE + 1 || COMMAND_QUEUE_ARENA_SIZE > 65535
+    #error "COMMAND_QUEUE_ARENA_SIZE must be between MAX_CMD_SIZE + 1 and 65535."
+  #endif
+#endif
+
+#if ENABLED(SD_READ_AHEAD) && !WITHIN(SD_READ_AHEAD_BLOCKS, 1, 8)
+  #error "SD_READ_AHEAD_BLOCKS must be between 1 and 8."
+#endif
+
+#if ENABLED(SD_BLOCK_CACHE) && !WITHIN(SD_CACHE_BLOCKS, 1, 8)
+  #error "SD_CACHE_BLOCKS must be between 1 and 8."
+#endif
+
+#if ENABLED(SD_DIR_INDEX)
+  #if DISABLED(SDCARD_SORT_ALPHA)
+    #error "SD_DIR_INDEX requires SDCARD_SORT_ALPHA."
+  #elif ENABLED(SDSORT_USES_RAM)
+    #error "SD_DIR_INDEX replaces SDSORT_USES_RAM. Disable one of them."
+  #endif
+#endif
+
+#if ENABLED(SERIAL_CREDITS) && DISABLED(ADVANCED_OK)
+  #error "SERIAL_CREDITS requires ADVANCED_OK."
+#endif
+
+#if ENABLED(GCODE_G1_FAST_PATH) && DISABLED(FASTER_GCODE_PARSER)
+  #error "GCODE_G1_FAST_PATH requires FASTER_GCODE_PARSER."
+#endif
+
+#if ENABLED(SERIAL_DEFERRED_TX)
+  #if TX_BUFFER_SIZE == 0
+    #error "SERIAL_DEFERRED_TX requires a TX_BUFFER_SIZE greater than 0."
+  #elif SERIAL_DEFERRED_TX_SIZE < 16 || SERIAL_DEFERRED_TX_SIZE > 256 || !IS_POWER_OF_2(SERIAL_DEFERRED_TX_SIZE)
+    #error "SERIAL_DEFERRED_TX_SIZE must be a power of 2 from 16 to 256."
+  #endif
+#endif
+
+#if ENABLED(BINARY_TELEMETRY) && !WITHIN(TELEMETRY_KEY_FRAMES, 1, 255)
+  #error "TELEMETRY_KEY_FRAMES must be from 1 to 255."
+#endif
+
+#if ENABLED(INPUT_SHAPING)
+  #if IS_KINEMATIC
+    #error "INPUT_SHAPING is not supported for DELTA, SCARA or HANGPRINTER."
+  #elif ENABLED(DUAL_X_CARRIAGE)
+    #error "INPUT_SHAPING is not compatible with DUAL_X_CARRIAGE."
+  #elif ENABLED(STEP_STREAM) || ENABLED(UNREGISTERED_MOVE_SUPPORT)
+    #error "INPUT_SHAPING is not compatible with STEP_STREAM or UNREGISTERED_MOVE_SUPPORT."
+  #elif !WITHIN(INPUT_SHAPING_TYPE, 0, 2)
+    #error "INPUT_SHAPING_TYPE must be 0 (ZV), 1 (ZVD) or 2 (MZV)."
+  #elif !WITHIN(INPUT_SHAPING_QUEUE_SIZE, 8, 128) || !IS_POWER_OF_2(INPUT_SHAPING_QUEUE_SIZE)
+    #error "INPUT_SHAPING_QUEUE_SIZE must be a power of 2 from 8 to 128."
+  #endif
+#endif
+
+#if ENABLED(PER_AXIS_STEP_TIMING)
+  #if ENABLED(INPUT_SHAPING)
+    #error "PER_AXIS_STEP_TIMING is not compatible with INPUT_SHAPING."
+  #elif ENABLED(ADAPTIVE_STEP_SMOOTHING)
+    #error "PER_AXIS_STEP_TIMING replaces ADAPTIVE_STEP_SMOOTHING. Disable one of them."
+  #endif
+#endif
+
 /**
  * Mechaduino requirements
  */
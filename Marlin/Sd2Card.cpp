@@ -165,6 +165,11 @@
 
 // send command and return error code.  Return zero for OK
 uint8_t Sd2Card::cardCommand(uint8_t cmd, uint32_t arg) {
+  #if ENABLED(SD_READ_AHEAD)
+    // Any other command ends a multiple block read
+    if (streaming_ && cmd != CMD12) readStreamEnd();
+  #endif
+
   // select card
   chipSelectLow();
 
@@ -299,6 +304,9 @@ bool Sd2Card::eraseSingleBlockEnable() {
  */
 bool Sd2Card::init(uint8_t sckRateID, pin_t chipSelectPin) {
   errorCode_ = type_ = 0;
+  #if ENABLED(SD_READ_AHEAD)
+    streaming_ = false;
+  #endif
   chipSelectPin_ = chipSelectPin;
   // 16-bit init start time allows over a minute
   uint16_t t0 = (uint16_t)millis();
@@ -569,6 +577,44 @@ bool Sd2Card::readStop() {
   return true;
 }
 
+#if ENABLED(SD_READ_AHEAD)
+
+  /**
+   * Read a 512 byte block, continuing the open multiple block read if the
+   * block follows the one it sent last, or else starting a new one.
+   * The sequence stays open until another command is sent to the card.
+   *
+   * \param[in] blockNumber Logical block to be read.
+   * \param[out] dst Pointer to the location that will receive the data.
+   * \return true for success, false for failure.
+   */
+  bool Sd2Card::readStream(uint32_t blockNumber, uint8_t* dst) {
+    if (!streaming_ || blockNumber != streamBlock_) {
+      readStreamEnd();
+      if (!readStart(blockNumber)) return false;
+      streaming_ = true;
+      streamBlock_ = blockNumber;
+    }
+    if (readData(dst)) {
+      streamBlock_++;
+      return true;
+    }
+    // Fall back to a single block read, which may retry
+    readStreamEnd();
+    return readBlock(blockNumber, dst);
+  }
+
+  /**
+   * End the open multiple block read, if any
+   */
+  void Sd2Card::readStreamEnd() {
+    if (!streaming_) return;
+    streaming_ = false;
+    readStop();
+  }
+
+#endif // SD_READ_AHEAD
+
 /**
  * Set the SPI clock rate.
  *
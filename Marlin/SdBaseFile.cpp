@@ -67,11 +67,11 @@ bool SdBaseFile::addDirCluster() {
   vol_->cacheSetBlockNumber(block, true);
 
   // zero first block of cluster
-  memset(vol_->cacheBuffer_.data, 0, 512);
+  memset(vol_->cache()->data, 0, 512);
 
   // zero rest of cluster
   for (uint8_t i = 1; i < vol_->blocksPerCluster_; i++) {
-    if (!vol_->writeBlock(block + i, vol_->cacheBuffer_.data)) return false;
+    if (!vol_->writeBlock(block + i, vol_->cache()->data)) return false;
   }
   // Increase directory file size by cluster size
   fileSize_ += 512UL << vol_->clusterSizeShift_;
@@ -829,7 +829,7 @@ bool SdBaseFile::openParent(SdBaseFile* dir) {
   // first block of parent dir
   if (!vol_->cacheRawBlock(lbn, SdVolume::CACHE_FOR_READ)) return false;
 
-  p = &vol_->cacheBuffer_.dir[1];
+  p = &vol_->cache()->dir[1];
   // verify name for '../..'
   if (p->name[0] != '.' || p->name[1] != '.') return false;
   // '..' is pointer to first cluster of parent. open '../..' to find parent
@@ -1022,7 +1022,7 @@ int16_t SdBaseFile::read(void* buf, uint16_t nbyte) {
     NOMORE(n, 512 - offset);
 
     // no buffering needed if n == 512
-    if (n == 512 && block != vol_->cacheBlockNumber()) {
+    if (n == 512 && !vol_->cacheHolds(block)) {
       if (!vol_->readBlock(block, dst)) return -1;
     }
     else {
@@ -1038,6 +1038,54 @@ int16_t SdBaseFile::read(void* buf, uint16_t nbyte) {
   return nbyte;
 }
 
+#if ENABLED(SD_READ_AHEAD)
+
+  /**
+   * Read the block at the current position with a multiple block read,
+   * which keeps streaming while the blocks of the file follow one another.
+   * The position must be at the start of a block.
+   *
+   * \param[out] dst Pointer to 512 bytes that will receive the block.
+   *
+   * \return The number of bytes of the file in the block, zero at the
+   * end of the file, or -1 for an error.
+   */
+  int16_t SdBaseFile::readStream(uint8_t* dst) {
+    uint32_t block;  // raw device block number
+
+    // error if not open, write only or not at a block
+    if (!isOpen() || !(flags_ & O_READ) || (curPosition_ & 0x1FF)) return -1;
+    if (curPosition_ >= fileSize_) return 0;
+
+    if (type_ == FAT_FILE_TYPE_ROOT_FIXED)
+      block = vol_->rootDirStart() + (curPosition_ >> 9);
+    else {
+      uint8_t blockOfCluster = vol_->blockOfCluster(curPosition_);
+      if (blockOfCluster == 0) {
+        // start of new cluster
+        if (curPosition_ == 0)
+          curCluster_ = firstCluster_;                      // use first cluster in file
+        else if (!vol_->fatGet(curCluster_, &curCluster_))  // get next cluster from FAT
+          return -1;
+      }
+      block = vol_->clusterStartBlock(curCluster_) + blockOfCluster;
+    }
+
+    // The cache may hold a newer copy of the block
+    if (vol_->cacheHolds(block)) {
+      if (!vol_->cacheRawBlock(block, SdVolume::CACHE_FOR_READ)) return -1;
+      memcpy(dst, vol_->cache()->data, 512);
+    }
+    else if (!vol_->readStream(block, dst))
+      return -1;
+
+    const uint16_t n = MIN(fileSize_ - curPosition_, 512UL);
+    curPosition_ += n;
+    return n;
+  }
+
+#endif // SD_READ_AHEAD
+
 /**
  * Read the next entry in a directory.
  *
@@ -1680,10 +1728,8 @@ int16_t SdBaseFile::write(const void* buf, uint16_t nbyte) {
     uint32_t block = vol_->clusterStartBlock(curCluster_) + blockOfCluster;
     if (n == 512) {
       // full block - don't need to use cache
-      if (vol_->cacheBlockNumber() == block) {
-        // invalidate cache if block is in cache
-        vol_->cacheSetBlockNumber(0xFFFFFFFF, false);
-      }
+      // invalidate cache if block is in cache
+      vol_->cacheInvalidate(block);
       if (!vol_->writeBlock(block, src)) goto FAIL;
     }
     else {
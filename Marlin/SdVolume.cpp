@@ -34,13 +34,25 @@
 
 #if !USE_MULTIPLE_CARDS
   // raw block cache
-  uint32_t SdVolume::cacheBlockNumber_;  // current block number
-  cache_t  SdVolume::cacheBuffer_;       // 512 byte cache for Sd2Card
+  #if ENABLED(SD_BLOCK_CACHE)
+    SdVolume::cacheEntry_t SdVolume::cacheFat_;                    // FAT block
+    SdVolume::cacheEntry_t SdVolume::cacheData_[SD_CACHE_BLOCKS];  // data and directory blocks
+    SdVolume::cacheEntry_t* SdVolume::cacheCurrent_ = cacheData_;  // block of the last cacheRawBlock()
+  #else
+    uint32_t SdVolume::cacheBlockNumber_;  // current block number
+    cache_t  SdVolume::cacheBuffer_;       // 512 byte cache for Sd2Card
+    bool     SdVolume::cacheDirty_;        // cacheFlush() will write block if true
+  #endif
   Sd2Card* SdVolume::sdCard_;            // pointer to SD card object
-  bool     SdVolume::cacheDirty_;        // cacheFlush() will write block if true
   uint32_t SdVolume::cacheMirrorBlock_;  // mirror  block for second FAT
 #endif  // USE_MULTIPLE_CARDS
 
+#if ENABLED(SD_BLOCK_CACHE)
+  uint32_t SdVolume::cacheHits, SdVolume::cacheMisses,
+           SdVolume::fatHits, SdVolume::fatMisses,
+           SdVolume::cacheWrites;
+#endif
+
 // find a contiguous group of clusters
 bool SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
   // start of group
@@ -113,6 +125,111 @@ bool SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
   return true;
 }
 
+#if ENABLED(SD_BLOCK_CACHE)
+
+// write a cached block back to the card if it has changed
+bool SdVolume::cacheWriteBack(cacheEntry_t* entry) {
+  if (entry->dirty) {
+    if (!sdCard_->writeBlock(entry->blockNumber, entry->buffer.data))
+      return false;
+
+    // mirror FAT tables
+    if (entry == &cacheFat_ && cacheMirrorBlock_) {
+      if (!sdCard_->writeBlock(cacheMirrorBlock_, entry->buffer.data))
+        return false;
+      cacheMirrorBlock_ = 0;
+    }
+    entry->dirty = false;
+    cacheWrites++;
+  }
+  return true;
+}
+
+// write back all changed blocks, the data before the FAT
+bool SdVolume::cacheFlush() {
+  for (uint8_t i = 0; i < SD_CACHE_BLOCKS; i++)
+    if (!cacheWriteBack(&cacheData_[i])) return false;
+  return cacheWriteBack(&cacheFat_);
+}
+
+// the data or directory block in the cache, or NULL
+SdVolume::cacheEntry_t* SdVolume::cacheFind(uint32_t blockNumber) {
+  for (uint8_t i = 0; i < SD_CACHE_BLOCKS; i++)
+    if (cacheData_[i].blockNumber == blockNumber) return &cacheData_[i];
+  return NULL;
+}
+
+// make a block the current one and the most recently used
+void SdVolume::cacheUse(cacheEntry_t* entry) {
+  for (uint8_t i = 0; i < SD_CACHE_BLOCKS; i++)
+    if (cacheData_[i].age < 0xFF) cacheData_[i].age++;
+  entry->age = 0;
+  cacheCurrent_ = entry;
+}
+
+bool SdVolume::cacheRawBlock(uint32_t blockNumber, bool dirty) {
+  cacheEntry_t* entry = cacheFind(blockNumber);
+  if (entry)
+    cacheHits++;
+  else {
+    // replace the least recently used block
+    entry = cacheData_;
+    for (uint8_t i = 1; i < SD_CACHE_BLOCKS; i++)
+      if (cacheData_[i].age > entry->age) entry = &cacheData_[i];
+    if (!cacheWriteBack(entry)) return false;
+    if (!sdCard_->readBlock(blockNumber, entry->buffer.data)) {
+      entry->blockNumber = 0xFFFFFFFF;
+      return false;
+    }
+    entry->blockNumber = blockNumber;
+    cacheMisses++;
+  }
+  if (dirty) entry->dirty = true;
+  cacheUse(entry);
+  return true;
+}
+
+// FAT blocks have their own entry, so walking a chain keeps the data cached
+cache_t* SdVolume::cacheFatBlock(uint32_t blockNumber, bool dirty) {
+  if (cacheFat_.blockNumber == blockNumber)
+    fatHits++;
+  else {
+    if (!cacheWriteBack(&cacheFat_)) return NULL;
+    if (!sdCard_->readBlock(blockNumber, cacheFat_.buffer.data)) {
+      cacheFat_.blockNumber = 0xFFFFFFFF;
+      return NULL;
+    }
+    cacheFat_.blockNumber = blockNumber;
+    fatMisses++;
+  }
+  if (dirty) cacheFat_.dirty = true;
+  return &cacheFat_.buffer;
+}
+
+void SdVolume::cacheSetBlockNumber(uint32_t blockNumber, bool dirty) {
+  cacheEntry_t* entry = cacheFind(blockNumber);
+  if (!entry) {
+    // the cache was flushed, so any block may be given up
+    entry = cacheData_;
+    for (uint8_t i = 1; i < SD_CACHE_BLOCKS; i++)
+      if (cacheData_[i].age > entry->age) entry = &cacheData_[i];
+    entry->blockNumber = blockNumber;
+  }
+  entry->dirty = dirty;
+  cacheUse(entry);
+}
+
+// forget a block that is written around the cache
+void SdVolume::cacheInvalidate(uint32_t blockNumber) {
+  cacheEntry_t* entry = cacheFind(blockNumber);
+  if (entry) {
+    entry->blockNumber = 0xFFFFFFFF;
+    entry->dirty = false;
+  }
+}
+
+#else // !SD_BLOCK_CACHE
+
 bool SdVolume::cacheFlush() {
   if (cacheDirty_) {
     if (!sdCard_->writeBlock(cacheBlockNumber_, cacheBuffer_.data))
@@ -139,6 +256,8 @@ bool SdVolume::cacheRawBlock(uint32_t blockNumber, bool dirty) {
   return true;
 }
 
+#endif // !SD_BLOCK_CACHE
+
 // return the size in bytes of a cluster chain
 bool SdVolume::chainSize(uint32_t cluster, uint32_t* size) {
   uint32_t s = 0;
@@ -158,15 +277,16 @@ bool SdVolume::fatGet(uint32_t cluster, uint32_t* value) {
     uint16_t index = cluster;
     index += index >> 1;
     lba = fatStartBlock_ + (index >> 9);
-    if (!cacheRawBlock(lba, CACHE_FOR_READ)) return false;
+    cache_t* fat = cacheFatBlock(lba, CACHE_FOR_READ);
+    if (!fat) return false;
     index &= 0x1FF;
-    uint16_t tmp = cacheBuffer_.data[index];
+    uint16_t tmp = fat->data[index];
     index++;
     if (index == 512) {
-      if (!cacheRawBlock(lba + 1, CACHE_FOR_READ)) return false;
+      if (!(fat = cacheFatBlock(lba + 1, CACHE_FOR_READ))) return false;
       index = 0;
     }
-    tmp |= cacheBuffer_.data[index] << 8;
+    tmp |= fat->data[index] << 8;
     *value = cluster & 1 ? tmp >> 4 : tmp & 0xFFF;
     return true;
   }
@@ -178,10 +298,10 @@ bool SdVolume::fatGet(uint32_t cluster, uint32_t* value) {
   else
     return false;
 
-  if (lba != cacheBlockNumber_ && !cacheRawBlock(lba, CACHE_FOR_READ))
-    return false;
+  const cache_t* fat = cacheFatBlock(lba, CACHE_FOR_READ);
+  if (!fat) return false;
 
-  *value = (fatType_ == 16) ? cacheBuffer_.fat16[cluster & 0xFF] : (cacheBuffer_.fat32[cluster & 0x7F] & FAT32MASK);
+  *value = (fatType_ == 16) ? fat->fat16[cluster & 0xFF] : (fat->fat32[cluster & 0x7F] & FAT32MASK);
   return true;
 }
 
@@ -198,28 +318,29 @@ bool SdVolume::fatPut(uint32_t cluster, uint32_t value) {
     uint16_t index = cluster;
     index += index >> 1;
     lba = fatStartBlock_ + (index >> 9);
-    if (!cacheRawBlock(lba, CACHE_FOR_WRITE)) return false;
+    cache_t* fat = cacheFatBlock(lba, CACHE_FOR_WRITE);
+    if (!fat) return false;
     // mirror second FAT
     if (fatCount_ > 1) cacheMirrorBlock_ = lba + blocksPerFat_;
     index &= 0x1FF;
     uint8_t tmp = value;
     if (cluster & 1) {
-      tmp = (cacheBuffer_.data[index] & 0xF) | tmp << 4;
+      tmp = (fat->data[index] & 0xF) | tmp << 4;
     }
-    cacheBuffer_.data[index] = tmp;
+    fat->data[index] = tmp;
     index++;
     if (index == 512) {
       lba++;
       index = 0;
-      if (!cacheRawBlock(lba, CACHE_FOR_WRITE)) return false;
+      if (!(fat = cacheFatBlock(lba, CACHE_FOR_WRITE))) return false;
       // mirror second FAT
       if (fatCount_ > 1) cacheMirrorBlock_ = lba + blocksPerFat_;
     }
     tmp = value >> 4;
     if (!(cluster & 1)) {
-      tmp = ((cacheBuffer_.data[index] & 0xF0)) | tmp >> 4;
+      tmp = ((fat->data[index] & 0xF0)) | tmp >> 4;
     }
-    cacheBuffer_.data[index] = tmp;
+    fat->data[index] = tmp;
     return true;
   }
 
@@ -230,13 +351,14 @@ bool SdVolume::fatPut(uint32_t cluster, uint32_t value) {
   else
     return false;
 
-  if (!cacheRawBlock(lba, CACHE_FOR_WRITE)) return false;
+  cache_t* fat = cacheFatBlock(lba, CACHE_FOR_WRITE);
+  if (!fat) return false;
 
   // store entry
   if (fatType_ == 16)
-    cacheBuffer_.fat16[cluster & 0xFF] = value;
+    fat->fat16[cluster & 0xFF] = value;
   else
-    cacheBuffer_.fat32[cluster & 0x7F] = value;
+    fat->fat32[cluster & 0x7F] = value;
 
   // mirror second FAT
   if (fatCount_ > 1) cacheMirrorBlock_ = lba + blocksPerFat_;
@@ -278,15 +400,16 @@ int32_t SdVolume::freeClusterCount() {
     return -1;
 
   for (uint32_t lba = fatStartBlock_; todo; todo -= n, lba++) {
-    if (!cacheRawBlock(lba, CACHE_FOR_READ)) return -1;
+    const cache_t* fat = cacheFatBlock(lba, CACHE_FOR_READ);
+    if (!fat) return -1;
     NOMORE(n, todo);
     if (fatType_ == 16) {
       for (uint16_t i = 0; i < n; i++)
-        if (cacheBuffer_.fat16[i] == 0) free++;
+        if (fat->fat16[i] == 0) free++;
     }
     else {
       for (uint16_t i = 0; i < n; i++)
-        if (cacheBuffer_.fat32[i] == 0) free++;
+        if (fat->fat32[i] == 0) free++;
     }
   }
   return free;
@@ -312,22 +435,33 @@ bool SdVolume::init(Sd2Card* dev, uint8_t part) {
   sdCard_ = dev;
   fatType_ = 0;
   allocSearchStart_ = 2;
-  cacheDirty_ = 0;  // cacheFlush() will write block if true
+  #if ENABLED(SD_BLOCK_CACHE)
+    cacheFat_.blockNumber = 0xFFFFFFFF;
+    cacheFat_.dirty = false;
+    for (uint8_t i = 0; i < SD_CACHE_BLOCKS; i++) {
+      cacheData_[i].blockNumber = 0xFFFFFFFF;
+      cacheData_[i].dirty = false;
+      cacheData_[i].age = 0xFF;
+    }
+    cacheCurrent_ = cacheData_;
+  #else
+    cacheDirty_ = 0;  // cacheFlush() will write block if true
+    cacheBlockNumber_ = 0xFFFFFFFF;
+  #endif
   cacheMirrorBlock_ = 0;
-  cacheBlockNumber_ = 0xFFFFFFFF;
 
   // if part == 0 assume super floppy with FAT boot sector in block zero
   // if part > 0 assume mbr volume with partition table
   if (part) {
     if (part > 4) return false;
     if (!cacheRawBlock(volumeStartBlock, CACHE_FOR_READ)) return false;
-    part_t* p = &cacheBuffer_.mbr.part[part - 1];
+    part_t* p = &cache()->mbr.part[part - 1];
     if ((p->boot & 0x7F) != 0  || p->totalSectors < 100 || p->firstSector == 0)
       return false; // not a valid partition
     volumeStartBlock = p->firstSector;
   }
   if (!cacheRawBlock(volumeStartBlock, CACHE_FOR_READ)) return false;
-  fbs = &cacheBuffer_.fbs32;
+  fbs = &cache()->fbs32;
   if (fbs->bytesPerSector != 512 ||
       fbs->fatCount == 0 ||
       fbs->reservedSectorCount == 0 ||
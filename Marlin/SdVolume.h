@@ -61,7 +61,11 @@ union cache_t {
 class SdVolume {
  public:
   // Create an instance of SdVolume
-  SdVolume() : fatType_(0) {}
+  SdVolume() : fatType_(0) {
+    #if USE_MULTIPLE_CARDS && ENABLED(SD_BLOCK_CACHE)
+      cacheCurrent_ = cacheData_;
+    #endif
+  }
   /**
    * Clear the cache and returns a pointer to the cache.  Used by the WaveRP
    * recorder to do raw write to the SD card.  Not for normal apps.
@@ -69,8 +73,13 @@ class SdVolume {
    */
   cache_t* cacheClear() {
     if (!cacheFlush()) return 0;
-    cacheBlockNumber_ = 0xFFFFFFFF;
-    return &cacheBuffer_;
+    #if ENABLED(SD_BLOCK_CACHE)
+      cacheCurrent_->blockNumber = 0xFFFFFFFF;
+      return &cacheCurrent_->buffer;
+    #else
+      cacheBlockNumber_ = 0xFFFFFFFF;
+      return &cacheBuffer_;
+    #endif
   }
 
   /**
@@ -119,6 +128,14 @@ class SdVolume {
    */
   bool dbgFat(uint32_t n, uint32_t* v) { return fatGet(n, v); }
 
+  #if ENABLED(SD_BLOCK_CACHE)
+    // Cache statistics since the last reset
+    static uint32_t cacheHits, cacheMisses,  // Data and directory blocks
+                    fatHits, fatMisses,      // FAT blocks
+                    cacheWrites;             // Dirty blocks written back
+    static void resetCacheStats() { cacheHits = cacheMisses = fatHits = fatMisses = cacheWrites = 0; }
+  #endif
+
  private:
   // Allow SdBaseFile access to SdVolume private data.
   friend class SdBaseFile;
@@ -128,17 +145,39 @@ class SdVolume {
   // value for dirty argument in cacheRawBlock to indicate write to cache
   static bool const CACHE_FOR_WRITE = true;
 
+  #if ENABLED(SD_BLOCK_CACHE)
+    // A cached device block
+    struct cacheEntry_t {
+      cache_t buffer;        // 512 byte copy of the block
+      uint32_t blockNumber;  // Logical number of the block, 0xFFFFFFFF if none
+      bool dirty;            // cacheFlush() will write block if true
+      uint8_t age;           // Uses of other blocks since this one was used
+    };
+  #endif
+
   #if USE_MULTIPLE_CARDS
-    cache_t cacheBuffer_;        // 512 byte cache for device blocks
-    uint32_t cacheBlockNumber_;  // Logical number of block in the cache
+    #if ENABLED(SD_BLOCK_CACHE)
+      cacheEntry_t cacheFat_;                    // FAT block, kept apart from the data
+      cacheEntry_t cacheData_[SD_CACHE_BLOCKS];  // Data and directory blocks, least recently used replaced first
+      cacheEntry_t* cacheCurrent_;               // Block of the last cacheRawBlock()
+    #else
+      cache_t cacheBuffer_;        // 512 byte cache for device blocks
+      uint32_t cacheBlockNumber_;  // Logical number of block in the cache
+      bool cacheDirty_;            // cacheFlush() will write block if true
+    #endif
     Sd2Card* sdCard_;            // Sd2Card object for cache
-    bool cacheDirty_;            // cacheFlush() will write block if true
     uint32_t cacheMirrorBlock_;  // block number for mirror FAT
   #else
-    static cache_t cacheBuffer_;        // 512 byte cache for device blocks
-    static uint32_t cacheBlockNumber_;  // Logical number of block in the cache
+    #if ENABLED(SD_BLOCK_CACHE)
+      static cacheEntry_t cacheFat_;                    // FAT block, kept apart from the data
+      static cacheEntry_t cacheData_[SD_CACHE_BLOCKS];  // Data and directory blocks, least recently used replaced first
+      static cacheEntry_t* cacheCurrent_;               // Block of the last cacheRawBlock()
+    #else
+      static cache_t cacheBuffer_;        // 512 byte cache for device blocks
+      static uint32_t cacheBlockNumber_;  // Logical number of block in the cache
+      static bool cacheDirty_;            // cacheFlush() will write block if true
+    #endif
     static Sd2Card* sdCard_;            // Sd2Card object for cache
-    static bool cacheDirty_;            // cacheFlush() will write block if true
     static uint32_t cacheMirrorBlock_;  // block number for mirror FAT
   #endif
 
@@ -159,23 +198,57 @@ class SdVolume {
   uint32_t clusterStartBlock(uint32_t cluster) const { return dataStartBlock_ + ((cluster - 2) << clusterSizeShift_); }
   uint32_t blockNumber(uint32_t cluster, uint32_t position) const { return clusterStartBlock(cluster) + blockOfCluster(position); }
 
-  cache_t* cache() { return &cacheBuffer_; }
-  uint32_t cacheBlockNumber() const { return cacheBlockNumber_; }
+  #if ENABLED(SD_BLOCK_CACHE)
+
+    cache_t* cache() { return &cacheCurrent_->buffer; }
+    uint32_t cacheBlockNumber() const { return cacheCurrent_->blockNumber; }
+
+    #if USE_MULTIPLE_CARDS
+      bool cacheFlush();
+      bool cacheRawBlock(uint32_t blockNumber, bool dirty);
+      cache_t* cacheFatBlock(uint32_t blockNumber, bool dirty);
+      bool cacheWriteBack(cacheEntry_t* entry);
+      cacheEntry_t* cacheFind(uint32_t blockNumber);
+      void cacheUse(cacheEntry_t* entry);
+    #else
+      static bool cacheFlush();
+      static bool cacheRawBlock(uint32_t blockNumber, bool dirty);
+      static cache_t* cacheFatBlock(uint32_t blockNumber, bool dirty);
+      static bool cacheWriteBack(cacheEntry_t* entry);
+      static cacheEntry_t* cacheFind(uint32_t blockNumber);
+      static void cacheUse(cacheEntry_t* entry);
+    #endif
+
+    // used by SdBaseFile write to assign cache to SD location, after cacheFlush()
+    void cacheSetBlockNumber(uint32_t blockNumber, bool dirty);
+    void cacheSetDirty() { cacheCurrent_->dirty = true; }
+    bool cacheHolds(uint32_t blockNumber) { return cacheFind(blockNumber) != NULL; }
+    void cacheInvalidate(uint32_t blockNumber);
 
-  #if USE_MULTIPLE_CARDS
-    bool cacheFlush();
-    bool cacheRawBlock(uint32_t blockNumber, bool dirty);
   #else
-    static bool cacheFlush();
-    static bool cacheRawBlock(uint32_t blockNumber, bool dirty);
-  #endif
 
-  // used by SdBaseFile write to assign cache to SD location
-  void cacheSetBlockNumber(uint32_t blockNumber, bool dirty) {
-    cacheDirty_ = dirty;
-    cacheBlockNumber_  = blockNumber;
-  }
-  void cacheSetDirty() { cacheDirty_ |= CACHE_FOR_WRITE; }
+    cache_t* cache() { return &cacheBuffer_; }
+    uint32_t cacheBlockNumber() const { return cacheBlockNumber_; }
+
+    #if USE_MULTIPLE_CARDS
+      bool cacheFlush();
+      bool cacheRawBlock(uint32_t blockNumber, bool dirty);
+    #else
+      static bool cacheFlush();
+      static bool cacheRawBlock(uint32_t blockNumber, bool dirty);
+    #endif
+    cache_t* cacheFatBlock(uint32_t blockNumber, bool dirty) { return cacheRawBlock(blockNumber, dirty) ? &cacheBuffer_ : NULL; }
+
+    // used by SdBaseFile write to assign cache to SD location
+    void cacheSetBlockNumber(uint32_t blockNumber, bool dirty) {
+      cacheDirty_ = dirty;
+      cacheBlockNumber_  = blockNumber;
+    }
+    void cacheSetDirty() { cacheDirty_ |= CACHE_FOR_WRITE; }
+    bool cacheHolds(uint32_t blockNumber) const { return cacheBlockNumber_ == blockNumber; }
+    void cacheInvalidate(uint32_t blockNumber) { if (cacheBlockNumber_ == blockNumber) cacheSetBlockNumber(0xFFFFFFFF, false); }
+
+  #endif
   bool chainSize(uint32_t beginCluster, uint32_t* size);
   bool fatGet(uint32_t cluster, uint32_t* value);
   bool fatPut(uint32_t cluster, uint32_t value);
@@ -187,6 +260,9 @@ class SdVolume {
     return  cluster >= FAT32EOC_MIN;
   }
   bool readBlock(uint32_t block, uint8_t* dst) { return sdCard_->readBlock(block, dst); }
+  #if ENABLED(SD_READ_AHEAD)
+    bool readStream(uint32_t block, uint8_t* dst) { return sdCard_->readStream(block, dst); }
+  #endif
   bool writeBlock(uint32_t block, const uint8_t* dst) { return sdCard_->writeBlock(block, dst); }
 
   // Deprecated functions
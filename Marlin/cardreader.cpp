@@ -38,6 +38,9 @@
 CardReader::CardReader() {
   #if ENABLED(SDCARD_SORT_ALPHA)
     sort_count = 0;
+    #if ENABLED(SD_DIR_INDEX)
+      dir_indexed = false;
+    #endif
     #if ENABLED(SDSORT_GCODE)
       sort_alpha = true;
       sort_folders = FOLDER_SORTING;
@@ -49,6 +52,12 @@ CardReader::CardReader() {
   sdpos = 0;
   file_subcall_ctr = 0;
 
+  #if ENABLED(SD_READ_AHEAD)
+    ahead_head = ahead_count = 0;
+    ahead_pos = 0;
+    reset_read_ahead_stats();
+  #endif
+
   workDirDepth = 0;
   ZERO(workDirParents);
 
@@ -72,6 +81,16 @@ char *createFilename(char *buffer, const dir_t &p) { //buffer > 12characters
   return buffer;
 }
 
+/**
+ * Folders and G-code files that aren't hidden are listed
+ */
+static bool is_listed(const dir_t &p, const char * const longname) {
+  if (p.name[0] == DIR_NAME_DELETED || p.name[0] == '.') return false;
+  if (longname[0] == '.') return false;
+  if (!DIR_IS_FILE_OR_SUBDIR(&p) || (p.attributes & DIR_ATT_HIDDEN)) return false;
+  return DIR_IS_SUBDIR(&p) || (p.name[8] == 'G' && p.name[9] != '~');
+}
+
 /**
  * Dive into a folder and recurse depth-first to perform a pre-set operation lsAction:
  *   LS_Count       - Add +1 to nrFiles for every file within the parent
@@ -123,17 +142,11 @@ void CardReader::lsDive(const char *prepend, SdFile parent, const char * const m
       // close() is done automatically by destructor of SdFile
     }
     else {
-      uint8_t pn0 = p.name[0];
-      if (pn0 == DIR_NAME_FREE) break;
-      if (pn0 == DIR_NAME_DELETED || pn0 == '.') continue;
-      if (longFilename[0] == '.') continue;
-
-      if (!DIR_IS_FILE_OR_SUBDIR(&p) || (p.attributes & DIR_ATT_HIDDEN)) continue;
+      if (p.name[0] == DIR_NAME_FREE) break;
+      if (!is_listed(p, longFilename)) continue;
 
       filenameIsDir = DIR_IS_SUBDIR(&p);
 
-      if (!filenameIsDir && (p.name[8] != 'G' || p.name[9] == '~')) continue;
-
       switch (lsAction) {  // 1 based file count
         case LS_Count:
           nrFiles++;
@@ -162,9 +175,13 @@ void CardReader::lsDive(const char *prepend, SdFile parent, const char * const m
 }
 
 void CardReader::ls() {
-  lsAction = LS_SerialPrint;
-  root.rewind();
-  lsDive(NULL, root);
+  #if ENABLED(SD_DIR_INDEX)
+    lsIndexed();
+  #else
+    lsAction = LS_SerialPrint;
+    root.rewind();
+    lsDive(NULL, root);
+  #endif
 }
 
 #if ENABLED(LONG_FILENAME_HOST_SUPPORT)
@@ -288,6 +305,9 @@ void CardReader::initsd() {
 void CardReader::release() {
   sdprinting = false;
   cardOK = false;
+  #if ENABLED(SD_DIR_INDEX)
+    flush_presort();
+  #endif
 }
 
 void CardReader::openAndPrintFile(const char *name) {
@@ -401,6 +421,9 @@ void CardReader::openFile(char * const path, const bool read, const bool subcall
     if (file.open(curDir, fname, O_READ)) {
       filesize = file.fileSize();
       sdpos = 0;
+      #if ENABLED(SD_READ_AHEAD)
+        clear_read_ahead(0);
+      #endif
       SERIAL_PROTOCOLPAIR(MSG_SD_FILE_OPENED, fname);
       SERIAL_PROTOCOLLNPAIR(MSG_SD_SIZE, filesize);
       SERIAL_PROTOCOLLNPGM(MSG_SD_FILE_SELECTED);
@@ -528,6 +551,10 @@ void CardReader::beginautostart() {
 void CardReader::closefile(const bool store_location) {
   file.sync();
   file.close();
+  #if ENABLED(SD_DIR_INDEX)
+    // Show an uploaded file
+    if (saving && dir_indexed) presort();
+  #endif
   saving = logging = false;
 
   if (store_location) {
@@ -642,12 +669,250 @@ void CardReader::setroot() {
   #endif
 }
 
+#if ENABLED(SD_DIR_INDEX)
+
+  /**
+   * The sorted index of a folder is kept in a file of the folder: a header
+   * block, then a record for each listed item in sorted order. The stamp
+   * hashes the directory entries and long names of the listed items, so a
+   * file added, removed, renamed or written, by Marlin or on a PC, makes
+   * the index stale and it is built again.
+   */
+  #define DIR_INDEX_NAME    "DIRINDEX.BIN"
+  #define DIR_INDEX_VERSION 1
+  // A power of 2, so no record spans two blocks
+  #define DIR_INDEX_RECORD  (LONG_FILENAME_LENGTH > 43 ? 128 : 64)
+  // Longer names are cut short in the record
+  #define DIR_INDEX_LONG    (LONG_FILENAME_LENGTH > DIR_INDEX_RECORD - 7 - (FILENAME_LENGTH) ? DIR_INDEX_RECORD - 7 - (FILENAME_LENGTH) : LONG_FILENAME_LENGTH)
+
+  typedef struct {
+    char magic[4];            // "MIDX"
+    uint8_t version, record_size;
+    int8_t folders;           // Folder sorting of the records
+    uint16_t count;           // Records after the header block
+    uint32_t stamp;           // index_stamp() of the folder
+  } dir_index_header_t;
+
+  typedef struct {
+    uint32_t fileSize;
+    uint16_t dirIndex;        // Entry of the item in the folder
+    bool isDir;
+    char filename[FILENAME_LENGTH], longFilename[DIR_INDEX_LONG];
+    uint8_t pad[DIR_INDEX_RECORD - 7 - (FILENAME_LENGTH) - (DIR_INDEX_LONG)];
+  } dir_index_record_t;
+
+  static_assert(sizeof(dir_index_record_t) == DIR_INDEX_RECORD, "An SD_DIR_INDEX record must fill DIR_INDEX_RECORD exactly.");
+
+  static uint32_t index_hash(uint32_t h, const void * const data, uint8_t len) {
+    const uint8_t *d = (const uint8_t*)data;
+    while (len--) h = (h ^ *d++) * 16777619UL; // FNV-1a
+    return h;
+  }
+
+  /**
+   * Hash the listed items of a folder, and find the entry of its index.
+   * The last access date is left out, since some systems change it on
+   * every read.
+   */
+  static uint32_t index_stamp(SdFile &dir, char * const longname, uint16_t &entry) {
+    uint32_t h = 2166136261UL;
+    dir_t p;
+    entry = 0xFFFF;
+    dir.rewind();
+    while (dir.readDir(&p, longname) > 0) {
+      if (!memcmp(p.name, "DIRINDEXBIN", 11)) entry = dir.curPosition() / sizeof(dir_t) - 1;
+      if (!is_listed(p, longname)) continue;
+      h = index_hash(h, &p, offsetof(dir_t, lastAccessDate));
+      h = index_hash(h, &p.firstClusterHigh, sizeof(dir_t) - offsetof(dir_t, firstClusterHigh));
+      h = index_hash(h, longname, strlen(longname));
+    }
+    return h;
+  }
+
+  // Read or write a record, which is in one block of the file
+  static bool index_record(SdFile &index, const uint16_t nr, dir_index_record_t &rec, const bool write) {
+    if (!index.seekSet(512UL + uint32_t(nr) * (DIR_INDEX_RECORD))) return false;
+    return (write ? index.write(&rec, sizeof(rec)) : index.read(&rec, sizeof(rec))) == int16_t(sizeof(rec));
+  }
+
+  // Whether item a sorts after item b, as in presort()
+  static bool index_after(const dir_index_record_t &a, const dir_index_record_t &b, const int8_t folders) {
+    if (folders && a.isDir != b.isDir) return folders > 0 ? a.isDir : b.isDir;
+    return strcasecmp(a.longFilename[0] ? a.longFilename : a.filename, b.longFilename[0] ? b.longFilename : b.filename) > 0;
+  }
+
+  /**
+   * Write a record for each listed item of the folder, then sort the
+   * records in place. The header goes last, so an index that was cut
+   * short is never taken as valid.
+   */
+  static bool index_build(SdFile &dir, SdFile &index, const uint32_t stamp, const int8_t folders, char * const longname, uint16_t &count) {
+    dir_index_record_t rec, tmp;
+    memset(&rec, 0, sizeof(rec));
+    if (!index.truncate(0)) return false;
+    for (uint8_t i = 0; i < 512 / (DIR_INDEX_RECORD); i++)
+      if (index.write(&rec, sizeof(rec)) != int16_t(sizeof(rec))) return false;
+
+    uint16_t n = 0;
+    dir_t p;
+    dir.rewind();
+    while (n < 0xFFFF && dir.readDir(&p, longname) > 0) {
+      if (!is_listed(p, longname)) continue;
+      rec.fileSize = p.fileSize;
+      rec.dirIndex = dir.curPosition() / sizeof(dir_t) - 1;
+      rec.isDir = DIR_IS_SUBDIR(&p);
+      createFilename(rec.filename, p);
+      strncpy(rec.longFilename, longname, DIR_INDEX_LONG - 1);
+      if (index.write(&rec, sizeof(rec)) != int16_t(sizeof(rec))) return false;
+      n++;
+    }
+
+    // Shell sort, whose passes mostly step through the file in order
+    static const uint16_t gaps[] PROGMEM = { 1750, 701, 301, 132, 57, 23, 10, 4, 1 };
+    for (uint8_t g = 0; g < COUNT(gaps); g++) {
+      const uint16_t gap = pgm_read_word(&gaps[g]);
+      for (uint16_t i = gap; i < n; i++) {
+        if (!index_record(index, i, tmp, false)) return false;
+        uint16_t j = i;
+        for (; j >= gap; j -= gap) {
+          if (!index_record(index, j - gap, rec, false)) return false;
+          if (!index_after(rec, tmp, folders)) break;
+          if (!index_record(index, j, rec, true)) return false;
+        }
+        if (j != i && !index_record(index, j, tmp, true)) return false;
+      }
+    }
+
+    dir_index_header_t head = { { 'M', 'I', 'D', 'X' }, DIR_INDEX_VERSION, DIR_INDEX_RECORD, folders, n, stamp };
+    if (!index.seekSet(0) || index.write(&head, sizeof(head)) != int16_t(sizeof(head)) || !index.sync()) return false;
+    count = n;
+    return true;
+  }
+
+  /**
+   * Open the index of a folder. If the folder has changed the index is built
+   * again, or with 'build' false the card is left alone. False if there is no
+   * valid index, as on a locked card.
+   */
+  bool CardReader::dir_index_open(SdFile &dir, SdFile &index, uint16_t &count, const bool build) {
+    const int8_t folders =
+      #if ENABLED(SDSORT_GCODE)
+        sort_folders
+      #elif HAS_FOLDER_SORTING
+        FOLDER_SORTING
+      #else
+        0
+      #endif
+    ;
+    uint16_t entry;
+    const uint32_t stamp = index_stamp(dir, longFilename, entry);
+    if (index.isOpen()) index.close();
+    // Open the index where the walk found it, without a second walk
+    if (entry == 0xFFFF ? !build || !index.open(&dir, DIR_INDEX_NAME, O_RDWR | O_CREAT) : !index.open(&dir, entry, build ? O_RDWR : O_READ)) return false;
+
+    dir_index_header_t head;
+    if (index.read(&head, sizeof(head)) == int16_t(sizeof(head))
+      && !memcmp(head.magic, "MIDX", 4) && head.version == DIR_INDEX_VERSION && head.record_size == DIR_INDEX_RECORD
+      && head.folders == folders && head.stamp == stamp
+      && index.fileSize() >= 512UL + uint32_t(head.count) * (DIR_INDEX_RECORD)
+    ) {
+      count = head.count;
+      return true;
+    }
+    if (build && index_build(dir, index, stamp, folders, longFilename, count)) return true;
+    index.close();
+    return false;
+  }
+
+  /**
+   * M20 from the index of each folder that has a valid one, or the folder
+   * itself without one. M20 never builds an index. The walk keeps the next
+   * record of each level and opens a folder again from the root when its
+   * subfolder is done, so it takes the same stack at any depth.
+   */
+  void CardReader::lsIndexed() {
+    static char path[MAXPATHNAMELENGTH];  // "/" and FOLDERNAME12/ for each level
+    static dir_index_record_t rec;
+    uint16_t next[MAX_DIR_DEPTH];         // Next record of each level
+    SdFile dir = root, index;
+    uint8_t depth = 0;
+    strcpy(path, "/");
+    next[0] = 0;
+    for (;;) {
+      uint16_t count = 0;
+      if (!dir_index_open(dir, index, count, false) && !next[depth]) {
+        lsAction = LS_SerialPrint;
+        dir.rewind();
+        lsDive(depth ? path : NULL, dir);
+      }
+
+      bool reopen = false;
+      while (!reopen && next[depth] < count && index_record(index, next[depth]++, rec, false)) {
+        if (rec.isDir) {
+          // Open the folder with the index handle, then start over in the folder
+          index.close();
+          if (depth < MAX_DIR_DEPTH - 1 && index.open(&dir, rec.filename, O_READ)) {
+            dir = index;
+            strcat(path, rec.filename);
+            strcat(path, "/");
+            next[++depth] = 0;
+          }
+          else {
+            SERIAL_ECHO_START();
+            SERIAL_ECHOPGM(MSG_SD_CANT_OPEN_SUBDIR);
+            SERIAL_ECHOLN(rec.filename);
+          }
+          reopen = true;
+        }
+        else {
+          if (depth) SERIAL_PROTOCOL(path);
+          SERIAL_PROTOCOL(rec.filename);
+          SERIAL_PROTOCOLCHAR(' ');
+          SERIAL_PROTOCOLLN(rec.fileSize);
+        }
+      }
+      if (reopen) continue;
+
+      // The folder is done. Go back up to its parent.
+      if (!depth--) break;
+      char *name = path + strlen(path) - 1;
+      while (name[-1] != '/') name--;
+      *name = '\0';
+      dir = root;
+      for (name = path + 1; *name; ) {
+        char * const slash = strchr(name, '/');
+        *slash = '\0';
+        index.close();
+        const bool opened = index.open(&dir, name, O_READ);
+        *slash = '/';
+        if (!opened) return;
+        dir = index;
+        name = slash + 1;
+      }
+    }
+  }
+
+#endif // SD_DIR_INDEX
+
 #if ENABLED(SDCARD_SORT_ALPHA)
 
   /**
    * Get the name of a file in the current directory by sort-index
    */
   void CardReader::getfilename_sorted(const uint16_t nr) {
+    #if ENABLED(SD_DIR_INDEX)
+      if (dir_indexed) {
+        dir_index_record_t rec;
+        if (nr < sort_count && index_record(dirIndex, nr, rec, false)) {
+          strcpy(filename, rec.filename);
+          strcpy(longFilename, rec.longFilename);
+          filenameIsDir = rec.isDir;
+        }
+        else
+          filename[0] = longFilename[0] = '\0';
+        return;
+      }
+    #endif
     getfilename(
       #if ENABLED(SDSORT_GCODE)
         sort_alpha &&
@@ -674,6 +939,15 @@ void CardReader::setroot() {
       if (!sort_alpha) return;
     #endif
 
+    // The index of the folder holds all its items, sorted
+    #if ENABLED(SD_DIR_INDEX)
+      // Building writes the card, so not while printing from it
+      if (cardOK && dir_index_open(workDir, dirIndex, sort_count, !sdprinting)) {
+        dir_indexed = true;
+        return;
+      }
+    #endif
+
     // If there are files, sort up to the limit
     uint16_t fileCnt = getnrfilenames();
     if (fileCnt > 0) {
@@ -858,6 +1132,14 @@ void CardReader::setroot() {
   }
 
   void CardReader::flush_presort() {
+    #if ENABLED(SD_DIR_INDEX)
+      if (dir_indexed) {
+        dirIndex.close();
+        dir_indexed = false;
+        sort_count = 0;
+        return;
+      }
+    #endif
     if (sort_count > 0) {
       #if ENABLED(SDSORT_DYNAMIC_RAM)
         delete sort_order;
@@ -877,6 +1159,9 @@ void CardReader::setroot() {
 #endif // SDCARD_SORT_ALPHA
 
 uint16_t CardReader::get_num_Files() {
+  #if ENABLED(SD_DIR_INDEX)
+    if (dir_indexed) return sort_count;
+  #endif
   return
     #if ENABLED(SDCARD_SORT_ALPHA) && SDSORT_USES_RAM && SDSORT_CACHE_NAMES
       nrFiles // no need to access the SD card for filenames
@@ -920,6 +1205,75 @@ void CardReader::printingHasFinished() {
   }
 }
 
+#if ENABLED(SD_READ_AHEAD)
+
+  /**
+   * Drop the blocks read ahead and continue reading the file from index
+   */
+  void CardReader::clear_read_ahead(const uint32_t index) {
+    ahead_head = ahead_count = 0;
+    ahead_pos = index;
+    file.seekSet(index & ~0x1FFUL);
+  }
+
+  /**
+   * Read the next block of the file into a free buffer. The card keeps
+   * streaming it with CMD18 until something else on the card is accessed.
+   */
+  bool CardReader::read_ahead_block() {
+    if (ahead_count >= SD_READ_AHEAD_BLOCKS || file.curPosition() >= filesize) return false;
+    uint8_t b = ahead_head + ahead_count;
+    if (b >= SD_READ_AHEAD_BLOCKS) b -= SD_READ_AHEAD_BLOCKS;
+    if (file.readStream(ahead_buffer[b]) <= 0) return false;
+    ahead_count++;
+    ahead_blocks++;
+    return true;
+  }
+
+  /**
+   * Fill the buffers between commands, one block per call
+   */
+  void CardReader::read_ahead() {
+    if (sdprinting && isFileOpen()) read_ahead_block();
+  }
+
+  int16_t CardReader::get() {
+    sdpos = ahead_pos;
+    if (ahead_pos >= filesize || !isFileOpen()) return -1;
+
+    // Nothing read ahead, so read the block now
+    if (!ahead_count) {
+      const uint32_t start_us = micros();
+      const bool ok = read_ahead_block();
+      const uint32_t us = micros() - start_us;
+      ahead_stall_us += us;
+      NOLESS(ahead_stall_us_max, MIN(us, 0xFFFFUL));
+      ahead_stalls++;
+      if (!ok) return -1;
+    }
+
+    const uint8_t c = ahead_buffer[ahead_head][ahead_pos & 0x1FF];
+    if (!(++ahead_pos & 0x1FF)) {
+      // Done with this block
+      if (++ahead_head >= SD_READ_AHEAD_BLOCKS) ahead_head = 0;
+      ahead_count--;
+    }
+    return c;
+  }
+
+  void CardReader::setIndex(const uint32_t index) {
+    sdpos = index;
+    clear_read_ahead(index);
+  }
+
+  void CardReader::reset_read_ahead_stats() {
+    ahead_blocks = ahead_stall_us = 0;
+    ahead_stalls = ahead_stall_us_max = 0;
+    ahead_since_ms = millis();
+  }
+
+#endif // SD_READ_AHEAD
+
 #if ENABLED(AUTO_REPORT_SD_STATUS)
   uint8_t CardReader::auto_report_sd_interval = 0;
   millis_t CardReader::next_sd_report_ms;
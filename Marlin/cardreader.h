@@ -99,9 +99,17 @@ public:
   FORCE_INLINE void pauseSDPrint() { sdprinting = false; }
   FORCE_INLINE bool isFileOpen() { return file.isOpen(); }
   FORCE_INLINE bool eof() { return sdpos >= filesize; }
-  FORCE_INLINE int16_t get() { sdpos = file.curPosition(); return (int16_t)file.read(); }
-  FORCE_INLINE void setIndex(const uint32_t index) { sdpos = index; file.seekSet(index); }
+  #if ENABLED(SD_READ_AHEAD)
+    int16_t get();
+    void setIndex(const uint32_t index);
+    void read_ahead();
+    void reset_read_ahead_stats();
+  #else
+    FORCE_INLINE int16_t get() { sdpos = file.curPosition(); return (int16_t)file.read(); }
+    FORCE_INLINE void setIndex(const uint32_t index) { sdpos = index; file.seekSet(index); }
+  #endif
   FORCE_INLINE uint32_t getIndex() { return sdpos; }
+  FORCE_INLINE uint32_t getFileSize() { return filesize; }
   FORCE_INLINE uint8_t percentDone() { return (isFileOpen() && filesize) ? sdpos / ((filesize + 99) / 100) : 0; }
   FORCE_INLINE char* getWorkDirName() { workDir.getFilename(filename); return filename; }
 
@@ -120,6 +128,14 @@ public:
   bool saving, logging, sdprinting, cardOK, filenameIsDir;
   char filename[FILENAME_LENGTH], longFilename[LONG_FILENAME_LENGTH];
   int8_t autostart_index;
+
+  #if ENABLED(SD_READ_AHEAD)
+    uint32_t ahead_blocks,        // Blocks read since the stats were reset
+             ahead_stall_us;      // Time get() waited for a block
+    uint16_t ahead_stalls,        // Times get() found no block read ahead
+             ahead_stall_us_max;  // Longest wait
+    millis_t ahead_since_ms;
+  #endif
 private:
   SdFile root, workDir, workDirParents[MAX_DIR_DEPTH];
   uint8_t workDirDepth;
@@ -189,6 +205,16 @@ private:
   char proc_filenames[SD_PROCEDURE_DEPTH][MAXPATHNAMELENGTH];
   uint32_t filesize, sdpos;
 
+  #if ENABLED(SD_READ_AHEAD)
+    // Blocks of the print file read ahead of get(), starting with the block of ahead_pos
+    uint8_t ahead_buffer[SD_READ_AHEAD_BLOCKS][512],
+            ahead_head,           // Buffer of the block of ahead_pos
+            ahead_count;          // Blocks in the buffers
+    uint32_t ahead_pos;           // Position in the file of the next byte for get()
+    bool read_ahead_block();
+    void clear_read_ahead(const uint32_t index);
+  #endif
+
   LsAction lsAction; //stored for recursion.
   uint16_t nrFiles; //counter for the files in the current directory and recycled as position counter for getting the nrFiles'th name in the directory.
   char* diveDirName;
@@ -198,6 +224,13 @@ private:
     void flush_presort();
   #endif
 
+  #if ENABLED(SD_DIR_INDEX)
+    SdFile dirIndex;            // Sorted index of workDir, open while dir_indexed
+    bool dir_indexed;
+    bool dir_index_open(SdFile &dir, SdFile &index, uint16_t &count, const bool build);
+    void lsIndexed();
+  #endif
+
   #if ENABLED(AUTO_REPORT_SD_STATUS)
     static uint8_t auto_report_sd_interval;
     static millis_t next_sd_report_ms;
@@ -37,7 +37,7 @@
  */
 
 // Change EEPROM version if the structure changes
-#define EEPROM_VERSION "V55"
+#define EEPROM_VERSION "V57"
 #define EEPROM_OFFSET 100
 
 // Check the integrity of data offsets.
@@ -170,7 +170,8 @@ typedef struct SettingsDataStruct {
           delta_diagonal_rod,                           // M665 L
           delta_segments_per_second,                    // M665 S
           delta_calibration_radius,                     // M665 B
-          delta_tower_angle_trim[ABC];                  // M665 XYZ
+          delta_tower_angle_trim[ABC],                  // M665 XYZ
+          segment_chord_tolerance;                      // M665 C
 
   #elif ENABLED(HANGPRINTER)
 
@@ -184,7 +185,8 @@ typedef struct SettingsDataStruct {
           anchor_C_z,                                   // M665 O
           anchor_D_z,                                   // M665 P
           delta_segments_per_second,                    // M665 S
-          hangprinter_calibration_radius_placeholder;
+          hangprinter_calibration_radius_placeholder,
+          segment_chord_tolerance;                      // M665 C
 
   #elif ENABLED(X_DUAL_ENDSTOPS) || ENABLED(Y_DUAL_ENDSTOPS) || ENABLED(Z_DUAL_ENDSTOPS)
 
@@ -273,6 +275,13 @@ typedef struct SettingsDataStruct {
   float filament_change_unload_length[MAX_EXTRUDERS],   // M603 T U
         filament_change_load_length[MAX_EXTRUDERS];     // M603 T L
 
+  //
+  // INPUT_SHAPING
+  //
+  uint8_t shaping_type[2];                              // M593 X Y T  stepper.shaping_type[]
+  float shaping_frequency[2],                           // M593 X Y F  stepper.shaping_frequency[]
+        shaping_zeta[2];                                // M593 X Y D  stepper.shaping_zeta[]
+
 } SettingsData;
 
 #pragma pack(pop)
@@ -327,6 +336,12 @@ void MarlinSettings::postprocess() {
     set_z_fade_height(new_z_fade_height, false); // false = no report
   #endif
 
+  #if ENABLED(INPUT_SHAPING)
+    // Let the pending echoes play out with the impulses they started with
+    planner.synchronize();
+    stepper.refresh_shaping();
+  #endif
+
   #if ENABLED(AUTO_BED_LEVELING_BILINEAR)
     refresh_bed_level();
   #endif
@@ -585,6 +600,12 @@ void MarlinSettings::postprocess() {
       EEPROM_WRITE(delta_segments_per_second); // 1 float
       EEPROM_WRITE(delta_calibration_radius);  // 1 float
       EEPROM_WRITE(delta_tower_angle_trim);    // 3 floats
+      #if ENABLED(ADAPTIVE_SEGMENTATION)
+        EEPROM_WRITE(segment_chord_tolerance); // 1 float
+      #else
+        dummy = 0.0f;
+        EEPROM_WRITE(dummy);
+      #endif
 
     #elif ENABLED(HANGPRINTER)
 
@@ -601,6 +622,11 @@ void MarlinSettings::postprocess() {
       EEPROM_WRITE(anchor_D_z);                // 1 float
       EEPROM_WRITE(delta_segments_per_second); // 1 float
       EEPROM_WRITE(dummy);                     // 1 float
+      #if ENABLED(ADAPTIVE_SEGMENTATION)
+        EEPROM_WRITE(segment_chord_tolerance); // 1 float
+      #else
+        EEPROM_WRITE(dummy);
+      #endif
 
     #elif ENABLED(X_DUAL_ENDSTOPS) || ENABLED(Y_DUAL_ENDSTOPS) || ENABLED(Z_DUAL_ENDSTOPS)
 
@@ -966,6 +992,23 @@ void MarlinSettings::postprocess() {
       for (uint8_t q = MAX_EXTRUDERS * 2; q--;) EEPROM_WRITE(dummy);
     #endif
 
+    //
+    // Input shaping
+    //
+
+    _FIELD_TEST(shaping_type);
+
+    #if ENABLED(INPUT_SHAPING)
+      EEPROM_WRITE(stepper.shaping_type);
+      EEPROM_WRITE(stepper.shaping_frequency);
+      EEPROM_WRITE(stepper.shaping_zeta);
+    #else
+      const uint8_t shaping_type[2] = { 0 };
+      EEPROM_WRITE(shaping_type);
+      dummy = 0;
+      for (uint8_t q = 4; q--;) EEPROM_WRITE(dummy);
+    #endif
+
     //
     // Validate CRC and Data Size
     //
@@ -1206,6 +1249,11 @@ void MarlinSettings::postprocess() {
         EEPROM_READ(delta_segments_per_second); // 1 float
         EEPROM_READ(delta_calibration_radius);  // 1 float
         EEPROM_READ(delta_tower_angle_trim);    // 3 floats
+        #if ENABLED(ADAPTIVE_SEGMENTATION)
+          EEPROM_READ(segment_chord_tolerance); // 1 float
+        #else
+          EEPROM_READ(dummy);
+        #endif
 
       #elif ENABLED(HANGPRINTER)
         EEPROM_READ(anchor_A_y);                // 1 float
@@ -1219,6 +1267,11 @@ void MarlinSettings::postprocess() {
         EEPROM_READ(anchor_D_z);                // 1 float
         EEPROM_READ(delta_segments_per_second); // 1 float
         EEPROM_READ(dummy);                     // 1 float
+        #if ENABLED(ADAPTIVE_SEGMENTATION)
+          EEPROM_READ(segment_chord_tolerance); // 1 float
+        #else
+          EEPROM_READ(dummy);
+        #endif
 
       #elif ENABLED(X_DUAL_ENDSTOPS) || ENABLED(Y_DUAL_ENDSTOPS) || ENABLED(Z_DUAL_ENDSTOPS)
 
@@ -1576,6 +1629,22 @@ void MarlinSettings::postprocess() {
         for (uint8_t q = MAX_EXTRUDERS * 2; q--;) EEPROM_READ(dummy);
       #endif
 
+      //
+      // Input shaping
+      //
+
+      _FIELD_TEST(shaping_type);
+
+      #if ENABLED(INPUT_SHAPING)
+        EEPROM_READ(stepper.shaping_type);
+        EEPROM_READ(stepper.shaping_frequency);
+        EEPROM_READ(stepper.shaping_zeta);
+      #else
+        uint8_t shaping_type[2];
+        EEPROM_READ(shaping_type);
+        for (uint8_t q = 4; q--;) EEPROM_READ(dummy);
+      #endif
+
       eeprom_error = size_error(eeprom_index - (EEPROM_OFFSET));
       if (eeprom_error) {
         SERIAL_ECHO_START();
@@ -1847,6 +1916,9 @@ void MarlinSettings::reset() {
     delta_segments_per_second = DELTA_SEGMENTS_PER_SECOND;
     delta_calibration_radius = DELTA_CALIBRATION_RADIUS;
     COPY(delta_tower_angle_trim, dta);
+    #if ENABLED(ADAPTIVE_SEGMENTATION)
+      segment_chord_tolerance = SEGMENT_CHORD_TOLERANCE;
+    #endif
 
   #elif ENABLED(HANGPRINTER)
 
@@ -1860,6 +1932,9 @@ void MarlinSettings::reset() {
     anchor_C_z = float(ANCHOR_C_Z);
     anchor_D_z = float(ANCHOR_D_Z);
     delta_segments_per_second = KINEMATIC_SEGMENTS_PER_SECOND;
+    #if ENABLED(ADAPTIVE_SEGMENTATION)
+      segment_chord_tolerance = SEGMENT_CHORD_TOLERANCE;
+    #endif
 
   #elif ENABLED(X_DUAL_ENDSTOPS) || ENABLED(Y_DUAL_ENDSTOPS) || ENABLED(Z_DUAL_ENDSTOPS)
 
@@ -1981,6 +2056,14 @@ void MarlinSettings::reset() {
     }
   #endif
 
+  #if ENABLED(INPUT_SHAPING)
+    stepper.shaping_type[X_AXIS] = stepper.shaping_type[Y_AXIS] = INPUT_SHAPING_TYPE;
+    stepper.shaping_frequency[X_AXIS] = INPUT_SHAPING_X_FREQ;
+    stepper.shaping_frequency[Y_AXIS] = INPUT_SHAPING_Y_FREQ;
+    stepper.shaping_zeta[X_AXIS] = INPUT_SHAPING_X_ZETA;
+    stepper.shaping_zeta[Y_AXIS] = INPUT_SHAPING_Y_ZETA;
+  #endif
+
   postprocess();
 
   #if ENABLED(EEPROM_CHITCHAT)
@@ -2370,6 +2453,9 @@ void MarlinSettings::reset() {
       SERIAL_ECHOPAIR(" X", LINEAR_UNIT(delta_tower_angle_trim[A_AXIS]));
       SERIAL_ECHOPAIR(" Y", LINEAR_UNIT(delta_tower_angle_trim[B_AXIS]));
       SERIAL_ECHOPAIR(" Z", LINEAR_UNIT(delta_tower_angle_trim[C_AXIS]));
+      #if ENABLED(ADAPTIVE_SEGMENTATION)
+        SERIAL_ECHOPAIR(" C", LINEAR_UNIT(segment_chord_tolerance));
+      #endif
       SERIAL_EOL();
 
     #elif ENABLED(HANGPRINTER)
@@ -2388,6 +2474,9 @@ void MarlinSettings::reset() {
       SERIAL_ECHOPAIR(" O", anchor_C_z);
       SERIAL_ECHOPAIR(" P", anchor_D_z);
       SERIAL_ECHOPAIR(" S", delta_segments_per_second);
+      #if ENABLED(ADAPTIVE_SEGMENTATION)
+        SERIAL_ECHOPAIR(" C", LINEAR_UNIT(segment_chord_tolerance));
+      #endif
       SERIAL_EOL();
 
     #elif ENABLED(X_DUAL_ENDSTOPS) || ENABLED(Y_DUAL_ENDSTOPS) || ENABLED(Z_DUAL_ENDSTOPS)
@@ -2785,6 +2874,21 @@ void MarlinSettings::reset() {
         #endif // EXTRUDERS > 2
       #endif // EXTRUDERS == 1
     #endif // ADVANCED_PAUSE_FEATURE
+
+    #if ENABLED(INPUT_SHAPING)
+      if (!forReplay) {
+        CONFIG_ECHO_START;
+        SERIAL_ECHOLNPGM("Input Shaping:");
+      }
+      CONFIG_ECHO_START;
+      SERIAL_ECHOPAIR("  M593 X T", int(stepper.shaping_type[X_AXIS]));
+      SERIAL_ECHOPAIR(" F", stepper.shaping_frequency[X_AXIS]);
+      SERIAL_ECHOLNPAIR(" D", stepper.shaping_zeta[X_AXIS]);
+      CONFIG_ECHO_START;
+      SERIAL_ECHOPAIR("  M593 Y T", int(stepper.shaping_type[Y_AXIS]));
+      SERIAL_ECHOPAIR(" F", stepper.shaping_frequency[Y_AXIS]);
+      SERIAL_ECHOLNPAIR(" D", stepper.shaping_zeta[Y_AXIS]);
+    #endif
   }
 
 #endif // !DISABLE_M503
@@ -462,6 +462,75 @@
  */
 //#define ADAPTIVE_STEP_SMOOTHING
 
+/**
+ * Adaptive Multistepping
+ *
+ * Multistepping takes 2, 4 or more steps per stepper ISR call at high step rates.
+ * Normally it switches at fixed rates, worked out from worst-case cycle counts,
+ * so it bunches steps even when the ISR has time to spare. With this option each
+ * block uses the lowest multiplier that keeps the stepper ISR under the given
+ * share of the CPU, from the ISR time measured on the running machine.
+ * With MOTION_STATS, M930 also counts the blocks run at each multiplier.
+ * Compare it with fixed multistepping with buildroot/share/scripts/motionSim.py --check multistep
+ */
+//#define ADAPTIVE_MULTISTEPPING
+#if ENABLED(ADAPTIVE_MULTISTEPPING)
+  #define ADAPTIVE_MULTISTEPPING_LOAD 60  // (%) Share of the CPU the stepper ISR may use (10-90)
+#endif
+
+/**
+ * Step Rate Interpolation
+ *
+ * Work out the rate of the acceleration and deceleration ramps only at knots
+ * spaced to change it by a small share, and let the stepper ISR interpolate the
+ * timer interval linearly between them. Most ramp steps then skip the rate
+ * multiply and the step rate lookup of the stepper ISR.
+ * Not compatible with S_CURVE_ACCELERATION.
+ * Compare the ISR load with buildroot/share/scripts/motionSim.py
+ */
+//#define STEP_RATE_INTERPOLATION
+#if ENABLED(STEP_RATE_INTERPOLATION)
+  #define STEP_RATE_SEGMENT_SHIFT 4  // Knots change the rate by 1/2^n (2-6)
+#endif
+
+/**
+ * Input Shaping
+ *
+ * Convolve the X and Y motion with a shaper that cancels the ringing of the frame
+ * at the given frequency, so the machine can run at higher accelerations.
+ * Each step the planner asks for is split into impulses: part of it is taken
+ * at once and the rest is echoed later, half a ringing period apart (ZV), or
+ * in three parts (ZVD, MZV) that also cope with a frequency that is a bit off.
+ * Measure the frequency from the ringing on a test print: speed / spacing of the ripples.
+ * Set with M593 X Y T F D and saved with M500. A frequency of 0 turns an axis off.
+ * On CoreXY/CoreXZ machines the A and B motors are shaped, so give X and Y the same settings.
+ * Not for DELTA, SCARA or HANGPRINTER, or with STEP_STREAM. Costs 16 bytes of RAM per queue entry.
+ * Check the ringing it leaves with buildroot/share/scripts/motionSim.py --check inputShaping
+ */
+//#define INPUT_SHAPING
+#if ENABLED(INPUT_SHAPING)
+  #define INPUT_SHAPING_TYPE        0     // 0=ZV 1=ZVD 2=MZV
+  #define INPUT_SHAPING_X_FREQ     40.0   // (Hz) Ringing frequency of X, 0 to disable
+  #define INPUT_SHAPING_Y_FREQ     40.0   // (Hz) Ringing frequency of Y, 0 to disable
+  #define INPUT_SHAPING_X_ZETA      0.1   // Damping ratio of X (0-0.99)
+  #define INPUT_SHAPING_Y_ZETA      0.1   // Damping ratio of Y (0-0.99)
+  #define INPUT_SHAPING_QUEUE_SIZE 32     // Step times held per axis for the echoes (power of 2, 8-128)
+#endif
+
+/**
+ * Per-Axis Step Timing
+ *
+ * Step the axes that move less than the fastest one at the time the line
+ * really crosses each of their steps, to 1/256 of a step of the fastest axis,
+ * instead of on the nearest step of the fastest axis. This takes out the
+ * aliasing of slow axes in multi-axis moves without raising the ISR rate.
+ * Each such step costs a short interrupt of its own: roughly 6% more CPU on
+ * an AVR printing at 100mm/s. Compare its step times and interrupts with
+ * those of Bresenham with buildroot/share/scripts/motionSim.py --check stepTiming
+ * Replaces ADAPTIVE_STEP_SMOOTHING. Not compatible with INPUT_SHAPING.
+ */
+//#define PER_AXIS_STEP_TIMING
+
 // Microstep setting (Only functional when stepper driver microstep pins are connected to MCU.
 #define MICROSTEP_MODES { 16, 16, 16, 16, 16 } // [1,2,4,8,16]
 
@@ -645,6 +714,17 @@
                                       // Note: Only affects SCROLL_LONG_FILENAMES with SDSORT_CACHE_NAMES but not SDSORT_DYNAMIC_RAM.
   #endif
 
+  /**
+   * Keep a sorted index of each folder opened on the LCD in a DIRINDEX.BIN
+   * file on the card, built again when the listed files of the folder change
+   * (but not while printing). The LCD then reads a page of names from one
+   * block of the index, instead of walking the folder for every name, and all
+   * the items are sorted. M20 uses the indexes there are, but never adds one.
+   * Needs SDCARD_SORT_ALPHA and a writable card (else the sort above is used).
+   * Check it with buildroot/share/scripts/sdDirIndexTest.py
+   */
+  //#define SD_DIR_INDEX
+
   // This allows hosts to request long names for files and folders with M33
   //#define LONG_FILENAME_HOST_SUPPORT
 
@@ -670,6 +750,33 @@
    */
   //#define AUTO_REPORT_SD_STATUS
 
+  /**
+   * Read SD print files ahead of the command reader, a block at a time
+   * between commands, with a multiple block read (CMD18) that keeps
+   * streaming while the blocks of the file follow one another. A block
+   * boundary then no longer stops the main loop for a card read.
+   * Report the blocks read and the time spent waiting for them with M931.
+   * Check it with buildroot/share/scripts/sdReadAheadTest.py
+   */
+  //#define SD_READ_AHEAD
+  #if ENABLED(SD_READ_AHEAD)
+    #define SD_READ_AHEAD_BLOCKS 2 // Blocks of 512 bytes of SRAM (1-8)
+  #endif
+
+  /**
+   * Cache FAT blocks apart from data and directory blocks, and keep more
+   * than one data block. Walking or growing the FAT of one file then no
+   * longer throws out the directory or data block of another, such as
+   * the power-loss recovery file saved during a print. The least recently
+   * used data block is replaced, and changed blocks are only written back
+   * when replaced or flushed. Report the hits and misses with M931.
+   * Compare with buildroot/share/scripts/motionSim.py --check sdCache
+   */
+  //#define SD_BLOCK_CACHE
+  #if ENABLED(SD_BLOCK_CACHE)
+    #define SD_CACHE_BLOCKS 2 // Data blocks of 512 bytes of SRAM, plus one for the FAT (1-8)
+  #endif
+
 #endif // SDSUPPORT
 
 /**
@@ -786,6 +893,19 @@
 #if ENABLED(LIN_ADVANCE)
   #define LIN_ADVANCE_K 0.22  // Unit: mm compression per 1mm/s extruder speed
   //#define LA_DEBUG          // If enabled, this will generate debug information output over USB.
+
+  /**
+   * Build and release the advance over a window of time, following the pressure
+   * of the planned speed averaged over the window, rather than at the full
+   * acceleration of every ramp. The E steps of the move are sent as they come
+   * instead of with the advance steps, and print moves are slowed where the move
+   * plus its advance would pass the E max feedrate.
+   * Compare it with plain LIN_ADVANCE with buildroot/share/scripts/motionSim.py --check linAdvance
+   */
+  //#define LIN_ADVANCE_SMOOTHING
+  #if ENABLED(LIN_ADVANCE_SMOOTHING)
+    #define LIN_ADVANCE_SMOOTH_TIME 40  // (ms) Window the pressure is averaged over (5-200)
+  #endif
 #endif
 
 // @section leveling
@@ -824,6 +944,53 @@
 // Moves (or segments) with fewer steps than this will be joined with the next move
 #define MIN_STEPS_PER_SEGMENT 6
 
+/**
+ * Incremental inverse kinematics for DELTA and HANGPRINTER
+ *
+ * Along a segmented straight move the squared rod or line lengths are
+ * quadratic in the segment index. They are advanced with two additions
+ * per axis instead of a full distance calculation, and recalculated from
+ * scratch every INCREMENTAL_IK_RESYNC segments to bound float drift.
+ */
+//#define INCREMENTAL_IK
+#if ENABLED(INCREMENTAL_IK)
+  #define INCREMENTAL_IK_RESYNC 32
+#endif
+
+/**
+ * Adaptive segmentation for DELTA and HANGPRINTER
+ *
+ * Split kinematic moves by the chord error of the motor paths instead of
+ * by time alone. The segment length is chosen so that a straight step
+ * between segment ends deviates from the true rod or line length curve
+ * by at most the tolerance (in mm). Segments-per-second stays the upper
+ * limit, so nearly linear moves are split into far fewer blocks.
+ * With bilinear bed leveling on a DELTA the segments are kept no longer than
+ * the mesh spacing while leveling is on.
+ *
+ * Set the tolerance with M665 C<mm>.
+ */
+//#define ADAPTIVE_SEGMENTATION
+#if ENABLED(ADAPTIVE_SEGMENTATION)
+  #define SEGMENT_CHORD_TOLERANCE 0.01 // (mm)
+#endif
+
+/**
+ * Merge collinear segments in the planner
+ *
+ * A move that continues the last queued block in the same direction, at the
+ * same feedrate and extrusion ratio, extends that block instead of taking a
+ * new one, as long as the stepper has not started on it. Finely segmented
+ * paths then cover more distance within BLOCK_BUFFER_SIZE blocks.
+ *
+ * Not compatible with CORE kinematics, MIXING_EXTRUDER, FILAMENT_WIDTH_SENSOR or
+ * XY_FREQUENCY_LIMIT.
+ */
+//#define BLOCK_MERGING
+#if ENABLED(BLOCK_MERGING)
+  #define BLOCK_MERGE_MAX_DEVIATION 1 // (steps) Largest distance of any merged joint from the merged line on any axis
+#endif
+
 /**
  * Minimum delay after setting the stepper DIR (in ns)
  *     0 : No delay (Expect at least 10µS since one Stepper ISR must transpire)
@@ -890,6 +1057,31 @@
 #define MAX_CMD_SIZE 96
 #define BUFSIZE 4
 
+/**
+ * Assemble serial lines straight into the command queue instead of a line buffer.
+ * The line number, checksum, and parameter letters are read as the characters
+ * arrive, so the line isn't copied or scanned again before the parser uses it.
+ * Saves MAX_CMD_SIZE bytes of SRAM and uses (QUEUED_PARAM_OFFSETS + 1) * BUFSIZE.
+ * Check it against the line buffer with buildroot/share/scripts/motionSim.py --check serialQueue
+ */
+//#define ZERO_COPY_COMMAND_QUEUE
+#if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+  #define QUEUED_PARAM_OFFSETS 7 // Parameters found per command. Longer commands are scanned by the parser.
+#endif
+
+/**
+ * Pack the command queue into one arena of bytes instead of BUFSIZE slots
+ * of MAX_CMD_SIZE. Each command takes only its length plus two bytes, so
+ * more of the short moves of a print are queued in the same SRAM, and
+ * BUFSIZE becomes the most commands the arena holds (raise it, e.g. to 16).
+ * Not compatible with ZERO_COPY_COMMAND_QUEUE.
+ * Check it with buildroot/share/scripts/motionSim.py --check commandQueue
+ */
+//#define COMMAND_QUEUE_ARENA
+#if ENABLED(COMMAND_QUEUE_ARENA)
+  #define COMMAND_QUEUE_ARENA_SIZE 388 // Bytes, at least MAX_CMD_SIZE + 1. The RAM of 4 slots of MAX_CMD_SIZE 96 and their "ok" flags.
+#endif
+
 // Transmission to Host Buffer Size
 // To save 386 bytes of PROGMEM (and TX_BUFFER_SIZE+3 bytes of RAM) set to 0.
 // To buffer a simple "ok" you need 4 bytes.
@@ -921,6 +1113,25 @@
   //#define SERIAL_STATS_DROPPED_RX
 #endif
 
+// Enable this option to count the time the main loop waits for room to send
+// serial output. Report it with M932, and reset it with "M932 R".
+//#define SERIAL_STATS_TX_BLOCKED
+
+/**
+ * Deferred serial output
+ *
+ * Numbers and PROGMEM strings printed by SERIAL_ECHOPAIR, SERIAL_ECHOPGM, "ok"
+ * and the like are queued as small records (a tag and the raw value) and only
+ * formatted into the TX buffer from idle() as it has room, so the main loop no
+ * longer waits on the UART or formats floats while the planner needs it.
+ * Output from the stepper and temperature ISRs is still written directly.
+ * Requires TX_BUFFER_SIZE > 0. Model: buildroot/share/scripts/serialDeferredTx.py
+ */
+//#define SERIAL_DEFERRED_TX
+#if ENABLED(SERIAL_DEFERRED_TX)
+  #define SERIAL_DEFERRED_TX_SIZE 128 // Bytes of queued records. A power of 2 from 16 to 256.
+#endif
+
 // Enable an emergency-command parser to intercept certain commands as they
 // enter the serial receive buffer, so they cannot be blocked.
 // Currently handles M108, M112, M410
@@ -936,6 +1147,47 @@
 // Some clients will have this feature soon. This could make the NO_TIMEOUTS unnecessary.
 #define ADVANCED_OK
 
+/**
+ * Credit-based flow control (M941 S1)
+ *
+ * Adds R<bytes>, the count of bytes taken from the RX buffer, to "ok" and
+ * "Resend:" so the host can keep several lines in flight without overrunning
+ * RX_BUFFER_SIZE, instead of waiting for an "ok" per line. Requires ADVANCED_OK.
+ * Reference sender and loopback benchmark: buildroot/share/scripts/serialCredits.py
+ */
+//#define SERIAL_CREDITS
+
+/**
+ * Binary G-code transport
+ *
+ * After "M940 S1" the host sends CRC-16 checked frames, each holding several
+ * commands with their numbers already in binary. A frame is acknowledged with
+ * "ok F<seq>" once all of its commands are queued, instead of an "ok" per line.
+ * A malformed command gets "Error:Bad binary command F<seq> Q<n>" instead, with
+ * n the commands of the frame that were queued.
+ * An empty frame switches back to text. M115 reports it as BINARY_GCODE.
+ * Encode and benchmark with buildroot/share/scripts/binaryGcode.py
+ */
+//#define BINARY_GCODE
+#if ENABLED(BINARY_GCODE)
+  #define BINARY_FRAME_SIZE 64 // (bytes) Largest frame payload
+#endif
+
+/**
+ * Binary telemetry
+ *
+ * "M942 S<seconds>" or "M942 P<ms>" starts a stream of binary frames sent from
+ * idle(), with temperatures, heater PWM, planner and command queue depth,
+ * position, SD position and fan speeds, and no float formatting. A frame only
+ * holds the groups that changed since the one before, except for a key frame
+ * every TELEMETRY_KEY_FRAMES frames. M115 reports it as BINARY_TELEMETRY.
+ * Decode with buildroot/share/scripts/telemetryDecode.py
+ */
+//#define BINARY_TELEMETRY
+#if ENABLED(BINARY_TELEMETRY)
+  #define TELEMETRY_KEY_FRAMES 10 // A frame with every group after this many frames
+#endif
+
 // @section extras
 
 /**
@@ -1489,6 +1741,14 @@
  */
 #define FASTER_GCODE_PARSER
 
+/**
+ * Parse plain G0/G1 lines (only X Y Z E F, with fixed-point values) in one pass,
+ * converting the values for the move without strtod or a search per axis.
+ * Any other line, or a move with anything unusual in it, uses the full parser.
+ * Benchmark with buildroot/share/scripts/gcodeG1FastBench.py
+ */
+//#define GCODE_G1_FAST_PATH
+
 /**
  * User-defined menu items that execute custom GCode
  */
@@ -1656,6 +1916,32 @@
                               // Default behaviour is limited to Z axis only.
 #endif
 
+/**
+ * Motion statistics
+ *
+ * Collect planner and stepper throughput counters on the running machine:
+ * blocks queued and the time spent planning them, stepper ISR timer ticks
+ * per step event, and how often the stepper ran out of blocks while more
+ * moves were coming.
+ *
+ * M930 reports the counters. M930 R resets them.
+ * Run G-code on the host with buildroot/share/scripts/motionSim.py
+ */
+//#define MOTION_STATS
+
+/**
+ * Stepper ISR profile
+ *
+ * Time each phase of the stepper ISR (pulse, block, linear advance and the
+ * other step generators) and the temperature ISR in stepper timer ticks, with
+ * min/avg/max and a histogram per phase. Also count the stepper ISRs entered
+ * late and those that fell so far behind they gave up on pulse timing.
+ * Use it to see how close a machine runs to the MCU's limits.
+ *
+ * M933 reports the profile. M933 R resets it. Costs 44 bytes of RAM per phase.
+ */
+//#define STEPPER_ISR_PROFILE
+
 // Enable Marlin dev mode which adds some special commands
 //#define MARLIN_DEV_MODE
 
@@ -533,6 +533,18 @@
   // Warning: For this to work, don't use decimal points in the ANCHOR_ABCD_XYZ definitions.
   #define CONVENTIONAL_GEOMETRY
 
+  /**
+   * Refine the forward kinematics with a least squares fit of all four lines.
+   * The closed-form solution ignores the redundant fourth line and has truncation
+   * errors of tens of microns. Gauss-Newton iterations starting from it use all
+   * lines, and a fixed iteration count keeps the cost bounded.
+   * See buildroot/share/scripts/hangprinterFkBench.py for accuracy and cost.
+   */
+  //#define HANGPRINTER_FK_LEAST_SQUARES
+  #if ENABLED(HANGPRINTER_FK_LEAST_SQUARES)
+    #define HANGPRINTER_FK_ITERATIONS 1
+  #endif
+
   /**
    * Line buildup compensation feature
    * For documentation of theory behind, see:
@@ -583,6 +595,20 @@
     #define MOTOR_GEAR_TEETH { 10, 10, 10, 10 }
     #define SPOOL_GEAR_TEETH { 100, 100, 100, 100 }
 
+    /**
+     * Compute step targets incrementally from the previous segment instead of
+     * with one SQRT per line. The spool model is expanded to second order around
+     * its last exact evaluation, which is redone every LINE_BUILDUP_RESYNC segments
+     * and for any line more than LINE_BUILDUP_MAX_DELTA mm away from it. The
+     * targets stay within rounding (half a step) plus a few hundredths. Compare
+     * them with the SQRT with buildroot/share/scripts/motionSim.py --check lineBuildup
+     */
+    //#define LINE_BUILDUP_INCREMENTAL
+    #if ENABLED(LINE_BUILDUP_INCREMENTAL)
+      #define LINE_BUILDUP_RESYNC 64        // Segments between exact evaluations
+      #define LINE_BUILDUP_MAX_DELTA 50.0   // (mm) Lines further from the last exact evaluation are evaluated again
+    #endif
+
   #endif // LINE_BUILDUP_COMPENSATION_FEATURE
 #endif // HANGPRINTER
 
@@ -590,6 +616,18 @@
 // Super useful when Hangprinting
 #define UNREGISTERED_MOVE_SUPPORT
 
+/**
+ * G6 S3: Binary step stream
+ * The host sends per-axis runs of steps (interval, count, add) that are queued
+ * and played out by the stepper ISR, bypassing kinematics and the planner.
+ * Generate and check streams with buildroot/share/scripts/stepStream.py
+ * Requires UNREGISTERED_MOVE_SUPPORT. Each queue slot takes 7 bytes per axis.
+ */
+//#define STEP_STREAM
+#if ENABLED(STEP_STREAM)
+  #define STEP_STREAM_QUEUE_SIZE 8 // Chunks queued per axis. Must be a power of 2.
+#endif
+
 /**
  * == Torque mode: G95 [ A B C D ] ==
  * Sets your Mechaduino-driven and i2c-connected Mechaduino in torque mode.
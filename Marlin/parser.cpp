@@ -59,6 +59,11 @@ int GCodeParser::codenum;
   char *GCodeParser::command_args; // start of parameters
 #endif
 
+#if ENABLED(GCODE_G1_FAST_PATH)
+  bool GCodeParser::fast_move;
+  float GCodeParser::move_value[XYZE + 1];
+#endif
+
 // Create a global instance of the GCode parser singleton
 GCodeParser parser;
 
@@ -79,14 +84,130 @@ void GCodeParser::reset() {
     codebits = 0;                       // No codes yet
     //ZERO(param);                      // No parameters (should be safe to comment out this line)
   #endif
+  #if ENABLED(GCODE_G1_FAST_PATH)
+    fast_move = false;                  // No move values yet
+  #endif
 }
 
+#if ENABLED(GCODE_G1_FAST_PATH)
+
+  // Powers of ten to place the decimal point of a fixed-point value
+  static const float pow10_table[] PROGMEM = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f };
+
+  /**
+   * Convert [-+]?[0-9]*.?[0-9]* (with at least one digit) as a fixed-point
+   * number of up to 9 digits. Fraction digits past the 9th significant digit
+   * are dropped, since a float can't hold them. Return a pointer past the value,
+   * or NULL if the value is out of range or not in this form.
+   */
+  static char* parse_fixed(char *p, float &value) {
+    const bool neg = (*p == '-');
+    if (neg || *p == '+') ++p;
+    uint32_t n = 0;
+    uint8_t places = 0;
+    bool point = false, digits = false;
+    for (;; ++p) {
+      const char c = *p;
+      if (NUMERIC(c)) {
+        if (n < 100000000UL && places < COUNT(pow10_table) - 1) {
+          n = n * 10 + (c - '0');
+          if (point) ++places;
+        }
+        else if (!point || n < 10000000UL) // Too large, or too small to drop digits
+          return NULL;
+        digits = true;
+      }
+      else if (c == '.' && !point)
+        point = true;
+      else
+        break;
+    }
+    if (!digits) return NULL;
+    float f = n;
+    if (places) f /= pgm_read_float(&pow10_table[places]);
+    value = neg ? -f : f;
+    return p;
+  }
+
+  /**
+   * Parse a G0/G1 line having only X Y Z E F parameters, each with a
+   * fixed-point value, converting the values straight into move_value[].
+   * The parameters are also flagged as seen, so handlers can test them.
+   * A line number and checksum are skipped as with parse().
+   *
+   * Return false for anything else (other codes or parameters, a parameter
+   * given twice or with no value, exponents, very long values), leaving the
+   * line unchanged for parse().
+   */
+  bool GCodeParser::parse_G0_G1(char *p) {
+    // Skip spaces and N[-0-9]*
+    while (*p == ' ') ++p;
+    if (*p == 'N' && NUMERIC_SIGNED(p[1])) {
+      p += 2;
+      while (NUMERIC(*p)) ++p;
+      while (*p == ' ') ++p;
+    }
+
+    // Only G0 and G1, with no sub-code
+    if (p[0] != 'G' || !WITHIN(p[1], '0', '1') || NUMERIC(p[2]) || p[2] == '.') return false;
+
+    reset();
+    command_ptr = p;
+    command_letter = 'G';
+    codenum = p[1] - '0';
+    move_value[XYZE] = 0;               // No feedrate
+
+    char *end = (p += 2);
+    for (;;) {
+      while (*p == ' ') ++p;
+      const char code = *p;
+      if (code == '\0' || code == '*') break;
+      uint8_t i;
+      switch (code) {
+        case 'X': i = X_AXIS; break;
+        case 'Y': i = Y_AXIS; break;
+        case 'Z': i = Z_AXIS; break;
+        case 'E': i = E_CART; break;
+        case 'F': i = XYZE; break;
+        default: return false;          // Any other parameter needs parse()
+      }
+      if (TEST32(codebits, LETTER_BIT(code))) return false; // Given twice
+      do ++p; while (*p == ' ');        // Skip spaces between parameters & values
+      set(code, p);
+      if (!(p = parse_fixed(p, move_value[i]))) return false;
+      end = p;
+    }
+    *end = '\0';                        // Nullify the checksum and trailing spaces
+
+    #if ENABLED(INCH_MODE_SUPPORT)
+      LOOP_XYZE(i) move_value[i] *= axis_unit_factor((AxisEnum)i);
+      move_value[XYZE] *= linear_unit_factor;
+    #endif
+
+    fast_move = true;
+    return true;
+  }
+
+#endif // GCODE_G1_FAST_PATH
+
 // Populate all fields by parsing a single line of GCode
 // 58 bytes of SRAM are used to speed up seen/value
-void GCodeParser::parse(char *p) {
+void GCodeParser::parse(char *p
+  #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+    , const uint8_t * const params/*=NULL*/
+  #endif
+) {
+
+  #if ENABLED(GCODE_G1_FAST_PATH)
+    if (parse_G0_G1(p)) return;         // Most lines of a print are plain moves
+  #endif
 
   reset(); // No codes to report
 
+  #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+    char * const line = p;
+  #endif
+
   // Skip spaces
   while (*p == ' ') ++p;
 
@@ -158,6 +279,26 @@ void GCodeParser::parse(char *p) {
     const bool debug = codenum == 800;
   #endif
 
+  #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+    // Visit only the parameter letters found as the line was received
+    if (params
+      #if ENABLED(DEBUG_GCODE_PARSER)
+        && !debug
+      #endif
+    ) {
+      string_arg = NULL;
+      for (uint8_t i = 1; i <= params[0]; i++) {
+        p = line + params[i];
+        const char code = *p++;
+        while (*p == ' ') p++;                  // Skip spaces between parameters & values
+        const bool has_num = valid_float(p);
+        if (!has_num && !string_arg) string_arg = p - 1;
+        set(code, has_num ? p : NULL);
+      }
+      return;
+    }
+  #endif
+
   /**
    * Find all parameters, set flags and pointers for fast parsing
    *
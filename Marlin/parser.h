@@ -180,7 +180,19 @@ public:
 
   // Populate all fields by parsing a single line of GCode
   // This uses 54 bytes of SRAM to speed up seen/value
-  static void parse(char * p);
+  static void parse(char * p
+    #if ENABLED(ZERO_COPY_COMMAND_QUEUE)
+      , const uint8_t * const params=NULL // Count and offsets of the parameter letters, if known
+    #endif
+  );
+
+  #if ENABLED(GCODE_G1_FAST_PATH)
+    static bool fast_move;                // The move values below were converted by parse_G0_G1()
+    static float move_value[XYZE + 1];    // X Y Z E and F, in the current units
+
+    // Parse a plain G0/G1 line in one pass. False if it needs the full parse().
+    static bool parse_G0_G1(char * p);
+  #endif
 
   #if ENABLED(CNC_COORDINATE_SYSTEMS)
     // Parse the next parameter as a new command
@@ -137,6 +137,17 @@ float Planner::max_feedrate_mm_s[NUM_AXIS_N], // (mm/s) M203 XYZE - Max speeds
   bool Planner::abort_on_endstop_hit = false;
 #endif
 
+#if ENABLED(MOTION_STATS)
+  uint32_t Planner::stats_blocks,
+           Planner::stats_plan_us,
+           Planner::stats_plan_us_max,
+           Planner::stats_since_ms;
+  #if ENABLED(BLOCK_MERGING)
+    uint32_t Planner::stats_merged;
+  #endif
+  uint32_t Planner::stats_evals;
+#endif
+
 #if ENABLED(DISTINCT_E_FACTORS)
   uint8_t Planner::last_extruder = 0;     // Respond to extruder change
   #define _EINDEX (E_AXIS + active_extruder)
@@ -197,6 +208,20 @@ uint32_t Planner::cutoff_long;
 float Planner::previous_speed[NUM_AXIS],
       Planner::previous_nominal_speed_sqr;
 
+#if ENABLED(LINE_BUILDUP_INCREMENTAL)
+  float Planner::lb_length[MOV_AXIS],
+        Planner::lb_steps[MOV_AXIS],
+        Planner::lb_slope[MOV_AXIS],
+        Planner::lb_curve[MOV_AXIS];
+  uint8_t Planner::lb_resync_countdown = 0;
+#endif
+
+#if ENABLED(BLOCK_MERGING)
+  float Planner::merge_fr_mm_s,
+        Planner::merge_slope_min[NUM_AXIS],
+        Planner::merge_slope_max[NUM_AXIS];
+#endif
+
 #if ENABLED(DISABLE_INACTIVE_EXTRUDER)
   uint8_t Planner::g_uc_extruder_last_move[EXTRUDERS] = { 0 };
 #endif
@@ -238,8 +263,23 @@ void Planner::init() {
   #endif
   clear_block_buffer();
   delay_before_delivering = 0;
+  #if ENABLED(MOTION_STATS)
+    reset_stats();
+  #endif
 }
 
+#if ENABLED(MOTION_STATS)
+
+  void Planner::reset_stats() {
+    stats_blocks = stats_plan_us = stats_plan_us_max = stats_evals = 0;
+    #if ENABLED(BLOCK_MERGING)
+      stats_merged = 0;
+    #endif
+    stats_since_ms = millis();
+  }
+
+#endif
+
 #if ENABLED(S_CURVE_ACCELERATION)
 
   /**
@@ -764,6 +804,23 @@ void Planner::calculate_trapezoid_for_block(block_t* const block, const float &e
   block->final_rate = final_rate;
 }
 
+#if ENABLED(LIN_ADVANCE_SMOOTHING)
+
+  /**
+   * The STEP timer value for the advance ISR of a block whose lead follows the
+   * pressure of the speed averaged over LIN_ADVANCE_SMOOTH_TIME. The lead for a
+   * speed change shorter than the window builds over the whole window. A longer
+   * one builds at the block acceleration, as without smoothing.
+   * 'comp' is the lead in E steps per mm/s of path speed.
+   */
+  uint16_t Planner::smoothed_advance_speed(const block_t * const block, const float &comp, const float &speed_change) {
+    const float lead_rate = comp * MIN(block->acceleration, speed_change * (1000.0f / (LIN_ADVANCE_SMOOTH_TIME)));
+    // A tiny lead change may build faster than the window, not slower than the timer allows
+    return lead_rate > (STEPPER_TIMER_RATE) / 65535.0f ? uint16_t((STEPPER_TIMER_RATE) / lead_rate) : 65535;
+  }
+
+#endif
+
 /*                            PLANNER SPEED DEFINITION
                                      +--------+   <- current->nominal_speed
                                     /          \
@@ -877,8 +934,12 @@ void Planner::reverse_pass_kernel(block_t* const current, const block_t * const
 /**
  * recalculate() needs to go over the current plan twice.
  * Once in reverse and once forward. This implements the reverse pass.
+ *
+ * The pass stops at the first block whose entry speed doesn't change, since
+ * the blocks before it only depend on that speed. Returns the index of the
+ * block where it stopped, from which the other passes continue.
  */
-void Planner::reverse_pass() {
+uint8_t Planner::reverse_pass() {
   // Initialize block index to the last block in the planner buffer.
   uint8_t block_index = prev_block_index(block_buffer_head);
 
@@ -889,7 +950,7 @@ void Planner::reverse_pass() {
   // If there was a race condition and block_buffer_planned was incremented
   //  or was pointing at the head (queue empty) break loop now and avoid
   //  planning already consumed blocks
-  if (planned_block_index == block_buffer_head) return;
+  if (planned_block_index == block_buffer_head) return planned_block_index;
 
   // Reverse Pass: Coarsely maximize all possible deceleration curves back-planning from the last
   // block in buffer. Cease planning when the last optimal planned or tail pointer is reached.
@@ -903,6 +964,13 @@ void Planner::reverse_pass() {
     // Only consider non sync blocks
     if (!TEST(current->flag, BLOCK_BIT_SYNC_POSITION)) {
       reverse_pass_kernel(current, next);
+      #if ENABLED(MOTION_STATS)
+        ++stats_evals;
+      #endif
+
+      // New blocks and changed entry speeds are flagged. Stop at the first unchanged one.
+      if (!TEST(current->flag, BLOCK_BIT_RECALCULATE)) return block_index;
+
       next = current;
     }
 
@@ -915,12 +983,13 @@ void Planner::reverse_pass() {
     while (planned_block_index != block_buffer_planned) {
 
       // If we reached the busy block or an already processed block, break the loop now
-      if (block_index == planned_block_index) return;
+      if (block_index == planned_block_index) return planned_block_index;
 
       // Advance the pointer, following the busy block
       planned_block_index = next_block_index(planned_block_index);
     }
   }
+  return planned_block_index;
 }
 
 // The kernel called by recalculate() when scanning the plan from first to last entry.
@@ -975,18 +1044,21 @@ void Planner::forward_pass_kernel(const block_t* const previous, block_t* const
 
 /**
  * recalculate() needs to go over the current plan twice.
- * Once in reverse and once forward. This implements the forward pass.
+ * Once in reverse and once forward. This implements the forward pass,
+ * starting from the block where the reverse pass stopped.
  */
-void Planner::forward_pass() {
+void Planner::forward_pass(const uint8_t start_index) {
 
   // Forward Pass: Forward plan the acceleration curve from the planned pointer onward.
   // Also scans for optimal plan breakpoints and appropriately updates the planned pointer.
 
-  // Begin at buffer planned pointer. Note that block_buffer_planned can be modified
-  //  by the stepper ISR,  so read it ONCE. It it guaranteed that block_buffer_planned
-  //  will never lead head, so the loop is safe to execute. Also note that the forward
-  //  pass will never modify the values at the tail.
-  uint8_t block_index = block_buffer_planned;
+  // Begin at the given block, but never behind the buffer planned pointer. Note that
+  //  block_buffer_planned can be modified by the stepper ISR, so read it ONCE. It it
+  //  guaranteed that block_buffer_planned will never lead head, so the loop is safe to
+  //  execute. Also note that the forward pass will never modify the values at the tail.
+  const uint8_t planned_block_index = block_buffer_planned;
+  uint8_t block_index = BLOCK_MOD(start_index - planned_block_index) < BLOCK_MOD(block_buffer_head - planned_block_index)
+    ? start_index : planned_block_index;
 
   block_t *current;
   const block_t * previous = NULL;
@@ -1002,8 +1074,12 @@ void Planner::forward_pass() {
       // the previous block became BUSY, so assume the current block's
       // entry speed can't be altered (since that would also require
       // updating the exit speed of the previous block).
-      if (!previous || !stepper.is_block_busy(previous))
+      if (!previous || !stepper.is_block_busy(previous)) {
         forward_pass_kernel(previous, current, block_index);
+        #if ENABLED(MOTION_STATS)
+          ++stats_evals;
+        #endif
+      }
       previous = current;
     }
     // Advance to the previous
@@ -1012,14 +1088,17 @@ void Planner::forward_pass() {
 }
 
 /**
- * Recalculate the trapezoid speed profiles for all blocks in the plan
- * according to the entry_factor for each junction. Must be called by
+ * Recalculate the trapezoid speed profiles for the blocks in the plan from
+ * the given block onward, according to the entry_factor for each junction.
+ * Blocks before it keep their entry and exit speeds. Must be called by
  * recalculate() after updating the blocks.
  */
-void Planner::recalculate_trapezoids() {
+void Planner::recalculate_trapezoids(const uint8_t start_index) {
   // The tail may be changed by the ISR so get a local copy.
-  uint8_t block_index = block_buffer_tail,
-          head_block_index = block_buffer_head;
+  const uint8_t tail_block_index = block_buffer_tail;
+  uint8_t head_block_index = block_buffer_head,
+          block_index = BLOCK_MOD(start_index - tail_block_index) < BLOCK_MOD(head_block_index - tail_block_index)
+            ? start_index : tail_block_index;
   // Since there could be a sync block in the head of the queue, and the
   // next loop must not recalculate the head block (as it needs to be
   // specially handled), scan backwards to the first non-SYNC block.
@@ -1038,7 +1117,7 @@ void Planner::recalculate_trapezoids() {
     head_block_index = prev_index;
   }
 
-  // Go from the tail (currently executed block) to the first block, without including it)
+  // Go from the start block (or the currently executed one) to the last block, without including it
   block_t *current = NULL, *next = NULL;
   float current_entry_speed = 0.0, next_entry_speed = 0.0;
   while (block_index != head_block_index) {
@@ -1068,11 +1147,17 @@ void Planner::recalculate_trapezoids() {
             const float current_nominal_speed = SQRT(current->nominal_speed_sqr),
                         nomr = 1.0f / current_nominal_speed;
             calculate_trapezoid_for_block(current, current_entry_speed * nomr, next_entry_speed * nomr);
+            #if ENABLED(MOTION_STATS)
+              ++stats_evals;
+            #endif
             #if ENABLED(LIN_ADVANCE)
               if (current->use_advance_lead) {
                 const float comp = current->e_D_ratio * extruder_advance_K * axis_steps_per_mm[E_AXIS];
                 current->max_adv_steps = current_nominal_speed * comp;
                 current->final_adv_steps = next_entry_speed * comp;
+                #if ENABLED(LIN_ADVANCE_SMOOTHING)
+                  current->advance_speed = smoothed_advance_speed(current, comp, current_nominal_speed - MIN(current_entry_speed, next_entry_speed));
+                #endif
               }
             #endif
           }
@@ -1107,11 +1192,17 @@ void Planner::recalculate_trapezoids() {
       const float next_nominal_speed = SQRT(next->nominal_speed_sqr),
                   nomr = 1.0f / next_nominal_speed;
       calculate_trapezoid_for_block(next, next_entry_speed * nomr, float(MINIMUM_PLANNER_SPEED) * nomr);
+      #if ENABLED(MOTION_STATS)
+        ++stats_evals;
+      #endif
       #if ENABLED(LIN_ADVANCE)
         if (next->use_advance_lead) {
           const float comp = next->e_D_ratio * extruder_advance_K * axis_steps_per_mm[E_AXIS];
           next->max_adv_steps = next_nominal_speed * comp;
           next->final_adv_steps = (MINIMUM_PLANNER_SPEED) * comp;
+          #if ENABLED(LIN_ADVANCE_SMOOTHING)
+            next->advance_speed = smoothed_advance_speed(next, comp, next_nominal_speed - MIN(next_entry_speed, float(MINIMUM_PLANNER_SPEED)));
+          #endif
         }
       #endif
     }
@@ -1125,12 +1216,14 @@ void Planner::recalculate_trapezoids() {
 void Planner::recalculate() {
   // Initialize block index to the last block in the planner buffer.
   const uint8_t block_index = prev_block_index(block_buffer_head);
+  // Blocks before this one keep their speeds
+  uint8_t start_index = block_index;
   // If there is just one block, no planning can be done. Avoid it!
   if (block_index != block_buffer_planned) {
-    reverse_pass();
-    forward_pass();
+    start_index = reverse_pass();
+    forward_pass(start_index);
   }
-  recalculate_trapezoids();
+  recalculate_trapezoids(start_index);
 }
 
 #if ENABLED(AUTOTEMP)
@@ -1528,15 +1621,59 @@ float Planner::get_axis_position_mm(const AxisEnum axis) {
     axis_steps = stepper.position(axis);
   #endif
   #if ENABLED(LINE_BUILDUP_COMPENSATION_FEATURE)
-    if (axis != E_AXIS) return (sq(axis_steps / k0[axis] + sqrtk1[axis]) - k1[axis]) / k2[axis];
+    if (axis != E_AXIS) {
+      // Inverse of the spool model, expanded to avoid subtracting k1 from a nearly equal square
+      const float u = axis_steps / k0[axis];
+      return u * (u + 2 * sqrtk1[axis]) / k2[axis];
+    }
   #endif
   return axis_steps * steps_to_mm[axis];
 }
 
+#if ENABLED(LINE_BUILDUP_INCREMENTAL)
+
+  /**
+   * Step target of a line from the spool model, without SQRT for most segments.
+   *
+   * The model is s(l) = k0 * (sqrt(k1 + k2 * l) - sqrtk1). Between exact evaluations
+   * s is expanded to second order around the last exact one. Each target comes
+   * straight from that point, so float rounding doesn't add up over the segments.
+   * The third derivative of s is tiny for any real spool, so for lines within
+   * LINE_BUILDUP_MAX_DELTA of the expansion point the expansion stays far below
+   * a step. The exact form is rearranged as
+   * k0 * k2 * l / (sqrt(k1 + k2 * l) + sqrtk1) to avoid the cancellation of two
+   * nearly equal square roots, which costs a few steps of resolution in float.
+   */
+  int32_t Planner::line_buildup_steps(const uint8_t axis, const float &l, const bool resync) {
+    const float dl = l - lb_length[axis];
+    if (resync || ABS(dl) > LINE_BUILDUP_MAX_DELTA) {
+      const float u = SQRT(k1[axis] + k2[axis] * l),
+                  inv_u = 1.0f / u,
+                  k0k2 = k0[axis] * k2[axis];
+      lb_steps[axis] = k0k2 * l / (u + sqrtk1[axis]);
+      lb_slope[axis] = 0.5f * k0k2 * inv_u;
+      lb_curve[axis] = -0.25f * lb_slope[axis] * k2[axis] * sq(inv_u);
+      lb_length[axis] = l;
+      return LROUND(lb_steps[axis]);
+    }
+    return LROUND(lb_steps[axis] + (lb_slope[axis] + lb_curve[axis] * dl) * dl);
+  }
+
+#endif // LINE_BUILDUP_INCREMENTAL
+
 /**
  * Block until all buffered steps are executed / cleaned
  */
-void Planner::synchronize() { while (has_blocks_queued() || cleaning_buffer_counter) idle(); }
+void Planner::synchronize() {
+  while (has_blocks_queued() || cleaning_buffer_counter
+    #if ENABLED(INPUT_SHAPING)
+      || stepper.shaping_busy() // The shaped motors are still catching up
+    #endif
+  ) idle();
+  #if ENABLED(MOTION_STATS)
+    stepper.stats_drained();
+  #endif
+}
 
 #if ENABLED(UNREGISTERED_MOVE_SUPPORT)
   #define COUNT_MOVE count_it
@@ -1544,6 +1681,180 @@ void Planner::synchronize() { while (has_blocks_queued() || cleaning_buffer_coun
   #define COUNT_MOVE true
 #endif
 
+#if ENABLED(BLOCK_MERGING)
+
+  /**
+   * Planner::merge_into_last_block
+   *
+   * Extend the last queued block to the target instead of queuing a new block,
+   * if the move continues it in a straight line at the same feedrate and the
+   * stepper has not started on it. Every joint merged into the block, not only
+   * the newest, must lie within BLOCK_MERGE_MAX_DEVIATION steps of the merged
+   * line on each axis, so a gentle curve can't be merged into a long chord.
+   *
+   * The length is the sum of the segment lengths, and the nominal speed is
+   * worked out again for it, as SLOWDOWN may have lowered it for a short first
+   * segment. The direction doesn't change, so the junction state kept for the
+   * next block (previous_speed, previous_nominal_speed_sqr) only scales with the
+   * speed. The block is left flagged for recalculation.
+   *
+   * Returns true if the move was merged
+   */
+  bool Planner::merge_into_last_block(const int32_t (&target)[NUM_AXIS]
+    #if HAS_POSITION_FLOAT
+      , const float (&target_float)[NUM_AXIS]
+    #endif
+    , const float &fr_mm_s, const uint8_t extruder, const float &millimeters
+    #if ENABLED(UNREGISTERED_MOVE_SUPPORT)
+      , const bool count_it
+    #endif
+  ) {
+    if (block_buffer_head == block_buffer_tail || fr_mm_s != merge_fr_mm_s) return false;
+
+    block_t * const block = &block_buffer[prev_block_index(block_buffer_head)];
+    if (TEST(block->flag, BLOCK_BIT_SYNC_POSITION) || block->active_extruder != extruder) return false;
+
+    #if ENABLED(UNREGISTERED_MOVE_SUPPORT)
+      if (!count_it || !block->count_it) return false;
+    #endif
+
+    #if FAN_COUNT > 0
+      for (uint8_t i = 0; i < FAN_COUNT; i++) if (block->fan_speed[i] != fanSpeeds[i]) return false;
+    #endif
+
+    #if ENABLED(BARICUDA)
+      if (block->valve_pressure != baricuda_valve_pressure || block->e_to_p_pressure != baricuda_e_to_p_pressure) return false;
+    #endif
+
+    // Same direction on every axis
+    int32_t delta[NUM_AXIS];
+    uint8_t dm = 0;
+    LOOP_NUM_AXIS(i) {
+      delta[i] = target[i] - position[i];
+      if (delta[i] < 0) SBI(dm, i);
+    }
+    if (dm != block->direction_bits) return false;
+
+    #if ENABLED(PREVENT_COLD_EXTRUSION)
+      if (delta[E_AXIS] && thermalManager.tooColdToExtrude(extruder)) return false;
+    #endif
+
+    uint32_t steps[NUM_AXIS], step_event_count = 0;
+    LOOP_MOV_AXIS(i) steps[i] = block->steps[i] + ABS(delta[i]);
+    steps[E_AXIS] = block->steps[E_AXIS] + uint32_t(ABS(delta[E_AXIS] * e_factor[extruder]) + 0.5f);
+    LOOP_NUM_AXIS(i) NOLESS(step_event_count, steps[i]);
+
+    #if ENABLED(PREVENT_LENGTHY_EXTRUDE)
+      if (steps[E_AXIS] > (uint32_t)axis_steps_per_mm[E_AXIS_N] * (EXTRUDE_MAXLENGTH)) return false;
+    #endif
+
+    // The joints must lie on the line the merged block will be stepped along.
+    // Each joint bounds the steps per step event of each axis, and the bounds
+    // of the earlier joints are kept with the block.
+    const float inv_joint_events = 1.0f / float(block->step_event_count),
+                inv_events = 1.0f / float(step_event_count);
+    float slope_min[NUM_AXIS], slope_max[NUM_AXIS];
+    LOOP_NUM_AXIS(i) {
+      slope_min[i] = MAX(merge_slope_min[i], (float(block->steps[i]) - float(BLOCK_MERGE_MAX_DEVIATION)) * inv_joint_events);
+      slope_max[i] = MIN(merge_slope_max[i], (float(block->steps[i]) + float(BLOCK_MERGE_MAX_DEVIATION)) * inv_joint_events);
+      if (!WITHIN(steps[i] * inv_events, slope_min[i], slope_max[i])) return false;
+    }
+
+    // The length of the segment, as _populate_block() works it out
+    float segment_mm = millimeters;
+    bool e_only = true;
+    LOOP_MOV_AXIS(i) if (ABS(delta[i]) >= MIN_STEPS_PER_SEGMENT) e_only = false;
+    if (e_only)
+      segment_mm = ABS(delta[E_AXIS] * e_factor[extruder]) * steps_to_mm[E_AXIS_N];
+    else if (!segment_mm) {
+      float sum = 0;
+      LOOP_MOV_AXIS(i) sum += sq(delta[i] * steps_to_mm[i]);
+      segment_mm = SQRT(sum);
+    }
+    const float new_millimeters = block->millimeters + segment_mm;
+
+    // The nominal speed of the longer block, as _populate_block() works it out
+    float inverse_secs = MAX(fr_mm_s, steps[E_AXIS] ? min_feedrate_mm_s : min_travel_feedrate_mm_s) / new_millimeters;
+    #if ENABLED(SLOWDOWN)
+      const uint8_t moves_queued = nonbusy_movesplanned() - 1; // Besides this block
+      if (WITHIN(moves_queued, 2, (BLOCK_BUFFER_SIZE) / 2 - 1)) {
+        const uint32_t segment_time_us = LROUND(1000000.0f / inverse_secs);
+        if (segment_time_us < min_segment_time_us)
+          inverse_secs = 1000000.0f / (segment_time_us + LROUND(2 * (min_segment_time_us - segment_time_us) / moves_queued));
+      }
+    #endif
+
+    // Limit the speed of each axis, as _populate_block() does
+    float speed_factor = 1.0f;
+    LOOP_NUM_AXIS(i) {
+      #if ENABLED(DISTINCT_E_FACTORS)
+        const uint8_t a = i == E_AXIS ? E_AXIS_N : i;
+      #else
+        const uint8_t a = i;
+      #endif
+      const float cs = steps[i] * steps_to_mm[a] * inverse_secs;
+      if (cs > max_feedrate_mm_s[a]) NOMORE(speed_factor, max_feedrate_mm_s[a] / cs);
+    }
+    inverse_secs *= speed_factor;
+    const float nominal_speed_sqr = sq(new_millimeters * inverse_secs);
+
+    #if ENABLED(LIN_ADVANCE_SMOOTHING)
+      // The acceleration and lead of the block were limited for its lower speed
+      if (block->use_advance_lead && nominal_speed_sqr > block->nominal_speed_sqr) return false;
+    #endif
+
+    // Keep the Stepper ISR off the block while it changes. It may have taken the
+    // block, or even finished it, since the checks above.
+    SBI(block->flag, BLOCK_BIT_RECALCULATE);
+    if (stepper.is_block_busy(block) || block_buffer_head == block_buffer_tail) {
+      CBI(block->flag, BLOCK_BIT_RECALCULATE);
+      return false;
+    }
+
+    #if ENABLED(ULTRA_LCD)
+      const float old_secs = block->millimeters / SQRT(block->nominal_speed_sqr);
+    #endif
+
+    // The speeds of the axes at the junction with the next block scale with the nominal speed
+    const float speed_ratio = SQRT(nominal_speed_sqr / block->nominal_speed_sqr);
+    LOOP_NUM_AXIS(i) previous_speed[i] *= speed_ratio;
+    previous_nominal_speed_sqr = nominal_speed_sqr;
+
+    block->millimeters = new_millimeters;
+    LOOP_NUM_AXIS(i) block->steps[i] = steps[i];
+    COPY(merge_slope_min, slope_min);
+    COPY(merge_slope_max, slope_max);
+    block->step_event_count = step_event_count;
+
+    block->nominal_speed_sqr = nominal_speed_sqr;
+    block->nominal_rate = CEIL(step_event_count * inverse_secs);
+    block->acceleration_steps_per_s2 = block->acceleration * step_event_count / new_millimeters;
+    #if DISABLED(S_CURVE_ACCELERATION)
+      block->acceleration_rate = (uint32_t)(block->acceleration_steps_per_s2 * (4096.0f * 4096.0f / (STEPPER_TIMER_RATE)));
+    #endif
+
+    // Whether the block can now reach its nominal speed from a stop
+    SET_BIT_TO(block->flag, BLOCK_BIT_NOMINAL_LENGTH,
+      nominal_speed_sqr <= max_allowable_speed_sqr(-block->acceleration, sq(float(MINIMUM_PLANNER_SPEED)), new_millimeters));
+
+    #if ENABLED(ULTRA_LCD)
+      const uint32_t segment_time_us = LROUND(1000000.0f * (1.0f / inverse_secs - old_secs));
+      const bool was_enabled = STEPPER_ISR_ENABLED();
+      if (was_enabled) DISABLE_STEPPER_DRIVER_INTERRUPT();
+      block_buffer_runtime_us += segment_time_us;
+      if (was_enabled) ENABLE_STEPPER_DRIVER_INTERRUPT();
+    #endif
+
+    COPY(position, target);
+    #if HAS_POSITION_FLOAT
+      COPY(position_float, target_float);
+    #endif
+
+    return true;
+  }
+
+#endif // BLOCK_MERGING
+
 /**
  * Planner::_buffer_steps
  *
@@ -1571,10 +1882,33 @@ bool Planner::_buffer_steps(const int32_t (&target)[NUM_AXIS]
   // If we are cleaning, do not accept queuing of movements
   if (cleaning_buffer_counter) return false;
 
+  #if ENABLED(BLOCK_MERGING)
+    // Extend the last block if this continues it, without waiting for a free block
+    if (merge_into_last_block(target
+      #if HAS_POSITION_FLOAT
+        , target_float
+      #endif
+      , fr_mm_s, extruder, millimeters
+      #if ENABLED(UNREGISTERED_MOVE_SUPPORT)
+        , count_it
+      #endif
+    )) {
+      recalculate();
+      #if ENABLED(MOTION_STATS)
+        ++stats_merged;
+      #endif
+      return true;
+    }
+  #endif
+
   // Wait for the next available block
   uint8_t next_buffer_head;
   block_t * const block = get_next_free_block(next_buffer_head);
 
+  #if ENABLED(MOTION_STATS)
+    const uint32_t stats_start_us = micros(); // Don't count the wait for a free block
+  #endif
+
   // Fill the block with the specified movement
   if (!_populate_block(block, false, target
     #if HAS_POSITION_FLOAT
@@ -1590,6 +1924,12 @@ bool Planner::_buffer_steps(const int32_t (&target)[NUM_AXIS]
     return true;
   }
 
+  #if ENABLED(BLOCK_MERGING)
+    merge_fr_mm_s = fr_mm_s;
+    // A new block has no joints yet
+    LOOP_NUM_AXIS(i) { merge_slope_min[i] = 0; merge_slope_max[i] = 1; }
+  #endif
+
   // If this is the first added movement, reload the delay, otherwise, cancel it.
   if (block_buffer_head == block_buffer_tail) {
     // If it was the first queued block, restart the 1st block delivery delay, to
@@ -1598,6 +1938,9 @@ bool Planner::_buffer_steps(const int32_t (&target)[NUM_AXIS]
     // variable, so there is no risk setting this here (but it MUST be done
     // before the following line!!)
     delay_before_delivering = BLOCK_DELAY_FOR_1ST_MOVE;
+    #if ENABLED(MOTION_STATS)
+      stepper.stats_block_queued();
+    #endif
   }
 
   // Move buffer head
@@ -1606,6 +1949,13 @@ bool Planner::_buffer_steps(const int32_t (&target)[NUM_AXIS]
   // Recalculate and optimize trapezoidal speed profiles
   recalculate();
 
+  #if ENABLED(MOTION_STATS)
+    const uint32_t plan_us = micros() - stats_start_us;
+    stats_plan_us += plan_us;
+    NOLESS(stats_plan_us_max, plan_us);
+    ++stats_blocks;
+  #endif
+
   // Movement successfully queued!
   return true;
 }
@@ -2201,10 +2551,17 @@ bool Planner::_populate_block(block_t * const block, bool split_move,
           block->use_advance_lead = false;
         else {
           const uint32_t max_accel_steps_per_s2 = MAX_E_JERK / (extruder_advance_K * block->e_D_ratio) * steps_per_mm;
-          #if ENABLED(LA_DEBUG)
-            if (accel > max_accel_steps_per_s2) SERIAL_ECHOLNPGM("Acceleration limited.");
-          #endif
-          NOMORE(accel, max_accel_steps_per_s2);
+          if (accel > max_accel_steps_per_s2
+            #if ENABLED(LIN_ADVANCE_SMOOTHING)
+              // A lead spread over the window may change the E speed by no more than E jerk anyway
+              && extruder_advance_K * block->e_D_ratio * SQRT(block->nominal_speed_sqr) * (1000.0f / (LIN_ADVANCE_SMOOTH_TIME)) > MAX_E_JERK
+            #endif
+          ) {
+            #if ENABLED(LA_DEBUG)
+              SERIAL_ECHOLNPGM("Acceleration limited.");
+            #endif
+            accel = max_accel_steps_per_s2;
+          }
         }
       }
     #endif
@@ -2235,6 +2592,41 @@ bool Planner::_populate_block(block_t * const block, bool split_move,
       LIMIT_ACCEL_FLOAT(E_AXIS, ACCEL_IDX);
     }
   }
+
+  #if ENABLED(LIN_ADVANCE_SMOOTHING)
+    if (block->use_advance_lead) {
+      /**
+       * The E speed peaks as a ramp ends with the lead still building, at
+       * e_D_ratio * (v + K * MIN(a, dv / T)) for a speed change dv of at most v.
+       * Where that passes the E max feedrate, accelerate more gently or run
+       * slower, whichever takes less time over the block.
+       */
+      const float max_speed = max_feedrate_mm_s[E_AXIS_N] / block->e_D_ratio,
+                  inv_smooth_time = 1000.0f / (LIN_ADVANCE_SMOOTH_TIME),
+                  nominal_speed = SQRT(block->nominal_speed_sqr),
+                  accel_mm = accel / steps_per_mm;
+      if (nominal_speed + extruder_advance_K * MIN(accel_mm, nominal_speed * inv_smooth_time) > max_speed) {
+        const float gentle_accel = (max_speed - nominal_speed) / extruder_advance_K,
+                    slow_speed = MAX(max_speed / (1.0f + extruder_advance_K * inv_smooth_time), max_speed - extruder_advance_K * accel_mm);
+        if (gentle_accel > 0 && block->millimeters / nominal_speed + nominal_speed / gentle_accel < block->millimeters / slow_speed + slow_speed / accel_mm) {
+          #if ENABLED(LA_DEBUG)
+            SERIAL_ECHOLNPGM("Acceleration limited by E.");
+          #endif
+          accel = gentle_accel * steps_per_mm;
+        }
+        else {
+          #if ENABLED(LA_DEBUG)
+            SERIAL_ECHOLNPGM("Speed limited by E.");
+          #endif
+          const float lead_factor = slow_speed / nominal_speed;
+          LOOP_NUM_AXIS(i) current_speed[i] *= lead_factor;
+          block->nominal_rate *= lead_factor;
+          block->nominal_speed_sqr = sq(slow_speed);
+        }
+      }
+    }
+  #endif
+
   block->acceleration_steps_per_s2 = accel;
   block->acceleration = accel / steps_per_mm;
   #if DISABLED(S_CURVE_ACCELERATION)
@@ -2242,7 +2634,12 @@ bool Planner::_populate_block(block_t * const block, bool split_move,
   #endif
   #if ENABLED(LIN_ADVANCE)
     if (block->use_advance_lead) {
-      block->advance_speed = (STEPPER_TIMER_RATE) / (extruder_advance_K * block->e_D_ratio * block->acceleration * axis_steps_per_mm[E_AXIS_N]);
+      #if ENABLED(LIN_ADVANCE_SMOOTHING)
+        // Until planned, assume the block starts from rest
+        block->advance_speed = smoothed_advance_speed(block, extruder_advance_K * block->e_D_ratio * axis_steps_per_mm[E_AXIS_N], SQRT(block->nominal_speed_sqr));
+      #else
+        block->advance_speed = (STEPPER_TIMER_RATE) / (extruder_advance_K * block->e_D_ratio * block->acceleration * axis_steps_per_mm[E_AXIS_N]);
+      #endif
       #if ENABLED(LA_DEBUG)
         if (extruder_advance_K * block->e_D_ratio * block->acceleration * 2 < SQRT(block->nominal_speed_sqr) * block->e_D_ratio)
           SERIAL_ECHOLNPGM("More than 2 steps per eISR loop executed.");
@@ -2550,10 +2947,20 @@ bool Planner::buffer_segment(const float &a, const float &b, const float &c
     }
   #endif
 
+  #if ENABLED(LINE_BUILDUP_INCREMENTAL)
+    const bool lb_resync = !lb_resync_countdown;
+    lb_resync_countdown = lb_resync ? (LINE_BUILDUP_RESYNC) - 1 : lb_resync_countdown - 1;
+  #endif
+
   // The target position of the tool in absolute steps
   // Calculate target position in absolute steps
   const int32_t target[NUM_AXIS] = {
-    #if ENABLED(LINE_BUILDUP_COMPENSATION_FEATURE)
+    #if ENABLED(LINE_BUILDUP_INCREMENTAL)
+      line_buildup_steps(A_AXIS, a, lb_resync),
+      line_buildup_steps(B_AXIS, b, lb_resync),
+      line_buildup_steps(C_AXIS, c, lb_resync),
+      line_buildup_steps(D_AXIS, d, lb_resync),
+    #elif ENABLED(LINE_BUILDUP_COMPENSATION_FEATURE)
       LROUND(k0[A_AXIS] * (SQRT(k1[A_AXIS] + a * k2[A_AXIS]) - sqrtk1[A_AXIS])),
       LROUND(k0[B_AXIS] * (SQRT(k1[B_AXIS] + b * k2[B_AXIS]) - sqrtk1[B_AXIS])),
       LROUND(k0[C_AXIS] * (SQRT(k1[C_AXIS] + c * k2[C_AXIS]) - sqrtk1[C_AXIS])),
@@ -2654,7 +3061,13 @@ void Planner::_set_position_mm(const float &a, const float &b, const float &c
   #if ENABLED(DISTINCT_E_FACTORS)
     last_extruder = active_extruder;
   #endif
-  #if ENABLED(LINE_BUILDUP_COMPENSATION_FEATURE)
+  #if ENABLED(LINE_BUILDUP_INCREMENTAL)
+    lb_resync_countdown = LINE_BUILDUP_RESYNC;
+    position[A_AXIS] = line_buildup_steps(A_AXIS, a, true);
+    position[B_AXIS] = line_buildup_steps(B_AXIS, b, true);
+    position[C_AXIS] = line_buildup_steps(C_AXIS, c, true);
+    position[D_AXIS] = line_buildup_steps(D_AXIS, d, true);
+  #elif ENABLED(LINE_BUILDUP_COMPENSATION_FEATURE)
     position[A_AXIS] = LROUND(k0[A_AXIS] * (SQRT(k1[A_AXIS] + a * k2[A_AXIS]) - sqrtk1[A_AXIS])),
     position[B_AXIS] = LROUND(k0[B_AXIS] * (SQRT(k1[B_AXIS] + b * k2[B_AXIS]) - sqrtk1[B_AXIS])),
     position[C_AXIS] = LROUND(k0[C_AXIS] * (SQRT(k1[C_AXIS] + c * k2[C_AXIS]) - sqrtk1[C_AXIS])),
@@ -270,6 +270,17 @@ class Planner {
       static bool abort_on_endstop_hit;
     #endif
 
+    #if ENABLED(MOTION_STATS)
+      static uint32_t stats_blocks,         // Blocks queued since the last reset
+                      stats_plan_us,        // (µs) Time spent queuing and planning those blocks
+                      stats_plan_us_max,    // (µs) Longest single queue-and-plan call
+                      stats_since_ms;       // millis() at the last reset
+      #if ENABLED(BLOCK_MERGING)
+        static uint32_t stats_merged;       // Moves merged into the last queued block
+      #endif
+      static uint32_t stats_evals;          // Junction and trapezoid evaluations by recalculate()
+    #endif
+
   private:
 
     /**
@@ -297,6 +308,25 @@ class Planner {
       static float last_fade_z;
     #endif
 
+    #if ENABLED(LINE_BUILDUP_INCREMENTAL)
+      /**
+       * Expansion point of the spool model for each line: the line length of the
+       * last exact evaluation, its unrounded step position, the slope ds/dl and
+       * half of d2s/dl2
+       */
+      static float lb_length[MOV_AXIS],
+                   lb_steps[MOV_AXIS],
+                   lb_slope[MOV_AXIS],
+                   lb_curve[MOV_AXIS];
+      static uint8_t lb_resync_countdown;   // Segments left until the next exact evaluation
+    #endif
+
+    #if ENABLED(BLOCK_MERGING)
+      static float merge_fr_mm_s,           // Requested feedrate of the last queued block
+                   merge_slope_min[NUM_AXIS], // Steps per step event the last block may take on each axis
+                   merge_slope_max[NUM_AXIS]; // and still pass all of its joints within BLOCK_MERGE_MAX_DEVIATION
+    #endif
+
     #if ENABLED(DISABLE_INACTIVE_EXTRUDER)
       /**
        * Counters to manage disabling inactive extruders
@@ -327,6 +357,10 @@ class Planner {
 
     void init();
 
+    #if ENABLED(MOTION_STATS)
+      static void reset_stats();
+    #endif
+
     /**
      * Static (class) Methods
      */
@@ -872,13 +906,33 @@ class Planner {
 
     static void calculate_trapezoid_for_block(block_t* const block, const float &entry_factor, const float &exit_factor);
 
+    #if ENABLED(LIN_ADVANCE_SMOOTHING)
+      static uint16_t smoothed_advance_speed(const block_t * const block, const float &comp, const float &speed_change);
+    #endif
+
+    #if ENABLED(LINE_BUILDUP_INCREMENTAL)
+      static int32_t line_buildup_steps(const uint8_t axis, const float &l, const bool resync);
+    #endif
+
+    #if ENABLED(BLOCK_MERGING)
+      static bool merge_into_last_block(const int32_t (&target)[NUM_AXIS]
+        #if HAS_POSITION_FLOAT
+          , const float (&target_float)[NUM_AXIS]
+        #endif
+        , const float &fr_mm_s, const uint8_t extruder, const float &millimeters
+        #if ENABLED(UNREGISTERED_MOVE_SUPPORT)
+          , const bool count_it
+        #endif
+      );
+    #endif
+
     static void reverse_pass_kernel(block_t* const current, const block_t * const next);
     static void forward_pass_kernel(const block_t * const previous, block_t* const current, uint8_t block_index);
 
-    static void reverse_pass();
-    static void forward_pass();
+    static uint8_t reverse_pass();
+    static void forward_pass(const uint8_t start_index);
 
-    static void recalculate_trapezoids();
+    static void recalculate_trapezoids(const uint8_t start_index);
 
     static void recalculate();
 
@@ -41,9 +41,17 @@
 job_recovery_info_t job_recovery_info;
 JobRecoveryPhase job_recovery_phase = JOB_RECOVERY_IDLE;
 uint8_t job_recovery_commands_count; //=0
-char job_recovery_commands[BUFSIZE + APPEND_CMD_COUNT][MAX_CMD_SIZE];
+#if ENABLED(COMMAND_QUEUE_ARENA)
+  char job_recovery_commands[COMMAND_QUEUE_ARENA_SIZE + (APPEND_CMD_COUNT) * (MAX_CMD_SIZE)];
+  // Each command follows the nul of the one before
+  #define NEXT_RECOVERY_COMMAND() (ind++ ? (cmd += strlen(cmd) + 1) : cmd)
+#else
+  char job_recovery_commands[BUFSIZE + APPEND_CMD_COUNT][MAX_CMD_SIZE];
+  #define NEXT_RECOVERY_COMMAND() job_recovery_commands[ind++]
+#endif
 // Extern
-extern uint8_t active_extruder, commands_in_queue, cmd_queue_index_r;
+extern uint8_t active_extruder, commands_in_queue;
+extern cmd_queue_index_t cmd_queue_index_r;
 
 #if ENABLED(DEBUG_POWER_LOSS_RECOVERY)
   void debug_print_job_recovery(const bool recovery) {
@@ -90,10 +98,21 @@ extern uint8_t active_extruder, commands_in_queue, cmd_queue_index_r;
         #endif
         SERIAL_PROTOCOLLNPAIR("cmd_queue_index_r: ", int(job_recovery_info.cmd_queue_index_r));
         SERIAL_PROTOCOLLNPAIR("commands_in_queue: ", int(job_recovery_info.commands_in_queue));
-        if (recovery)
-          for (uint8_t i = 0; i < job_recovery_commands_count; i++) SERIAL_PROTOCOLLNPAIR("> ", job_recovery_commands[i]);
-        else
-          for (uint8_t i = 0; i < job_recovery_info.commands_in_queue; i++) SERIAL_PROTOCOLLNPAIR("> ", job_recovery_info.command_queue[i]);
+        if (recovery) {
+          #if ENABLED(COMMAND_QUEUE_ARENA)
+            const char *cmd = job_recovery_commands;
+            for (uint8_t i = 0; i < job_recovery_commands_count; i++, cmd += strlen(cmd) + 1) SERIAL_PROTOCOLLNPAIR("> ", cmd);
+          #else
+            for (uint8_t i = 0; i < job_recovery_commands_count; i++) SERIAL_PROTOCOLLNPAIR("> ", job_recovery_commands[i]);
+          #endif
+        }
+        else {
+          cmd_queue_index_t r = job_recovery_info.cmd_queue_index_r;
+          for (uint8_t i = 0; i < job_recovery_info.commands_in_queue; i++) {
+            SERIAL_PROTOCOLLNPAIR("> ", QUEUED_COMMAND(job_recovery_info.command_queue, r));
+            r = NEXT_QUEUED_COMMAND(job_recovery_info.command_queue, r);
+          }
+        }
         SERIAL_PROTOCOLLNPAIR("sd_filename: ", job_recovery_info.sd_filename);
         SERIAL_PROTOCOLLNPAIR("sdpos: ", job_recovery_info.sdpos);
         SERIAL_PROTOCOLLNPAIR("print_job_elapsed: ", job_recovery_info.print_job_elapsed);
@@ -132,14 +151,17 @@ void check_print_job_recovery() {
       if (job_recovery_info.valid_head && job_recovery_info.valid_head == job_recovery_info.valid_foot) {
 
         uint8_t ind = 0;
+        #if ENABLED(COMMAND_QUEUE_ARENA)
+          char *cmd = job_recovery_commands;
+        #endif
 
         #if HAS_LEVELING
-          strcpy_P(job_recovery_commands[ind++], PSTR("M420 S0 Z0"));               // Leveling off before G92 or G28
+          strcpy_P(NEXT_RECOVERY_COMMAND(), PSTR("M420 S0 Z0"));                    // Leveling off before G92 or G28
         #endif
 
-        strcpy_P(job_recovery_commands[ind++], PSTR("G92.0 Z0"));                   // Ensure Z is equal to 0
-        strcpy_P(job_recovery_commands[ind++], PSTR("G1 Z2"));                      // Raise Z by 2mm (we hope!)
-        strcpy_P(job_recovery_commands[ind++], PSTR("G28 R0"
+        strcpy_P(NEXT_RECOVERY_COMMAND(), PSTR("G92.0 Z0"));                        // Ensure Z is equal to 0
+        strcpy_P(NEXT_RECOVERY_COMMAND(), PSTR("G1 Z2"));                           // Raise Z by 2mm (we hope!)
+        strcpy_P(NEXT_RECOVERY_COMMAND(), PSTR("G28 R0"
           #if ENABLED(MARLIN_DEV_MODE)
             " S"
           #elif !IS_KINEMATIC
@@ -154,7 +176,7 @@ void check_print_job_recovery() {
             // Restore leveling state before G92 sets Z
             // This ensures the steppers correspond to the native Z
             dtostrf(job_recovery_info.fade, 1, 1, str_1);
-            sprintf_P(job_recovery_commands[ind++], PSTR("M420 S%i Z%s"), int(job_recovery_info.leveling), str_1);
+            sprintf_P(NEXT_RECOVERY_COMMAND(), PSTR("M420 S%i Z%s"), int(job_recovery_info.leveling), str_1);
           }
         #endif
 
@@ -165,17 +187,17 @@ void check_print_job_recovery() {
           #endif
           , 1, 3, str_2
         );
-        sprintf_P(job_recovery_commands[ind++], PSTR("G92.0 Z%s E%s"), str_1, str_2); // Current Z + 2 and E
+        sprintf_P(NEXT_RECOVERY_COMMAND(), PSTR("G92.0 Z%s E%s"), str_1, str_2); // Current Z + 2 and E
 
-        uint8_t r = job_recovery_info.cmd_queue_index_r, c = job_recovery_info.commands_in_queue;
-        while (c--) {
-          strcpy(job_recovery_commands[ind++], job_recovery_info.command_queue[r]);
-          r = (r + 1) % BUFSIZE;
+        cmd_queue_index_t r = job_recovery_info.cmd_queue_index_r;
+        for (uint8_t c = job_recovery_info.commands_in_queue; c--;) {
+          strcpy(NEXT_RECOVERY_COMMAND(), QUEUED_COMMAND(job_recovery_info.command_queue, r));
+          r = NEXT_QUEUED_COMMAND(job_recovery_info.command_queue, r);
         }
 
         if (job_recovery_info.sd_filename[0] == '/') job_recovery_info.sd_filename[0] = ' ';
-        sprintf_P(job_recovery_commands[ind++], PSTR("M23 %s"), job_recovery_info.sd_filename);
-        sprintf_P(job_recovery_commands[ind++], PSTR("M24 S%ld T%ld"), job_recovery_info.sdpos, job_recovery_info.print_job_elapsed);
+        sprintf_P(NEXT_RECOVERY_COMMAND(), PSTR("M23 %s"), job_recovery_info.sd_filename);
+        sprintf_P(NEXT_RECOVERY_COMMAND(), PSTR("M24 S%ld T%ld"), job_recovery_info.sdpos, job_recovery_info.print_job_elapsed);
 
         job_recovery_commands_count = ind;
 
@@ -61,8 +61,14 @@ typedef struct {
   #endif
 
   // Command queue
-  uint8_t cmd_queue_index_r, commands_in_queue;
-  char command_queue[BUFSIZE][MAX_CMD_SIZE];
+  #if ENABLED(COMMAND_QUEUE_ARENA)
+    uint16_t cmd_queue_index_r;
+    uint8_t commands_in_queue;
+    char command_queue[COMMAND_QUEUE_ARENA_SIZE];
+  #else
+    uint8_t cmd_queue_index_r, commands_in_queue;
+    char command_queue[BUFSIZE][MAX_CMD_SIZE];
+  #endif
 
   // SD Filename and position
   char sd_filename[MAXPATHNAMELENGTH];
@@ -90,7 +96,12 @@ extern JobRecoveryPhase job_recovery_phase;
   #define APPEND_CMD_COUNT 7
 #endif
 
-extern char job_recovery_commands[BUFSIZE + APPEND_CMD_COUNT][MAX_CMD_SIZE];
+#if ENABLED(COMMAND_QUEUE_ARENA)
+  // Packed nul-terminated commands, as many as the arena holds and the extras
+  extern char job_recovery_commands[COMMAND_QUEUE_ARENA_SIZE + (APPEND_CMD_COUNT) * (MAX_CMD_SIZE)];
+#else
+  extern char job_recovery_commands[BUFSIZE + APPEND_CMD_COUNT][MAX_CMD_SIZE];
+#endif
 extern uint8_t job_recovery_commands_count;
 
 void check_print_job_recovery();
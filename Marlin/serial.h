@@ -87,7 +87,11 @@ extern const char errormagic[] PROGMEM;
 // Functions for serial printing from PROGMEM. (Saves loads of SRAM.)
 //
 FORCE_INLINE void serialprintPGM(const char* str) {
-  while (char ch = pgm_read_byte(str++)) SERIAL_CHAR(ch);
+  #if USE_MARLINSERIAL && ENABLED(SERIAL_DEFERRED_TX)
+    MYSERIAL0.printPGM(str);
+  #else
+    while (char ch = pgm_read_byte(str++)) SERIAL_CHAR(ch);
+  #endif
 }
 
 void serial_echopair_PGM(const char* s_P, const char *v);
@@ -135,6 +135,32 @@ uint8_t Stepper::steps_per_isr;
 #endif
     uint8_t Stepper::oversampling_factor;
 
+#if DISABLED(DISABLE_MULTI_STEPPING)
+  // The stepping frequency limits for each multistepping rate
+  const uint32_t Stepper::multistep_limit[8] PROGMEM = {
+    (  MAX_STEP_ISR_FREQUENCY_1X     ),
+    (  MAX_STEP_ISR_FREQUENCY_2X >> 1),
+    (  MAX_STEP_ISR_FREQUENCY_4X >> 2),
+    (  MAX_STEP_ISR_FREQUENCY_8X >> 3),
+    ( MAX_STEP_ISR_FREQUENCY_16X >> 4),
+    ( MAX_STEP_ISR_FREQUENCY_32X >> 5),
+    ( MAX_STEP_ISR_FREQUENCY_64X >> 6),
+    (MAX_STEP_ISR_FREQUENCY_128X >> 7)
+  };
+#endif
+
+#if ENABLED(ADAPTIVE_MULTISTEPPING)
+  // Until they are measured, assume the costs stepper.h estimates
+  uint32_t Stepper::multistep_pass_rate = MAX_STEP_ISR_FREQUENCY_1X;
+  uint16_t Stepper::multistep_call = ((ISR_BASE_CYCLES) / (STEPPER_TIMER_PRESCALE)) << 4,
+           Stepper::multistep_event = ((ISR_LOOP_CYCLES) / (STEPPER_TIMER_PRESCALE)) << 4;
+  uint16_t Stepper::multistep_events;
+  uint8_t Stepper::multistep_shift;
+  #if ENABLED(MOTION_STATS)
+    uint16_t Stepper::stats_multistep[8] = { 0 };
+  #endif
+#endif
+
 int32_t Stepper::delta_error[NUM_AXIS] = { 0 };
 uint32_t Stepper::advance_dividend[NUM_AXIS] = { 0 },
          Stepper::advance_divisor = 0,
@@ -176,14 +202,83 @@ uint32_t Stepper::nextMainISR = 0;
 
   bool Stepper::LA_use_advance_lead;
 
+  #if ENABLED(LIN_ADVANCE_SMOOTHING)
+    uint32_t Stepper::LA_lead_left = 0;
+    uint16_t Stepper::LA_release_rate;
+  #endif
+
 #endif // LIN_ADVANCE
 
+#if ENABLED(STEP_STREAM)
+  uint32_t Stepper::nextStreamISR = 0,
+           Stepper::stream_elapsed = 0;
+  stream_chunk_t Stepper::stream_queue[NUM_AXIS][STEP_STREAM_QUEUE_SIZE];
+  volatile uint8_t Stepper::stream_head[NUM_AXIS] = { 0 },
+                   Stepper::stream_tail[NUM_AXIS] = { 0 };
+  int32_t Stepper::stream_wait[NUM_AXIS],
+          Stepper::stream_interval[NUM_AXIS];
+  int16_t Stepper::stream_add[NUM_AXIS];
+  uint16_t Stepper::stream_left[NUM_AXIS];
+  uint8_t Stepper::stream_dir_bits,
+          Stepper::stream_idle_bits;
+  volatile bool Stepper::stream_running = false;
+  volatile uint16_t Stepper::stream_underruns;
+#endif
+
+#if ENABLED(INPUT_SHAPING)
+  uint8_t Stepper::shaping_type[SHAPING_AXES];
+  float Stepper::shaping_frequency[SHAPING_AXES],
+        Stepper::shaping_zeta[SHAPING_AXES];
+  uint32_t Stepper::nextShapingISR = 0,
+           Stepper::shaping_time = 0;
+  shaping_entry_t Stepper::shaping_queue[SHAPING_AXES][INPUT_SHAPING_QUEUE_SIZE];
+  uint8_t Stepper::shaping_head[SHAPING_AXES] = { 0 },
+          Stepper::shaping_tail[SHAPING_AXES][2] = { { 0 } },
+          Stepper::shaping_echoes[SHAPING_AXES] = { 0 },
+          Stepper::shaping_factor[SHAPING_AXES][3] = { { SHAPING_UNIT }, { SHAPING_UNIT } },
+          Stepper::shaping_dir_bits = 0;
+  uint32_t Stepper::shaping_delay[SHAPING_AXES][2];
+  uint16_t Stepper::shaping_gap[SHAPING_AXES];
+  int16_t Stepper::shaping_left[SHAPING_AXES][2] = { { 0 } };
+  uint16_t Stepper::shaping_every[SHAPING_AXES][2];
+  uint32_t Stepper::shaping_due[SHAPING_AXES][2];
+  int32_t Stepper::shaping_error[SHAPING_AXES] = { 0 };
+  int16_t Stepper::shaping_steps[SHAPING_AXES] = { 0 };
+#endif
+
+#if ENABLED(PER_AXIS_STEP_TIMING)
+  uint32_t Stepper::nextTimedISR = 0,
+           Stepper::timed_clock = 0,
+           Stepper::timed_start,
+           Stepper::timed_ticks,
+           Stepper::timed_first,
+           Stepper::timed_last,
+           Stepper::timed_due[NUM_AXIS],
+           Stepper::timed_dividend[NUM_AXIS],
+           Stepper::timed_event[NUM_AXIS];
+  int32_t Stepper::timed_error[NUM_AXIS];
+  uint8_t Stepper::timed_shift,
+          Stepper::timed_axes = 0,
+          Stepper::timed_pending = 0;
+#endif
+
 int32_t Stepper::ticks_nominal = -1;
 
 #if DISABLED(S_CURVE_ACCELERATION)
   uint32_t Stepper::acc_step_rate; // needed for deceleration start point
 #endif
 
+#if ENABLED(STEP_RATE_INTERPOLATION)
+  uint32_t Stepper::rate_knot_time,
+           Stepper::rate_knot_rate,
+           Stepper::rate_interval;
+  int32_t Stepper::rate_slope;
+  uint16_t Stepper::rate_knot_interval;
+  uint8_t Stepper::rate_knot_loops;
+  int8_t Stepper::rate_knot_base;
+  bool Stepper::rate_decelerating;
+#endif
+
 volatile int32_t Stepper::endstops_trigsteps[XYZ],
                  Stepper::count_position[NUM_AXIS] = { 0 };
 int8_t Stepper::count_direction[NUM_AXIS] = {
@@ -193,6 +288,20 @@ int8_t Stepper::count_direction[NUM_AXIS] = {
   #endif
 };
 
+#if ENABLED(MOTION_STATS)
+  uint32_t Stepper::stats_isr_ticks = 0,
+           Stepper::stats_step_events = 0;
+  uint16_t Stepper::stats_starved = 0;
+  uint32_t Stepper::stats_dry_ms = 0;
+#endif
+
+#if ENABLED(STEPPER_ISR_PROFILE)
+  isr_profile_t Stepper::profile[ISR_PHASES];
+  uint32_t Stepper::profile_isrs = 0,
+           Stepper::profile_late = 0;
+  uint16_t Stepper::profile_overruns = 0;
+#endif
+
 #if ENABLED(X_DUAL_ENDSTOPS) || ENABLED(Y_DUAL_ENDSTOPS) || ENABLED(Z_DUAL_ENDSTOPS)
   #define DUAL_ENDSTOP_APPLY_STEP(A,V)                                                                                        \
     if (homing_dual_axis) {                                                                                                   \
@@ -374,11 +483,18 @@ void Stepper::set_directions() {
       count_direction[_AXIS(A)] = 1; \
     }
 
+  #if ENABLED(INPUT_SHAPING)
+    // Shaped motors are turned when they take their steps. Only count the planned direction.
+    #define SET_SHAPED_DIR(A) count_direction[_AXIS(A)] = motor_direction(_AXIS(A)) ? -1 : 1
+  #else
+    #define SET_SHAPED_DIR(A) SET_STEP_DIR(A)
+  #endif
+
   #if HAS_X_DIR
-    SET_STEP_DIR(X); // A
+    SET_SHAPED_DIR(X); // A
   #endif
   #if HAS_Y_DIR
-    SET_STEP_DIR(Y); // B
+    SET_SHAPED_DIR(Y); // B
   #endif
   #if HAS_Z_DIR
     SET_STEP_DIR(Z); // C
@@ -1149,13 +1265,32 @@ void Stepper::set_directions() {
 HAL_STEP_TIMER_ISR {
   HAL_timer_isr_prologue(STEP_TIMER_NUM);
 
+  #if ENABLED(SERIAL_DEFERRED_TX)
+    ++serial_isr_depth; // Endstop and stream reports print from here, with interrupts enabled
+  #endif
+
   Stepper::isr();
 
+  #if ENABLED(SERIAL_DEFERRED_TX)
+    --serial_isr_depth;
+  #endif
+
   HAL_timer_isr_epilogue(STEP_TIMER_NUM);
 }
 
 #define STEP_MULTIPLY(A,B) MultiU24X32toH16(A, B)
 
+// Time a phase of the stepper ISR. The timer can't wrap while the compare is at its maximum.
+#if ENABLED(STEPPER_ISR_PROFILE)
+  #define PROFILED(PHASE, CODE) do{ \
+    const hal_timer_t profile_start = HAL_timer_get_count(STEP_TIMER_NUM); \
+    CODE; \
+    profile_phase(PHASE, HAL_timer_get_count(STEP_TIMER_NUM) - profile_start); \
+  }while(0)
+#else
+  #define PROFILED(PHASE, CODE) CODE
+#endif
+
 void Stepper::isr() {
   DISABLE_ISRS();
 
@@ -1164,6 +1299,26 @@ void Stepper::isr() {
   // periods to big periods are respected and the timer does not reset to 0
   HAL_timer_set_compare(STEP_TIMER_NUM, HAL_TIMER_TYPE_MAX);
 
+  #if ENABLED(MOTION_STATS)
+    // The timer can't wrap while the compare is at its maximum
+    const hal_timer_t stats_isr_start = HAL_timer_get_count(STEP_TIMER_NUM);
+  #endif
+
+  #if ENABLED(ADAPTIVE_MULTISTEPPING)
+    const hal_timer_t multistep_isr_start = HAL_timer_get_count(STEP_TIMER_NUM);
+    multistep_events = 0;
+  #endif
+
+  #if ENABLED(STEPPER_ISR_PROFILE)
+    {
+      // The timer was reset by the compare match, so it counts the ticks since then
+      const hal_timer_t latency = HAL_timer_get_count(STEP_TIMER_NUM);
+      profile_phase(ISR_PHASE_LATENCY, latency);
+      ++profile_isrs;
+      if (latency > hal_timer_t((STEPPER_TIMER_TICKS_PER_US) * 8)) ++profile_late;
+    }
+  #endif
+
   // Count of ticks for the next ISR
   hal_timer_t next_isr_ticks = 0;
 
@@ -1177,17 +1332,40 @@ void Stepper::isr() {
     ENABLE_ISRS();
 
     // Run main stepping pulse phase ISR if we have to
-    if (!nextMainISR) Stepper::stepper_pulse_phase_isr();
+    if (!nextMainISR) PROFILED(ISR_PHASE_PULSE, Stepper::stepper_pulse_phase_isr());
 
     #if ENABLED(LIN_ADVANCE)
+      #if ENABLED(LIN_ADVANCE_SMOOTHING)
+        // Send the E steps of the move now, not with the next lead step
+        if (LA_steps && nextAdvanceISR && !LA_lead_left) {
+          LA_lead_left = nextAdvanceISR;
+          nextAdvanceISR = 0;
+        }
+      #endif
+
       // Run linear advance stepper ISR if we have to
-      if (!nextAdvanceISR) nextAdvanceISR = Stepper::advance_isr();
+      if (!nextAdvanceISR) PROFILED(ISR_PHASE_ADVANCE, nextAdvanceISR = Stepper::advance_isr());
+    #endif
+
+    #if ENABLED(STEP_STREAM)
+      // Run the step stream ISR if we have to
+      if (!nextStreamISR) PROFILED(ISR_PHASE_STREAM, nextStreamISR = Stepper::stream_isr());
+    #endif
+
+    #if ENABLED(INPUT_SHAPING)
+      // Run the input shaping ISR if we have to
+      if (!nextShapingISR) PROFILED(ISR_PHASE_SHAPING, nextShapingISR = Stepper::shaping_isr());
+    #endif
+
+    #if ENABLED(PER_AXIS_STEP_TIMING)
+      // Run the per-axis step timing ISR if we have to
+      if (!nextTimedISR) PROFILED(ISR_PHASE_TIMED, nextTimedISR = Stepper::timed_isr());
     #endif
 
     // ^== Time critical. NOTHING besides pulse generation should be above here!!!
 
     // Run main stepping block processing ISR if we have to
-    if (!nextMainISR) nextMainISR = Stepper::stepper_block_phase_isr();
+    if (!nextMainISR) PROFILED(ISR_PHASE_BLOCK, nextMainISR = Stepper::stepper_block_phase_isr());
 
     uint32_t interval =
       #if ENABLED(LIN_ADVANCE)
@@ -1197,6 +1375,18 @@ void Stepper::isr() {
       #endif
     ;
 
+    #if ENABLED(STEP_STREAM)
+      NOMORE(interval, nextStreamISR);
+    #endif
+
+    #if ENABLED(INPUT_SHAPING)
+      NOMORE(interval, nextShapingISR);
+    #endif
+
+    #if ENABLED(PER_AXIS_STEP_TIMING)
+      NOMORE(interval, nextTimedISR);
+    #endif
+
     // Limit the value to the maximum possible value of the timer
     NOMORE(interval, HAL_TIMER_TYPE_MAX);
 
@@ -1208,6 +1398,23 @@ void Stepper::isr() {
       if (nextAdvanceISR != LA_ADV_NEVER) nextAdvanceISR -= interval;
     #endif
 
+    #if ENABLED(STEP_STREAM)
+      // Compute the time remaining for the stream isr
+      nextStreamISR -= interval;
+    #endif
+
+    #if ENABLED(INPUT_SHAPING)
+      // Compute the time remaining for the shaping isr, and the time of the next pass
+      nextShapingISR -= interval;
+      shaping_time += interval;
+    #endif
+
+    #if ENABLED(PER_AXIS_STEP_TIMING)
+      // Compute the time remaining for the timed step isr, and the time of its steps
+      nextTimedISR -= interval;
+      timed_clock += interval;
+    #endif
+
     /**
      * This needs to avoid a race-condition caused by interleaving
      * of interrupts required by both the LA and Stepper algorithms.
@@ -1258,7 +1465,12 @@ void Stepper::isr() {
      * loop to 10 iterations. Beyond that, there's no way to ensure correct pulse
      * timing, since the MCU isn't fast enough.
      */
-    if (!--max_loops) next_isr_ticks = min_ticks;
+    if (!--max_loops) {
+      next_isr_ticks = min_ticks;
+      #if ENABLED(STEPPER_ISR_PROFILE)
+        ++profile_overruns;
+      #endif
+    }
 
     // Advance pulses if not enough time to wait for the next ISR
   } while (next_isr_ticks < min_ticks);
@@ -1266,6 +1478,21 @@ void Stepper::isr() {
   // Now 'next_isr_ticks' contains the period to the next Stepper ISR - And we are
   // sure that the time has not arrived yet - Warrantied by the scheduler
 
+  #if ENABLED(MOTION_STATS)
+    stats_isr_ticks += hal_timer_t(HAL_timer_get_count(STEP_TIMER_NUM) - stats_isr_start);
+  #endif
+
+  #if ENABLED(ADAPTIVE_MULTISTEPPING)
+    // Average the cost of a call besides its step events over the last 16 calls, in 1/16 ticks.
+    // Only calls with few events, so the error of the event cost doesn't swamp it.
+    if (multistep_events <= 2) {
+      int32_t call = (int32_t(hal_timer_t(HAL_timer_get_count(STEP_TIMER_NUM) - multistep_isr_start)) << 4)
+                   - int32_t(multistep_events * multistep_event);
+      LIMIT(call, 0, 32767);
+      multistep_call += (int16_t(call) - int16_t(multistep_call)) >> 4;
+    }
+  #endif
+
   // Set the next ISR to fire at the proper time
   HAL_timer_set_compare(STEP_TIMER_NUM, hal_timer_t(next_isr_ticks));
 
@@ -1286,6 +1513,59 @@ void Stepper::isr() {
   #define COUNT_IT true
 #endif
 
+#if ENABLED(INPUT_SHAPING)
+
+  #if MINIMUM_STEPPER_DIR_DELAY > 0
+    #define SHAPING_DIR_DELAY() DELAY_NS(MINIMUM_STEPPER_DIR_DELAY)
+  #else
+    #define SHAPING_DIR_DELAY() NOOP
+  #endif
+
+  // Step a shaped motor if its shaped position is half a step away, turning it first if needed
+  #define SHAPING_STEP_START(AXIS) do{ \
+    if (shaping_error[_AXIS(AXIS)] >= (SHAPING_UNIT) / 2 || shaping_error[_AXIS(AXIS)] < -(SHAPING_UNIT) / 2) { \
+      const bool rev = shaping_error[_AXIS(AXIS)] < 0; \
+      if (rev != TEST(shaping_dir_bits, _AXIS(AXIS))) { \
+        AXIS##_APPLY_DIR(rev ? INVERT_## AXIS##_DIR : !INVERT_## AXIS##_DIR, false); \
+        shaping_dir_bits ^= _BV(_AXIS(AXIS)); \
+        SHAPING_DIR_DELAY(); \
+      } \
+      _APPLY_STEP(AXIS)(!_INVERT_STEP_PIN(AXIS), 0); \
+      shaping_error[_AXIS(AXIS)] += rev ? (SHAPING_UNIT) : -(SHAPING_UNIT); \
+      count_position[_AXIS(AXIS)] += rev ? -1 : 1; \
+      SBI(shaping_step_bits, _AXIS(AXIS)); \
+    } \
+  }while(0)
+
+  #define SHAPING_STEP_STOP(AXIS) do{ \
+    if (TEST(shaping_step_bits, _AXIS(AXIS))) _APPLY_STEP(AXIS)(_INVERT_STEP_PIN(AXIS), 0); \
+  }while(0)
+
+#endif
+
+#if ENABLED(PER_AXIS_STEP_TIMING)
+
+  // E steps counted for the advance ISR or mixed are left to the pulse phase
+  #if ENABLED(LIN_ADVANCE) || ENABLED(MIXING_EXTRUDER)
+    #define TIMED_AXES MOV_AXIS
+  #else
+    #define TIMED_AXES NUM_AXIS
+    #define TIMED_E
+  #endif
+
+  #define TIMED_STEP_START(AXIS) do{ \
+    if (TEST(step_bits, _AXIS(AXIS))) { \
+      _APPLY_STEP(AXIS)(!_INVERT_STEP_PIN(AXIS), 0); \
+      if (COUNT_IT) count_position[_AXIS(AXIS)] += count_direction[_AXIS(AXIS)]; \
+    } \
+  }while(0)
+
+  #define TIMED_STEP_STOP(AXIS) do{ \
+    if (TEST(step_bits, _AXIS(AXIS))) _APPLY_STEP(AXIS)(_INVERT_STEP_PIN(AXIS), 0); \
+  }while(0)
+
+#endif
+
 void Stepper::stepper_pulse_phase_isr() {
 
   // If we must abort the current block, do so!
@@ -1296,6 +1576,12 @@ void Stepper::stepper_pulse_phase_isr() {
       current_block = NULL;
       planner.discard_current_block();
     }
+    #if ENABLED(INPUT_SHAPING)
+      shaping_discard();
+    #endif
+    #if ENABLED(PER_AXIS_STEP_TIMING)
+      timed_axes = timed_pending = 0;
+    #endif
   }
 
   // If there is no current block, do nothing
@@ -1308,9 +1594,20 @@ void Stepper::stepper_pulse_phase_isr() {
   // Just update the value we will get at the end of the loop
   step_events_completed += events_to_do;
 
+  #if ENABLED(MOTION_STATS)
+    stats_step_events += events_to_do;
+  #endif
+
   // Get the timer count and estimate the end of the pulse
   hal_timer_t pulse_end = HAL_timer_get_count(PULSE_TIMER_NUM) + hal_timer_t(MIN_PULSE_TICKS);
 
+  #if ENABLED(ADAPTIVE_MULTISTEPPING)
+    multistep_events += events_to_do;
+    // The second half of a full pass gives the cost of a step event, without the rest of the call
+    const uint8_t multistep_half = (multistep_shift && events_to_do == steps_per_isr) ? events_to_do >> 1 : 0;
+    hal_timer_t multistep_start = 0;
+  #endif
+
   const hal_timer_t added_step_ticks = hal_timer_t(ADDED_STEP_TICKS);
 
   // Take multiple steps per interrupt (For high speed moves)
@@ -1319,6 +1616,10 @@ void Stepper::stepper_pulse_phase_isr() {
     #define _APPLY_STEP(AXIS) AXIS ##_APPLY_STEP
     #define _INVERT_STEP_PIN(AXIS) INVERT_## AXIS ##_STEP_PIN
 
+    #if ENABLED(INPUT_SHAPING)
+      uint8_t shaping_step_bits = 0;
+    #endif
+
     // Start an active pulse, if Bresenham says so, and update position
     #define PULSE_START(AXIS) do{ \
       delta_error[_AXIS(AXIS)] += advance_dividend[_AXIS(AXIS)]; \
@@ -1336,6 +1637,30 @@ void Stepper::stepper_pulse_phase_isr() {
       } \
     }while(0)
 
+    #if ENABLED(INPUT_SHAPING)
+      // Bresenham moves the planned position of a shaped axis, and the first
+      // impulse of each planned step moves the shaped position right away
+      #define SHAPED_PULSE_START(AXIS) do{ \
+        delta_error[_AXIS(AXIS)] += advance_dividend[_AXIS(AXIS)]; \
+        if (delta_error[_AXIS(AXIS)] >= 0) { \
+          shaping_steps[_AXIS(AXIS)] += count_direction[_AXIS(AXIS)]; \
+          if (count_direction[_AXIS(AXIS)] < 0) \
+            shaping_error[_AXIS(AXIS)] -= shaping_factor[_AXIS(AXIS)][0]; \
+          else \
+            shaping_error[_AXIS(AXIS)] += shaping_factor[_AXIS(AXIS)][0]; \
+        } \
+        SHAPING_STEP_START(AXIS); \
+      }while(0)
+
+      #define SHAPED_PULSE_STOP(AXIS) do{ \
+        if (delta_error[_AXIS(AXIS)] >= 0) delta_error[_AXIS(AXIS)] -= advance_divisor; \
+        SHAPING_STEP_STOP(AXIS); \
+      }while(0)
+    #else
+      #define SHAPED_PULSE_START PULSE_START
+      #define SHAPED_PULSE_STOP PULSE_STOP
+    #endif
+
     // Pulse start
     #if ENABLED(HANGPRINTER)
       #if HAS_A_STEP
@@ -1352,10 +1677,10 @@ void Stepper::stepper_pulse_phase_isr() {
       #endif
     #else
       #if HAS_X_STEP
-        PULSE_START(X);
+        SHAPED_PULSE_START(X);
       #endif
       #if HAS_Y_STEP
-        PULSE_START(Y);
+        SHAPED_PULSE_START(Y);
       #endif
       #if HAS_Z_STEP
         PULSE_START(Z);
@@ -1419,10 +1744,10 @@ void Stepper::stepper_pulse_phase_isr() {
       #endif
     #else
       #if HAS_X_STEP
-        PULSE_STOP(X);
+        SHAPED_PULSE_STOP(X);
       #endif
       #if HAS_Y_STEP
-        PULSE_STOP(Y);
+        SHAPED_PULSE_STOP(Y);
       #endif
       #if HAS_Z_STEP
         PULSE_STOP(Z);
@@ -1453,17 +1778,104 @@ void Stepper::stepper_pulse_phase_isr() {
         // Add to the value, the time that the pulse must be active (to be used on the next loop)
         pulse_end += hal_timer_t(MIN_PULSE_TICKS);
       #endif
+      #if ENABLED(ADAPTIVE_MULTISTEPPING)
+        if (events_to_do == multistep_half) multistep_start = HAL_timer_get_count(PULSE_TIMER_NUM);
+      #endif
     }
 
   } while (events_to_do);
+
+  #if ENABLED(ADAPTIVE_MULTISTEPPING)
+    // Average the cost of a step event over the last 16 full passes, in 1/16 ticks
+    if (multistep_half) {
+      const hal_timer_t ticks = HAL_timer_get_count(PULSE_TIMER_NUM) - multistep_start;
+      const int16_t event = MIN((uint32_t(ticks) << 4) >> (multistep_shift - 1), uint32_t(4095));
+      multistep_event += (event - int16_t(multistep_event)) >> 4;
+    }
+  #endif
 }
 
+#if ENABLED(STEP_RATE_INTERPOLATION)
+
+  // The rate of the current ramp 'time' ticks into it, as the trapezoid ramp works it out
+  FORCE_INLINE uint32_t Stepper::ramp_rate(const uint32_t time, const bool decel) {
+    const uint32_t change = STEP_MULTIPLY(time, current_block->acceleration_rate);
+    if (decel) return change < acc_step_rate ? MAX(acc_step_rate - change, current_block->final_rate) : current_block->final_rate;
+    return MIN(change + current_block->initial_rate, current_block->nominal_rate);
+  }
+
+  /**
+   * Start the next segment of the acceleration or deceleration ramp. The rate is
+   * worked out as the trapezoid ramp does it, at the start of the segment unless
+   * the ISR is just past the last knot, and at the next knot. That is as far ahead
+   * as changes the rate by about 1/2^STEP_RATE_SEGMENT_SHIFT. Until the knot the
+   * ISR only adds a slope to the interval.
+   */
+  void Stepper::next_rate_segment(const uint32_t time, const bool decel) {
+    uint32_t rate, from;
+    uint8_t loops;
+    if (rate_knot_interval && time - rate_knot_time < rate_knot_interval) {
+      rate = rate_knot_rate;
+      from = rate_knot_interval;
+      loops = rate_knot_loops;
+    }
+    else {
+      rate = ramp_rate(time, decel);
+      from = calc_timer_interval(rate, oversampling_factor, &loops);
+    }
+
+    // The rate changes by 1/2^n in rate * 2^24 / (acceleration_rate * 2^n) ticks
+    int8_t shift = rate_knot_base;
+    for (uint32_t r = rate; r > 1; r >>= 1) ++shift;
+    NOMORE(shift, 30);
+
+    // Not worth interpolating over less than two ISRs
+    if (shift < 7 || _BV32(shift) < (from << 1)) {
+      steps_per_isr = loops;
+      rate_interval = from << 8;
+      rate_slope = 0;
+      rate_knot_time = time + 1;
+      rate_knot_interval = 0;
+      return;
+    }
+
+    rate_knot_time = time + _BV32(shift);
+    rate_knot_rate = ramp_rate(rate_knot_time, decel);
+    rate_knot_interval = calc_timer_interval(rate_knot_rate, oversampling_factor, &rate_knot_loops);
+
+    // Step the whole segment as often per ISR as its faster end does
+    uint32_t to = rate_knot_interval;
+    uint8_t to_loops = rate_knot_loops;
+    for (; loops < to_loops; loops <<= 1) from <<= 1;
+    for (; to_loops < loops; to_loops <<= 1) to <<= 1;
+    steps_per_isr = loops;
+    #if ENABLED(ADAPTIVE_MULTISTEPPING)
+      for (multistep_shift = 0; loops > 1; loops >>= 1) ++multistep_shift;
+    #endif
+    NOMORE(from, 65535UL);
+    NOMORE(to, 65535UL);
+
+    // Over 2^n ticks the ISR runs about 2^(n+1) / (from + to) times,
+    // so the interval changes by (to^2 - from^2) / 2^(n+1) on each run.
+    rate_interval = from << 8;
+    shift -= 7;
+    rate_slope = to > from ? int32_t(MIN((sq(to) - sq(from)) >> shift, 0x7FFFFFFFUL))
+                           : -int32_t(MIN((sq(from) - sq(to)) >> shift, 0x7FFFFFFFUL));
+  }
+
+#endif // STEP_RATE_INTERPOLATION
+
 // This is the last half of the stepper interrupt: This one processes and
 // properly schedules blocks from the planner. This is executed after creating
 // the step pulses, so it is not time critical, as pulses are already done.
 
 uint32_t Stepper::stepper_block_phase_isr() {
 
+  #if ENABLED(INPUT_SHAPING)
+    // Queue the steps the pulse phase took on the shaped axes, for their echoes
+    for (uint8_t a = 0; a < SHAPING_AXES; a++) if (shaping_steps[a]) shaping_push(a);
+  #endif
+
   // If no queued movements, just wait 1ms for the next move
   uint32_t interval = (STEPPER_TIMER_RATE / 1000);
 
@@ -1475,6 +1887,10 @@ uint32_t Stepper::stepper_block_phase_isr() {
       axis_did_move = 0;
       current_block = NULL;
       planner.discard_current_block();
+      #if ENABLED(MOTION_STATS)
+        // Counted as a starvation only if the planner queues more moves soon
+        if (!planner.has_blocks_queued()) stats_dry_ms = millis() | 1;
+      #endif
     }
     else {
       // Step events not completed yet...
@@ -1482,21 +1898,31 @@ uint32_t Stepper::stepper_block_phase_isr() {
       // Are we in acceleration phase ?
       if (step_events_completed <= accelerate_until) { // Calculate new timer value
 
-        #if ENABLED(S_CURVE_ACCELERATION)
-          // Get the next speed to use (Jerk limited!)
-          uint32_t acc_step_rate =
-            acceleration_time < current_block->acceleration_time
-              ? _eval_bezier_curve(acceleration_time)
-              : current_block->cruise_rate;
+        #if ENABLED(STEP_RATE_INTERPOLATION)
+
+          // Interpolate between the knots of the ramp
+          interval = rate_ramp_interval(acceleration_time, false);
+
         #else
-          acc_step_rate = STEP_MULTIPLY(acceleration_time, current_block->acceleration_rate) + current_block->initial_rate;
-          NOMORE(acc_step_rate, current_block->nominal_rate);
-        #endif
 
-        // acc_step_rate is in steps/second
+          #if ENABLED(S_CURVE_ACCELERATION)
+            // Get the next speed to use (Jerk limited!)
+            uint32_t acc_step_rate =
+              acceleration_time < current_block->acceleration_time
+                ? _eval_bezier_curve(acceleration_time)
+                : current_block->cruise_rate;
+          #else
+            acc_step_rate = STEP_MULTIPLY(acceleration_time, current_block->acceleration_rate) + current_block->initial_rate;
+            NOMORE(acc_step_rate, current_block->nominal_rate);
+          #endif
+
+          // acc_step_rate is in steps/second
+
+          // step_rate to timer interval and steps per stepper isr
+          interval = calc_timer_interval(acc_step_rate, oversampling_factor, &steps_per_isr);
+
+        #endif // !STEP_RATE_INTERPOLATION
 
-        // step_rate to timer interval and steps per stepper isr
-        interval = calc_timer_interval(acc_step_rate, oversampling_factor, &steps_per_isr);
         acceleration_time += interval;
 
         #if ENABLED(LIN_ADVANCE)
@@ -1509,39 +1935,56 @@ uint32_t Stepper::stepper_block_phase_isr() {
       }
       // Are we in Deceleration phase ?
       else if (step_events_completed > decelerate_after) {
-        uint32_t step_rate;
-
-        #if ENABLED(S_CURVE_ACCELERATION)
-          // If this is the 1st time we process the 2nd half of the trapezoid...
-          if (!bezier_2nd_half) {
-            // Initialize the Bézier speed curve
-            _calc_bezier_curve_coeffs(current_block->cruise_rate, current_block->final_rate, current_block->deceleration_time_inverse);
-            bezier_2nd_half = true;
-            // The first point starts at cruise rate. Just save evaluation of the Bézier curve
-            step_rate = current_block->cruise_rate;
-          }
-          else {
-            // Calculate the next speed to use
-            step_rate = deceleration_time < current_block->deceleration_time
-              ? _eval_bezier_curve(deceleration_time)
-              : current_block->final_rate;
+
+        #if ENABLED(STEP_RATE_INTERPOLATION)
+
+          // The deceleration starts from the rate of the last acceleration ISR
+          if (!rate_decelerating) {
+            rate_decelerating = true;
+            acc_step_rate = ramp_rate(acceleration_time - ((rate_interval - rate_slope) >> 8), false);
+            rate_knot_time = 0;
+            rate_knot_interval = 0;
           }
+          interval = rate_ramp_interval(deceleration_time, true);
+
         #else
 
-          // Using the old trapezoidal control
-          step_rate = STEP_MULTIPLY(deceleration_time, current_block->acceleration_rate);
-          if (step_rate < acc_step_rate) { // Still decelerating?
-            step_rate = acc_step_rate - step_rate;
-            NOLESS(step_rate, current_block->final_rate);
-          }
-          else
-            step_rate = current_block->final_rate;
-        #endif
+          uint32_t step_rate;
+
+          #if ENABLED(S_CURVE_ACCELERATION)
+            // If this is the 1st time we process the 2nd half of the trapezoid...
+            if (!bezier_2nd_half) {
+              // Initialize the Bézier speed curve
+              _calc_bezier_curve_coeffs(current_block->cruise_rate, current_block->final_rate, current_block->deceleration_time_inverse);
+              bezier_2nd_half = true;
+              // The first point starts at cruise rate. Just save evaluation of the Bézier curve
+              step_rate = current_block->cruise_rate;
+            }
+            else {
+              // Calculate the next speed to use
+              step_rate = deceleration_time < current_block->deceleration_time
+                ? _eval_bezier_curve(deceleration_time)
+                : current_block->final_rate;
+            }
+          #else
+
+            // Using the old trapezoidal control
+            step_rate = STEP_MULTIPLY(deceleration_time, current_block->acceleration_rate);
+            if (step_rate < acc_step_rate) { // Still decelerating?
+              step_rate = acc_step_rate - step_rate;
+              NOLESS(step_rate, current_block->final_rate);
+            }
+            else
+              step_rate = current_block->final_rate;
+          #endif
+
+          // step_rate is in steps/second
 
-        // step_rate is in steps/second
+          // step_rate to timer interval and steps per stepper isr
+          interval = calc_timer_interval(step_rate, oversampling_factor, &steps_per_isr);
+
+        #endif // !STEP_RATE_INTERPOLATION
 
-        // step_rate to timer interval and steps per stepper isr
-        interval = calc_timer_interval(step_rate, oversampling_factor, &steps_per_isr);
         deceleration_time += interval;
 
         #if ENABLED(LIN_ADVANCE)
@@ -1689,18 +2132,64 @@ uint32_t Stepper::stepper_block_phase_isr() {
       // Based on the oversampling factor, do the calculations
       step_event_count = current_block->step_event_count << oversampling;
 
+      #if ENABLED(ADAPTIVE_MULTISTEPPING)
+        {
+          // Pick the lowest multiplier that runs the cruise rate within the ISR load target:
+          //   (rate / multiplier) * call ticks + rate * event ticks <= target ticks per second
+          // All in 1/16 ticks, as measured
+          const uint32_t rate = current_block->nominal_rate << oversampling,
+                         budget = uint32_t(STEPPER_TIMER_RATE) / 100 * (ADAPTIVE_MULTISTEPPING_LOAD) * 16,
+                         events = rate * multistep_event,
+                         calls = rate * multistep_call,
+                         spare = events < budget ? budget - events : 0;
+          uint8_t idx = 0;
+          while (idx < 7 && calls > (spare << idx)) ++idx;
+          // No multiplier meets the target, so fall back to the fixed frequency limits
+          if (calls > (spare << idx)) {
+            idx = 0;
+            while (idx < 7 && (rate >> idx) > (uint32_t)pgm_read_dword(&multistep_limit[idx])) ++idx;
+          }
+          multistep_pass_rate = MAX(rate >> idx, uint32_t(1));
+          NOMORE(multistep_pass_rate, uint32_t(MAXIMUM_STEPPER_RATE));
+          #if ENABLED(MOTION_STATS)
+            if (stats_multistep[idx] < 0xFFFF) ++stats_multistep[idx];
+          #endif
+        }
+      #endif
+
       // Initialize Bresenham delta errors to 1/2
       delta_error[X_AXIS] = delta_error[Y_AXIS] = delta_error[Z_AXIS] = delta_error[E_AXIS] = -int32_t(step_event_count);
+      #if ENABLED(HANGPRINTER)
+        delta_error[D_AXIS] = -int32_t(step_event_count);
+      #endif
 
       // Calculate Bresenham dividends
       advance_dividend[X_AXIS] = current_block->steps[X_AXIS] << 1;
       advance_dividend[Y_AXIS] = current_block->steps[Y_AXIS] << 1;
       advance_dividend[Z_AXIS] = current_block->steps[Z_AXIS] << 1;
+      #if ENABLED(HANGPRINTER)
+        advance_dividend[D_AXIS] = current_block->steps[D_AXIS] << 1;
+      #endif
       advance_dividend[E_AXIS] = current_block->steps[E_AXIS] << 1;
 
       // Calculate Bresenham divisor
       advance_divisor = step_event_count << 1;
 
+      #if ENABLED(PER_AXIS_STEP_TIMING)
+        // Axes with fewer steps than step events get steps of their own between the passes.
+        // Their pulse phase Bresenham is left without a dividend, so it never steps them.
+        timed_axes = timed_pending = 0;
+        for (uint8_t a = 0; a < TIMED_AXES; a++) {
+          if (advance_dividend[a] && advance_dividend[a] < advance_divisor) {
+            timed_dividend[a] = advance_dividend[a];
+            timed_error[a] = delta_error[a];
+            timed_event[a] = 0;
+            advance_dividend[a] = 0;
+            SBI(timed_axes, a);
+          }
+        }
+      #endif
+
       // No step events completed so far
       step_events_completed = 0;
 
@@ -1738,8 +2227,20 @@ uint32_t Stepper::stepper_block_phase_isr() {
           //Start the ISR
           nextAdvanceISR = 0;
           LA_isr_rate = current_block->advance_speed;
+          #if ENABLED(LIN_ADVANCE_SMOOTHING)
+            LA_release_rate = current_block->advance_speed;
+          #endif
+        }
+        else {
+          LA_isr_rate = LA_ADV_NEVER;
+          #if ENABLED(LIN_ADVANCE_SMOOTHING)
+            // Release the lead left over from the last print move at the rate it was built
+            if (LA_current_adv_steps) {
+              LA_isr_rate = LA_release_rate;
+              nextAdvanceISR = 0;
+            }
+          #endif
         }
-        else LA_isr_rate = LA_ADV_NEVER;
       #endif
 
       if (current_block->direction_bits != last_direction_bits
@@ -1787,9 +2288,23 @@ uint32_t Stepper::stepper_block_phase_isr() {
 
       // Calculate the initial timer interval
       interval = calc_timer_interval(current_block->initial_rate, oversampling_factor, &steps_per_isr);
+
+      #if ENABLED(STEP_RATE_INTERPOLATION)
+        // 24 - log2(acceleration_rate), rounded down, less STEP_RATE_SEGMENT_SHIFT
+        rate_knot_base = 24 - (STEP_RATE_SEGMENT_SHIFT);
+        for (uint32_t r = current_block->acceleration_rate - 1; r; r >>= 1) --rate_knot_base;
+        rate_knot_time = 0;
+        rate_knot_interval = 0;
+        rate_decelerating = false;
+      #endif
     }
   }
 
+  #if ENABLED(PER_AXIS_STEP_TIMING)
+    // Time the steps the other axes take before the coming pass
+    if (current_block && timed_axes) timed_pass(interval);
+  #endif
+
   // Return the interval to wait
   return interval;
 }
@@ -1800,6 +2315,14 @@ uint32_t Stepper::stepper_block_phase_isr() {
   uint32_t Stepper::advance_isr() {
     uint32_t interval;
 
+    #if ENABLED(LIN_ADVANCE_SMOOTHING)
+      if (LA_lead_left) {
+        // Only here for the E steps of the move. The lead step stays due when it was
+        interval = LA_lead_left;
+        LA_lead_left = 0;
+      }
+      else
+    #endif
     if (LA_use_advance_lead) {
       if (step_events_completed > decelerate_after && LA_current_adv_steps > LA_final_adv_steps) {
         LA_steps--;
@@ -1812,9 +2335,25 @@ uint32_t Stepper::stepper_block_phase_isr() {
         LA_current_adv_steps++;
         interval = LA_isr_rate;
       }
+      #if ENABLED(LIN_ADVANCE_SMOOTHING)
+        else if (LA_current_adv_steps > LA_max_adv_steps) {
+          // Lead left over from the last block, which ran at a higher pressure
+          LA_steps--;
+          LA_current_adv_steps--;
+          interval = LA_isr_rate;
+        }
+      #endif
       else
         interval = LA_isr_rate = LA_ADV_NEVER;
     }
+    #if ENABLED(LIN_ADVANCE_SMOOTHING)
+      else if (LA_current_adv_steps) {
+        // Release the lead left over from the last print move
+        LA_steps--;
+        LA_current_adv_steps--;
+        interval = LA_isr_rate;
+      }
+    #endif
     else
       interval = LA_ADV_NEVER;
 
@@ -1888,6 +2427,566 @@ uint32_t Stepper::stepper_block_phase_isr() {
   }
 #endif // LIN_ADVANCE
 
+#if ENABLED(STEP_STREAM)
+
+  #if ENABLED(HANGPRINTER)
+    #define STREAM_AXES(F) do{ F(A); F(B); F(C); F(D); }while(0)
+  #else
+    #define STREAM_AXES(F) do{ F(X); F(Y); F(Z); }while(0)
+  #endif
+
+  #define STREAM_PULSE_START(AXIS) do{ \
+    if (TEST(step_bits, _AXIS(AXIS))) _APPLY_STEP(AXIS)(!_INVERT_STEP_PIN(AXIS), 0); \
+  }while(0)
+  #define STREAM_PULSE_STOP(AXIS) do{ \
+    if (TEST(step_bits, _AXIS(AXIS))) _APPLY_STEP(AXIS)(_INVERT_STEP_PIN(AXIS), 0); \
+  }while(0)
+  #define STREAM_DIR(AXIS) do{ \
+    if (TEST(dir_change, _AXIS(AXIS))) AXIS##_APPLY_DIR(TEST(stream_dir_bits, _AXIS(AXIS)) ? INVERT_## AXIS##_DIR : !INVERT_## AXIS##_DIR, false); \
+  }while(0)
+
+  /**
+   * Timer interrupt for the G6 S3 step stream. Every axis counts down to its own
+   * next step, so the axes keep the relative timing the host gave them while
+   * sharing this one timer channel. A chunk is (interval, count, add): 'count'
+   * steps, the first 'interval' ticks after the previous step of the axis, the
+   * interval growing by 'add' after each step. A chunk with no steps only delays.
+   */
+  uint32_t Stepper::stream_isr() {
+    if (!stream_running) return STEPPER_TIMER_RATE / 1000;
+
+    const uint8_t old_dir_bits = stream_dir_bits;
+    uint8_t step_bits = 0;
+    int32_t next = STEPPER_TIMER_RATE / 1000;
+
+    LOOP_NUM_AXIS(i) {
+      if (TEST(stream_idle_bits, i)) {
+        // A chunk arriving after the axis ran dry can only start from now
+        if (stream_head[i] == stream_tail[i]) continue;
+        CBI(stream_idle_bits, i);
+        stream_wait[i] = 0;
+        stream_underruns++;
+      }
+      else
+        stream_wait[i] -= stream_elapsed;
+
+      if (stream_wait[i] <= 0) {
+        if (stream_left[i]) {
+          SBI(step_bits, i);
+          count_position[i] += TEST(stream_dir_bits, i) ? -1 : 1;
+          if (--stream_left[i]) {
+            stream_interval[i] += stream_add[i];
+            stream_wait[i] += stream_interval[i];
+          }
+        }
+        if (!stream_left[i]) {
+          // The chunk is done, take the next one. Its direction is applied after the pulse.
+          const uint8_t t = stream_tail[i];
+          if (t == stream_head[i]) {
+            SBI(stream_idle_bits, i);
+            continue;
+          }
+          const stream_chunk_t &chunk = stream_queue[i][t];
+          stream_left[i] = chunk.count;
+          stream_interval[i] = chunk.interval;
+          stream_add[i] = chunk.add;
+          stream_wait[i] += chunk.interval;
+          SET_BIT_TO(stream_dir_bits, i, chunk.dir);
+          stream_tail[i] = (t + 1) & (STEP_STREAM_QUEUE_SIZE - 1);
+        }
+      }
+      NOMORE(next, stream_wait[i]);
+    }
+
+    if (step_bits) {
+      hal_timer_t pulse_end = HAL_timer_get_count(PULSE_TIMER_NUM) + hal_timer_t(MIN_PULSE_TICKS);
+
+      STREAM_AXES(STREAM_PULSE_START);
+      STREAM_PULSE_START(E);
+
+      #if MINIMUM_STEPPER_PULSE
+        // Just wait for the requested pulse duration
+        while (HAL_timer_get_count(PULSE_TIMER_NUM) < pulse_end) { /* nada */ }
+      #else
+        UNUSED(pulse_end);
+      #endif
+
+      STREAM_AXES(STREAM_PULSE_STOP);
+      STREAM_PULSE_STOP(E);
+    }
+
+    const uint8_t dir_change = stream_dir_bits ^ old_dir_bits;
+    if (dir_change) {
+      STREAM_AXES(STREAM_DIR);
+      if (TEST(dir_change, E_AXIS)) {
+        if (TEST(stream_dir_bits, E_AXIS))
+          REV_E_DIR(active_extruder);
+        else
+          NORM_E_DIR(active_extruder);
+      }
+    }
+
+    // A late axis steps on the next pass through the scheduler
+    NOLESS(next, 1);
+    stream_elapsed = next;
+    return next;
+  }
+
+  bool Stepper::stream_push(const AxisEnum axis, const stream_chunk_t &chunk) {
+    const uint8_t h = stream_head[axis], next_h = (h + 1) & (STEP_STREAM_QUEUE_SIZE - 1);
+    if (next_h == stream_tail[axis]) return false;
+    stream_queue[axis][h] = chunk;
+    stream_head[axis] = next_h;
+    return true;
+  }
+
+  void Stepper::stream_start() {
+    if (stream_running) return;
+
+    const bool was_enabled = STEPPER_ISR_ENABLED();
+    if (was_enabled) DISABLE_STEPPER_DRIVER_INTERRUPT();
+
+    // Take the directions the pins already have, so only changes are applied.
+    // Linear advance may have left E the other way, so set it explicitly.
+    stream_dir_bits = last_direction_bits;
+    if (TEST(stream_dir_bits, E_AXIS))
+      REV_E_DIR(active_extruder);
+    else
+      NORM_E_DIR(active_extruder);
+    stream_idle_bits = 0;
+    stream_underruns = 0;
+    LOOP_NUM_AXIS(i) {
+      stream_wait[i] = 0;
+      stream_left[i] = 0;
+    }
+    stream_elapsed = 0;
+    nextStreamISR = 0;
+    stream_running = true;
+
+    if (was_enabled) ENABLE_STEPPER_DRIVER_INTERRUPT();
+    wake_up();
+  }
+
+  void Stepper::stream_stop() {
+    const bool was_enabled = STEPPER_ISR_ENABLED();
+    if (was_enabled) DISABLE_STEPPER_DRIVER_INTERRUPT();
+
+    stream_running = false;
+    LOOP_NUM_AXIS(i) stream_tail[i] = stream_head[i];
+
+    // Put the direction pins back the way the planned moves expect them
+    set_directions();
+
+    if (was_enabled) ENABLE_STEPPER_DRIVER_INTERRUPT();
+  }
+
+  bool Stepper::stream_busy() {
+    // The ISR takes a chunk off the queue before it sets the steps left
+    bool busy = false;
+    CRITICAL_SECTION_START;
+    LOOP_NUM_AXIS(i) if (stream_left[i] || stream_head[i] != stream_tail[i]) { busy = true; break; }
+    CRITICAL_SECTION_END;
+    return busy;
+  }
+
+#endif // STEP_STREAM
+
+#if ENABLED(INPUT_SHAPING)
+
+  #define SHAPING_QUEUE_MASK (INPUT_SHAPING_QUEUE_SIZE - 1)
+
+  // Spacing of the steps a motor still owes after its echoes
+  #define SHAPING_STEP_TICKS ((STEPPER_TIMER_RATE) / 20000UL)
+
+  /**
+   * Timer interrupt for the echoes of the shaped axes. The pulse phase applies the
+   * first impulse of each planned step as it is traced and the block phase queues
+   * the steps of the pass with its time. Here every later impulse is added to the
+   * shaped position when its delay has run out, the steps of an entry spread over
+   * its span as they were planned, and a motor more than half a step from its
+   * shaped position takes a step. The impulses add up to a whole step, so a motor
+   * lags the plan by a few milliseconds and stops on the same step.
+   */
+  uint32_t Stepper::shaping_isr() {
+    uint32_t next = HAL_TIMER_TYPE_MAX;
+
+    for (uint8_t a = 0; a < SHAPING_AXES; a++) {
+      const uint8_t h = shaping_head[a];
+      for (uint8_t k = 0; k < shaping_echoes[a]; k++) {
+        const uint8_t factor = shaping_factor[a][k + 1];
+        int16_t &left = shaping_left[a][k];
+        uint8_t t = shaping_tail[a][k];
+        while (t != h) {
+          if (!left) {
+            const shaping_entry_t &entry = shaping_queue[a][t];
+            const int32_t wait = int32_t(entry.time + shaping_delay[a][k] - shaping_time);
+            if (wait > 0) {
+              NOMORE(next, uint32_t(wait));
+              break;
+            }
+            if (!entry.steps) {
+              t = (t + 1) & SHAPING_QUEUE_MASK;
+              continue;
+            }
+            // Space the echoed steps evenly over the span, centred in it.
+            // One division per entry, and entries are a millisecond or so apart.
+            const uint16_t n = ABS(entry.steps), every = entry.span / n;
+            left = entry.steps;
+            shaping_every[a][k] = every;
+            shaping_due[a][k] = entry.time + shaping_delay[a][k] + ((entry.span - every * (n - 1)) >> 1);
+          }
+          const int32_t wait = int32_t(shaping_due[a][k] - shaping_time);
+          if (wait > 0) {
+            NOMORE(next, uint32_t(wait));
+            break;
+          }
+          if (left > 0) {
+            shaping_error[a] += factor;
+            left--;
+          }
+          else {
+            shaping_error[a] -= factor;
+            left++;
+          }
+          shaping_due[a][k] += shaping_every[a][k];
+          if (!left) t = (t + 1) & SHAPING_QUEUE_MASK;
+        }
+        shaping_tail[a][k] = t;
+      }
+    }
+
+    uint8_t shaping_step_bits = 0;
+    hal_timer_t pulse_end = HAL_timer_get_count(PULSE_TIMER_NUM) + hal_timer_t(MIN_PULSE_TICKS);
+
+    #if HAS_X_STEP
+      SHAPING_STEP_START(X);
+    #endif
+    #if HAS_Y_STEP
+      SHAPING_STEP_START(Y);
+    #endif
+
+    if (shaping_step_bits) {
+      #if MINIMUM_STEPPER_PULSE
+        // Just wait for the requested pulse duration
+        while (HAL_timer_get_count(PULSE_TIMER_NUM) < pulse_end) { /* nada */ }
+      #else
+        UNUSED(pulse_end);
+      #endif
+
+      #if HAS_X_STEP
+        SHAPING_STEP_STOP(X);
+      #endif
+      #if HAS_Y_STEP
+        SHAPING_STEP_STOP(Y);
+      #endif
+
+      // A motor a step or more behind (the queue was full) catches up at a steady rate
+      for (uint8_t a = 0; a < SHAPING_AXES; a++)
+        if (shaping_error[a] >= (SHAPING_UNIT) / 2 || shaping_error[a] < -(SHAPING_UNIT) / 2)
+          NOMORE(next, SHAPING_STEP_TICKS);
+    }
+
+    return next;
+  }
+
+  /**
+   * Queue the steps of a pass for their echoes. Passes less than shaping_gap after the
+   * first one of the newest entry join it, so the queue holds the longest delay at any
+   * step rate, and its echoes are spread over the time of its passes. Should the queue
+   * still be full the steps join the newest entry anyway, any echo already under way
+   * being taken at once.
+   */
+  void Stepper::shaping_push(const uint8_t a) {
+    const int16_t steps = shaping_steps[a];
+    shaping_steps[a] = 0;
+
+    const uint8_t echoes = shaping_echoes[a];
+    if (!echoes) return;
+
+    const uint8_t h = shaping_head[a], next_h = (h + 1) & SHAPING_QUEUE_MASK;
+    shaping_entry_t &newest = shaping_queue[a][(h - 1) & SHAPING_QUEUE_MASK];
+    const uint32_t elapsed = shaping_time - newest.time;
+
+    if (shaping_tail[a][0] != h && elapsed < shaping_gap[a]) {
+      newest.span = elapsed;
+      newest.steps += steps;
+    }
+    else if (next_h != shaping_tail[a][echoes - 1]) {
+      shaping_entry_t &entry = shaping_queue[a][h];
+      entry.time = shaping_time;
+      entry.span = 0;
+      entry.steps = steps;
+      shaping_head[a] = next_h;
+    }
+    else {
+      newest.span = MIN(elapsed, 0xFFFFUL);
+      newest.steps += steps;
+      const uint8_t last = (h - 1) & SHAPING_QUEUE_MASK;
+      for (uint8_t k = 0; k < echoes; k++)
+        if (shaping_tail[a][k] == h || (shaping_tail[a][k] == last && shaping_left[a][k]))
+          shaping_error[a] += int32_t(steps) * shaping_factor[a][k + 1];
+    }
+
+    NOMORE(nextShapingISR, shaping_delay[a][0]);
+  }
+
+  // How many steps the motor is behind the plan, counting the echoes still to come
+  int32_t Stepper::shaping_lag(const uint8_t a) {
+    int32_t lag = shaping_error[a];
+    const uint8_t h = shaping_head[a];
+    for (uint8_t k = 0; k < shaping_echoes[a]; k++) {
+      const uint8_t factor = shaping_factor[a][k + 1];
+      uint8_t t = shaping_tail[a][k];
+      if (shaping_left[a][k]) {
+        lag += int32_t(shaping_left[a][k]) * factor;
+        t = (t + 1) & SHAPING_QUEUE_MASK;
+      }
+      for (; t != h; t = (t + 1) & SHAPING_QUEUE_MASK)
+        lag += int32_t(shaping_queue[a][t].steps) * factor;
+    }
+    return lag / (SHAPING_UNIT);
+  }
+
+  // Drop the echoes still to come, so the motors stop where they are
+  void Stepper::shaping_discard() {
+    for (uint8_t a = 0; a < SHAPING_AXES; a++) {
+      shaping_tail[a][0] = shaping_tail[a][1] = shaping_head[a];
+      shaping_left[a][0] = shaping_left[a][1] = 0;
+      shaping_error[a] = 0;
+      shaping_steps[a] = 0;
+    }
+  }
+
+  /**
+   * Work out the impulses of each axis from its shaper, frequency and damping ratio,
+   * for the damped period td = 1 / (f * sqrt(1 - zeta^2)):
+   *
+   *   ZV:  1, K          at 0, td/2                K = exp(-zeta * PI / sqrt(1 - zeta^2))
+   *   ZVD: 1, 2K, K^2    at 0, td/2, td
+   *   MZV: a, bK', aK'^2 at 0, 3td/8, 3td/4        K' = exp(-0.75 * zeta * PI / sqrt(1 - zeta^2)),
+   *                                                a = 1 - 1/sqrt(2), b = sqrt(2) - 1
+   *
+   * scaled to add up to SHAPING_UNIT. Echoes still pending are moved into the
+   * shaped positions, to be stepped out at once.
+   */
+  void Stepper::refresh_shaping() {
+    uint8_t echoes[SHAPING_AXES], factor[SHAPING_AXES][3];
+    uint32_t delay[SHAPING_AXES][2];
+    uint16_t gap[SHAPING_AXES];
+
+    for (uint8_t a = 0; a < SHAPING_AXES; a++) {
+      const float f = shaping_frequency[a], zeta = shaping_zeta[a];
+      if (f <= 0) {
+        echoes[a] = 0;
+        factor[a][0] = SHAPING_UNIT;
+        gap[a] = 0;
+        continue;
+      }
+      const float df = SQRT(1.0f - sq(zeta)), td = 1.0f / (f * df);
+      float amp[3], at[3];
+      switch (shaping_type[a]) {
+        default: {
+          const float K = exp(-zeta * M_PI / df);
+          amp[0] = 1; amp[1] = K;
+          at[1] = 0.5f * td;
+          echoes[a] = 1;
+        } break;
+        case SHAPER_ZVD: {
+          const float K = exp(-zeta * M_PI / df);
+          amp[0] = 1; amp[1] = 2 * K; amp[2] = sq(K);
+          at[1] = 0.5f * td; at[2] = td;
+          echoes[a] = 2;
+        } break;
+        case SHAPER_MZV: {
+          const float K = exp(-0.75f * zeta * M_PI / df), a1 = 1.0f - M_SQRT1_2;
+          amp[0] = a1; amp[1] = (M_SQRT2 - 1.0f) * K; amp[2] = a1 * sq(K);
+          at[1] = 0.375f * td; at[2] = 0.75f * td;
+          echoes[a] = 2;
+        } break;
+      }
+      float sum = amp[0];
+      for (uint8_t k = 1; k <= echoes[a]; k++) sum += amp[k];
+      uint8_t rest = SHAPING_UNIT;
+      for (uint8_t k = 1; k <= echoes[a]; k++) {
+        factor[a][k] = LROUND(amp[k] * (SHAPING_UNIT) / sum);
+        rest -= factor[a][k];
+        delay[a][k - 1] = LROUND(at[k] * (STEPPER_TIMER_RATE));
+      }
+      factor[a][0] = rest;
+      // Room in the queue for the longest delay, with a few entries to spare
+      gap[a] = MIN(delay[a][echoes[a] - 1] / (INPUT_SHAPING_QUEUE_SIZE - 4), 0xFFFFUL);
+    }
+
+    const bool was_enabled = STEPPER_ISR_ENABLED();
+    if (was_enabled) DISABLE_STEPPER_DRIVER_INTERRUPT();
+
+    for (uint8_t a = 0; a < SHAPING_AXES; a++) {
+      shaping_error[a] = shaping_lag(a) * (SHAPING_UNIT);
+      shaping_tail[a][0] = shaping_tail[a][1] = shaping_head[a];
+      shaping_left[a][0] = shaping_left[a][1] = 0;
+      shaping_echoes[a] = echoes[a];
+      for (uint8_t k = 0; k <= echoes[a]; k++) shaping_factor[a][k] = factor[a][k];
+      for (uint8_t k = 0; k < echoes[a]; k++) shaping_delay[a][k] = delay[a][k];
+      shaping_gap[a] = gap[a];
+    }
+    nextShapingISR = 0;
+
+    if (was_enabled) ENABLE_STEPPER_DRIVER_INTERRUPT();
+  }
+
+  bool Stepper::shaping_busy() {
+    const bool was_enabled = STEPPER_ISR_ENABLED();
+    if (was_enabled) DISABLE_STEPPER_DRIVER_INTERRUPT();
+
+    bool busy = false;
+    for (uint8_t a = 0; a < SHAPING_AXES; a++)
+      if ((shaping_echoes[a] && shaping_tail[a][shaping_echoes[a] - 1] != shaping_head[a])
+        || shaping_error[a] >= (SHAPING_UNIT) / 2 || shaping_error[a] < -(SHAPING_UNIT) / 2
+      ) busy = true;
+
+    if (was_enabled) ENABLE_STEPPER_DRIVER_INTERRUPT();
+    return busy;
+  }
+
+#endif // INPUT_SHAPING
+
+#if ENABLED(PER_AXIS_STEP_TIMING)
+
+  /**
+   * Timer interrupt for the axes of a block that take fewer steps than it has step
+   * events. The pulse phase only steps the axes moving on every event. Each of the
+   * others takes its steps here at the times its own line crosses them, worked out
+   * by timed_next(), instead of on the event the Bresenham line tracer rounds them to.
+   */
+  uint32_t Stepper::timed_isr() {
+    uint8_t step_bits = 0;
+    for (uint8_t a = 0; a < TIMED_AXES; a++)
+      if (TEST(timed_pending, a) && int32_t(timed_due[a] - timed_clock) <= 0) SBI(step_bits, a);
+
+    if (step_bits) {
+      hal_timer_t pulse_end = HAL_timer_get_count(PULSE_TIMER_NUM) + hal_timer_t(MIN_PULSE_TICKS);
+
+      #if ENABLED(HANGPRINTER)
+        #if HAS_A_STEP
+          TIMED_STEP_START(A);
+        #endif
+        #if HAS_B_STEP
+          TIMED_STEP_START(B);
+        #endif
+        #if HAS_C_STEP
+          TIMED_STEP_START(C);
+        #endif
+        #if HAS_D_STEP
+          TIMED_STEP_START(D);
+        #endif
+      #else
+        #if HAS_X_STEP
+          TIMED_STEP_START(X);
+        #endif
+        #if HAS_Y_STEP
+          TIMED_STEP_START(Y);
+        #endif
+        #if HAS_Z_STEP
+          TIMED_STEP_START(Z);
+        #endif
+      #endif
+      #if ENABLED(TIMED_E)
+        TIMED_STEP_START(E);
+      #endif
+
+      #if MINIMUM_STEPPER_PULSE
+        // Just wait for the requested pulse duration
+        while (HAL_timer_get_count(PULSE_TIMER_NUM) < pulse_end) { /* nada */ }
+      #else
+        UNUSED(pulse_end);
+      #endif
+
+      #if ENABLED(HANGPRINTER)
+        #if HAS_A_STEP
+          TIMED_STEP_STOP(A);
+        #endif
+        #if HAS_B_STEP
+          TIMED_STEP_STOP(B);
+        #endif
+        #if HAS_C_STEP
+          TIMED_STEP_STOP(C);
+        #endif
+        #if HAS_D_STEP
+          TIMED_STEP_STOP(D);
+        #endif
+      #else
+        #if HAS_X_STEP
+          TIMED_STEP_STOP(X);
+        #endif
+        #if HAS_Y_STEP
+          TIMED_STEP_STOP(Y);
+        #endif
+        #if HAS_Z_STEP
+          TIMED_STEP_STOP(Z);
+        #endif
+      #endif
+      #if ENABLED(TIMED_E)
+        TIMED_STEP_STOP(E);
+      #endif
+
+      for (uint8_t a = 0; a < TIMED_AXES; a++) if (TEST(step_bits, a)) timed_next(a);
+    }
+
+    // The nearest step of any axis
+    uint32_t next = HAL_TIMER_TYPE_MAX;
+    for (uint8_t a = 0; a < TIMED_AXES; a++)
+      if (TEST(timed_pending, a)) NOMORE(next, timed_due[a] - timed_clock);
+    return next;
+  }
+
+  // From the block phase: time the steps of the timed axes that come before the next pass
+  void Stepper::timed_pass(const uint32_t interval) {
+    timed_start = timed_clock;
+    timed_ticks = interval;
+    timed_first = step_events_completed;
+    timed_last = timed_first + MIN(step_event_count - timed_first, uint32_t(steps_per_isr));
+    timed_shift = 0;
+    while (_BV(timed_shift) < steps_per_isr) ++timed_shift;
+
+    for (uint8_t a = 0; a < TIMED_AXES; a++)
+      if (TEST(timed_axes, a) && !TEST(timed_pending, a)) timed_next(a);
+  }
+
+  /**
+   * Trace the line of a timed axis over the events of the coming pass, to its next step.
+   * The error left when the line crosses a step says how far into the event it did, so
+   * the step is timed at that point of the event, as if the pass had its events evenly
+   * spread. The fraction comes from a shift-and-subtract division to 1/256 of an event.
+   */
+  void Stepper::timed_next(const uint8_t a) {
+    while (timed_event[a] < timed_last) {
+      ++timed_event[a];
+      timed_error[a] += timed_dividend[a];
+      if (timed_error[a] >= 0) {
+        uint32_t over = timed_error[a];
+        timed_error[a] -= advance_divisor;
+        uint8_t early = 0;
+        for (uint8_t i = 8; i--;) {
+          over <<= 1;
+          early <<= 1;
+          if (over >= timed_dividend[a]) {
+            over -= timed_dividend[a];
+            early |= 1;
+          }
+        }
+        // 1/256 events into the pass, for at most 128 events and 16 bit intervals
+        const uint32_t at = ((timed_event[a] - timed_first) << 8) - early;
+        timed_due[a] = timed_start + ((timed_ticks * at) >> (8 + timed_shift));
+        SBI(timed_pending, a);
+        NOMORE(nextTimedISR, timed_due[a] - timed_clock);
+        return;
+      }
+    }
+    CBI(timed_pending, a);
+  }
+
+#endif // PER_AXIS_STEP_TIMING
+
 // Check if the given block is busy or not - Must not be called from ISR contexts
 // The current_block could change in the middle of the read by an Stepper ISR, so
 // we must explicitly prevent that!
@@ -2065,6 +3164,17 @@ void Stepper::init() {
   sei();
 
   set_directions(); // Init directions to last_direction_bits = 0
+
+  #if ENABLED(INPUT_SHAPING)
+    // The shaped motors are turned by their steps
+    #if HAS_X_DIR
+      X_APPLY_DIR(!INVERT_X_DIR, false);
+    #endif
+    #if HAS_Y_DIR
+      Y_APPLY_DIR(!INVERT_Y_DIR, false);
+    #endif
+    shaping_dir_bits = 0;
+  #endif
 }
 
 /**
@@ -2108,8 +3218,84 @@ void Stepper::_set_position(const int32_t &a, const int32_t &b, const int32_t &c
     #endif
   #endif
   count_position[E_AXIS] = e;
+
+  #if ENABLED(INPUT_SHAPING)
+    // The shaped motors are still behind the plan by their pending echoes
+    for (uint8_t a = 0; a < SHAPING_AXES; a++) count_position[a] -= shaping_lag(a);
+  #endif
 }
 
+#if ENABLED(MOTION_STATS)
+
+  void Stepper::get_stats(uint32_t &isr_ticks, uint32_t &step_events, uint16_t &starved, const bool reset/*=false*/) {
+    const bool was_enabled = STEPPER_ISR_ENABLED();
+    if (was_enabled) DISABLE_STEPPER_DRIVER_INTERRUPT();
+
+    isr_ticks = stats_isr_ticks;
+    step_events = stats_step_events;
+    starved = stats_starved;
+    if (reset) {
+      stats_isr_ticks = stats_step_events = 0;
+      stats_starved = 0;
+    }
+
+    if (was_enabled) ENABLE_STEPPER_DRIVER_INTERRUPT();
+  }
+
+  #if ENABLED(ADAPTIVE_MULTISTEPPING)
+
+    void Stepper::get_multistep_stats(uint16_t (&blocks)[8], const bool reset/*=false*/) {
+      const bool was_enabled = STEPPER_ISR_ENABLED();
+      if (was_enabled) DISABLE_STEPPER_DRIVER_INTERRUPT();
+
+      COPY(blocks, stats_multistep);
+      if (reset) ZERO(stats_multistep);
+
+      if (was_enabled) ENABLE_STEPPER_DRIVER_INTERRUPT();
+    }
+
+  #endif
+
+#endif // MOTION_STATS
+
+#if ENABLED(STEPPER_ISR_PROFILE)
+
+  void Stepper::profile_phase(const ISRPhase phase, const hal_timer_t ticks) {
+    isr_profile_t &p = profile[phase];
+    if (!p.count++ || ticks < p.min) p.min = ticks;
+    NOLESS(p.max, ticks);
+    p.total += ticks;
+    // Buckets double in width from 16 ticks, the last one takes the rest
+    uint8_t b = 0;
+    for (hal_timer_t t = ticks >> 4; t && b < ISR_PROFILE_BUCKETS - 1; t >>= 1) b++;
+    p.hist[b]++;
+  }
+
+  void Stepper::get_profile(const ISRPhase phase, isr_profile_t &copy, const bool reset/*=false*/) {
+    // The temperature ISR adds to its phase too
+    CRITICAL_SECTION_START;
+    copy = profile[phase];
+    if (reset) memset(&profile[phase], 0, sizeof(isr_profile_t));
+    CRITICAL_SECTION_END;
+  }
+
+  void Stepper::get_profile_counts(uint32_t &isrs, uint32_t &late, uint16_t &overruns, const bool reset/*=false*/) {
+    const bool was_enabled = STEPPER_ISR_ENABLED();
+    if (was_enabled) DISABLE_STEPPER_DRIVER_INTERRUPT();
+
+    isrs = profile_isrs;
+    late = profile_late;
+    overruns = profile_overruns;
+    if (reset) {
+      profile_isrs = profile_late = 0;
+      profile_overruns = 0;
+    }
+
+    if (was_enabled) ENABLE_STEPPER_DRIVER_INTERRUPT();
+  }
+
+#endif // STEPPER_ISR_PROFILE
+
 /**
  * Get a stepper's position in steps.
  */
@@ -222,6 +222,64 @@ static FORCE_INLINE uint16_t MultiU16X8toH16(uint8_t charIn1, uint16_t intIn2) {
   return intRes;
 }
 
+#if ENABLED(STEP_STREAM)
+  // A run of steps on one axis, queued by G6 S3 and played by Stepper::stream_isr()
+  typedef struct {
+    uint16_t interval;  // Timer ticks from the previous step of the axis to the first step
+    uint16_t count;     // Number of steps, 0 for a pure delay of 'interval' ticks
+    int16_t add;        // Added to the interval after each step
+    bool dir;           // Step in the negative direction
+  } stream_chunk_t;
+#endif
+
+#if ENABLED(INPUT_SHAPING)
+  // The shapers M593 T selects
+  enum ShaperType : uint8_t { SHAPER_ZV, SHAPER_ZVD, SHAPER_MZV };
+
+  #define SHAPING_AXES 2          // X and Y, or the A and B motors of Core machines
+  #define SHAPING_UNIT 128        // An impulse of one whole step
+
+  // The steps the pulse phase took on a shaped axis in passes close together, echoed by Stepper::shaping_isr()
+  typedef struct {
+    uint32_t time;      // Stepper::shaping_time of the first pass
+    uint16_t span;      // Ticks from the first pass to the last one, the echoes spread over it
+    int16_t steps;      // Signed steps of the passes
+  } shaping_entry_t;
+#endif
+
+#if ENABLED(STEPPER_ISR_PROFILE)
+  // The parts of the stepper and temperature ISRs M933 reports the time of
+  enum ISRPhase : uint8_t {
+    ISR_PHASE_LATENCY,    // From the stepper timer compare match to Stepper::isr()
+    ISR_PHASE_PULSE,
+    ISR_PHASE_BLOCK,
+    #if ENABLED(LIN_ADVANCE)
+      ISR_PHASE_ADVANCE,
+    #endif
+    #if ENABLED(STEP_STREAM)
+      ISR_PHASE_STREAM,
+    #endif
+    #if ENABLED(INPUT_SHAPING)
+      ISR_PHASE_SHAPING,
+    #endif
+    #if ENABLED(PER_AXIS_STEP_TIMING)
+      ISR_PHASE_TIMED,
+    #endif
+    ISR_PHASE_TEMPERATURE,
+    ISR_PHASES
+  };
+
+  #define ISR_PROFILE_BUCKETS 8     // Histogram buckets: under 16 ticks, doubling up to 1024 ticks and over
+
+  // Stepper timer ticks taken by one phase
+  typedef struct {
+    uint32_t count,                 // Times the phase ran
+             total;                 // Ticks taken in all
+    hal_timer_t min, max;           // Shortest and longest run
+    uint32_t hist[ISR_PROFILE_BUCKETS];
+  } isr_profile_t;
+#endif
+
 class Stepper {
 
   public:
@@ -237,6 +295,12 @@ class Stepper {
       static uint32_t motor_current_setting[3];
     #endif
 
+    #if ENABLED(INPUT_SHAPING)
+      static uint8_t shaping_type[SHAPING_AXES];      // M593 T  ShaperType of each axis
+      static float shaping_frequency[SHAPING_AXES],   // M593 F  Ringing frequency (Hz), 0 = unshaped
+                   shaping_zeta[SHAPING_AXES];        // M593 D  Damping ratio
+    #endif
+
   private:
 
     static block_t* current_block;          // A pointer to the block currently being traced
@@ -269,6 +333,21 @@ class Stepper {
       static constexpr uint8_t oversampling_factor = 0;
     #endif
 
+    #if DISABLED(DISABLE_MULTI_STEPPING)
+      static const uint32_t multistep_limit[8]; // PROGMEM stepping frequency limits for each multistepping rate
+    #endif
+
+    #if ENABLED(ADAPTIVE_MULTISTEPPING)
+      static uint32_t multistep_pass_rate;  // Fastest ISR rate the current block may run at before it multisteps
+      static uint16_t multistep_call,       // Measured 1/16 ticks of a stepper ISR call besides its step events
+                      multistep_event,      // Measured 1/16 ticks of a step event
+                      multistep_events;     // Step events done in the running stepper ISR call
+      static uint8_t multistep_shift;       // log2 of steps_per_isr
+      #if ENABLED(MOTION_STATS)
+        static uint16_t stats_multistep[8]; // Blocks run at each multiplier, 1x to 128x
+      #endif
+    #endif
+
     // Delta error variables for the Bresenham line tracer
     static int32_t delta_error[NUM_AXIS];
     static uint32_t advance_dividend[NUM_AXIS],
@@ -305,13 +384,76 @@ class Stepper {
       static uint16_t LA_current_adv_steps, LA_final_adv_steps, LA_max_adv_steps; // Copy from current executed block. Needed because current_block is set to NULL "too early".
       static int8_t LA_steps;
       static bool LA_use_advance_lead;
+      #if ENABLED(LIN_ADVANCE_SMOOTHING)
+        static uint32_t LA_lead_left;   // Time to the next lead step, kept while the E steps of the move are sent
+        static uint16_t LA_release_rate; // Lead rate of the last print move, to release its leftover lead
+      #endif
     #endif // LIN_ADVANCE
 
+    #if ENABLED(STEP_STREAM)
+      static uint32_t nextStreamISR,        // Time remaining for the next stream ISR
+                      stream_elapsed;       // Ticks since the previous stream ISR
+      static stream_chunk_t stream_queue[NUM_AXIS][STEP_STREAM_QUEUE_SIZE];
+      static volatile uint8_t stream_head[NUM_AXIS], stream_tail[NUM_AXIS];
+      static int32_t stream_wait[NUM_AXIS],       // Ticks until the next step or chunk of each axis
+                     stream_interval[NUM_AXIS];   // Current step interval of each axis
+      static int16_t stream_add[NUM_AXIS];        // Interval change per step of each axis
+      static uint16_t stream_left[NUM_AXIS];      // Steps left in the current chunk of each axis
+      static uint8_t stream_dir_bits,             // Directions of the current chunks
+                     stream_idle_bits;            // Axes that ran out of queued chunks
+      static volatile bool stream_running;
+    #endif
+
+    #if ENABLED(INPUT_SHAPING)
+      static uint32_t nextShapingISR,             // Time remaining for the next shaping ISR
+                      shaping_time;               // Timer ticks counted by the ISR scheduler
+      static shaping_entry_t shaping_queue[SHAPING_AXES][INPUT_SHAPING_QUEUE_SIZE];
+      static uint8_t shaping_head[SHAPING_AXES],
+                     shaping_tail[SHAPING_AXES][2],   // Next entry to echo, for each echo
+                     shaping_echoes[SHAPING_AXES],    // Impulses after the first one, 0 if unshaped
+                     shaping_factor[SHAPING_AXES][3], // Impulse amplitudes, adding up to SHAPING_UNIT
+                     shaping_dir_bits;                // Directions the shaped motors are set to
+      static uint32_t shaping_delay[SHAPING_AXES][2]; // Echo delays, in timer ticks
+      static uint16_t shaping_gap[SHAPING_AXES];      // Passes closer than this share a queue entry
+      static int16_t shaping_left[SHAPING_AXES][2];   // Steps of the tail entry still to echo, 0 if not started
+      static uint16_t shaping_every[SHAPING_AXES][2]; // Ticks between them
+      static uint32_t shaping_due[SHAPING_AXES][2];   // Time of the next one
+      static int32_t shaping_error[SHAPING_AXES];     // Shaped position less motor position, in SHAPING_UNITs
+      static int16_t shaping_steps[SHAPING_AXES];     // Steps of this pulse phase, to queue
+    #endif
+
+    #if ENABLED(PER_AXIS_STEP_TIMING)
+      static uint32_t nextTimedISR,               // Time remaining for the next timed step ISR
+                      timed_clock,                // Timer ticks counted by the ISR scheduler
+                      timed_start,                // timed_clock of the pass before the coming one
+                      timed_ticks,                // Ticks to the coming pass
+                      timed_first,                // Step events done before the coming pass
+                      timed_last,                 // Step events done after it
+                      timed_due[NUM_AXIS],        // timed_clock of the next step of each timed axis
+                      timed_dividend[NUM_AXIS],   // Bresenham dividends of the timed axes
+                      timed_event[NUM_AXIS];      // Step events each timed axis is traced to
+      static int32_t timed_error[NUM_AXIS];       // Bresenham errors of the timed axes
+      static uint8_t timed_shift,                 // log2 of the step events of the coming pass
+                     timed_axes,                  // Axes of the current block stepped at their own times
+                     timed_pending;               // Timed axes with a step due before the coming pass
+    #endif
+
     static int32_t ticks_nominal;
     #if DISABLED(S_CURVE_ACCELERATION)
       static uint32_t acc_step_rate; // needed for deceleration start point
     #endif
 
+    #if ENABLED(STEP_RATE_INTERPOLATION)
+      static uint32_t rate_knot_time,       // Ramp time of the next interval knot, in timer ticks
+                      rate_knot_rate,       // Step rate at the next knot
+                      rate_interval;        // Timer interval, in 1/256 ticks
+      static int32_t rate_slope;            // Timer interval change per ISR, in 1/256 ticks
+      static uint16_t rate_knot_interval;   // Timer interval at the next knot, 0 if there is none
+      static uint8_t rate_knot_loops;       // Steps per ISR at the next knot
+      static int8_t rate_knot_base;         // log2 of the ticks between knots, less log2 of the step rate
+      static bool rate_decelerating;        // The knots follow the deceleration ramp
+    #endif
+
     static volatile int32_t endstops_trigsteps[XYZ];
 
     //
@@ -324,6 +466,20 @@ class Stepper {
     //
     static int8_t count_direction[NUM_AXIS];
 
+    #if ENABLED(MOTION_STATS)
+      static uint32_t stats_isr_ticks,    // Stepper timer ticks spent inside the stepper ISR
+                      stats_step_events;  // Step events produced by the pulse phase
+      static uint16_t stats_starved;      // Times the stepper ran dry while moves were still coming
+      static uint32_t stats_dry_ms;       // When the stepper last ran out of blocks, 0 once accounted for
+    #endif
+
+    #if ENABLED(STEPPER_ISR_PROFILE)
+      static isr_profile_t profile[ISR_PHASES];
+      static uint32_t profile_isrs,       // Stepper ISRs taken
+                      profile_late;       // Stepper ISRs entered later than the scheduler's margin
+      static uint16_t profile_overruns;   // Stepper ISRs that ran out of loops and gave up on pulse timing
+    #endif
+
   public:
 
     //
@@ -350,6 +506,42 @@ class Stepper {
       static uint32_t advance_isr();
     #endif
 
+    #if ENABLED(STEP_STREAM)
+      // The step stream ISR
+      static uint32_t stream_isr();
+
+      static volatile uint16_t stream_underruns;  // Chunks that arrived after their axis ran dry
+
+      // Queue a chunk for an axis, returning false if its queue is full
+      static bool stream_push(const AxisEnum axis, const stream_chunk_t &chunk);
+
+      // Start playing the queued chunks, all axes beginning at the same time
+      static void stream_start();
+
+      // Stop playing and drop any chunks left in the queues
+      static void stream_stop();
+
+      // Whether any axis still has chunks to play
+      static bool stream_busy();
+    #endif
+
+    #if ENABLED(INPUT_SHAPING)
+      // The input shaping ISR
+      static uint32_t shaping_isr();
+
+      // Work out the impulses from the M593 settings. Echoes still pending are stepped out at once,
+      // so call planner.synchronize() first.
+      static void refresh_shaping();
+
+      // Whether the shaped motors still have echoes or steps to play
+      static bool shaping_busy();
+    #endif
+
+    #if ENABLED(PER_AXIS_STEP_TIMING)
+      // The per-axis step timing ISR
+      static uint32_t timed_isr();
+    #endif
+
     // Check if the given block is busy or not - Must not be called from ISR contexts
     static bool is_block_busy(const block_t* const block);
 
@@ -389,6 +581,34 @@ class Stepper {
     // Triggered position of an axis in steps
     static int32_t triggered_position(const AxisEnum axis);
 
+    #if ENABLED(MOTION_STATS)
+      // Get a consistent copy of the stepper counters, optionally resetting them
+      static void get_stats(uint32_t &isr_ticks, uint32_t &step_events, uint16_t &starved, const bool reset=false);
+
+      // The planner queued a block into an empty queue. If the stepper ran dry just
+      // before, it was waiting for this move: the planner didn't keep up.
+      FORCE_INLINE static void stats_block_queued() {
+        if (stats_dry_ms && PENDING(millis(), stats_dry_ms + 500)) ++stats_starved;
+        stats_dry_ms = 0;
+      }
+
+      // The queue was drained on purpose (planner.synchronize())
+      FORCE_INLINE static void stats_drained() { stats_dry_ms = 0; }
+
+      #if ENABLED(ADAPTIVE_MULTISTEPPING)
+        static void get_multistep_stats(uint16_t (&blocks)[8], const bool reset=false);
+      #endif
+    #endif
+
+    #if ENABLED(STEPPER_ISR_PROFILE)
+      // Add a run of one ISR phase, in stepper timer ticks, to its profile
+      static void profile_phase(const ISRPhase phase, const hal_timer_t ticks);
+
+      // Get a consistent copy of the profile of a phase, or of the ISR counters, optionally resetting it
+      static void get_profile(const ISRPhase phase, isr_profile_t &copy, const bool reset=false);
+      static void get_profile_counts(uint32_t &isrs, uint32_t &late, uint16_t &overruns, const bool reset=false);
+    #endif
+
     #if HAS_DIGIPOTSS || HAS_MOTOR_CURRENT_PWM
       static void digitalPotWrite(const int16_t address, const int16_t value);
       static void digipot_current(const uint8_t driver, const int16_t current);
@@ -467,6 +687,17 @@ class Stepper {
     // Set direction bits for all steppers
     static void set_directions();
 
+    #if ENABLED(INPUT_SHAPING)
+      static void shaping_push(const uint8_t axis);
+      static int32_t shaping_lag(const uint8_t axis);
+      static void shaping_discard();
+    #endif
+
+    #if ENABLED(PER_AXIS_STEP_TIMING)
+      static void timed_pass(const uint32_t interval);
+      static void timed_next(const uint8_t axis);
+    #endif
+
     // Allow reset_stepper_drivers to access private set_directions
     friend void reset_stepper_drivers();
 
@@ -477,23 +708,21 @@ class Stepper {
       step_rate <<= scale;
 
       uint8_t multistep = 1;
-      #if DISABLED(DISABLE_MULTI_STEPPING)
-
-        // The stepping frequency limits for each multistepping rate
-        static const uint32_t limit[] PROGMEM = {
-          (  MAX_STEP_ISR_FREQUENCY_1X     ),
-          (  MAX_STEP_ISR_FREQUENCY_2X >> 1),
-          (  MAX_STEP_ISR_FREQUENCY_4X >> 2),
-          (  MAX_STEP_ISR_FREQUENCY_8X >> 3),
-          ( MAX_STEP_ISR_FREQUENCY_16X >> 4),
-          ( MAX_STEP_ISR_FREQUENCY_32X >> 5),
-          ( MAX_STEP_ISR_FREQUENCY_64X >> 6),
-          (MAX_STEP_ISR_FREQUENCY_128X >> 7)
-        };
+      #if ENABLED(ADAPTIVE_MULTISTEPPING)
+
+        // Step as many events per ISR as the current block needs to stay within the ISR load target
+        multistep_shift = 0;
+        while (multistep_shift < 7 && step_rate > multistep_pass_rate) {
+          step_rate >>= 1;
+          ++multistep_shift;
+        }
+        multistep = _BV(multistep_shift);
+
+      #elif DISABLED(DISABLE_MULTI_STEPPING)
 
         // Select the proper multistepping
         uint8_t idx = 0;
-        while (idx < 7 && step_rate > (uint32_t)pgm_read_dword(&limit[idx])) {
+        while (idx < 7 && step_rate > (uint32_t)pgm_read_dword(&multistep_limit[idx])) {
           step_rate >>= 1;
           multistep <<= 1;
           ++idx;
@@ -525,6 +754,21 @@ class Stepper {
       return timer;
     }
 
+    #if ENABLED(STEP_RATE_INTERPOLATION)
+
+      static uint32_t ramp_rate(const uint32_t time, const bool decel);
+      static void next_rate_segment(const uint32_t time, const bool decel);
+
+      // The timer interval of the next ISR, interpolated between the knots of the ramp
+      FORCE_INLINE static uint32_t rate_ramp_interval(const uint32_t time, const bool decel) {
+        if (time >= rate_knot_time) next_rate_segment(time, decel);
+        const uint32_t interval = rate_interval >> 8;
+        rate_interval += rate_slope;
+        return interval;
+      }
+
+    #endif
+
     #if ENABLED(S_CURVE_ACCELERATION)
       static void _calc_bezier_curve_coeffs(const int32_t v0, const int32_t v1, const uint32_t av);
       static int32_t _eval_bezier_curve(const uint32_t curr_step);
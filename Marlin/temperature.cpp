@@ -38,7 +38,7 @@
   #include "MarlinSPI.h"
 #endif
 
-#if ENABLED(BABYSTEPPING)
+#if ENABLED(BABYSTEPPING) || ENABLED(STEPPER_ISR_PROFILE)
   #include "stepper.h"
 #endif
 
@@ -1842,8 +1842,27 @@ void Temperature::readings_ready() {
 HAL_TEMP_TIMER_ISR {
   HAL_timer_isr_prologue(TEMP_TIMER_NUM);
 
+  #if ENABLED(STEPPER_ISR_PROFILE)
+    // The temperature timer wraps every 256 ticks, at the ISR rate, so this is good for one run
+    const uint8_t profile_start = HAL_timer_get_count(TEMP_TIMER_NUM);
+  #endif
+
+  #if ENABLED(SERIAL_DEFERRED_TX)
+    ++serial_isr_depth; // Errors print from here, with interrupts enabled
+  #endif
+
   Temperature::isr();
 
+  #if ENABLED(SERIAL_DEFERRED_TX)
+    --serial_isr_depth;
+  #endif
+
+  #if ENABLED(STEPPER_ISR_PROFILE)
+    // Profiled in stepper timer ticks like the stepper ISR phases
+    const uint8_t profile_ticks = HAL_timer_get_count(TEMP_TIMER_NUM) - profile_start;
+    stepper.profile_phase(ISR_PHASE_TEMPERATURE, profile_ticks * hal_timer_t((STEPPER_TIMER_RATE) / ((TEMP_TIMER_FREQUENCY) * 256)));
+  #endif
+
   HAL_timer_isr_epilogue(TEMP_TIMER_NUM);
 }
 
@@ -27,7 +27,7 @@
 
 void safe_delay(millis_t ms);
 
-#if ENABLED(EEPROM_SETTINGS)
+#if ENABLED(EEPROM_SETTINGS) || ENABLED(BINARY_GCODE) || ENABLED(BINARY_TELEMETRY)
   void crc16(uint16_t *crc, const void * const data, uint16_t cnt);
 #endif
 
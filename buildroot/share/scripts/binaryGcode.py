@@ -0,0 +1,374 @@
+#!/usr/bin/env python
+
+""" Encode G-code into the frames of the BINARY_GCODE transport (M940 S1).
+
+Each command becomes a letter, a 16-bit code number and typed parameters, and
+the commands are packed into CRC-16 checked frames of up to --frame-size bytes.
+Without an input file a curved path of short segments is generated.
+
+The frames are fed byte by byte through a mirror of get_binary_commands(), with
+random corruption of the link if --error-rate is given, and the commands that
+come out are compared with the input. Then the link time of the file is
+estimated for text lines with line numbers and checksums, acknowledged one at
+a time or with BUFSIZE lines in flight, and for binary frames. With --port the
+file is sent to a printer, which needs pyserial. A command the printer rejects
+is reported and skipped, and the rest of its frame is sent again.
+"""
+
+from __future__ import print_function, division
+
+import argparse
+import binascii
+import math
+import random
+import struct
+import sys
+
+parser = argparse.ArgumentParser(description=__doc__)
+parser.add_argument('gcode', nargs='?', help='G-code file (default: a curved path)')
+parser.add_argument('-o', '--output', help='Write the frames to this file')
+parser.add_argument('-f', '--frame-size', type=int, default=64, help='BINARY_FRAME_SIZE (default=64)')
+parser.add_argument('-b', '--baud', type=int, default=250000, help='Serial baud rate (default=250000)')
+parser.add_argument('-l', '--latency', type=float, default=1.0, help='Host turnaround per reply in ms (default=1)')
+parser.add_argument('-e', '--error-rate', type=float, default=0, help='Probability of a corrupted byte (default=0)')
+parser.add_argument('-n', '--segments', type=int, default=5000, help='Segments of the generated path (default=5000)')
+parser.add_argument('--port', help='Send the file to the printer on this serial port')
+parser.add_argument('--seed', type=int, default=1, help='Random seed (default=1)')
+args = parser.parse_args()
+
+SYNC = 0xB5
+MAX_CMD_SIZE = 96
+BUFSIZE = 4
+RX_BUFFER_SIZE = 128
+STRING_ARGS = set(['M23', 'M28', 'M30', 'M32', 'M33', 'M117', 'M118', 'M928'])
+# Parameter types, with (type, bytes, decimals, smallest, largest) for the numbers
+NONE, RAW = 0, 7
+NUMBERS = [(1, 1, 0, -0x80, 0x7F), (2, 2, 0, -0x8000, 0x7FFF),
+           (3, 3, 3, -0x800000, 0x7FFFFF), (4, 4, 5, -0x80000000, 0x7FFFFFFF)]
+
+def curved_path():
+  random.seed(args.seed)
+  lines, x, y, e, heading = ['G28', 'M83', 'G1 Z0.2 F3000'], 100.0, 100.0, 0.0, 0.0
+  radius = 20.0
+  for i in range(args.segments):
+    if i % 50 == 0:
+      radius = random.uniform(5, 60) * random.choice((-1, 1))
+    heading += 0.4 / radius
+    x += 0.4 * math.cos(heading)
+    y += 0.4 * math.sin(heading)
+    lines.append('G1 X%.3f Y%.3f E%.5f' % (x, y, 0.4 * 0.033))
+  return lines
+
+def clean(line):
+  """ The command as get_serial_commands() queues it, without line number and checksum """
+  line = line.split(';')[0].strip()
+  if line.startswith('N'):
+    line = line.split(None, 1)[1] if ' ' in line else ''
+  return line.split('*')[0].strip()
+
+def encode_value(value):
+  """ Return (type, bytes) for a parameter value, or None if only text keeps it exact """
+  if not value:
+    return NONE, b''
+  try:
+    v = float(value)
+  except ValueError:
+    return None
+  decimals = len(value.split('.')[1]) if '.' in value else 0
+  for kind, size, places, low, high in NUMBERS:
+    if decimals <= places:
+      n = int(round(v * 10 ** places))
+      if low <= n <= high and abs(n - v * 10 ** places) < 1e-6 * 10 ** places:
+        return kind, struct.pack('<i', n)[:size]
+  return None
+
+def encode(command):
+  """ Encode one command, or raise ValueError """
+  words = command.split(None, 1)
+  head, rest = words[0].upper(), words[1] if len(words) > 1 else ''
+  if head[0] not in 'GMT' or not head[1:].isdigit() or int(head[1:]) > 0xFFFF:
+    raise ValueError('cannot encode "%s"' % command)
+  out = struct.pack('<cH', head[0].encode(), int(head[1:]))
+  if head in STRING_ARGS:
+    params = [rest] if rest else []
+  else:
+    params = rest.split()
+  for word in params:
+    encoded = None if head in STRING_ARGS else encode_value(word[1:])
+    if encoded is not None and word[0].isalpha():
+      kind, data = encoded
+      out += struct.pack('<B', kind << 5 | (ord(word[0].upper()) - ord('A'))) + data
+    else:
+      text = word.encode()
+      out += struct.pack('<BB', RAW << 5, len(text)) + text
+  if decode_command(struct.pack('<B', len(out)) + out)[0] is None:
+    raise ValueError('"%s" is too long' % command)
+  return struct.pack('<B', len(out)) + out
+
+def decode_command(p):
+  """ Mirror of decode_binary_command(), returns (text, bytes used) or (None, 0) if malformed """
+  p = bytearray(p)
+  length = p[0]
+  if length < 3 or length >= len(p):
+    return None, 0
+  p = p[:length + 1]
+  text = '%c%d' % (p[1], p[2] | p[3] << 8)
+  i = 4
+  while i < len(p):
+    tag = p[i]
+    i += 1
+    kind = tag >> 5
+    if kind == RAW:
+      if i >= len(p) or i + 1 + p[i] > len(p):
+        return None, 0
+      text += ' ' + p[i + 1:i + 1 + p[i]].decode(errors='replace')
+      i += 1 + p[i]
+      continue
+    text += ' %c' % (ord('A') + (tag & 0x1F))
+    if kind == NONE:
+      continue
+    if kind > len(NUMBERS):
+      return None, 0
+    _, size, places, _, _ = NUMBERS[kind - 1]
+    if i + size > len(p):
+      return None, 0
+    n = struct.unpack('<i', bytes(p[i:i + size] + (b'\xff' if p[i + size - 1] & 0x80 else b'\x00') * (4 - size)))[0]
+    i += size
+    sign = '-' if n < 0 else ''
+    digits = str(abs(n)).rjust(places + 1, '0')
+    text += sign + (digits[:-places] + '.' + digits[-places:] if places else digits)
+  if len(text) >= MAX_CMD_SIZE:
+    return None, 0
+  return text, length + 1
+
+def window():
+  """ Frames in flight: one being queued and the rest waiting in the RX buffer """
+  return 1 + RX_BUFFER_SIZE // (args.frame_size + 5)
+
+def frame(seq, payload):
+  body = struct.pack('<BB', seq & 0xFF, len(payload)) + payload
+  return struct.pack('<B', SYNC) + body + struct.pack('<H', binascii.crc_hqx(body, 0))
+
+def frames(encoded):
+  """ Pack the encoded commands into frame payloads """
+  out, payload = [], b''
+  for cmd in encoded:
+    if len(cmd) > args.frame_size:
+      sys.exit('A command does not fit in a %d byte frame' % args.frame_size)
+    if len(payload) + len(cmd) > args.frame_size:
+      out.append(payload)
+      payload = b''
+    payload += cmd
+  if payload:
+    out.append(payload)
+  return out
+
+class Firmware(object):
+  """ Mirror of get_binary_commands(), with the queue always free """
+  def __init__(self):
+    self.frame, self.count, self.seq, self.resend_sent = bytearray(), 0, 0, False
+    self.commands, self.replies = [], []
+
+  def read(self, c):
+    if not self.count:
+      if c == SYNC:
+        self.count = 1
+      return
+    self.frame.append(c)
+    self.count += 1
+    if self.count == 3 and self.frame[1] > args.frame_size:
+      self.count, self.frame = 0, bytearray()
+    if self.count < 5 or self.count < self.frame[1] + 5:
+      return
+    f, length = self.frame, self.frame[1]
+    self.count, self.frame = 0, bytearray()
+    if binascii.crc_hqx(bytes(f[:length + 2]), 0) == f[length + 2] | f[length + 3] << 8:
+      if f[0] == self.seq:
+        pos, queued = 2, 0
+        while pos < length + 2:
+          text, used = decode_command(bytes(f[pos:length + 2]))
+          if not used:
+            self.replies.append(('error', f[0], queued))
+            self.resend_sent = True
+            return
+          self.commands.append(text)
+          pos += used
+          queued += 1
+        self.seq = (self.seq + 1) & 0xFF
+        self.resend_sent = False
+        self.replies.append(('ok', f[0], None))
+        return
+      if (f[0] + 1) & 0xFF == self.seq:
+        self.replies.append(('ok', f[0], None))
+        return
+    if not self.resend_sent:
+      self.replies.append(('resend', self.seq, None))
+      self.resend_sent = True
+
+def split_payload(payload):
+  """ The encoded commands of a frame payload """
+  out, p = [], bytearray(payload)
+  while p:
+    out.append(bytes(p[:p[0] + 1]))
+    p = p[p[0] + 1:]
+  return out
+
+def rejected(payloads, base, queued):
+  """ Skip the command the printer rejected and send the rest of the frame under its number """
+  cmds = split_payload(payloads[base])
+  print('Frame %d: command %d was rejected (%s), %d commands were queued' % (
+    base, queued + 1, binascii.hexlify(cmds[queued]).decode() if queued < len(cmds) else '?', queued))
+  rest = b''.join(cmds[queued + 1:])
+  if rest:
+    payloads[base] = rest
+  else:
+    del payloads[base]
+
+def loopback(payloads):
+  """ Send the frames through a corrupting link into the firmware mirror, going back on resends """
+  payloads = list(payloads)
+  fw = Firmware()
+  base, nxt, sent_bytes, resends = 0, 0, 0, 0
+  while base < len(payloads):
+    # Keep the window full, then deliver the replies of what was sent
+    while nxt < len(payloads) and nxt - base < window():
+      for c in bytearray(frame(nxt, payloads[nxt])):
+        if random.random() < args.error_rate:
+          c ^= 1 << random.randint(0, 7)
+        fw.read(c)
+        sent_bytes += 1
+      nxt += 1
+    replies, fw.replies = fw.replies, []
+    if not replies:
+      # Everything in flight was lost, so time out and go back
+      nxt = base
+      resends += 1
+    for kind, seq, queued in replies:
+      if kind == 'ok' and seq == base & 0xFF:
+        base += 1
+      elif kind == 'resend' and seq == base & 0xFF:
+        nxt = base
+        resends += 1
+      elif kind == 'error' and seq == base & 0xFF:
+        rejected(payloads, base, queued)
+        nxt = base
+    nxt = max(nxt, base)
+  return fw.commands, sent_bytes, resends
+
+def same(a, b):
+  """ Whether two commands have the same letters and values """
+  wa, wb = a.split(), b.split()
+  if len(wa) != len(wb):
+    return False
+  for x, y in zip(wa, wb):
+    if x[0].upper() != y[0].upper():
+      return False
+    try:
+      if abs(float(x[1:] or 0) - float(y[1:] or 0)) > 1e-9:
+        return False
+    except ValueError:
+      if x != y:
+        return False
+  return True
+
+def link_time(sizes, ack_bytes, max_msgs, max_bytes):
+  """ Seconds to move messages over the serial link with the given flow control """
+  byte_time = 10.0 / args.baud
+  t, line_free, reply_free, flight = 0.0, 0.0, 0.0, []
+  for size in sizes:
+    while flight and (len(flight) >= max_msgs or sum(s for _, s in flight) + size > max_bytes):
+      t = max(t, flight.pop(0)[0])
+    line_free = max(line_free, t) + size * byte_time
+    reply_free = max(reply_free, line_free) + ack_bytes * byte_time
+    flight.append((reply_free + args.latency / 1000, size))
+  return max(a for a, _ in flight) if flight else 0.0
+
+def text_line(n, command):
+  line = 'N%d %s' % (n, command)
+  checksum = 0
+  for c in bytearray(line.encode()):
+    checksum ^= c
+  return '%s*%d\n' % (line, checksum)
+
+def send(payloads):
+  import serial
+  port = serial.Serial(args.port, args.baud, timeout=10)
+
+  def reply():
+    while True:
+      line = port.readline().decode(errors='replace').strip()
+      if not line:
+        sys.exit('No reply from the printer')
+      if line.startswith(('ok', 'Resend:', 'Error:Bad binary command')):
+        return line
+      print(line)
+
+  port.write(b'M115\n')
+  caps = []
+  while True:
+    line = port.readline().decode(errors='replace').strip()
+    if not line or line.startswith('ok'):
+      break
+    caps.append(line)
+  if 'Cap:BINARY_GCODE:1' not in caps:
+    sys.exit('The printer does not support BINARY_GCODE')
+  port.write(b'M940 S1\n')
+  reply()
+
+  payloads = payloads + [b'']
+  base = nxt = 0
+  while base < len(payloads):
+    while nxt < len(payloads) and nxt - base < window():
+      port.write(frame(nxt, payloads[nxt]))
+      nxt += 1
+    words = reply().split()
+    if words[-1][0] == 'Q':
+      # "Error:Bad binary command F<seq> Q<queued>"
+      if int(words[-2][1:]) == base & 0xFF:
+        rejected(payloads, base, int(words[-1][1:]))
+        nxt = base
+      continue
+    seq = int(words[-1][1:])
+    if words[0] == 'ok' and seq == base & 0xFF:
+      base += 1
+    elif words[0] == 'Resend:' and seq == base & 0xFF:
+      nxt = base
+
+random.seed(args.seed)
+if args.gcode:
+  with open(args.gcode) as f:
+    lines = f.read().splitlines()
+else:
+  lines = curved_path()
+commands = [c for c in (clean(l) for l in lines) if c]
+try:
+  encoded = [encode(c) for c in commands]
+except ValueError as err:
+  sys.exit(str(err))
+payloads = frames(encoded)
+data = b''.join(frame(i, p) for i, p in enumerate(payloads))
+
+decoded, sent_bytes, resends = loopback(payloads)
+bad = sum(1 for a, b in zip(commands, decoded) if not same(a, b)) + abs(len(commands) - len(decoded))
+print('%d commands in %d frames, %.1f bytes per command. Loopback: %d mismatches, %d resends, %d bytes sent' % (
+  len(commands), len(payloads), len(data) / max(len(commands), 1), bad, resends, sent_bytes))
+
+text = [len(text_line(i + 1, c)) for i, c in enumerate(commands)]
+frame_sizes = [len(p) + 5 for p in payloads]
+print('%d baud, %.1fms reply latency:' % (args.baud, args.latency))
+for name, sizes, ack, msgs, limit in (
+    ('text, one line at a time', text, 3, 1, RX_BUFFER_SIZE),
+    ('text, %d lines in flight' % BUFSIZE, text, 3, BUFSIZE, RX_BUFFER_SIZE),
+    ('binary frames', frame_sizes, 7, window(), RX_BUFFER_SIZE + args.frame_size + 5)):
+  seconds = link_time(sizes, ack, msgs, limit)
+  print('  %-26s %7d bytes %8.0f commands/s' % (name, sum(sizes), len(commands) / seconds if seconds else 0))
+
+if args.output:
+  with open(args.output, 'wb') as f:
+    f.write(data)
+
+if args.port:
+  send(payloads)
+
+if bad:
+  sys.exit(1)
@@ -0,0 +1,190 @@
+#!/usr/bin/env python
+
+""" Compare G-code dispatch through the sorted table with the switch it replaced.
+
+Reads the entries of the dispatch table from Marlin_main.cpp, ignoring their
+#if guards. The switch had a case for each of them. It is modeled the way
+avr-gcc lowers a switch at -Os, into jump tables for dense runs of cases
+and a balanced compare tree over the rest, and its handlers checked Running
+themselves where G0/G1 did. The table path follows gcode_lookup(), which indexes
+G0-G99 and M0-M299 directly and binary searches the rest, then the flag tests
+of process_parsed_command(). Each command of a G-code file
+(without one, a generated slicer-like print) is timed in estimated AVR cycles
+for the dispatch alone and with GCodeParser::parse() in front of it, and the
+commands per second of a 16MHz AVR are printed for both paths.
+"""
+
+from __future__ import print_function, division
+
+import argparse
+import os
+import random
+import re
+
+parser = argparse.ArgumentParser(description=__doc__)
+parser.add_argument('gcode', nargs='?', help='G-code file (default: a generated print)')
+parser.add_argument('-n', '--layers', type=int, default=200, help='Layers of the generated print (default=200)')
+parser.add_argument('--source', default=os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', '..', 'Marlin', 'Marlin_main.cpp'),
+                    help='Path of Marlin_main.cpp')
+parser.add_argument('--seed', type=int, default=1, help='Random seed (default=1)')
+args = parser.parse_args()
+
+F_CPU = 16000000
+
+# Rough AVR cycle costs
+CYCLES = {
+  'compare': 5,         # cpi/cpc/ldi on a 16-bit code and a branch
+  'jump_table': 24,     # Range check and __tablejump2__
+  'call': 10,           # call/ret of a handler
+  'letter': 4,          # Test of the command letter
+  'running': 4,         # lds and test of Running
+  'keepalive': 2,       # sts of busy_state
+  'dense_index': 16,    # Range check, lpm of the index byte, entry address
+  'search_step': 26,    # One pass of gcode_lookup(): midpoint, lpm word, compare
+  'search_setup': 16,   # Range check and key of gcode_lookup()
+  'fetch': 9,           # lpm of the handler and flags
+  'icall': 10,          # movw and eicall/ret
+  'flag_test': 2,       # sbrc/sbrs on one flag
+  'parse_command': 90,  # reset(), N skip, letter and code number
+  'parse_char': 14      # Each character of the arguments
+}
+
+# avr-gcc TARGET_CASE_VALUES_THRESHOLD with JMP/CALL, and the -Os growth ratio
+JUMP_TABLE_MIN_CASES, JUMP_TABLE_MAX_RATIO = 17, 3
+
+def read_source():
+  src = open(args.source).read()
+  table = src[src.index('gcode_table[] PROGMEM'):src.index('#undef G_ENTRY')]
+  flags = {}
+  for l, n, f in re.findall(r'([GM])_ENTRY\((\d+),\s*\w+,\s*([^)]*)\)', table):
+    flags[(0x8000 if l == 'M' else 0) | int(n)] = set(re.findall(r'GCODE_(\w+)', f))
+  entries = sorted(flags)
+  cases = {'G': [k for k in entries if k < 0x8000],
+           'M': [k & 0x7FFF for k in entries if k >= 0x8000]}
+  return cases, entries, flags
+
+def clusters(values):
+  """ Minimal clustering into jump tables and single cases, as in gcc's find_jump_tables() """
+  n = len(values)
+  best = [(0, [])] + [None] * n
+  for i in range(1, n + 1):
+    for j in range(i):
+      count, span = i - j, values[i - 1] - values[j] + 1
+      if count == 1 or (count >= JUMP_TABLE_MIN_CASES and span <= JUMP_TABLE_MAX_RATIO * count):
+        cand = (best[j][0] + 1, best[j][1] + [values[j:i]])
+        if best[i] is None or cand[0] < best[i][0]:
+          best[i] = cand
+  return best[n][1]
+
+def tree_costs(groups):
+  """ Cycles to reach each case value through a balanced compare tree over the clusters """
+  costs = {}
+  def walk(lo, hi, depth):
+    if lo >= hi:
+      return
+    mid = (lo + hi) // 2
+    group = groups[mid]
+    # Equality test of a single case, or the range test of a jump table
+    here = (depth + 1) * CYCLES['compare'] + (CYCLES['jump_table'] if len(group) > 1 else 0)
+    for v in group:
+      costs[v] = here
+    walk(lo, mid, depth + 1)
+    walk(mid + 1, hi, depth + 1)
+  walk(0, len(groups), 0)
+  return costs, 2 * len(groups).bit_length() * CYCLES['compare']
+
+def lookup_cost(entries, key):
+  """ Cycles of gcode_lookup() """
+  if (key & 0x7FFF) < (300 if key & 0x8000 else 100):
+    return CYCLES['dense_index']
+  lo, hi, steps = 0, len(entries), 0
+  while lo < hi:
+    mid = (lo + hi) >> 1
+    steps += 1
+    if entries[mid] == key:
+      break
+    if entries[mid] < key:
+      lo = mid + 1
+    else:
+      hi = mid
+  return CYCLES['search_setup'] + steps * CYCLES['search_step']
+
+def table_cost(entries, flags, key):
+  """ Cycles of the table path of process_parsed_command() after the letter test """
+  f = flags.get(key, set())
+  cycles = lookup_cost(entries, key) + CYCLES['fetch'] + CYCLES['icall'] + 4 * CYCLES['flag_test']
+  if 'MOVES' in f:
+    cycles += CYCLES['running']
+  if 'SAFE' not in f:
+    cycles += CYCLES['keepalive']
+  return cycles
+
+def generated_print():
+  """ A slicer-like file: start code, then layers of short extrusions, travels and retractions """
+  random.seed(args.seed)
+  lines = ['M140 S60', 'M104 S210', 'M190 S60', 'M109 S210', 'M82', 'G28', 'G92 E0', 'M107', 'T0']
+  x, y, e = 100.0, 100.0, 0.0
+  for layer in range(args.layers):
+    lines.append('G1 Z%.2f F600' % (0.2 + 0.2 * layer))
+    lines.append('M73 P%d' % (100 * layer // args.layers))
+    if layer == 1:
+      lines.append('M106 S255')
+    lines.append('G92 E0')
+    e = 0.0
+    for _ in range(random.randint(3, 8)):
+      lines.append('G1 E%.5f F2400' % (e - 0.8))
+      lines.append('G0 F9000 X%.3f Y%.3f' % (random.uniform(20, 180), random.uniform(20, 180)))
+      lines.append('G1 E%.5f F2400' % e)
+      lines.append('M204 S%d' % random.choice((500, 1000)))
+      lines.append('M205 X%d Y%d' % ((10, 10) if random.random() < 0.5 else (8, 8)))
+      lines.append('G1 F%d' % random.choice((1800, 2700, 3600)))
+      for _ in range(random.randint(20, 120)):
+        x += random.uniform(-2, 2)
+        y += random.uniform(-2, 2)
+        e += random.uniform(0.01, 0.1)
+        lines.append('G1 X%.3f Y%.3f E%.5f' % (x, y, e))
+  lines += ['M104 S0', 'M140 S0', 'M107', 'G28 X0', 'M84']
+  return lines
+
+def commands(lines):
+  for line in lines:
+    line = line.split(';', 1)[0].strip()
+    match = re.match(r'(?:N\d+\s*)?([GMT])(\d+)', line)
+    if match:
+      yield match.group(1), int(match.group(2)), len(line) - match.end()
+
+cases, entries, flags = read_source()
+switch_costs = {}
+for letter in 'GM':
+  costs, miss = tree_costs(clusters(cases[letter]))
+  switch_costs[letter] = (costs, miss)
+
+lines = open(args.gcode).read().splitlines() if args.gcode else generated_print()
+totals = {'switch': 0, 'table': 0, 'parse': 0}
+count, mix = 0, {}
+for letter, code, arg_chars in commands(lines):
+  count += 1
+  mix[letter + str(code)] = mix.get(letter + str(code), 0) + 1
+  totals['parse'] += CYCLES['parse_command'] + CYCLES['parse_char'] * arg_chars
+  # Both paths test G, M and T in that order, and call the handler
+  letters = CYCLES['letter'] * ('GMT'.index(letter) + 1)
+  if letter == 'T':
+    totals['switch'] += letters + CYCLES['keepalive'] + CYCLES['call']
+    totals['table'] += letters + CYCLES['keepalive'] + CYCLES['fetch'] + CYCLES['icall'] + 4 * CYCLES['flag_test']
+    continue
+  costs, miss = switch_costs[letter]
+  key = (0x8000 if letter == 'M' else 0) | code
+  totals['switch'] += letters + costs.get(code, miss) + CYCLES['keepalive'] + CYCLES['call']
+  if letter == 'G' and code < 2:
+    totals['switch'] += CYCLES['running']
+  totals['table'] += letters + table_cost(entries, flags, key)
+
+top = sorted(mix.items(), key=lambda kv: -kv[1])[:6]
+print('%d commands, %s' % (count, ', '.join('%s %.1f%%' % (k, 100.0 * v / count) for k, v in top)))
+print('switch: %d G and %d M cases in %d + %d clusters; table: %d entries and index, %d bytes of PROGMEM' % (
+  len(cases['G']), len(cases['M']), len(clusters(cases['G'])), len(clusters(cases['M'])), len(entries) + 1, 5 * (len(entries) + 1) + 400))
+for name in ('switch', 'table'):
+  dispatch = totals[name] / count
+  full = (totals[name] + totals['parse']) / count
+  print('%-6s %6.1f cycles/dispatch %8d dispatches/s   with parse() %6.1f cycles %7d commands/s' % (
+    name, dispatch, F_CPU / dispatch, full, F_CPU / full))
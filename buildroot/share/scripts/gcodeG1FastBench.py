@@ -0,0 +1,248 @@
+#!/usr/bin/env python
+
+""" Time GCodeParser::parse() with and without GCODE_G1_FAST_PATH on the host.
+
+Copies parser.h and parser.cpp (with the macros.h, enum.h and types.h they
+need) next to stub Marlin headers, and builds them twice with the host C++
+compiler: once with FASTER_GCODE_PARSER alone and once with GCODE_G1_FAST_PATH
+too. Each build parses every line of a G-code file (without one, a generated
+slicer-like print) and gets the move values the way gcode_get_destination()
+does, and the parse ns per line of both builds are printed.
+
+The values and parameter flags of both builds are compared for each line of the
+print and for a list of unusual lines the fast path must hand to parse(), so a
+value off by more than a float rounding or a line parsed differently is reported.
+Times are for the host, and only their ratio says much about an AVR.
+"""
+
+from __future__ import print_function, division
+
+import argparse
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+
+parser = argparse.ArgumentParser(description=__doc__)
+parser.add_argument('gcode', nargs='?', help='G-code file (default: a generated print)')
+parser.add_argument('-n', '--layers', type=int, default=100, help='Layers of the generated print (default=100)')
+parser.add_argument('--numbered', action='store_true', help='Add line numbers and checksums, as a host sends them')
+parser.add_argument('--repeat', type=int, default=20, help='Times to parse all lines (default=20)')
+parser.add_argument('--cxx', default=os.environ.get('CXX', 'c++'), help='Host C++ compiler (default=$CXX or c++)')
+parser.add_argument('--marlin', default=os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', '..', 'Marlin'),
+                    help='Path of the Marlin sources')
+parser.add_argument('--seed', type=int, default=1, help='Random seed (default=1)')
+args = parser.parse_args()
+
+MAX_CMD_SIZE = 96
+
+STUB_CONFIG = r'''
+#ifndef MARLINCONFIG_H
+#define MARLINCONFIG_H
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "macros.h"
+#define FASTER_GCODE_PARSER
+#define PROGMEM
+#define pgm_read_float(p) (*(const float*)(p))
+#define PSTR(s) (s)
+#define constrain(v, lo, hi) ((v) < (lo) ? (lo) : (v) > (hi) ? (hi) : (v))
+#endif
+'''
+
+STUB_LANGUAGE = r'''
+#define MSG_UNKNOWN_COMMAND "Unknown command: \""
+#define SERIAL_ECHO_START() do{}while(0)
+#define SERIAL_ECHOPAIR(a, b) do{}while(0)
+#define SERIAL_CHAR(c) do{}while(0)
+#define SERIAL_EOL() do{}while(0)
+'''
+
+HARNESS = r'''
+#include "parser.h"
+#include <stdio.h>
+#include <time.h>
+
+static const char axis_codes[XYZE] = { 'X', 'Y', 'Z', 'E' };
+static float destination[XYZE + 1];
+static char lines[%(max_lines)d][%(max_cmd)d];
+
+// As gcode_get_destination() does, from a current position of 0
+static void get_destination() {
+  LOOP_XYZE(i) {
+    if (parser.seen(axis_codes[i])) {
+      const float v =
+        #if ENABLED(GCODE_G1_FAST_PATH)
+          parser.fast_move ? parser.move_value[i] :
+        #endif
+        parser.value_axis_units((AxisEnum)i);
+      destination[i] = v;
+    }
+    else
+      destination[i] = 0;
+  }
+  destination[XYZE] =
+    #if ENABLED(GCODE_G1_FAST_PATH)
+      parser.fast_move ? parser.move_value[XYZE] :
+    #endif
+    parser.linearval('F');
+}
+
+static double now_ns() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+  const int repeat = atoi(argv[1]);
+  int count = 0;
+  while (count < %(max_lines)d && fgets(lines[count], %(max_cmd)d, stdin)) {
+    char *nl = strchr(lines[count], '\n');
+    if (nl) *nl = '\0';
+    count++;
+  }
+  char buf[%(max_cmd)d];
+  if (repeat == 0) {
+    // One line of results per command: letter, code, flags, fast, values
+    for (int l = 0; l < count; l++) {
+      strcpy(buf, lines[l]);
+      parser.parse(buf);
+      get_destination();
+      uint32_t bits = 0;
+      for (char c = 'A'; c <= 'Z'; c++) if (parser.seen(c)) bits |= 1UL << (c - 'A');
+      int fast = 0;
+      #if ENABLED(GCODE_G1_FAST_PATH)
+        fast = parser.fast_move;
+      #endif
+      printf("%%c %%d %%lx %%d %%.9g %%.9g %%.9g %%.9g %%.9g\n", parser.command_letter, parser.codenum,
+        (unsigned long)bits, fast, destination[0], destination[1], destination[2], destination[3], destination[4]);
+    }
+    return 0;
+  }
+  // The copy alone, to take out of the parse time
+  volatile char sink = 0;
+  double t0 = now_ns();
+  for (int r = 0; r < repeat; r++)
+    for (int l = 0; l < count; l++) { strcpy(buf, lines[l]); sink += buf[0]; }
+  const double copy_ns = now_ns() - t0;
+  t0 = now_ns();
+  for (int r = 0; r < repeat; r++)
+    for (int l = 0; l < count; l++) {
+      strcpy(buf, lines[l]);
+      parser.parse(buf);
+      if (parser.command_letter == 'G' && parser.codenum < 2) get_destination();
+      sink += buf[0];
+    }
+  const double parse_ns = now_ns() - t0 - copy_ns;
+  printf("%%.1f\n", parse_ns / ((double)repeat * count));
+  return 0;
+}
+'''
+
+# Lines the fast path must give to parse(), and some it should take
+UNUSUAL = [
+  'G1 X10 Y20 A5', 'G1 X10 X20', 'G1 X', 'G1 X10 E', 'G1 X1.5E2.25', 'G1X10Y20', 'G1 X 10 Y 20',
+  'G01 X10', 'G1.1 X10', 'G 1 X10', 'G10', 'G11', 'G2 X10 Y10 I5', 'G1 X1e3', 'G1 X+5 Y-.25 Z.5',
+  'G1 X0.0000000001', 'G1 E12345.678901234', 'G1 X1234567890 Y1', 'G1 Y123456789.5', 'G1 X-0 Y-0.000',
+  'G1 X10 ; comment', 'G1 X10 S1', 'G1 X10*32', 'N12 G1 X10 Y20*99', 'N12 G1 X10 Y20  *99', 'G1 F-100',
+  'G1 X1.2.3', 'G1 X-', 'G1 X.', 'G1 Xa', 'G1 x10', 'G0 F9000 X1 Y2', 'G1', 'G0', 'M104 S210', 'T1',
+  'G28 X Y', 'G92 E0', 'M117 G1 X10', '  G1 X5', 'N5 M105*12', 'G1 E0.00001 F2400'
+]
+
+def generated_print():
+  lines = ['M140 S60', 'M104 S210', 'M190 S60', 'M109 S210', 'G28', 'G92 E0']
+  x, y, e = 100.0, 100.0, 0.0
+  for layer in range(args.layers):
+    lines.append('G1 Z%.2f F600' % (0.2 + 0.2 * layer))
+    for _ in range(random.randint(3, 8)):
+      lines.append('G1 E%.5f F2400' % (e - 0.8))
+      lines.append('G0 F9000 X%.3f Y%.3f' % (random.uniform(20, 180), random.uniform(20, 180)))
+      lines.append('G1 E%.5f F2400' % e)
+      for _ in range(random.randint(20, 120)):
+        x += random.uniform(-2, 2)
+        y += random.uniform(-2, 2)
+        e += random.uniform(0.01, 0.1)
+        lines.append(('G1 X%.3f Y%.3f E%.5f' % (x, y, e)) + (' F%d' % random.choice((1200, 1800, 2400)) if random.random() < 0.05 else ''))
+    if layer % 10 == 0:
+      lines += ['M106 S255', 'M105']
+  return lines
+
+def numbered(lines):
+  out = []
+  for n, l in enumerate(lines, 1):
+    l = 'N%d %s' % (n, l)
+    cs = 0
+    for ch in l:
+      cs ^= ord(ch)
+    out.append('%s*%d' % (l, cs))
+  return out
+
+def build(tmp, fast):
+  exe = os.path.join(tmp, 'fast' if fast else 'generic')
+  cmd = [args.cxx, '-O2', '-w', '-I', tmp, '-o', exe, os.path.join(tmp, 'parser.cpp'), os.path.join(tmp, 'harness.cpp')]
+  if fast:
+    cmd.insert(1, '-DGCODE_G1_FAST_PATH')
+  subprocess.check_call(cmd)
+  return exe
+
+def run(exe, lines, repeat):
+  p = subprocess.Popen([exe, str(repeat)], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+  out = p.communicate(('\n'.join(lines) + '\n').encode('ascii'))[0].decode('ascii')
+  if p.returncode:
+    sys.exit('%s failed' % exe)
+  return out.splitlines()
+
+failures = []
+
+def compare(lines, generic, fast):
+  hits = 0
+  for line, g, f in zip(lines, generic, fast):
+    g, f = g.split(), f.split()
+    hits += f[3] == '1'
+    if g[:3] != f[:3]:
+      failures.append('%r: parsed as %s, expected %s' % (line, ' '.join(f[:3]), ' '.join(g[:3])))
+      continue
+    for a, b, axis in zip(g[4:], f[4:], 'XYZEF'):
+      a, b = float(a), float(b)
+      if abs(a - b) > 2.5e-7 * abs(a):
+        failures.append('%r: %s=%s, expected %s' % (line, axis, repr(b), repr(a)))
+  return hits
+
+random.seed(args.seed)
+lines = open(args.gcode).read().splitlines() if args.gcode else generated_print()
+lines = [l.split(';', 1)[0].strip() for l in lines]
+lines = [l for l in lines if l]
+if args.numbered:
+  lines = numbered(lines)
+lines = [l[:MAX_CMD_SIZE - 1] for l in lines]
+
+tmp = tempfile.mkdtemp()
+try:
+  for f in ('parser.h', 'parser.cpp', 'macros.h', 'enum.h', 'types.h'):
+    shutil.copy(os.path.join(args.marlin, f), tmp)
+  for f, text in (('MarlinConfig.h', STUB_CONFIG), ('Marlin.h', ''), ('language.h', STUB_LANGUAGE),
+                  ('harness.cpp', HARNESS % {'max_lines': len(lines) + len(UNUSUAL), 'max_cmd': MAX_CMD_SIZE})):
+    open(os.path.join(tmp, f), 'w').write(text)
+  generic, fast = build(tmp, False), build(tmp, True)
+
+  unusual_hits = compare(UNUSUAL, run(generic, UNUSUAL, 0), run(fast, UNUSUAL, 0))
+  hits = compare(lines, run(generic, lines, 0), run(fast, lines, 0))
+  moves = sum(1 for l in lines if l.split('*')[0].split()[1 if l.startswith('N') else 0] in ('G0', 'G1'))
+  print('%d lines, %d G0/G1: the fast path took %d, and %d of %d unusual lines' % (len(lines), moves, hits, unusual_hits, len(UNUSUAL)))
+
+  ns_generic = float(run(generic, lines, args.repeat)[0])
+  ns_fast = float(run(fast, lines, args.repeat)[0])
+  print('parse() and the move values: %.1f ns per line, %.1f ns with GCODE_G1_FAST_PATH (%.2fx)' % (
+    ns_generic, ns_fast, ns_generic / max(ns_fast, 0.1)))
+finally:
+  shutil.rmtree(tmp)
+
+for f in failures[:20]:
+  print('FAIL', f)
+print('%d failures' % len(failures))
+sys.exit(1 if failures else 0)
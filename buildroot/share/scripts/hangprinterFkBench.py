@@ -0,0 +1,142 @@
+#!/usr/bin/env python
+
+""" Compare the Hangprinter forward kinematics solvers.
+
+Emulates single precision float (AVR 'float' and 'double') and recovers random
+positions from their step counts, as get_cartesian_from_steppers() does. The
+closed-form forward_kinematics_HANGPRINTER() is compared with the same solution
+refined by HANGPRINTER_FK_LEAST_SQUARES Gauss-Newton iterations, both with the
+original and the expanded step to line length conversion of the spool model.
+An estimated AVR cycle cost is printed for each solver.
+"""
+
+from __future__ import print_function, division
+
+import argparse
+import math
+import random
+import struct
+
+parser = argparse.ArgumentParser(description=__doc__)
+parser.add_argument('-n', '--positions', type=int, default=5000, help='Number of random positions (default=5000)')
+parser.add_argument('-i', '--iterations', type=int, default=1, help='HANGPRINTER_FK_ITERATIONS (default=1)')
+parser.add_argument('--seed', type=int, default=1, help='Random seed (default=1)')
+args = parser.parse_args()
+
+# Rough avr-libc costs in cycles for single precision operations
+CYCLES = {'add': 110, 'mul': 140, 'div': 470, 'sqrt': 480}
+
+def f32(x):
+  return struct.unpack('f', struct.pack('f', x))[0]
+
+# Defaults of example_configurations/hangprinter
+ANCHOR = [(0.0, -1234.0, -12.0), (1234.0, 123.0, -12.0), (-1234.0, 1234.0, -12.0), (0.0, 0.0, 1234.0)]
+MECHANICAL_ADVANTAGE = [1, 1, 1, 1]
+ACTION_POINTS = [2, 2, 2, 3]
+MOUNTED_LINE = [7500.0, 7500.0, 7500.0, 4000.0]
+SPOOL_RADII = [55.0, 55.0, 55.0, 55.0]
+MOTOR_GEAR_TEETH = [10, 10, 10, 10]
+SPOOL_GEAR_TEETH = [100, 100, 100, 100]
+SPOOL_BUILDUP_FACTOR = 0.0078
+STEPS_PER_MOTOR_REVOLUTION = 3200
+RADIUS = 1500.0
+
+def dist(p, q):
+  return math.sqrt(sum((a - b) ** 2 for a, b in zip(p, q)))
+
+origin = [dist((0, 0, 0), a) for a in ANCHOR]
+
+# Same derivation as recalc_hangprinter_settings()
+k0, k1, k2, sqrtk1 = [], [], [], []
+for i in range(4):
+  spu_r = MECHANICAL_ADVANTAGE[i] * STEPS_PER_MOTOR_REVOLUTION * SPOOL_GEAR_TEETH[i] / (2 * math.pi * MOTOR_GEAR_TEETH[i])
+  nr_lines = MECHANICAL_ADVANTAGE[i] * ACTION_POINTS[i]
+  k2.append(-nr_lines * SPOOL_BUILDUP_FACTOR)
+  k0.append(2.0 * spu_r / k2[i])
+  to_d = dist(ANCHOR[i], (0, 0, ANCHOR[3][2])) if i < 3 else 0
+  on_spool = ACTION_POINTS[i] * MOUNTED_LINE[i] - ACTION_POINTS[i] * to_d - nr_lines * origin[i]
+  k1.append(SPOOL_BUILDUP_FACTOR * (on_spool + nr_lines * origin[i]) + SPOOL_RADII[i] ** 2)
+  sqrtk1.append(math.sqrt(k1[i]))
+k0, k1, k2, sqrtk1 = [list(map(f32, v)) for v in (k0, k1, k2, sqrtk1)]
+A = [tuple(map(f32, a)) for a in ANCHOR]
+
+def steps(i, l):
+  return int(round(k0[i] * (math.sqrt(k1[i] + k2[i] * l) - math.sqrt(k1[i]))))
+
+def length_squared(i, s):
+  # (sq(s / k0 + sqrtk1) - k1) / k2
+  return f32(f32(f32(f32(f32(s / k0[i]) + sqrtk1[i]) ** 2) - k1[i]) / k2[i])
+
+def length_expanded(i, s):
+  # u * (u + 2 * sqrtk1) / k2, with u = s / k0
+  u = f32(s / k0[i])
+  return f32(f32(u * f32(u + f32(2 * sqrtk1[i]))) / k2[i])
+
+def closed_form(a, b, c, d):
+  """ Mirror of forward_kinematics_HANGPRINTER() without refinement """
+  Ay, Az = A[0][1], A[0][2]
+  Bx, By, Bz = A[1]
+  Cx, Cy, Cz = A[2]
+  Dz = A[3][2]
+  Asq = f32(Ay * Ay + Az * Az)
+  Bsq = f32(Bx * Bx + By * By + Bz * Bz)
+  Csq = f32(Cx * Cx + Cy * Cy + Cz * Cz)
+  Dsq = f32(Dz * Dz)
+  aa, dd = f32(a * a), f32(d * d)
+  k0b = f32(f32((-f32(b * b) + Bsq - Dsq + dd) / (2 * Bx)) + f32(By / (2 * Ay * Bx)) * f32(Dsq - Asq + aa - dd))
+  k0c = f32(f32((-f32(c * c) + Csq - Dsq + dd) / (2 * Cx)) + f32(Cy / (2 * Ay * Cx)) * f32(Dsq - Asq + aa - dd))
+  k1b = f32(f32((By * (Az - Dz)) / (Ay * Bx)) + f32((Dz - Bz) / Bx))
+  k1c = f32(f32((Cy * (Az - Dz)) / (Ay * Cx)) + f32((Dz - Cz) / Cx))
+  z = f32((k0b - k0c) / (k1c - k1b))
+  x = f32(k0c + f32(k1c * z))
+  y = f32(f32((Asq - Dsq - aa + dd) / (2 * Ay)) + f32(f32((Dz - Az) / Ay) * z))
+  return [x, y, z]
+
+def refine(p, lens):
+  """ Mirror of the HANGPRINTER_FK_LEAST_SQUARES iterations """
+  for _ in range(args.iterations):
+    xx = xy = xz = yy = yz = zz = rx = ry = rz = 0.0
+    for a, l0 in zip(A, lens):
+      e = [f32(p[j] - a[j]) for j in range(3)]
+      l = f32(math.sqrt(f32(e[0] * e[0] + e[1] * e[1] + e[2] * e[2])))
+      inv_l = f32(1 / l)
+      ux, uy, uz = [f32(v * inv_l) for v in e]
+      r = f32(l - l0)
+      xx, xy, xz = f32(xx + ux * ux), f32(xy + ux * uy), f32(xz + ux * uz)
+      yy, yz, zz = f32(yy + uy * uy), f32(yz + uy * uz), f32(zz + uz * uz)
+      rx, ry, rz = f32(rx + ux * r), f32(ry + uy * r), f32(rz + uz * r)
+    c00, c01, c02 = f32(yy * zz - yz * yz), f32(xz * yz - xy * zz), f32(xy * yz - xz * yy)
+    c11, c12, c22 = f32(xx * zz - xz * xz), f32(xy * xz - xx * yz), f32(xx * yy - xy * xy)
+    det = f32(xx * c00 + xy * c01 + xz * c02)
+    if not det:
+      break
+    inv_det = f32(1 / det)
+    p = [f32(p[0] - f32(c00 * rx + c01 * ry + c02 * rz) * inv_det),
+         f32(p[1] - f32(c01 * rx + c11 * ry + c12 * rz) * inv_det),
+         f32(p[2] - f32(c02 * rx + c12 * ry + c22 * rz) * inv_det)]
+  return p
+
+random.seed(args.seed)
+results = {}
+for _ in range(args.positions):
+  r, t = RADIUS * math.sqrt(random.random()) * 0.9, random.random() * 2 * math.pi
+  p = (r * math.cos(t), r * math.sin(t), random.uniform(0, 1000))
+  s = [steps(i, dist(p, a)) for i, a in enumerate(ANCHOR)]
+  # Error against the true position includes the step quantization
+  for conv_name, conv in (('squared', length_squared), ('expanded', length_expanded)):
+    lens = [conv(i, s[i]) for i in range(4)]
+    cf = closed_form(*lens)
+    for name, q in (('closed-form', cf), ('least-squares', refine(cf, lens))):
+      results.setdefault((name, conv_name), []).append(dist(p, q))
+
+def cost(ops):
+  return sum(CYCLES[k] * n for k, n in ops.items())
+
+closed_cycles = cost({'add': 24, 'mul': 16, 'div': 14})
+iter_cycles = cost({'add': 4 * 13 + 21, 'mul': 4 * 15 + 27, 'div': 4 + 1, 'sqrt': 4})
+
+print('%d positions, %d iterations' % (args.positions, args.iterations))
+for (name, conv_name), errs in sorted(results.items()):
+  rms = math.sqrt(sum(e * e for e in errs) / len(errs))
+  cycles = closed_cycles + (iter_cycles * args.iterations if name == 'least-squares' else 0)
+  print('%-14s %-9s max error %7.4f mm  rms %7.4f mm  ~%6d cycles' % (name, conv_name, max(errs), rms, cycles))
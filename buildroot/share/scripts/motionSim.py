@@ -0,0 +1,1041 @@
+#!/usr/bin/env python
+
+""" Build the Marlin motion pipeline for the host and run G-code through it.
+
+All of Marlin/*.cpp is built with the host C++ compiler against a simulated
+AVR: the registers are plain variables, the pins read low, the EEPROM lives in
+memory, and the stepper timer (TCNT1 / OCR1A) counts at STEPPER_TIMER_RATE on a
+simulated clock. A small driver calls setup(), then hands each line of the
+G-code to parser.parse() and process_parsed_command() and calls idle(), as
+loop() does. The stepper ISR fires from millis(), micros() and delay() when the
+simulated clock passes the compare match and the interrupts allow it, so the
+planner fills the queue and waits on the stepper as on the board. At the end
+the queue is drained and M930 prints the MOTION_STATS counters: blocks planned
+and the planning time per block, stepper timer ticks per step event, and the
+times the stepper ran out of blocks while moves were still coming. The count
+of step rate lookups (calc_timer_interval()) follows, since the host runs them
+far faster than the AVR and the ISR ticks hide them.
+
+The simulated clock is the host time times --slowdown, which stands for how
+much slower the AVR is than the host. With it the planning time and the ISR
+ticks are estimates, and they vary from run to run like the host load does.
+Compare runs made on the same host with the same --slowdown: a change to
+_populate_block(), recalculate() or the stepper ISR shows as a change in the
+per block time, the ticks per step and the starvation count. With --slowdown 0
+the clock moves a tick each time it is read instead, so the code takes next to
+no simulated time and a run repeats exactly: the step times are those the ISR
+was set for, and the ticks its own reads of the clock took, with no host in
+the way.
+
+Without a G-code file a test print is made up (--seed): per layer a circle in
+--segment mm chords and a run of random infill lines. Heater and homing
+commands are left out (G28 sets the position with G92 and turns the software
+endstops off, since homing is what sets their limits), and cold extrusion is
+allowed. The temperature ISR does not run, the LCD is left out of the build, no
+SD card answers unless a check formats one, and TX_BUFFER_SIZE is 0 unless it is set with -e. Boards on the ATmega2560 or ATmega1284P
+build; those needing other libraries (like SlowSoftI2CMaster) don't. The build
+warns as with -Wall -Wextra, and stops at any warning not in SIM_WARNINGS.
+
+The AVR is slower still at float maths than at the integer maths of the stepper
+ISR. The default --slowdown puts the ISR near its AVR cost, which leaves the
+planner faster than on the board: raise --slowdown to find where the queue
+starves.
+
+With --check NAME, motionSimChecks/NAME.cpp is built in with the options of its
+"// Options:" line (-e and -d come after them), and its sim_check() gets the
+G-code and --seed in place of the driver. A check runs the firmware itself: it
+calls loop() or any other function, sends bytes to the serial port with
+sim_serial_rx(), gets the lines sent through sim_serial_line, sees each stepper
+interrupt through sim_isr_hook and each write to an output port (the step
+pulses) through sim_port_hook, and formats an SD card in memory with
+sim_sd_format(), which the firmware reads and writes over SPI (sim_sd_reads and
+sim_sd_writes count the blocks). It returns nonzero when a check failed. A
+check with a "// Reference:" line of -e and -d is built twice, the second time
+with those changes too, and that reference build runs first: sim_reference is
+a file it writes and the build checked reads (sim_reference_build tells which).
+A "// Slowdown:" line sets the --slowdown the check runs at by default, and a
+"// Config:" line the -c it builds with.
+
+  motionSim.py                          the default configuration
+  motionSim.py -c delta/generic         an example configuration
+  motionSim.py -e BLOCK_MERGING print.gcode
+  motionSim.py --check commandQueue     a check of motionSimChecks
+  motionSim.py --check serialQueue      one against its reference build
+"""
+
+from __future__ import print_function, division
+
+import argparse
+import math
+import multiprocessing
+import os
+import random
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+parser.add_argument('gcode', nargs='?', help='G-code file to run (default: a made up test print)')
+parser.add_argument('-c', '--config', help='Example configuration, a folder under Marlin/example_configurations or a path')
+parser.add_argument('-e', '--enable', action='append', default=[], metavar='OPTION[=VALUE]', help='Enable a configuration option')
+parser.add_argument('-d', '--disable', action='append', default=[], metavar='OPTION', help='Disable a configuration option')
+parser.add_argument('-s', '--slowdown', type=float, help='Simulated time per host time, 0 for a tick per read of the clock (default=40)')
+parser.add_argument('-l', '--layers', type=int, default=4, help='Layers of the test print (default=4)')
+parser.add_argument('--segment', type=float, default=0.5, help='Chord length of the test print circles, in mm (default=0.5)')
+parser.add_argument('--feedrate', type=float, default=60.0, help='Print feedrate of the test print, in mm/s (default=60)')
+parser.add_argument('-v', '--verbose', action='store_true', help='Also print the "ok" of every line')
+parser.add_argument('--check', metavar='NAME', help='Run motionSimChecks/NAME.cpp with the G-code, instead of the G-code alone')
+parser.add_argument('--keep', action='store_true', help='Keep the build folder')
+parser.add_argument('--cxx', default=os.environ.get('CXX', 'c++'), help='Host C++ compiler (default=$CXX or c++)')
+parser.add_argument('--marlin', default=os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', '..', 'Marlin'),
+                    help='Path of the Marlin sources')
+parser.add_argument('--seed', type=int, default=1, help='Random seed (default=1)')
+args = parser.parse_args()
+
+# Options outside the LCD section that need the LCD, and the homing the simulation skips
+SIM_DISABLE = ['ADVANCED_PAUSE_FEATURE', 'LCD_BED_LEVELING', 'SHOW_CUSTOM_BOOTSCREEN', 'CUSTOM_STATUS_SCREEN_IMAGE',
+               'NO_MOTION_BEFORE_HOMING']
+
+# Registers wider than a byte
+WIDE_REGS = set(['ADC', 'ADCW', 'ICR1', 'ICR3', 'ICR4', 'ICR5', 'TCNT3', 'TCNT4', 'TCNT5'] +
+                ['OCR%d%s' % (t, c) for t in (1, 3, 4, 5) for c in 'ABC'])
+
+# The bit numbers of the pins in the fastio tables, like PINF1
+PIN_BIT = re.compile(r'^(?:PIN|PORT|DD)[A-L]([0-7])$')
+
+def declare_reg(r):
+  m = PIN_BIT.match(r)
+  return '#define %s %s\n' % (r, m.group(1)) if m else 'extern volatile uint%d_t %s;\n' % (16 if r in WIDE_REGS else 8, r)
+
+SIM_HEADERS = {
+  'Arduino.h': r'''#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <avr/pgmspace.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+typedef uint8_t byte;
+typedef bool boolean;
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define NOT_AN_INTERRUPT -1
+#define NOT_ON_TIMER 0
+#define NUM_DIGITAL_PINS 70
+#define digitalPinToInterrupt(p) (p)
+#define digitalPinToPCICR(p) ((volatile uint8_t*)0)
+#define digitalPinToPCICRbit(p) 0
+#define digitalPinToPCMSK(p) ((volatile uint8_t*)0)
+#define digitalPinToPCMSKbit(p) 0
+#define digitalPinToTimer(p) NOT_ON_TIMER
+#define digitalPinToBitMask(p) 1
+#define digitalPinToPort(p) 0
+#define portOutputRegister(p) ((volatile uint8_t*)0)
+#define portInputRegister(p) ((volatile uint8_t*)0)
+#define portModeRegister(p) ((volatile uint8_t*)0)
+#define analogInputToDigitalPin(p) ((p) + 54)
+#define clockCyclesPerMicrosecond() (F_CPU / 1000000L)
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define constrain(a,l,h) ((a)<(l)?(l):((a)>(h)?(h):(a)))
+#define sq(x) ((x)*(x))
+#define word(h, l) ((uint16_t)(((h) << 8) | (l)))
+#define lowByte(w) ((uint8_t)((w) & 0xFF))
+#define highByte(w) ((uint8_t)((w) >> 8))
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long);
+void delayMicroseconds(unsigned int);
+void pinMode(uint8_t, uint8_t);
+void digitalWrite(uint8_t, uint8_t);
+int digitalRead(uint8_t);
+int analogRead(uint8_t);
+void analogWrite(uint8_t, int);
+void attachInterrupt(uint8_t, void (*)(void), int);
+void detachInterrupt(uint8_t);
+long map(long, long, long, long, long);
+long random(long);
+long random(long, long);
+void randomSeed(unsigned long);
+char *dtostrf(double, signed char, unsigned char, char *);
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper*)(s))
+class Print { public: virtual size_t write(uint8_t) = 0; };
+class String {
+  const char *s;
+  public:
+    String(const char *str = "") : s(str) {}
+    unsigned int length() const { return strlen(s); }
+    char operator[](unsigned int i) const { return s[i]; }
+};
+''',
+  'Print.h': '#include "Arduino.h"\n',
+  'HardwareSerial.h': '#pragma once\n',
+  'SPI.h': r'''#pragma once
+#include <stdint.h>
+// No device answers on the SPI bus
+struct SPIClass {
+  void begin() {}
+  uint8_t transfer(uint8_t) { return 0xFF; }
+};
+static SPIClass SPI __attribute__((unused));
+''',
+  'Stream.h': '#include "Arduino.h"\n',
+  'Wire.h': r'''#pragma once
+#include <stdint.h>
+#include <stddef.h>
+// No device answers on the I2C bus
+struct TwoWire {
+  void begin(uint8_t = 0) {}
+  void beginTransmission(uint8_t) {}
+  uint8_t endTransmission(bool = true) { return 2; }
+  size_t write(uint8_t) { return 1; }
+  size_t write(const uint8_t*, size_t n) { return n; }
+  size_t write(const char*, size_t n) { return n; }
+  uint8_t requestFrom(uint8_t, uint8_t) { return 0; }
+  int available() { return 0; }
+  int read() { return -1; }
+  void onReceive(void (*)(int)) {}
+  void onRequest(void (*)()) {}
+};
+static TwoWire Wire __attribute__((unused));
+''',
+  'pins_arduino.h': '#pragma once\n',
+  'avr/io.h': r'''#pragma once
+#include <stdint.h>
+#define _BV(b) (1 << (b))
+#define _SFR_BYTE(x) (x)
+#define bit_is_set(r,b) ((r) & _BV(b))
+#define bit_is_clear(r,b) (!((r) & _BV(b)))
+#define E2END 4095
+#define RAMEND 8191
+#define SREG_I 7
+#define OCIE0B 2
+#define OCIE1A 1
+// USART 0, the serial port of the simulation
+#define UBRR0H UBRR0H
+#define UDR0 UDR0
+#define RXC0 7
+#define TXC0 6
+#define UDRE0 5
+#define FE0 4
+#define DOR0 3
+#define UPE0 2
+#define U2X0 1
+#define RXCIE0 7
+#define TXCIE0 6
+#define UDRIE0 5
+#define RXEN0 4
+#define TXEN0 3
+// Setting the I bit, or UDRIE0 with it set, runs a pending USART data register empty interrupt
+struct SimInterruptReg {
+  volatile uint8_t v;
+  operator uint8_t() const { return v; }
+  SimInterruptReg &operator=(uint8_t);
+  SimInterruptReg &operator|=(int b) { return *this = v | b; }
+  SimInterruptReg &operator&=(int b) { return *this = v & b; }
+};
+extern SimInterruptReg SREG, UCSR0B;
+// The output ports tell sim_port_hook of each write, so a check sees the step pulses
+struct SimPort {
+  volatile uint8_t v;
+  operator uint8_t() const { return v; }
+  SimPort &operator=(uint8_t);
+  SimPort &operator|=(int b) { return *this = v | b; }
+  SimPort &operator&=(int b) { return *this = v & b; }
+  SimPort &operator^=(int b) { return *this = v ^ b; }
+};
+extern SimPort PORTA, PORTB, PORTC, PORTD, PORTE, PORTF, PORTG, PORTH, PORTJ, PORTK, PORTL;
+// Timer 1 counts at STEPPER_TIMER_RATE from the last compare match
+struct SimTimer1 {
+  operator uint16_t() const;
+  SimTimer1 &operator=(uint16_t);
+};
+extern SimTimer1 TCNT1;
+// The USART is always ready to send
+struct SimUCSRA {
+  uint8_t v;
+  operator uint8_t() const { return v | _BV(UDRE0) | _BV(TXC0); }
+  SimUCSRA &operator=(uint8_t b) { v = b; return *this; }
+  SimUCSRA &operator|=(uint8_t b) { v |= b; return *this; }
+  SimUCSRA &operator&=(uint8_t b) { v &= b; return *this; }
+};
+extern SimUCSRA UCSR0A;
+// The USART data register prints what is written to it, and holds the byte sim_serial_rx() receives
+struct SimUDR {
+  operator uint8_t() const;
+  SimUDR &operator=(uint8_t);
+};
+extern SimUDR UDR0;
+// SPI: an SD card answers with the image of sim_sd_format(), and each byte is sent at once
+#define SPIF 7
+#define SPE 6
+#define MSTR 4
+#define SPR1 1
+#define SPR0 0
+#define SPI2X 0
+struct SimSPDR {
+  operator uint8_t() const;
+  SimSPDR &operator=(uint8_t);
+};
+extern SimSPDR SPDR;
+struct SimSPSR {
+  operator uint8_t() const { return _BV(SPIF); }
+  SimSPSR &operator=(uint8_t) { return *this; }
+};
+extern SimSPSR SPSR;
+#include "regs.h"
+''',
+  'avr/interrupt.h': r'''#pragma once
+#include "io.h"
+#define sei() (SREG |= _BV(SREG_I))
+#define cli() (SREG &= ~_BV(SREG_I))
+#define ISR(v, ...) extern "C" void v(void)
+#define ISR_NOBLOCK
+#define ISR_NAKED
+#define SIGNAL(v) extern "C" void v(void)
+''',
+  'avr/pgmspace.h': r'''#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_byte_near(p) pgm_read_byte(p)
+#define pgm_read_byte_far(p) pgm_read_byte(p)
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+#define pgm_read_word_near(p) pgm_read_word(p)
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+#define pgm_read_dword_near(p) pgm_read_dword(p)
+#define pgm_read_float(p) (*(const float*)(p))
+#define pgm_read_float_near(p) pgm_read_float(p)
+#define pgm_read_ptr(p) (*(void* const*)(p))
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strcat_P strcat
+#define strncat_P strncat
+#define strchr_P strchr
+#define strrchr_P strrchr
+#define strstr_P strstr
+#define memcpy_P memcpy
+#define sprintf_P sprintf
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+#define strcasecmp_P strcasecmp
+''',
+  'avr/eeprom.h': r'''#pragma once
+#include <stdint.h>
+#include <stddef.h>
+uint8_t eeprom_read_byte(const uint8_t*);
+void eeprom_write_byte(uint8_t*, uint8_t);
+void eeprom_update_byte(uint8_t*, uint8_t);
+void eeprom_read_block(void*, const void*, size_t);
+void eeprom_update_block(const void*, void*, size_t);
+''',
+  'avr/wdt.h': r'''#pragma once
+#define WDTO_4S 8
+#define WDTO_15MS 0
+void wdt_enable(int);
+void wdt_reset();
+void wdt_disable();
+''',
+  'util/atomic.h': r'''#pragma once
+#define ATOMIC_BLOCK(x) for (int _i = 1; _i; _i = 0)
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+''',
+  'util/delay.h': r'''#pragma once
+void _delay_ms(double);
+void _delay_us(double);
+''',
+}
+
+# The AVR delay.h is cycle counted asm
+SIM_DELAY_H = r'''#ifndef MARLIN_DELAY_H
+#define MARLIN_DELAY_H
+#define nop() do{}while(0)
+#define DELAY_CYCLES(x) do{}while(0)
+#define DELAY_NS(x) do{}while(0)
+#define DELAY_US(x) delayMicroseconds(x)
+#endif
+'''
+
+# C for the AVR asm helpers, from the comments next to them
+SIM_FUNCTIONS = [
+  ('stepper.h', 'static FORCE_INLINE uint16_t MultiU16X8toH16(uint8_t charIn1, uint16_t intIn2) {',
+   'return (uint32_t(charIn1) * intIn2 + 0x80) >> 8;'),
+  ('stepper.cpp', 'static FORCE_INLINE uint16_t MultiU24X32toH16(uint32_t longIn1, uint32_t longIn2) {',
+   'return (uint64_t(longIn1 & 0xFFFFFF) * longIn2 + 0x800000) >> 24;'),
+  ('stepper.cpp', 'void Stepper::_calc_bezier_curve_coeffs(const int32_t v0, const int32_t v1, const uint32_t av) {',
+   'bezier_AV = av; A_negative = v1 < v0; const int32_t d = A_negative ? v0 - v1 : v1 - v0;'
+   ' bezier_A = 6 * d; bezier_B = 15 * d; bezier_C = 10 * d; bezier_F = v0;'),
+  ('stepper.cpp', 'FORCE_INLINE int32_t Stepper::_eval_bezier_curve(const uint32_t curr_step) {',
+   'if (!curr_step) return bezier_F;'
+   ' const uint16_t t = (uint64_t(bezier_AV) * curr_step) >> 8; uint16_t f = t;'
+   ' f = (uint32_t(f) * t) >> 16; f = (uint32_t(f) * t) >> 16;'
+   ' const uint32_t c = (uint64_t(f) * bezier_C) >> 16; f = (uint32_t(f) * t) >> 16;'
+   ' const uint32_t b = (uint64_t(f) * bezier_B) >> 16; f = (uint32_t(f) * t) >> 16;'
+   ' const uint32_t a = (uint64_t(f) * bezier_A) >> 16;'
+   ' return A_negative ? int32_t(bezier_F - c + b - a) : int32_t(bezier_F + c - b + a);'),
+  ('planner.cpp', 'static uint32_t get_period_inverse(uint32_t d) {', 'return d ? 0xFFFFFF / d : 0xFFFFFF;'),
+  ('Marlin_main.cpp', 'extern void* __brkval;\n\n  int freeMemory() {', 'return RAMEND + 1;'),
+]
+
+# Warnings the build lets pass: in the sources the series started from, or of the host alone
+SIM_WARNINGS = [
+  r"^duration_t\.h:.*\[-Wformat-overflow=\]",
+  r"^temperature\.cpp:.*\[-Wimplicit-fallthrough=\]",             # The state machines fall through on purpose
+  r"^configuration_store\.cpp:.*\[-Wignored-qualifiers\]",
+  r"^configuration_store\.cpp:.*\[-Wint-to-pointer-cast\]",         # EEPROM addresses are ints
+  r"'void (homeaxis\(AxisEnum\)|print_es_state\(bool, const char\*\))' defined but not used",
+  r"from 'long int' to 'int32_t' \{aka 'int'\} \[-Wnarrowing\]",  # long is 32 bits on the AVR
+  r"^macros\.h:.*clearing an object of type 'class SdFile'",       # ZERO(workDirParents)
+  r"^SdBaseFile\.cpp:.*\[-Waddress-of-packed-member\]",            # Bytes on the AVR, so never unaligned
+  r"^cardreader\.cpp:.*'sprintf' may write a terminating nul",
+  r"^power_loss_recovery\.cpp:.*'%ld' expects argument of type 'long int', but argument \d+ has type 'uint32_t'",
+]
+
+# Where the AVR pointers and ints of 16 bits show, the C strchr() of avr-libc, and the LCD that is left out
+SIM_REPLACES = [
+  ('cardreader.cpp', 'char * const dirname_end = strchr(', 'const char * const dirname_end = strchr('),
+  ('SanityCheck.h', '#if ENABLED(POWER_LOSS_RECOVERY) && !ENABLED(ULTIPANEL)', '#if 0 // Only the resume menu needs the LCD'),
+  ('stepper.h', 'uint16_t table_address = (uint16_t)&', 'uintptr_t table_address = (uintptr_t)&'),
+  ('stepper.h', '      uint32_t timer;\n', '      uint32_t timer;\n      extern unsigned long sim_rate_lookups;\n      sim_rate_lookups++;\n'),
+  ('stepper.cpp', 'digipot_current(const uint8_t driver, const int current)', 'digipot_current(const uint8_t driver, const int16_t current)'),
+  # The registers aren't at their AVR addresses on the host, so write the port of every pin
+  ('fastio.h', 'do{ if (&(DIO ## IO ## _RPORT) < (uint8_t*)0x100) _WRITE_NC(IO,V); else _WRITE_C(IO,V); }while(0)', '_WRITE_NC(IO,V)'),
+]
+
+SIM_HAL_CPP = r'''// The simulated AVR: clock, stepper timer, serial port, SD card and EEPROM
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <avr/wdt.h>
+#include <util/delay.h>
+
+#define SIM_TIMER_RATE 2000000ULL   // STEPPER_TIMER_RATE
+
+extern "C" void TIMER1_COMPA_vect(void);
+extern "C" void USART0_UDRE_vect(void) __attribute__((weak)); // With TX_BUFFER_SIZE > 0
+extern "C" void USART0_RX_vect(void) __attribute__((weak));
+
+typedef std::chrono::steady_clock sim_clock;
+static sim_clock::time_point sim_start_time;
+static double sim_ticks_per_ns;
+static uint64_t sim_match;          // Simulated tick of the last compare match
+static bool sim_in_isr, sim_in_udre, sim_verbose;
+unsigned long sim_isr_count, sim_rate_lookups;
+void (*sim_isr_hook)(uint64_t tick);           // Called after each stepper ISR, with the tick of its compare match
+void (*sim_serial_line)(const char *line);     // Gets the serial output a line at a time, instead of stdout
+void (*sim_port_hook)(const SimPort &port, const uint8_t was, const uint64_t tick); // Called after each write to an output port
+
+SimInterruptReg SREG, UCSR0B;
+SimPort PORTA, PORTB, PORTC, PORTD, PORTE, PORTF, PORTG, PORTH, PORTJ, PORTK, PORTL;
+SimTimer1 TCNT1;
+SimUCSRA UCSR0A;
+SimUDR UDR0;
+SimSPDR SPDR;
+SimSPSR SPSR;
+
+static uint64_t sim_counted;        // The clock of --slowdown 0
+
+uint64_t sim_now() {
+  if (!sim_ticks_per_ns) return ++sim_counted;
+  return uint64_t(std::chrono::duration<double, std::nano>(sim_clock::now() - sim_start_time).count() * sim_ticks_per_ns);
+}
+
+void sim_start(const double slowdown, const bool verbose) {
+  sim_start_time = sim_clock::now();
+  sim_ticks_per_ns = slowdown * SIM_TIMER_RATE / 1e9;
+  sim_verbose = verbose;
+  SREG = _BV(SREG_I);               // The Arduino core enables interrupts before setup()
+}
+
+// Run the stepper ISR for every compare match the simulated clock has passed
+void sim_advance() {
+  if (sim_in_isr) return;           // The ISR masks itself, as HAL_STEP_TIMER_ISR does
+  while (bit_is_set(SREG, SREG_I) && bit_is_set(TIMSK1, OCIE1A)) {
+    const uint64_t due = sim_match + OCR1A + 1;
+    if (sim_now() < due) break;
+    sim_match = due;                // CTC mode: the counter restarts at the match
+    sim_in_isr = true;
+    TIMER1_COMPA_vect();
+    if (sim_isr_hook) sim_isr_hook(sim_match);
+    sim_in_isr = false;
+    SREG |= _BV(SREG_I);            // reti
+    sim_isr_count++;
+  }
+}
+
+// The USART is always ready to send, so the interrupt runs until it turns itself off
+SimInterruptReg &SimInterruptReg::operator=(uint8_t b) {
+  v = b;
+  while (USART0_UDRE_vect && !sim_in_udre && bit_is_set(SREG, SREG_I) && bit_is_set(UCSR0B, UDRIE0)) {
+    sim_in_udre = true;
+    SREG.v &= uint8_t(~_BV(SREG_I));
+    USART0_UDRE_vect();
+    SREG.v |= _BV(SREG_I);
+    sim_in_udre = false;
+  }
+  return *this;
+}
+
+SimTimer1::operator uint16_t() const { return uint16_t(sim_now() - sim_match); }
+SimTimer1 &SimTimer1::operator=(uint16_t v) { sim_match = sim_now() - v; return *this; }
+
+// A write in the stepper ISR is at the tick of its compare match, or on the
+// counted clock at the ticks its reads of the clock have taken since
+SimPort &SimPort::operator=(uint8_t b) {
+  const uint8_t was = v;
+  v = b;
+  if (sim_port_hook) sim_port_hook(*this, was, sim_in_isr && sim_ticks_per_ns ? sim_match : sim_now());
+  return *this;
+}
+
+static std::string sim_line;
+SimUDR &SimUDR::operator=(uint8_t c) {
+  if (c == '\n') {
+    if (sim_serial_line) sim_serial_line(sim_line.c_str());
+    else if (sim_verbose || sim_line.compare(0, 2, "ok")) printf("%s\n", sim_line.c_str());
+    sim_line.clear();
+  }
+  else if (c != '\r')
+    sim_line += char(c);
+  return *this;
+}
+
+// Receive bytes as the USART does, with a receive interrupt for each
+static uint8_t sim_rx_byte;
+SimUDR::operator uint8_t() const { return sim_rx_byte; }
+void sim_serial_rx(const char *s, const size_t n) {
+  for (size_t i = 0; i < n && USART0_RX_vect; i++) {
+    sim_rx_byte = s[i];
+    USART0_RX_vect();
+  }
+}
+
+/**
+ * An SDHC card in SPI mode, in memory. It takes the commands Sd2Card sends:
+ * reset and init, the CSD, single block reads and writes, and multiple
+ * block reads until CMD12. No card answers before sim_sd_format().
+ */
+std::vector<uint8_t> sim_sd;
+unsigned long sim_sd_reads, sim_sd_writes;   // Blocks sent and written
+static std::deque<uint8_t> sd_out;           // Bytes the card sends next
+static uint8_t sd_cmd[6], sd_cmd_len, sd_spi_out, sd_data[512 + 2];
+static uint16_t sd_data_len;
+static uint32_t sd_block;
+static bool sd_app, sd_streaming, sd_stream_gap;
+static enum { SD_COMMAND, SD_WRITE_TOKEN, SD_WRITE_DATA } sd_state;
+
+static void put16(uint8_t *p, const uint16_t v) { p[0] = v & 0xFF; p[1] = v >> 8; }
+static void put32(uint8_t *p, const uint32_t v) { put16(p, v & 0xFFFF); put16(p + 2, v >> 16); }
+
+// An empty FAT16 volume without a partition table, with 2 FATs and 512 root entries
+void sim_sd_format(const uint16_t clusters, const uint8_t cluster_blocks) {
+  const uint16_t fat_blocks = (2 * (clusters + 2) + 511) / 512, root_blocks = 512 * 32 / 512;
+  const uint32_t blocks = 1 + 2 * fat_blocks + root_blocks + uint32_t(clusters) * cluster_blocks;
+  sim_sd.assign(blocks * 512, 0);
+  uint8_t * const b = &sim_sd[0];
+  b[0] = 0xEB; b[1] = 0x3C; b[2] = 0x90;
+  memcpy(b + 3, "MOTNSIM ", 8);
+  put16(b + 11, 512);
+  b[13] = cluster_blocks;
+  put16(b + 14, 1);                          // Reserved blocks
+  b[16] = 2;                                 // FATs
+  put16(b + 17, 512);                        // Root entries
+  if (blocks < 0x10000) put16(b + 19, blocks); else put32(b + 32, blocks);
+  b[21] = 0xF8;
+  put16(b + 22, fat_blocks);
+  b[38] = 0x29;
+  memcpy(b + 43, "NO NAME    FAT16   ", 19);
+  b[510] = 0x55; b[511] = 0xAA;
+  for (uint8_t f = 0; f < 2; f++) {
+    uint8_t * const fat = b + 512 * (1 + f * fat_blocks);
+    put16(fat, 0xFFF8); put16(fat + 2, 0xFFFF);
+  }
+}
+
+static uint16_t sd_crc(const uint8_t *p, const uint16_t n) {
+  uint16_t crc = 0;
+  for (uint16_t i = 0; i < n; i++) {
+    crc ^= uint16_t(p[i]) << 8;
+    for (uint8_t b = 8; b--;) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+static void sd_send_data(const uint8_t *p, const uint16_t n) {
+  sd_out.push_back(0xFE);                    // Data token
+  sd_out.insert(sd_out.end(), p, p + n);
+  const uint16_t crc = sd_crc(p, n);
+  sd_out.push_back(crc >> 8);
+  sd_out.push_back(crc & 0xFF);
+}
+
+static bool sd_send_block(const uint32_t block) {
+  if (block >= sim_sd.size() / 512) return false;
+  sd_send_data(&sim_sd[block * 512], 512);
+  sim_sd_reads++;
+  return true;
+}
+
+static void sd_command() {
+  const uint8_t cmd = sd_cmd[0] & 0x3F;
+  const uint32_t arg = uint32_t(sd_cmd[1]) << 24 | uint32_t(sd_cmd[2]) << 16 | uint32_t(sd_cmd[3]) << 8 | sd_cmd[4];
+  const bool app = sd_app, in_range = arg < sim_sd.size() / 512;
+  sd_app = false;
+  sd_out.push_back(0xFF);                    // The answer starts a byte after the command
+  if (app && (cmd == 41 || cmd == 23)) {     // Ready, or the pre-erase count
+    sd_out.push_back(0x00);
+    return;
+  }
+  switch (cmd) {
+    case 0: sd_out.push_back(0x01); break;   // Idle
+    case 8: { const uint8_t r7[] = { 0x01, 0x00, 0x00, 0x01, 0xAA }; sd_out.insert(sd_out.end(), r7, r7 + 5); } break;
+    case 55: sd_out.push_back(0x00); sd_app = true; break;
+    case 58: { const uint8_t r3[] = { 0x00, 0xC0, 0xFF, 0x80, 0x00 }; sd_out.insert(sd_out.end(), r3, r3 + 5); } break;
+    case 9: {                                // CSD version 2
+      uint8_t csd[16] = { 0x40 };
+      const uint32_t c_size = sim_sd.size() / (512UL * 1024);
+      csd[7] = ((c_size ? c_size - 1 : 0) >> 16) & 0x3F;
+      csd[8] = ((c_size ? c_size - 1 : 0) >> 8) & 0xFF;
+      csd[9] = (c_size ? c_size - 1 : 0) & 0xFF;
+      csd[10] = 0x40;                        // Single block erase
+      sd_out.push_back(0x00);
+      sd_send_data(csd, 16);
+    } break;
+    case 12: sd_streaming = false; sd_out.push_back(0x00); break;
+    case 13: sd_out.push_back(0x00); sd_out.push_back(0x00); break;
+    case 17:
+      if (!in_range) { sd_out.push_back(0x40); break; } // Parameter error
+      sd_out.push_back(0x00);
+      sd_out.push_back(0xFF);
+      sd_send_block(arg);
+      break;
+    case 18:
+      if (!in_range) { sd_out.push_back(0x40); break; }
+      sd_out.push_back(0x00);
+      sd_streaming = true;
+      sd_stream_gap = false;
+      sd_block = arg;
+      break;
+    case 24:
+      if (!in_range) { sd_out.push_back(0x40); break; }
+      sd_out.push_back(0x00);
+      sd_state = SD_WRITE_TOKEN;
+      sd_block = arg;
+      break;
+    default: sd_out.push_back(0x04);         // Illegal command
+  }
+}
+
+SimSPDR &SimSPDR::operator=(uint8_t b) {
+  if (sim_sd.empty()) { sd_spi_out = 0xFF; return *this; }
+
+  // A command stops a multiple block read
+  if (sd_state == SD_COMMAND && !sd_cmd_len && (b & 0xC0) == 0x40 && sd_streaming) {
+    sd_streaming = false;
+    sd_out.clear();
+  }
+  // A multiple block read sends the next block after a gap byte
+  if (sd_out.empty() && sd_streaming) {
+    if (sd_stream_gap && sd_send_block(sd_block)) sd_block++; else sd_out.push_back(0xFF);
+    sd_stream_gap = !sd_stream_gap;
+  }
+  if (sd_out.empty())
+    sd_spi_out = 0xFF;
+  else {
+    sd_spi_out = sd_out.front();
+    sd_out.pop_front();
+  }
+
+  switch (sd_state) {
+    case SD_COMMAND:
+      if (sd_cmd_len || (b & 0xC0) == 0x40) {
+        sd_cmd[sd_cmd_len++] = b;
+        if (sd_cmd_len == 6) { sd_cmd_len = 0; sd_command(); }
+      }
+      break;
+    case SD_WRITE_TOKEN:
+      if (b == 0xFE) { sd_state = SD_WRITE_DATA; sd_data_len = 0; }
+      break;
+    case SD_WRITE_DATA:
+      sd_data[sd_data_len++] = b;
+      if (sd_data_len == sizeof(sd_data)) {  // The block and its CRC
+        memcpy(&sim_sd[sd_block * 512], sd_data, 512);
+        sim_sd_writes++;
+        const uint8_t r[] = { 0x05, 0x00, 0x00 }; // Accepted, then busy
+        sd_out.insert(sd_out.end(), r, r + 3);
+        sd_state = SD_COMMAND;
+      }
+      break;
+  }
+  return *this;
+}
+SimSPDR::operator uint8_t() const { return sd_spi_out; }
+
+unsigned long millis() { sim_advance(); return sim_now() / (SIM_TIMER_RATE / 1000); }
+unsigned long micros() { sim_advance(); return sim_now() / (SIM_TIMER_RATE / 1000000); }
+static void sim_wait(const uint64_t ticks) { const uint64_t end = sim_now() + ticks; while (sim_now() < end) sim_advance(); }
+void delay(unsigned long ms) { sim_wait(ms * (SIM_TIMER_RATE / 1000)); }
+void delayMicroseconds(unsigned int us) { sim_wait(us * (SIM_TIMER_RATE / 1000000)); }
+void _delay_ms(double ms) { delay(ms); }
+void _delay_us(double us) { delayMicroseconds(us); }
+
+static uint8_t sim_eeprom[E2END + 1];
+static bool sim_eeprom_ready;
+static uint8_t *sim_eeprom_at(const void *p) {
+  if (!sim_eeprom_ready) { memset(sim_eeprom, 0xFF, sizeof(sim_eeprom)); sim_eeprom_ready = true; }
+  return &sim_eeprom[uintptr_t(p) & E2END];
+}
+uint8_t eeprom_read_byte(const uint8_t *p) { return *sim_eeprom_at(p); }
+void eeprom_write_byte(uint8_t *p, uint8_t v) { *sim_eeprom_at(p) = v; }
+void eeprom_update_byte(uint8_t *p, uint8_t v) { *sim_eeprom_at(p) = v; }
+void eeprom_read_block(void *d, const void *s, size_t n) { for (size_t i = 0; i < n; i++) ((uint8_t*)d)[i] = *sim_eeprom_at((const uint8_t*)s + i); }
+void eeprom_update_block(const void *s, void *d, size_t n) { for (size_t i = 0; i < n; i++) *sim_eeprom_at((uint8_t*)d + i) = ((const uint8_t*)s)[i]; }
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+int digitalRead(uint8_t) { return LOW; }
+int analogRead(uint8_t) { return 0; }
+void analogWrite(uint8_t, int) {}
+void attachInterrupt(uint8_t, void (*)(void), int) {}
+void detachInterrupt(uint8_t) {}
+long map(long x, long in_min, long in_max, long out_min, long out_max) { return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min; }
+long random(long h) { return h > 0 ? rand() % h : 0; }
+long random(long l, long h) { return l + random(h - l); }
+void randomSeed(unsigned long s) { srand(s); }
+char *dtostrf(double v, signed char w, unsigned char p, char *s) { sprintf(s, "%*.*f", w, p, v); return s; }
+void wdt_enable(int) {}
+void wdt_reset() {}
+void wdt_disable() {}
+char *__brkval, __bss_end;
+'''
+
+SIM_MAIN_CPP = r'''// Run G-code through setup(), parser.parse() and process_parsed_command(), or run a check
+#include "Marlin.h"
+#include "planner.h"
+#include "temperature.h"
+#include "parser.h"
+
+void setup();
+void process_parsed_command();
+void sim_start(const double slowdown, const bool verbose);
+uint64_t sim_now();
+extern unsigned long sim_isr_count, sim_rate_lookups;
+int sim_check(const char *gcode, const unsigned seed) __attribute__((weak)); // Of a --check
+
+// Of a check with a "// Reference:" line, written by the reference build and read by the one checked
+FILE *sim_reference;
+bool sim_reference_build;
+
+// On the AVR unsigned int is uint16_t, here it needs its own
+void serial_echopair_PGM(const char* s_P, unsigned int v) { serial_echopair_PGM(s_P, (unsigned long)v); }
+
+void sim_setup() {
+  setup();
+  #if ENABLED(PREVENT_COLD_EXTRUSION)
+    thermalManager.allow_cold_extrude = true;
+  #endif
+}
+
+void sim_command(const char *cmd) {
+  char buf[MAX_CMD_SIZE];
+  strncpy(buf, cmd, sizeof(buf) - 1);
+  buf[sizeof(buf) - 1] = '\0';
+  parser.parse(buf);
+  process_parsed_command();
+  idle();
+}
+
+int main(int argc, char **argv) {
+  if (argc < 5) return 2;
+  sim_start(atof(argv[1]), atoi(argv[2]));
+  if (argc > 6) {
+    sim_reference_build = argv[6][0] == 'w';
+    if (!(sim_reference = fopen(argv[5], argv[6]))) return 2;
+  }
+  if (sim_check) return sim_check(argv[3], atoi(argv[4]));
+  sim_setup();
+  FILE *f = fopen(argv[3], "r");
+  if (!f) return 2;
+  char line[256];
+  unsigned long lines = 0;
+  while (fgets(line, sizeof(line), f)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    sim_command(line);
+    lines++;
+  }
+  fclose(f);
+  planner.synchronize();
+  const uint64_t ticks = sim_now();
+  sim_command("M930");
+  printf("Simulated %lu lines in %lu ms, %lu stepper ISR calls, %lu step rate lookups\n",
+         lines, (unsigned long)(ticks / (STEPPER_TIMER_RATE / 1000)), sim_isr_count, sim_rate_lookups);
+  return 0;
+}
+'''
+
+marlin = os.path.abspath(args.marlin)
+
+# A check, the options it builds with from its "// Options:" line, and the
+# changes of its reference build from a "// Reference:" line of -e and -d
+check_source, check_options, reference = None, [], None
+if args.check:
+  path = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'motionSimChecks', args.check + '.cpp')
+  if not os.path.exists(path): sys.exit('No check %s' % path)
+  with open(path) as f: check_source = f.read()
+  m = re.search(r'^// Options: (.*)$', check_source, re.M)
+  if m: check_options = m.group(1).split()
+  m = re.search(r'^// Reference: (.*)$', check_source, re.M)
+  if m:
+    words = m.group(1).split()
+    if len(words) % 2 or any(w not in ('-e', '-d') for w in words[::2]): sys.exit('Bad // Reference: line in %s' % path)
+    reference = list(zip(words[::2], words[1::2]))
+  m = re.search(r'^// Slowdown: (.*)$', check_source, re.M)
+  if m and args.slowdown is None: args.slowdown = float(m.group(1))
+  m = re.search(r'^// Config: (.*)$', check_source, re.M)
+  if m and not args.config: args.config = m.group(1).strip()
+if args.slowdown is None: args.slowdown = 40.0
+
+def set_option(text, name, value, enable):
+  """ Enable (with an optional value) or disable a #define of a configuration file """
+  if enable:
+    rep = (lambda m: m.group(1) + '#define ' + name + (' ' + value if value is not None else m.group(2)))
+    text, n = re.subn(r'^(\s*)(?://\s*)?#define %s\b([^\n]*)' % name, rep, text, 1, re.M)
+  else:
+    text, n = re.subn(r'^(\s*)#define %s\b' % name, r'\1//#define %s' % name, text, 0, re.M)
+  return text, n
+
+def configure(src, extra=()):
+  """ Put the configuration into the build, without LCD and SD card """
+  cfg_dir = os.path.join(marlin, 'example_configurations', args.config) if args.config else marlin
+  if args.config and not os.path.isdir(cfg_dir): cfg_dir = args.config
+  files = {}
+  for name in ('Configuration.h', 'Configuration_adv.h'):
+    path = os.path.join(cfg_dir, name)
+    if not os.path.exists(path): path = os.path.join(marlin, name)
+    with open(path) as f: files[name] = f.read()
+
+  cfg = files['Configuration.h']
+  start = cfg.find('LCD and SD support')
+  end = cfg.find('@section extras', start)
+  if start > 0 and end > 0:
+    cfg = cfg[:start] + re.sub(r'^(\s*)#define ', r'\1//#define ', cfg[start:end], 0, re.M) + cfg[end:]
+  files['Configuration.h'] = cfg
+
+  changes = [('MOTION_STATS', None, True), ('TX_BUFFER_SIZE', '0', True)]
+  changes += [(o.split('=', 1)[0], o.split('=', 1)[1] if '=' in o else None, True) for o in check_options]
+  changes += [(o.split('=', 1)[0], o.split('=', 1)[1] if '=' in o else None, True) for o in args.enable]
+  changes += [(o, None, False) for o in args.disable]
+  changes += [(o.split('=', 1)[0], o.split('=', 1)[1] if '=' in o else None, flag == '-e') for flag, o in extra]
+  changes += [(o, None, False) for o in SIM_DISABLE]
+  for name, value, enable in changes:
+    found = 0
+    for f in files:
+      files[f], n = set_option(files[f], name, value, enable)
+      found += n
+    if enable and not found:
+      sys.exit('%s is not an option of the configuration' % name)
+  for name in files:
+    with open(os.path.join(src, name), 'w') as f: f.write(files[name])
+  return files['Configuration.h']
+
+def patch_sources(src):
+  """ Swap the AVR asm and the naked ISRs for host code """
+  path = os.path.join(src, 'HAL.h')
+  with open(path) as f: hal = f.read()
+  for isr in ('TIMER1_COMPA_vect', 'TIMER0_COMPB_vect'):
+    name = 'HAL_STEP_TIMER_ISR' if isr == 'TIMER1_COMPA_vect' else 'HAL_TEMP_TIMER_ISR'
+    hal, n = re.subn(r'#define %s \\\n.*?\nvoid %s_bottom\(void\)\n' % (name, isr),
+                     '#define %s extern "C" void %s(void)\n' % (name, isr), hal, 1, re.S)
+    if not n: sys.exit('No %s in HAL.h' % name)
+  with open(path, 'w') as f: f.write(hal)
+  with open(os.path.join(src, 'delay.h'), 'w') as f: f.write(SIM_DELAY_H)
+  for name, head, body in SIM_FUNCTIONS:
+    path = os.path.join(src, name)
+    with open(path) as f: text = f.read()
+    i = text.find(head)
+    if i < 0: sys.exit('No %s in %s' % (head, name))
+    indent = text[text.rfind('\n', 0, i) + 1:i]
+    j = text.index('\n' + indent + '}\n', i)
+    text = text[:i] + head + '\n' + indent + '  ' + body + text[j:]
+    with open(path, 'w') as f: f.write(text)
+  for name, old, new in SIM_REPLACES:
+    path = os.path.join(src, name)
+    with open(path) as f: text = f.read()
+    if old not in text: sys.exit('No %s in %s' % (old, name))
+    with open(path, 'w') as f: f.write(text.replace(old, new))
+
+def build(work, src):
+  """ Build the sources, declaring the registers the compiler asks for """
+  hal = os.path.join(work, 'hal')
+  for name in SIM_HEADERS:
+    path = os.path.join(hal, name)
+    if not os.path.isdir(os.path.dirname(path)): os.makedirs(os.path.dirname(path))
+    with open(path, 'w') as f: f.write(SIM_HEADERS[name])
+  for name, text in (('sim_hal.cpp', SIM_HAL_CPP), ('sim_main.cpp', SIM_MAIN_CPP)):
+    with open(os.path.join(src, name), 'w') as f: f.write(text)
+  if check_source:
+    with open(os.path.join(src, 'sim_check.cpp'), 'w') as f: f.write(check_source)
+
+  # The board of the pins file: the ATmega2560, or else the Sanguino ATmega1284P
+  mcus = ['__AVR_ATmega2560__', '__AVR_ATmega1284P__']
+  env = dict(os.environ, LC_ALL='C')
+  sources = sorted(f for f in os.listdir(src) if f.endswith('.cpp'))
+  todo, regs, warnings = sources, set(), {}
+  while todo:
+    with open(os.path.join(hal, 'avr', 'regs.h'), 'w') as f:
+      f.write(''.join(declare_reg(r) for r in sorted(regs)))
+    # ENABLED() and the like expand to defined()
+    flags = ['-std=gnu++11', '-O2', '-Wall', '-Wextra', '-Wno-expansion-to-defined', '-D__AVR__', '-D' + mcus[0], '-DF_CPU=16000000UL',
+             '-DARDUINO=10805', '-I' + hal, '-I' + os.path.join(hal, 'avr')]
+    failed, new, wrong_mcu = [], set(), False
+    for i in range(0, len(todo), multiprocessing.cpu_count()):
+      jobs = [(name, subprocess.Popen([args.cxx] + flags + ['-c', '-o', name[:-4] + '.o', name], cwd=src, env=env,
+                                      stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True))
+              for name in todo[i:i + multiprocessing.cpu_count()]]
+      for name, job in jobs:
+        out = job.communicate()[0]
+        if not job.returncode:
+          warnings[name] = [w for w in re.findall(r'^\S+:\d+:\d+: warning: .*$', out, re.M)
+                            if not any(re.search(p, w) for p in SIM_WARNINGS)]
+          continue
+        failed.append(name)
+        found = set(re.findall(r"'([A-Z][A-Z0-9_]*)' was not declared", out)) - regs
+        if 'Oops!' in out and len(mcus) > 1: wrong_mcu = True
+        elif not found: sys.exit(out)
+        new |= found
+    if wrong_mcu:
+      mcus.pop(0)
+      todo = sources
+    else:
+      todo = failed
+    regs |= new
+
+  new = [w for name in sorted(warnings) for w in warnings[name]]
+  if new:
+    print('\n'.join(new))
+    sys.exit('%d new warnings' % len(new))
+
+  with open(os.path.join(src, 'sim_regs.cpp'), 'w') as f:
+    f.write('#include <stdint.h>\n' + ''.join('volatile uint%d_t %s;\n' % (16 if r in WIDE_REGS else 8, r) for r in sorted(regs) if not PIN_BIT.match(r)))
+  objs = sorted(f[:-4] + '.o' for f in os.listdir(src) if f.endswith('.cpp'))
+  subprocess.check_call([args.cxx, '-c', '-o', 'sim_regs.o', 'sim_regs.cpp'], cwd=src)
+  subprocess.check_call([args.cxx, '-o', 'motionsim'] + objs, cwd=src)
+  return os.path.join(src, 'motionsim')
+
+def config_value(cfg, name, default):
+  m = re.search(r'^\s*#define %s\s+([-0-9.]+)' % name, cfg, re.M)
+  return float(m.group(1)) if m else default
+
+def test_print(cfg, path):
+  """ Per layer a circle of short chords and random infill lines, around the middle of the bed """
+  random.seed(args.seed)
+  centered = re.search(r'^\s*#define (DELTA|HANGPRINTER)\b', cfg, re.M)
+  size = min(config_value(cfg, 'X_BED_SIZE', 200), config_value(cfg, 'Y_BED_SIZE', 200))
+  if centered: size = 2 * config_value(cfg, 'DELTA_PRINTABLE_RADIUS', 60)
+  cx, cy = (0, 0) if centered else (size / 2, size / 2)
+  r = size / 5
+  feed = args.feedrate * 60
+  e, ratio = 0.0, 0.033
+  lines = ['G90', 'M82', 'G28', 'G92 E0']
+  for layer in range(args.layers):
+    lines.append('G1 Z%.2f F600' % (0.2 * (layer + 1)))
+    n = max(3, int(2 * math.pi * r / args.segment))
+    lines.append('G0 X%.3f Y%.3f F6000' % (cx + r, cy))
+    for i in range(1, n + 1):
+      a = 2 * math.pi * i / n
+      e += 2 * r * math.sin(math.pi / n) * ratio
+      lines.append('G1 X%.3f Y%.3f E%.5f F%d' % (cx + r * math.cos(a), cy + r * math.sin(a), e, feed))
+    x, y = cx, cy
+    for i in range(40):
+      nx, ny = cx + random.uniform(-r, r) * 0.7, cy + random.uniform(-r, r) * 0.7
+      e += math.hypot(nx - x, ny - y) * ratio
+      lines.append('G1 X%.3f Y%.3f E%.5f F%d' % (nx, ny, e, feed))
+      x, y = nx, ny
+  with open(path, 'w') as f: f.write('\n'.join(lines) + '\n')
+
+def prepare(gcode, path):
+  """ Strip comments, checksums and the commands the simulation can't run """
+  skip = set(['M104', 'M109', 'M140', 'M190', 'M141', 'M191', 'M303', 'G29', 'M0', 'M1'])
+  out = []
+  with open(gcode) as f:
+    for line in f:
+      line = re.sub(r'^N\d+\s*|\*\d+\s*$', '', line.split(';', 1)[0].strip()).strip()
+      if not line: continue
+      word = line.split()[0].upper()
+      if word in skip: continue
+      if word == 'G28': out.append('M211 S0'); line = 'G92 X0 Y0 Z0'
+      out.append(line)
+  with open(path, 'w') as f: f.write('\n'.join(out) + '\n')
+  return len(out)
+
+def make(work, extra=()):
+  """ Configure, patch and build a copy of the sources in work """
+  src = os.path.join(work, 'src')
+  os.makedirs(src)
+  for name in os.listdir(marlin):
+    if name.endswith(('.cpp', '.h')): shutil.copy(os.path.join(marlin, name), src)
+  cfg = configure(src, extra)
+  patch_sources(src)
+  return cfg, build(work, src)
+
+work = tempfile.mkdtemp(prefix='motionsim')
+try:
+  print('Building in %s' % work)
+  cfg, sim = make(work)
+  if reference:
+    print('Building the reference with %s' % ' '.join(' '.join(r) for r in reference))
+    ref_sim = make(os.path.join(work, 'reference'), reference)[1]
+
+  gcode = args.gcode
+  if not gcode:
+    gcode = os.path.join(work, 'test.gcode')
+    test_print(cfg, gcode)
+  lines = prepare(gcode, os.path.join(work, 'run.gcode'))
+  run = [str(args.slowdown), '1' if args.verbose else '0', os.path.join(work, 'run.gcode'), str(args.seed)]
+  if reference:
+    print('Running the reference')
+    sys.stdout.flush()
+    run.append(os.path.join(work, 'reference.txt'))
+    code = subprocess.call([ref_sim] + run + ['w'])
+    if code: sys.exit('The reference exited with %d' % code)
+    run.append('r')
+  print('Running %d lines at --slowdown %g' % (lines, args.slowdown))
+  sys.stdout.flush()
+  t0 = time.time()
+  code = subprocess.call([sim] + run)
+  print('Host time %.2f s' % (time.time() - t0))
+  if code: sys.exit('The simulation exited with %d' % code)
+finally:
+  if args.keep:
+    print('Kept %s' % work)
+  else:
+    shutil.rmtree(work, True)
@@ -0,0 +1,349 @@
+/**
+ * motionSim.py --check commandQueue [print.gcode]
+ *
+ * Check the command queue of Marlin_main.cpp, packed into one arena with
+ * COMMAND_QUEUE_ARENA. Commands of random length are queued with
+ * enqueue_and_echo_command(), sent over the serial port and read from a file
+ * on the SD card, and loop() runs them, M118 echoing their text. After each
+ * step the commands the queue holds are walked with NEXT_QUEUED_COMMAND() and
+ * compared with the ones expected, so a command that overwrote another or a
+ * wrap in the wrong place shows up. The file raises Z every few commands, and
+ * after each power-loss recovery save check_print_job_recovery() must rebuild
+ * the queued commands from the card.
+ *
+ * Then the queue is filled with short commands, with the longest ones, and
+ * with one that ends at the last byte of the arena. Last, the G-code (without
+ * one, the test print) is streamed over the serial port and the commands the
+ * queue holds are counted each time one runs. For the BUFSIZE slots in the
+ * same SRAM run it with -d COMMAND_QUEUE_ARENA -e BUFSIZE=4.
+ */
+// Options: COMMAND_QUEUE_ARENA BUFSIZE=16 SDSUPPORT POWER_LOSS_RECOVERY
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "Marlin.h"
+#include "planner.h"
+#include "cardreader.h"
+#include "power_loss_recovery.h"
+
+void loop();
+void sim_setup();
+void sim_serial_rx(const char *s, const size_t n);
+void sim_sd_format(const uint16_t clusters, const uint8_t cluster_blocks);
+extern void (*sim_serial_line)(const char *line);
+
+extern uint8_t commands_in_queue;
+extern cmd_queue_index_t cmd_queue_index_r, cmd_queue_index_w;
+#if ENABLED(COMMAND_QUEUE_ARENA)
+  extern char command_queue[COMMAND_QUEUE_ARENA_SIZE];
+  #define RECORD_SIZE (MAX_CMD_SIZE + 1)
+#else
+  extern char command_queue[BUFSIZE][MAX_CMD_SIZE];
+#endif
+
+#define RANDOM_STEPS 20000
+#define FILE_LINES 3000
+
+static unsigned long failures;
+#define CHECK(COND, ...) do{ if (!(COND) && failures++ < 20) { printf("FAIL " __VA_ARGS__); printf("\n"); } }while(0)
+
+typedef std::deque<std::string> commands_t;
+static commands_t queued,         // What the queue should hold, oldest first
+                  echoed;         // Text of the M118 commands run
+static std::string serial_line;   // Sent and not yet queued
+static std::vector<std::string> file_lines;
+static std::vector<uint32_t> file_ends; // Offset of the '\r' ending each line
+static unsigned long next_id, oks, oks_expected, wraps, full_count, full_bytes, recoveries;
+
+static void on_line(const char *line) {
+  if (!strncmp(line, "ok", 2)) oks++;
+  else if (line[0] == 'q') echoed.push_back(line);
+}
+
+// A command of a length, from the shortest M118 up to MAX_CMD_SIZE - 1
+static std::string command(size_t length) {
+  char id[24];
+  sprintf(id, "M118 q%lu ", next_id++);
+  std::string cmd(id);
+  if (length > MAX_CMD_SIZE - 1) length = MAX_CMD_SIZE - 1;
+  if (length > cmd.size()) cmd.append(length - cmd.size(), 'x');
+  return cmd;
+}
+
+static std::string random_command(const bool short_only) {
+  const long kind = short_only ? 50 : random(100);
+  return command(kind < 5 ? MAX_CMD_SIZE - 1 : kind < 40 ? 10 + random(4) : 24 + random(16));
+}
+
+static commands_t live_queue() {
+  commands_t live;
+  cmd_queue_index_t r = cmd_queue_index_r;
+  for (uint8_t i = 0; i < commands_in_queue; i++) {
+    live.push_back(QUEUED_COMMAND(command_queue, r));
+    r = NEXT_QUEUED_COMMAND(command_queue, r);
+  }
+  return live;
+}
+
+#if ENABLED(COMMAND_QUEUE_ARENA)
+  // The most bytes a command could start in
+  static int free_bytes() {
+    const int r = cmd_queue_index_r, w = cmd_queue_index_w;
+    if (w < r || (commands_in_queue && w == r)) return r - w;
+    return max(COMMAND_QUEUE_ARENA_SIZE - w, r);
+  }
+#endif
+
+// The lines of the SD file read into the queue so far, all of them once it's closed
+static size_t file_lines_read() {
+  if (!card.isFileOpen()) return file_ends.size();
+  size_t n = 0;
+  while (n < file_ends.size() && file_ends[n] <= card.getIndex()) n++;
+  return n;
+}
+
+#if ENABLED(POWER_LOSS_RECOVERY)
+
+  /**
+   * The power goes off after a save: the commands rebuilt from the card must be
+   * the ones queued. loop() saves after running a command and then idle() reads
+   * more, so the queue saved holds those queued before loop() and maybe more.
+   */
+  static void check_recovery(const commands_t &queue, const size_t held) {
+    card.closeJobRecoveryFile();
+    check_print_job_recovery();
+    std::vector<std::string> cmds;
+    #if ENABLED(COMMAND_QUEUE_ARENA)
+      const char *c = job_recovery_commands;
+      for (uint8_t i = 0; i < job_recovery_commands_count; i++, c += strlen(c) + 1) cmds.push_back(c);
+      CHECK(size_t(c - job_recovery_commands) <= sizeof(job_recovery_commands), "recovery took %d bytes", int(c - job_recovery_commands));
+    #else
+      for (uint8_t i = 0; i < job_recovery_commands_count; i++) cmds.push_back(job_recovery_commands[i]);
+    #endif
+    // The queued commands are followed by M23 and M24
+    size_t n = min(queue.size(), cmds.size() < 2 ? 0 : cmds.size() - 2);
+    while (n && n >= held && !std::equal(queue.begin(), queue.begin() + n, cmds.end() - 2 - n)) n--;
+    CHECK(n >= max(held, size_t(1)), "recovered %d of the %d commands queued", int(n), int(max(held, size_t(1))));
+    CHECK(cmds.size() >= 2 && !strncmp(cmds[cmds.size() - 2].c_str(), "M23 ", 4), "recovery ends with %s", cmds.empty() ? "nothing" : cmds.back().c_str());
+    job_recovery_commands_count = 0;
+    recoveries++;
+  }
+
+#endif
+
+// Run loop() once: it reads serial and SD commands into the queue, then runs the oldest
+static void run_loop() {
+  const size_t file_before = file_lines_read();
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    const size_t held = queued.size();
+    const uint8_t saves = job_recovery_info.valid_head;
+  #endif
+  loop();
+
+  if (!serial_line.empty() && !MYSERIAL0.available()) {
+    queued.push_back(serial_line);
+    serial_line.clear();
+  }
+  for (size_t i = file_before, n = file_lines_read(); i < n; i++) queued.push_back(file_lines[i]);
+  if (queued.empty()) return;
+
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    const commands_t queue = queued;
+  #endif
+  const std::string ran = queued.front();
+  queued.pop_front();
+  if (!strncmp(ran.c_str(), "M118 ", 5)) {
+    CHECK(!echoed.empty() && echoed.front() == ran.substr(5), "ran %s instead of %s", echoed.empty() ? "nothing" : echoed.front().c_str(), ran.c_str());
+    if (!echoed.empty()) echoed.pop_front();
+  }
+  CHECK(echoed.empty(), "ran %s instead of %s", echoed.front().c_str(), ran.c_str());
+  echoed.clear();
+  #if ENABLED(POWER_LOSS_RECOVERY)
+    if (job_recovery_info.valid_head && job_recovery_info.valid_head != saves) check_recovery(queue, held);
+  #endif
+}
+
+static bool check_queue(const char * const when) {
+  const commands_t live = live_queue();
+  CHECK(live == queued, "%s: the queue holds %d commands, %d expected%s%s", when, int(live.size()), int(queued.size()),
+        live.empty() ? "" : ", first ", live.empty() ? "" : live.front().c_str());
+  #if ENABLED(COMMAND_QUEUE_ARENA)
+    // The flags of the commands from the serial port ask for an "ok"
+    cmd_queue_index_t r = cmd_queue_index_r;
+    for (uint8_t i = 0; i < commands_in_queue; i++, r = NEXT_QUEUED_COMMAND(command_queue, r))
+      CHECK(uint8_t(command_queue[r]) <= 1, "%s: flags %d at %d", when, uint8_t(command_queue[r]), int(r));
+  #endif
+  return live == queued;
+}
+
+static void drain() {
+  while (commands_in_queue || card.sdprinting || !serial_line.empty()) run_loop();
+  check_queue("drained");
+}
+
+// Commands from enqueue_and_echo_command(), the serial port and an SD file, run in random order
+static void random_steps() {
+  char name[] = "queue.gco";
+  card.openFile(name, false);
+  for (uint32_t i = 0, pos = 0; i < FILE_LINES; i++) {
+    char buf[MAX_CMD_SIZE + 3];
+    if (i % 25 == 24) sprintf(buf, "G1 Z%d.%d F600", int(i / 250), int(i / 25 % 10));
+    else strcpy(buf, random_command(false).c_str());
+    file_lines.push_back(buf);
+    pos += strlen(buf);
+    file_ends.push_back(pos);
+    pos += 2;
+    card.write_command(buf);
+  }
+  card.closefile();
+  card.openFile(name, true);
+  card.startFileprint();
+
+  for (unsigned long step = 0; step < RANDOM_STEPS && !failures; step++) {
+    const bool short_only = (step / 500) & 1;
+    const uint8_t before = commands_in_queue;
+    const cmd_queue_index_t w = cmd_queue_index_w;
+    const long op = random(100);
+    if (op < 35) {
+      const std::string cmd = random_command(short_only);
+      if (enqueue_and_echo_command(cmd.c_str()))
+        queued.push_back(cmd);
+      else if (commands_in_queue >= BUFSIZE)
+        full_count++;
+      else {
+        full_bytes++;
+        #if ENABLED(COMMAND_QUEUE_ARENA)
+          // Refused with room for more commands, so the free bytes must be short
+          CHECK(free_bytes() < RECORD_SIZE, "step %lu: refused with %d free bytes", step, free_bytes());
+        #endif
+      }
+    }
+    else if (op < 50 && serial_line.empty()) {
+      serial_line = random_command(short_only);
+      oks_expected++;
+      sim_serial_rx((serial_line + "\n").c_str(), serial_line.size() + 1);
+    }
+    else
+      run_loop();
+    if (before && cmd_queue_index_w < w) wraps++;
+    if (!check_queue("random steps")) break;
+  }
+  drain();
+  CHECK(oks == oks_expected, "%lu ok for %lu serial commands", oks, oks_expected);
+  printf("%d steps: %lu wraps, full %lu times at BUFSIZE and %lu by bytes, %lu recoveries\n",
+         RANDOM_STEPS, wraps, full_count, full_bytes, recoveries);
+  #if ENABLED(COMMAND_QUEUE_ARENA)
+    CHECK(wraps || COMMAND_QUEUE_ARENA_SIZE < 2 * RECORD_SIZE, "the arena never wrapped");
+  #endif
+  CHECK(full_bytes || full_count, "the queue was never full");
+}
+
+static void fill(const size_t length) {
+  std::string cmd;
+  while (enqueue_and_echo_command((cmd = command(length)).c_str())) queued.push_back(cmd);
+  check_queue("full");
+}
+
+static void fill_cases() {
+  // Short commands stop at BUFSIZE
+  fill(10);
+  #if ENABLED(COMMAND_QUEUE_ARENA)
+    CHECK(commands_in_queue == BUFSIZE || free_bytes() < RECORD_SIZE, "short commands: %d queued", commands_in_queue);
+  #else
+    CHECK(commands_in_queue == BUFSIZE, "short commands: %d queued", commands_in_queue);
+  #endif
+  drain();
+
+  // The longest commands stop where BUFSIZE slots in the same bytes would
+  fill(MAX_CMD_SIZE - 1);
+  #if ENABLED(COMMAND_QUEUE_ARENA)
+    CHECK(commands_in_queue == min(BUFSIZE, COMMAND_QUEUE_ARENA_SIZE / RECORD_SIZE), "longest commands: %d queued", commands_in_queue);
+  #else
+    CHECK(commands_in_queue == BUFSIZE, "longest commands: %d queued", commands_in_queue);
+  #endif
+  drain();
+
+  #if ENABLED(COMMAND_QUEUE_ARENA)
+    // Commands up to where the longest one ends at the last byte, leaving room for the shortest
+    const int last = COMMAND_QUEUE_ARENA_SIZE - RECORD_SIZE;
+    std::string cmd;
+    while (cmd_queue_index_w < last && commands_in_queue < BUFSIZE - 2) {
+      const int left = last - cmd_queue_index_w;
+      cmd = command(left <= RECORD_SIZE ? left - 2 : min(MAX_CMD_SIZE - 1, left - 22));
+      if (!enqueue_and_echo_command(cmd.c_str())) break;
+      queued.push_back(cmd);
+    }
+    if (cmd_queue_index_w != last || COMMAND_QUEUE_ARENA_SIZE < 2 * RECORD_SIZE) {
+      printf("Fill cases checked, without wrapping (the arena or BUFSIZE is too small)\n");
+      drain();
+      return;
+    }
+    // The longest one ends at the last byte, and the next one wraps
+    cmd = command(MAX_CMD_SIZE - 1);
+    CHECK(enqueue_and_echo_command(cmd.c_str()) && cmd_queue_index_w == COMMAND_QUEUE_ARENA_SIZE, "last byte: w=%d", int(cmd_queue_index_w));
+    queued.push_back(cmd);
+    while (cmd_queue_index_r < RECORD_SIZE) run_loop();
+    const std::string after = command(10);
+    CHECK(enqueue_and_echo_command(after.c_str()) && cmd_queue_index_w < cmd_queue_index_r,
+          "wrap after the last byte: r=%d w=%d", int(cmd_queue_index_r), int(cmd_queue_index_w));
+    queued.push_back(after);
+    check_queue("wrap after the last byte");
+    while (queued.front() != after) run_loop();
+    CHECK(cmd_queue_index_r == 0, "read past the last byte: r=%d", int(cmd_queue_index_r));
+    check_queue("read past the last byte");
+
+    // Emptying the queue starts over at 0
+    run_loop();
+    fill(10);
+    CHECK(cmd_queue_index_r == 0, "empty queue: r=%d", int(cmd_queue_index_r));
+    drain();
+  #endif
+  printf("Fill cases checked\n");
+}
+
+// Stream the G-code as fast as the serial buffer takes it, and count the commands queued
+static void capacity(const char *gcode) {
+  FILE *f = fopen(gcode, "r");
+  if (!f) { CHECK(false, "no %s", gcode); return; }
+  queued.clear();
+  unsigned long runs = 0, held = 0, least = BUFSIZE, lines = 0;
+  char line[MAX_CMD_SIZE + 2];
+  bool more = fgets(line, sizeof(line), f);
+  while (more || commands_in_queue || MYSERIAL0.available()) {
+    while (more && strlen(line) < size_t(RX_BUFFER_SIZE - 1 - MYSERIAL0.available())) {
+      sim_serial_rx(line, strlen(line));
+      lines++;
+      more = fgets(line, sizeof(line), f);
+    }
+    if (more && commands_in_queue) {
+      runs++;
+      held += commands_in_queue;
+      least = min(least, (unsigned long)commands_in_queue);
+    }
+    loop();
+  }
+  fclose(f);
+  planner.synchronize();
+  printf("%lu lines: the queue held %.1f commands on average and %lu at least, of BUFSIZE %d\n",
+         lines, runs ? double(held) / runs : 0.0, least, BUFSIZE);
+  #if ENABLED(COMMAND_QUEUE_ARENA)
+    const int slots = COMMAND_QUEUE_ARENA_SIZE / RECORD_SIZE;
+    CHECK(BUFSIZE <= slots || held >= runs * slots, "the arena held fewer commands than %d slots in its bytes", slots);
+  #endif
+}
+
+int sim_check(const char *gcode, const unsigned seed) {
+  randomSeed(seed);
+  sim_sd_format(4200, 4);
+  sim_setup();
+  sim_serial_line = on_line;
+  card.initsd();
+  CHECK(card.cardOK, "no SD card");
+  if (card.cardOK) random_steps();
+  if (!failures) fill_cases();
+  if (!failures) capacity(gcode);
+  printf("%lu failures\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * motionSim.py --check hangprinterFk
+ *
+ * Compare the Hangprinter forward kinematics of HANGPRINTER_FK_LEAST_SQUARES
+ * with the closed form of the reference build. The motors are set to the step
+ * counts of random positions (--seed) across the printable volume, from their
+ * line lengths in double precision through the spool model on the k0, k1, k2
+ * and sqrtk1 the firmware derived, and get_cartesian_from_steppers() takes the
+ * position back from them. The distance from the true position includes the
+ * step quantization.
+ *
+ * A least squares fit whose RMS or max error is over that of the closed form,
+ * or whose max error is over LIMIT, is a failure.
+ */
+// Config: hangprinter
+// Options: HANGPRINTER_FK_LEAST_SQUARES
+// Reference: -d HANGPRINTER_FK_LEAST_SQUARES
+// Slowdown: 0
+
+#include <cmath>
+
+#include "Marlin.h"
+#include "planner.h"
+#include "stepper.h"
+
+void sim_setup();
+extern FILE *sim_reference;
+extern bool sim_reference_build;
+
+void get_cartesian_from_steppers();
+extern float cartes[XYZ];
+
+#define POSITIONS 5000
+#define LIMIT 0.05        // mm
+
+static unsigned long failures;
+#define CHECK(COND, ...) do{ if (!(COND) && failures++ < 20) { printf("FAIL " __VA_ARGS__); printf("\n"); } }while(0)
+
+static double uniform(const double lo, const double hi) {
+  return lo + (hi - lo) * random(100000) / 100000.0;
+}
+
+struct Result {
+  double max_error, rms;
+  void write(FILE *f) const { fprintf(f, "%g %g\n", max_error, rms); }
+  bool read(FILE *f) { return fscanf(f, "%lg %lg", &max_error, &rms) == 2; }
+  void print(const char * const name) const { printf("  %-14s max error %7.4f mm  rms %7.4f mm\n", name, max_error, rms); }
+};
+
+int sim_check(const char *, const unsigned seed) {
+  randomSeed(seed);
+  sim_setup();
+
+  const double anchor[ABCD][XYZ] = {
+    { 0,          anchor_A_y, anchor_A_z },
+    { anchor_B_x, anchor_B_y, anchor_B_z },
+    { anchor_C_x, anchor_C_y, anchor_C_z },
+    { 0,          0,          anchor_D_z }
+  };
+  double sum_sq = 0;
+  Result r = { 0, 0 };
+  for (int n = 0; n < POSITIONS; n++) {
+    const double radius = HANGPRINTER_PRINTABLE_RADIUS * 0.9 * sqrt(uniform(0, 1)), angle = uniform(0, 2 * M_PI),
+                 p[XYZ] = { radius * cos(angle), radius * sin(angle), uniform(0, 1000) };
+    int32_t steps[ABCD];
+    LOOP_MOV_AXIS(i) {
+      const double l = sqrt(sq(p[X_AXIS] - anchor[i][X_AXIS]) + sq(p[Y_AXIS] - anchor[i][Y_AXIS]) + sq(p[Z_AXIS] - anchor[i][Z_AXIS]));
+      steps[i] = lround(double(planner.k0[i]) * (sqrt(double(planner.k1[i]) + double(planner.k2[i]) * l) - sqrt(double(planner.k1[i]))));
+    }
+    stepper.set_position(steps[A_AXIS], steps[B_AXIS], steps[C_AXIS], steps[D_AXIS], 0);
+    get_cartesian_from_steppers();
+    const double error = sqrt(sq(cartes[X_AXIS] - p[X_AXIS]) + sq(cartes[Y_AXIS] - p[Y_AXIS]) + sq(cartes[Z_AXIS] - p[Z_AXIS]));
+    NOLESS(r.max_error, error);
+    sum_sq += sq(error);
+  }
+  r.rms = sqrt(sum_sq / POSITIONS);
+
+  if (sim_reference_build)
+    r.write(sim_reference);
+  else {
+    Result closed;
+    CHECK(closed.read(sim_reference), "no reference figures");
+    printf("%d positions, %d iterations\n", POSITIONS, HANGPRINTER_FK_ITERATIONS);
+    closed.print("closed-form");
+    r.print("least-squares");
+    CHECK(r.rms <= closed.rms && r.max_error <= closed.max_error, "the least squares fit is further off than the closed form");
+    CHECK(r.max_error <= LIMIT, "the least squares fit is up to %.4f mm off", r.max_error);
+  }
+  printf("%lu failures\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,238 @@
+/**
+ * motionSim.py --check inputShaping
+ *
+ * Check the residual vibration INPUT_SHAPING leaves. X moves of random length
+ * (--seed), each from rest to rest with a pause after it, run unshaped
+ * (M593 F0) and with each shaper at INPUT_SHAPING_X_FREQ and _ZETA. The X step
+ * pulses drive a damped oscillator at that frequency: the toolhead on a frame
+ * ringing at it. The vibration each move leaves, one damped period after its
+ * last planned step, is compared (as an RMS over the moves) with that of the
+ * unshaped steps, at the frequency the shaper is set to and DETUNE off either
+ * way. Steps of 1/steps_per_mm leave some vibration of their own, so the
+ * unshaped steps are also shaped with the exact impulses of the shaper and
+ * rounded to whole steps. A shaper leaving more than LIMIT of the unshaped
+ * vibration beyond that, or a motor ending on another step than the plan, is
+ * a failure. Set the frequency with -e INPUT_SHAPING_X_FREQ=F.
+ *
+ * It runs on the counted clock, so the pulses are at the ticks the ISR set.
+ */
+// Options: INPUT_SHAPING
+// Slowdown: 0
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Marlin.h"
+#include "planner.h"
+#include "stepper.h"
+
+void loop();
+void sim_setup();
+extern void (*sim_isr_hook)(uint64_t tick);
+extern void (*sim_port_hook)(const SimPort &port, const uint8_t was, const uint64_t tick);
+
+extern uint8_t commands_in_queue;
+
+#define MOVES 8
+#define SPEED 150         // mm/s
+#define ACCEL 3000        // mm/s²
+#define DETUNE 0.15       // Relative frequency error to also check
+#define LIMIT 0.1         // Most vibration left beyond whole steps, relative to unshaped
+#define TIMER_RATE 2000000.0
+
+#define _PORT_OF(IO) DIO ## IO ## _WPORT
+#define _MASK_OF(IO) _BV(DIO ## IO ## _PIN)
+#define PORT_OF(IO) _PORT_OF(IO)
+#define MASK_OF(IO) _MASK_OF(IO)
+
+static unsigned long failures;
+#define CHECK(COND, ...) do{ if (!(COND) && failures++ < 20) { printf("FAIL " __VA_ARGS__); printf("\n"); } }while(0)
+
+struct Step { uint64_t tick; int dir; };
+typedef std::vector<Step> steps_t;
+
+struct Run {
+  steps_t motor;                 // X step pulses
+  std::vector<uint64_t> ends,    // Tick of the last planned step of each move
+                        starts;  // Tick the next move was taken up
+};
+static Run *recording;
+static bool was_queued;
+
+static void on_port(const SimPort &port, const uint8_t was, const uint64_t tick) {
+  if (&port != &PORT_OF(X_STEP_PIN) || !((port ^ was) & MASK_OF(X_STEP_PIN))) return;
+  if (bool(port & MASK_OF(X_STEP_PIN)) == bool(INVERT_X_STEP_PIN)) return; // The end of a pulse
+  const bool dir_pin = PORT_OF(X_DIR_PIN) & MASK_OF(X_DIR_PIN);
+  recording->motor.push_back({ tick, dir_pin != bool(INVERT_X_DIR) ? 1 : -1 });
+}
+
+// The stepper discards a block after its last step
+static void on_isr(uint64_t tick) {
+  const bool queued = planner.has_blocks_queued();
+  if (was_queued && !queued) recording->ends.push_back(tick);
+  if (!was_queued && queued && !recording->ends.empty()) recording->starts.push_back(tick);
+  was_queued = queued;
+}
+
+static void command(const char * const cmd) {
+  while (!enqueue_and_echo_command(cmd)) loop();
+}
+
+static void finish() {
+  while (commands_in_queue) loop();
+  planner.synchronize();
+}
+
+// The moves, unshaped with type -1
+static Run run_moves(const int type, const std::vector<float> &lengths, const std::vector<int> &pauses) {
+  char cmd[48];
+  if (type < 0)
+    command("M593 F0");
+  else {
+    sprintf(cmd, "M593 T%d F%g D%g", type, double(INPUT_SHAPING_X_FREQ), double(INPUT_SHAPING_X_ZETA));
+    command(cmd);
+  }
+  command("G1 X100 F9000");
+  finish();
+  const int32_t start = stepper.position(X_AXIS);
+
+  Run run;
+  recording = &run;
+  was_queued = false;
+  sim_port_hook = on_port;
+  sim_isr_hook = on_isr;
+  float x = 100;
+  for (size_t i = 0; i < lengths.size(); i++) {
+    x += i & 1 ? -lengths[i] : lengths[i];
+    sprintf(cmd, "G1 X%.3f F%d", double(x), SPEED * 60);
+    command(cmd);
+    sprintf(cmd, "G4 P%d", pauses[i]);
+    command(cmd);
+  }
+  finish();
+  sim_port_hook = NULL;
+  sim_isr_hook = NULL;
+  CHECK(run.ends.size() == lengths.size(), "%s: %d moves ended, %d planned", type < 0 ? "unshaped" : "shaped", int(run.ends.size()), int(lengths.size()));
+  // The motor and its pulses must have moved as far as the plan
+  const long planned = lround(x * planner.axis_steps_per_mm[X_AXIS]) - lround(100 * planner.axis_steps_per_mm[X_AXIS]);
+  long pulsed = 0;
+  for (size_t i = 0; i < run.motor.size(); i++) pulsed += run.motor[i].dir;
+  CHECK(stepper.position(X_AXIS) - start == planned && pulsed == planned, "%s: the motor moved %ld steps, pulsed %ld, the plan %ld",
+        type < 0 ? "unshaped" : "shaped", long(stepper.position(X_AXIS) - start), pulsed, planned);
+  return run;
+}
+
+// One damped period and a little after each move, unless the next one started
+static std::vector<uint64_t> samples(const Run &run) {
+  const uint64_t after = (1 / (INPUT_SHAPING_X_FREQ * sqrt(1 - sq(INPUT_SHAPING_X_ZETA))) + 0.005) * TIMER_RATE;
+  std::vector<uint64_t> s;
+  for (size_t i = 0; i < run.ends.size(); i++)
+    s.push_back(i < run.starts.size() ? min(run.ends[i] + after, run.starts[i]) : run.ends[i] + after);
+  return s;
+}
+
+// RMS amplitude (mm) of the ringing the steps leave at the sample ticks
+static double residual(const steps_t &motor, const double f, const std::vector<uint64_t> &at) {
+  const double zeta = INPUT_SHAPING_X_ZETA, w = 2 * M_PI * f, wd = w * sqrt(1 - zeta * zeta),
+               step_mm = 1 / planner.axis_steps_per_mm[X_AXIS];
+  double e = 0, v = 0, total = 0;
+  uint64_t t = motor.empty() ? 0 : motor[0].tick;
+  for (size_t m = 0, s = 0; s < at.size();) {
+    const bool is_step = m < motor.size() && motor[m].tick <= at[s];
+    const uint64_t tick = is_step ? motor[m].tick : at[s];
+    if (tick > t) {
+      const double dt = (tick - t) / TIMER_RATE, decay = exp(-zeta * w * dt), c = cos(wd * dt), sn = sin(wd * dt);
+      const double e2 = decay * (e * c + (v + zeta * w * e) / wd * sn);
+      v = decay * (v * c - (w * w * e + zeta * w * v) / wd * sn);
+      e = e2;
+      t = tick;
+    }
+    if (is_step)
+      e -= motor[m++].dir * step_mm;
+    else {
+      total += e * e + sq((v + zeta * w * e) / wd);
+      s++;
+    }
+  }
+  return sqrt(total / at.size());
+}
+
+// The steps shaped with the exact impulses of a shaper, rounded to whole steps
+static steps_t rounded(const steps_t &plan, const int type) {
+  const double zeta = INPUT_SHAPING_X_ZETA, df = sqrt(1 - zeta * zeta), td = 1 / (INPUT_SHAPING_X_FREQ * df);
+  std::vector<double> amp, at;
+  if (type == SHAPER_ZV) {
+    const double K = exp(-zeta * M_PI / df);
+    amp = { 1, K }; at = { 0, 0.5 * td };
+  }
+  else if (type == SHAPER_ZVD) {
+    const double K = exp(-zeta * M_PI / df);
+    amp = { 1, 2 * K, K * K }; at = { 0, 0.5 * td, td };
+  }
+  else {
+    const double K = exp(-0.75 * zeta * M_PI / df), a1 = 1 - sqrt(0.5);
+    amp = { a1, (sqrt(2) - 1) * K, a1 * K * K }; at = { 0, 0.375 * td, 0.75 * td };
+  }
+  double total = 0;
+  for (size_t i = 0; i < amp.size(); i++) total += amp[i];
+  std::vector<std::pair<uint64_t, double> > events;
+  for (size_t s = 0; s < plan.size(); s++)
+    for (size_t i = 0; i < amp.size(); i++)
+      events.push_back({ plan[s].tick + uint64_t(at[i] * TIMER_RATE + 0.5), plan[s].dir * amp[i] / total });
+  std::stable_sort(events.begin(), events.end(), [](const std::pair<uint64_t, double> &a, const std::pair<uint64_t, double> &b) { return a.first < b.first; });
+  steps_t motor;
+  double shaped = 0;
+  long pos = 0;
+  for (size_t i = 0; i < events.size(); i++) {
+    shaped += events[i].second;
+    for (; shaped - pos >= 0.5; pos++) motor.push_back({ events[i].first, 1 });
+    for (; shaped - pos < -0.5; pos--) motor.push_back({ events[i].first, -1 });
+  }
+  return motor;
+}
+
+int sim_check(const char *, const unsigned seed) {
+  randomSeed(seed);
+  sim_setup();
+  char cmd[32];
+  sprintf(cmd, "M201 X%d", ACCEL);
+  command(cmd);
+  sprintf(cmd, "M204 P%d", ACCEL);
+  command(cmd);
+  command("M211 S0");
+  std::vector<float> lengths;
+  std::vector<int> pauses;
+  for (int i = 0; i < MOVES; i++) {
+    lengths.push_back(2 + random(58000) / 1000.0f);
+    pauses.push_back(50 + random(150));
+  }
+
+  const Run unshaped = run_moves(-1, lengths, pauses);
+  if (unshaped.motor.empty() || unshaped.ends.empty()) {
+    printf("%lu failures\n", failures + 1);
+    return 1;
+  }
+  const std::vector<uint64_t> at = samples(unshaped);
+  const double freqs[] = { INPUT_SHAPING_X_FREQ * (1 - DETUNE), INPUT_SHAPING_X_FREQ, INPUT_SHAPING_X_FREQ * (1 + DETUNE) };
+  double base[3];
+  for (uint8_t f = 0; f < 3; f++) base[f] = residual(unshaped.motor, freqs[f], at);
+  printf("%d moves, %d steps, %.3f s\n", MOVES, int(unshaped.motor.size()), (unshaped.ends.back() - unshaped.motor[0].tick) / TIMER_RATE);
+  printf("Unshaped: ringing %.4f / %.4f / %.4f mm at %.1f / %.1f / %.1f Hz\n", base[0], base[1], base[2], freqs[0], freqs[1], freqs[2]);
+
+  const char * const names[] = { "ZV", "ZVD", "MZV" };
+  for (int type = SHAPER_ZV; type <= SHAPER_MZV; type++) {
+    const Run run = run_moves(type, lengths, pauses);
+    if (run.motor.empty() || run.ends.empty()) continue;
+    const std::vector<uint64_t> run_at = samples(run);
+    double left[3];
+    for (uint8_t f = 0; f < 3; f++) left[f] = residual(run.motor, freqs[f], run_at) / base[f];
+    const double floor = residual(rounded(unshaped.motor, type), freqs[1], at) / base[1],
+                 lag = run.motor.back().tick > run.ends.back() ? (run.motor.back().tick - run.ends.back()) / TIMER_RATE : 0;
+    printf("%-4s ringing left %.1f%% / %.1f%% / %.1f%% (in whole steps %.1f%%), last step %.1f ms after the plan\n",
+           names[type], 100 * left[0], 100 * left[1], 100 * left[2], 100 * floor, lag * 1000);
+    CHECK(left[1] <= floor + LIMIT, "%s: %.1f%% of the ringing left at %.1f Hz, %.1f%% in whole steps", names[type], 100 * left[1], freqs[1], 100 * floor);
+  }
+  printf("%lu failures\n", failures);
+  return failures ? 1 : 0;
+}
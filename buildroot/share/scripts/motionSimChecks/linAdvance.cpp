@@ -0,0 +1,185 @@
+/**
+ * motionSim.py --check linAdvance
+ *
+ * Compare the E steps of LIN_ADVANCE_SMOOTHING with those of the plain
+ * LIN_ADVANCE of the reference build. A run of random print moves (--seed)
+ * of random length, feedrate, direction and extrusion ratio, now and then
+ * after a stop, and a travel move after them, run with K, the E max feedrate
+ * and the E jerk set here. The E step pulses are recorded.
+ *
+ * For each build the E steps sent in any WINDOW ms are compared with the
+ * ceiling of the E max feedrate, and the largest step in the lead speed at
+ * the ends of a ramp with the E jerk. With LIN_ADVANCE_SMOOTHING a window
+ * over the ceiling by more than a step, a lead speed step over E jerk, or an
+ * extruder not ending where the plan does after the travel move (a lead left
+ * over), is a failure.
+ *
+ * It runs on the counted clock, so the pulses are at the ticks the ISR set.
+ */
+// Options: LIN_ADVANCE LIN_ADVANCE_SMOOTHING
+// Reference: -d LIN_ADVANCE_SMOOTHING
+// Slowdown: 0
+
+#include <cmath>
+#include <vector>
+
+#include "Marlin.h"
+#include "planner.h"
+#include "stepper.h"
+
+void loop();
+void sim_setup();
+extern void (*sim_isr_hook)(uint64_t tick);
+extern void (*sim_port_hook)(const SimPort &port, const uint8_t was, const uint64_t tick);
+extern FILE *sim_reference;
+extern bool sim_reference_build;
+
+extern uint8_t commands_in_queue;
+
+#define MOVES 60
+#define K 0.05
+#define ACCEL 2000        // mm/s²
+#define SPEED 250         // Fastest print feedrate, mm/s
+#define E_RATIO 0.033     // Typical E mm per mm of path, 1.75mm filament
+#define E_FEEDRATE 8      // mm/s
+#define E_JERK 5          // mm/s
+#define E_STEPS 415       // Steps per mm
+#define WINDOW 10         // ms
+#define TIMER_RATE 2000000.0
+
+#define _PORT_OF(IO) DIO ## IO ## _WPORT
+#define _MASK_OF(IO) _BV(DIO ## IO ## _PIN)
+#define PORT_OF(IO) _PORT_OF(IO)
+#define MASK_OF(IO) _MASK_OF(IO)
+
+static unsigned long failures;
+#define CHECK(COND, ...) do{ if (!(COND) && failures++ < 20) { printf("FAIL " __VA_ARGS__); printf("\n"); } }while(0)
+
+static std::vector<uint64_t> pulses;  // E step pulses
+static long e_net;                    // and the steps they make
+static int call_steps, burst;         // E steps of the running ISR call, and the most of any
+static double lead_jump;              // The largest lead speed at the ends of a ramp, mm/s
+static bool was_busy;
+static uint8_t was_tail;
+
+static void on_port(const SimPort &port, const uint8_t was, const uint64_t tick) {
+  if (&port != &PORT_OF(E0_STEP_PIN) || !((port ^ was) & MASK_OF(E0_STEP_PIN))) return;
+  if (bool(port & MASK_OF(E0_STEP_PIN)) == bool(INVERT_E_STEP_PIN)) return; // The end of a pulse
+  const bool dir_pin = PORT_OF(E0_DIR_PIN) & MASK_OF(E0_DIR_PIN);
+  pulses.push_back(tick);
+  e_net += dir_pin != bool(INVERT_E0_DIR) ? 1 : -1;
+  call_steps++;
+}
+
+// The block phase takes up a block with get_current_block(), which marks it busy
+static void on_isr(uint64_t) {
+  NOLESS(burst, call_steps);
+  call_steps = 0;
+  const uint8_t tail = planner.block_buffer_tail;
+  const bool busy = planner.has_blocks_queued() && planner.block_buffer_nonbusy != tail;
+  if (busy && !(was_busy && tail == was_tail)) {
+    const block_t &b = planner.block_buffer[tail];
+    if (b.use_advance_lead && (b.max_adv_steps != b.final_adv_steps || b.initial_rate < b.nominal_rate))
+      NOLESS(lead_jump, TIMER_RATE / b.advance_speed / planner.axis_steps_per_mm[E_AXIS]);
+  }
+  was_busy = busy;
+  was_tail = tail;
+}
+
+static void command(const char * const cmd) {
+  while (!enqueue_and_echo_command(cmd)) loop();
+}
+
+static void finish() {
+  while (commands_in_queue) loop();
+  planner.synchronize();
+}
+
+static double uniform(const double lo, const double hi) {
+  return lo + (hi - lo) * random(100000) / 100000.0;
+}
+
+struct Result {
+  long peak, over, left;
+  int burst;
+  double jump, seconds;
+  void write(FILE *f) const { fprintf(f, "%ld %ld %ld %d %g %g\n", peak, over, left, burst, jump, seconds); }
+  bool read(FILE *f) { return fscanf(f, "%ld %ld %ld %d %lg %lg", &peak, &over, &left, &burst, &jump, &seconds) == 6; }
+  void print(const char * const name, const long ceiling) const {
+    printf("  %-9s peak %6ld steps/s (%5.1f%%), %3ld windows over, lead speed step %.2f mm/s, most steps at once %d, %.2f s, lead left %ld\n",
+           name, peak, 100.0 * peak / ceiling, over, jump, burst, seconds, left);
+  }
+};
+
+int sim_check(const char *, const unsigned seed) {
+  randomSeed(seed);
+  sim_setup();
+  char cmd[80];
+  sprintf(cmd, "M900 K%g", K);
+  command(cmd);
+  sprintf(cmd, "M92 E%d", E_STEPS);
+  command(cmd);
+  sprintf(cmd, "M203 X%d Y%d E%d", SPEED, SPEED, E_FEEDRATE);
+  command(cmd);
+  sprintf(cmd, "M204 P%d T%d", ACCEL, ACCEL);
+  command(cmd);
+  sprintf(cmd, "M205 E%d", E_JERK);
+  command(cmd);
+  command("M211 S0");
+  command("M82");
+  command("G1 X100 Y100 F6000");
+  finish();
+  const int32_t start = stepper.position(E_AXIS);
+
+  sim_port_hook = on_port;
+  sim_isr_hook = on_isr;
+  float x = 100, y = 100, e = 0;
+  for (int i = 0; i < MOVES; i++) {
+    if (random(10) == 0) command("G4 P0");
+    const float length = uniform(0.5, 30), angle = uniform(0, 2 * M_PI);
+    x += length * cos(angle);
+    y += length * sin(angle);
+    e += length * E_RATIO * uniform(0.5, 1.5);
+    sprintf(cmd, "G1 X%.3f Y%.3f E%.4f F%d", double(x), double(y), double(e), int(uniform(0.2, 1) * SPEED * 60));
+    command(cmd);
+  }
+  // The travel move after the print
+  sprintf(cmd, "G1 X%.3f F%d", double(x + 20), SPEED * 60);
+  command(cmd);
+  finish();
+  sim_port_hook = NULL;
+  sim_isr_hook = NULL;
+
+  // The E steps in each window of the run
+  const long ceiling = long(E_FEEDRATE) * E_STEPS;
+  const uint64_t window = WINDOW * TIMER_RATE / 1000;
+  Result r = { 0, 0, 0, burst, lead_jump, 0 };
+  for (size_t i = 0, j = 0; i < pulses.size(); i = j) {
+    const uint64_t from = pulses[i] - (pulses[i] - pulses[0]) % window;
+    for (j = i; j < pulses.size() && pulses[j] < from + window; j++) { /* nada */ }
+    const long steps = j - i;
+    NOLESS(r.peak, long(steps * 1000 / WINDOW));
+    if (steps > ceiling * WINDOW / 1000 + 1) r.over++;
+  }
+  if (!pulses.empty()) r.seconds = (pulses.back() - pulses[0]) / TIMER_RATE;
+  // The stepper counts the steps of the moves, the pulses add the lead
+  const long planned = lround(e * planner.axis_steps_per_mm[E_AXIS]);
+  CHECK(stepper.position(E_AXIS) - start == planned, "the extruder traced %ld steps, the plan %ld", long(stepper.position(E_AXIS) - start), planned);
+  r.left = e_net - planned;
+
+  if (sim_reference_build)
+    r.write(sim_reference);
+  else {
+    Result plain;
+    CHECK(plain.read(sim_reference), "no reference figures");
+    printf("%d moves, K=%.3f, E max %d mm/s (%ld steps/s), window %d ms, smoothing over %d ms\n",
+           MOVES, K, E_FEEDRATE, ceiling, WINDOW, LIN_ADVANCE_SMOOTH_TIME);
+    plain.print("plain", ceiling);
+    r.print("smoothed", ceiling);
+    CHECK(!r.over, "%ld windows over the E step rate ceiling, up to %ld steps/s", r.over, r.peak);
+    CHECK(r.jump <= E_JERK * 1.01, "lead speed step of %.2f mm/s is over E jerk", r.jump);
+    CHECK(!r.left, "%ld lead steps left after the travel move", r.left);
+  }
+  printf("%lu failures\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * motionSim.py --check lineBuildup
+ *
+ * Compare the Hangprinter step targets of LINE_BUILDUP_INCREMENTAL with those
+ * of the SQRT of the reference build. Random moves (--seed) across the
+ * printable volume are cut into KINEMATIC_SEGMENTS_PER_SECOND segments, their
+ * line lengths come from inverse_kinematics() and go to buffer_segment(), and
+ * the steps of each block queued give the step target of each line. Those are
+ * compared with the spool model in double precision, on the k0, k1, k2 and
+ * sqrtk1 the firmware derived.
+ *
+ * With LINE_BUILDUP_INCREMENTAL a target further from the model than half a
+ * step and TOLERANCE is a failure, and with either a motor not ending on the
+ * last target. The SQRT in float itself loses a few steps to cancellation.
+ */
+// Config: hangprinter
+// Options: LINE_BUILDUP_INCREMENTAL
+// Reference: -d LINE_BUILDUP_INCREMENTAL
+// Slowdown: 0
+
+#include <cmath>
+
+#include "Marlin.h"
+#include "planner.h"
+#include "stepper.h"
+
+void sim_setup();
+extern FILE *sim_reference;
+extern bool sim_reference_build;
+
+#define MOVES 50
+#define FEEDRATE 200      // mm/s
+#define START_Z 100       // mm
+#define TOLERANCE 0.05    // Steps over rounding allowed
+
+static unsigned long failures;
+#define CHECK(COND, ...) do{ if (!(COND) && failures++ < 20) { printf("FAIL " __VA_ARGS__); printf("\n"); } }while(0)
+
+static double uniform(const double lo, const double hi) {
+  return lo + (hi - lo) * random(100000) / 100000.0;
+}
+
+// The steps of the spool model for a line length
+static double exact(const uint8_t axis, const float &l) {
+  return double(planner.k0[axis]) * (sqrt(double(planner.k1[axis]) + double(planner.k2[axis]) * l) - sqrt(double(planner.k1[axis])));
+}
+
+struct Result {
+  double max_error, rms;
+  void write(FILE *f) const { fprintf(f, "%g %g\n", max_error, rms); }
+  bool read(FILE *f) { return fscanf(f, "%lg %lg", &max_error, &rms) == 2; }
+  void print(const char * const name) const { printf("  %-12s max error %6.3f steps  rms %6.3f steps\n", name, max_error, rms); }
+};
+
+int sim_check(const char *, const unsigned seed) {
+  randomSeed(seed);
+  sim_setup();
+
+  float pos[XYZ] = { 0, 0, START_Z };
+  inverse_kinematics(pos);
+  planner._set_position_mm(line_lengths[A_AXIS], line_lengths[B_AXIS], line_lengths[C_AXIS], line_lengths[D_AXIS], 0);
+  int32_t target[ABCD];
+  LOOP_MOV_AXIS(i) target[i] = stepper.position((AxisEnum)i);
+
+  unsigned long segments = 0, lines = 0;
+  double sum_sq = 0;
+  Result r = { 0, 0 };
+  for (int m = 0; m < MOVES; m++) {
+    const float radius = HANGPRINTER_PRINTABLE_RADIUS * 0.9 * sqrt(uniform(0, 1)), angle = uniform(0, 2 * M_PI),
+                dest[XYZ] = { float(radius * cos(angle)), float(radius * sin(angle)), float(uniform(0, 1000)) };
+    const float length = SQRT(sq(dest[X_AXIS] - pos[X_AXIS]) + sq(dest[Y_AXIS] - pos[Y_AXIS]) + sq(dest[Z_AXIS] - pos[Z_AXIS]));
+    const int n = max(1, int(length / FEEDRATE * KINEMATIC_SEGMENTS_PER_SECOND));
+    for (int s = 1; s <= n; s++) {
+      float p[XYZ];
+      LOOP_XYZ(i) p[i] = pos[i] + (dest[i] - pos[i]) * s / n;
+      inverse_kinematics(p);
+      const uint8_t head = planner.block_buffer_head;
+      if (planner.buffer_segment(line_lengths[A_AXIS], line_lengths[B_AXIS], line_lengths[C_AXIS], line_lengths[D_AXIS], 0, FEEDRATE, 0, length / n)) {
+        const block_t &b = planner.block_buffer[head];
+        LOOP_MOV_AXIS(i) target[i] += TEST(b.direction_bits, i) ? -int32_t(b.steps[i]) : int32_t(b.steps[i]);
+      }
+      LOOP_MOV_AXIS(i) {
+        const double error = target[i] - exact(i, line_lengths[i]);
+        NOLESS(r.max_error, fabs(error));
+        sum_sq += sq(error);
+        lines++;
+        CHECK(sim_reference_build || fabs(error) <= 0.5 + TOLERANCE, "segment %lu: line %c target %ld is %.3f steps off the model", segments, "ABCD"[i], long(target[i]), error);
+      }
+      segments++;
+    }
+    COPY(pos, dest);
+  }
+  planner.synchronize();
+  LOOP_MOV_AXIS(i)
+    CHECK(stepper.position((AxisEnum)i) == target[i], "motor %c ended on step %ld, the last target %ld", "ABCD"[i], long(stepper.position((AxisEnum)i)), long(target[i]));
+  r.rms = sqrt(sum_sq / lines);
+
+  if (sim_reference_build)
+    r.write(sim_reference);
+  else {
+    Result sqrt_path;
+    CHECK(sqrt_path.read(sim_reference), "no reference figures");
+    printf("%lu segments, %lu line targets, resync every %d segments or past %g mm\n", segments, lines, LINE_BUILDUP_RESYNC, double(LINE_BUILDUP_MAX_DELTA));
+    sqrt_path.print("SQRT");
+    r.print("Incremental");
+  }
+  printf("%lu failures\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,197 @@
+/**
+ * motionSim.py --check multistep
+ *
+ * Compare ADAPTIVE_MULTISTEPPING with the fixed multistepping of the reference
+ * build. X moves at random cruise rates (--seed) up to MAX_RATE step events a
+ * second run on a machine whose stepper ISR takes CALL_TICKS more for each
+ * call with steps and EVENT_TICKS more for each step event: the check reads
+ * the clock that many times as the pulses go out. The firmware measures those
+ * costs itself, as on a board, and picks the multiplier of each block from
+ * them. The multiplier of each block is the one most of its step events
+ * carry, and its load the share of its time the stepper ISR ran. For both
+ * builds the multipliers used and the worst load are given.
+ *
+ * A block that runs the ISR over ADAPTIVE_MULTISTEPPING_LOAD (or the load of
+ * the fixed multiplier, when that is higher) by more than SLACK after a few
+ * blocks to settle, or that runs at a higher multiplier than the fixed one
+ * while the fixed one keeps under the target by SLACK, is a failure.
+ */
+// Options: ADAPTIVE_MULTISTEPPING
+// Reference: -d ADAPTIVE_MULTISTEPPING
+// Slowdown: 0
+
+#include <cmath>
+#include <vector>
+
+#include "Marlin.h"
+#include "planner.h"
+#include "stepper.h"
+
+void loop();
+void sim_setup();
+extern void (*sim_isr_hook)(uint64_t tick);
+extern void (*sim_port_hook)(const SimPort &port, const uint8_t was, const uint64_t tick);
+extern FILE *sim_reference;
+extern bool sim_reference_build;
+
+extern uint8_t commands_in_queue;
+
+#define MOVES 200
+#define LENGTH 60         // mm
+#define MAX_RATE 40000    // Step events/s
+#define ACCEL 20000       // mm/s²
+#define CALL_TICKS 40     // The machine's own cost of a stepper ISR call
+#define EVENT_TICKS 25    // and of each step event
+#define SETTLE 10         // Blocks before the measurements count
+#define SLACK 5.0         // Load over the target allowed, in percent
+#define LOAD ADAPTIVE_MULTISTEPPING_LOAD
+
+#define _PORT_OF(IO) DIO ## IO ## _WPORT
+#define _MASK_OF(IO) _BV(DIO ## IO ## _PIN)
+#define PORT_OF(IO) _PORT_OF(IO)
+#define MASK_OF(IO) _MASK_OF(IO)
+
+static unsigned long failures;
+#define CHECK(COND, ...) do{ if (!(COND) && failures++ < 20) { printf("FAIL " __VA_ARGS__); printf("\n"); } }while(0)
+
+struct Block {
+  uint64_t start, end;           // Ticks of the first and last step
+  uint64_t isr_ticks;            // Ticks the stepper ISR ran for in between
+  uint32_t calls[9];             // Calls taking 1, 2, 4... step events, and any other count
+};
+static std::vector<Block> blocks;
+static uint8_t call_events;      // X steps of the running ISR call
+static bool was_busy;
+static uint8_t was_tail;
+
+// Take the machine's time for the ISR, as the firmware reads it
+static void spend(const uint8_t ticks) {
+  for (uint8_t i = ticks; i--;) (void)uint16_t(TCNT1);
+}
+
+static void on_port(const SimPort &port, const uint8_t was, const uint64_t tick) {
+  if (&port != &PORT_OF(X_STEP_PIN) || !((port ^ was) & MASK_OF(X_STEP_PIN))) return;
+  if (bool(port & MASK_OF(X_STEP_PIN)) == bool(INVERT_X_STEP_PIN)) return; // The end of a pulse
+  if (blocks.empty()) return;
+  spend(call_events++ ? EVENT_TICKS : CALL_TICKS + EVENT_TICKS);
+  Block &b = blocks.back();
+  if (!b.start) b.start = tick;
+  b.end = tick;
+}
+
+// The block phase takes up a block with get_current_block(), which marks it busy
+static void on_isr(uint64_t) {
+  const uint16_t ran = TCNT1;
+  const uint8_t tail = planner.block_buffer_tail;
+  const bool busy = planner.has_blocks_queued() && planner.block_buffer_nonbusy != tail;
+  if (!blocks.empty() && call_events) {
+    Block &b = blocks.back();
+    b.isr_ticks += ran;
+    uint8_t i = 0;
+    while (i < 8 && call_events != _BV(i)) i++;
+    b.calls[i]++;
+  }
+  call_events = 0;
+  if (busy && !(was_busy && tail == was_tail)) {
+    const Block b = { 0, 0, 0, { 0 } };
+    blocks.push_back(b);
+  }
+  was_busy = busy;
+  was_tail = tail;
+}
+
+static void command(const char * const cmd) {
+  while (!enqueue_and_echo_command(cmd)) loop();
+}
+
+static void finish() {
+  while (commands_in_queue) loop();
+  planner.synchronize();
+}
+
+// The multiplier most step events of a block ran at, as log2
+static uint8_t multiplier(const Block &b) {
+  uint8_t m = 0;
+  for (uint8_t i = 1; i < 8; i++) if (b.calls[i] << i > b.calls[m] << m) m = i;
+  return m;
+}
+
+static double load(const Block &b) {
+  return b.end > b.start ? 100.0 * b.isr_ticks / (b.end - b.start) : 0;
+}
+
+int sim_check(const char *, const unsigned seed) {
+  randomSeed(seed);
+  sim_setup();
+  char cmd[64];
+  sprintf(cmd, "M203 X%d", MAX_RATE / 80 + 10);
+  command(cmd);
+  sprintf(cmd, "M201 X%d", ACCEL);
+  command(cmd);
+  sprintf(cmd, "M204 T%d", ACCEL);
+  command(cmd);
+  command("M92 X80");
+  command("M211 S0");
+  command("G1 X100 F6000");
+  finish();
+
+  std::vector<long> rates;
+  sim_port_hook = on_port;
+  sim_isr_hook = on_isr;
+  for (int i = 0; i < MOVES; i++) {
+    const double r = (20 + random(980)) / 1000.0;
+    rates.push_back(long(r * r * MAX_RATE) + 100);
+    sprintf(cmd, "G1 X%d F%.1f", i & 1 ? 100 : 100 + LENGTH, rates.back() / 80.0 * 60);
+    command(cmd);
+  }
+  finish();
+  sim_port_hook = NULL;
+  sim_isr_hook = NULL;
+  CHECK(blocks.size() == size_t(MOVES), "%d blocks run of %d", int(blocks.size()), MOVES);
+
+  if (sim_reference_build) {
+    for (size_t i = 0; i < blocks.size(); i++) fprintf(sim_reference, "%u %g\n", multiplier(blocks[i]), load(blocks[i]));
+    printf("%lu failures\n", failures);
+    return failures ? 1 : 0;
+  }
+
+  unsigned long used[2][8] = { { 0 } }, over = 0;
+  double worst[2] = { 0 };
+  for (size_t i = 0; i < blocks.size() && i < rates.size(); i++) {
+    unsigned fixed;
+    double fixed_load;
+    if (fscanf(sim_reference, "%u %lg", &fixed, &fixed_load) != 2 || fixed > 7) {
+      CHECK(false, "no reference figures for block %d", int(i));
+      break;
+    }
+    const Block &b = blocks[i];
+    const uint8_t adaptive = multiplier(b);
+    const double adaptive_load = load(b);
+    used[0][fixed]++;
+    used[1][adaptive]++;
+    NOLESS(worst[0], fixed_load);
+    if (i < SETTLE) continue;
+    NOLESS(worst[1], adaptive_load);
+    if (adaptive_load > max(double(LOAD), fixed_load) + SLACK) {
+      over++;
+      CHECK(false, "block %d: %ld events/s at %dx takes %.1f%% of the CPU", int(i), rates[i], 1 << adaptive, adaptive_load);
+    }
+    CHECK(adaptive <= fixed || fixed_load > LOAD - SLACK, "block %d: %ld events/s at %dx where %dx keeps up", int(i), rates[i], 1 << adaptive, 1 << fixed);
+  }
+
+  printf("%d blocks up to %d events/s, load target %d%%, the ISR taking %d ticks more a call and %d a step event\n",
+         int(blocks.size()), MAX_RATE, LOAD, CALL_TICKS, EVENT_TICKS);
+  const char * const names[] = { "fixed", "adaptive" };
+  for (uint8_t n = 0; n < 2; n++) {
+    unsigned long steps = 0;
+    printf("  %-9s", names[n]);
+    for (uint8_t m = 0; m < 8; m++) {
+      steps += used[n][m] << m;
+      if (used[n][m]) printf(" %dx:%4.1f%%", 1 << m, 100.0 * used[n][m] / blocks.size());
+    }
+    printf("  mean %.2f steps/call, max load %.1f%%\n", double(steps) / blocks.size(), worst[n]);
+  }
+  printf("Blocks over the target: %lu\n", over);
+  printf("%lu failures\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,231 @@
+/**
+ * motionSim.py --check sdCache [print.gcode]
+ *
+ * Compare the SD_BLOCK_CACHE of SdVolume with the single shared block of the
+ * reference build. The G-code (without one, the test print) is written to the
+ * card with a cluster of another file after every few of its own, and loop()
+ * prints it from the card, saving the power-loss recovery record at each new
+ * layer, while a line is appended to a log file in a subdirectory every few
+ * commands. The card counts the blocks read and written, and the card time
+ * is estimated from them. Set the blocks cached with -e SD_CACHE_BLOCKS=N.
+ *
+ * Then three files are read, written, seeked, synced and reopened at random
+ * (--seed) and checked against copies kept here. Last, the volume is mounted
+ * afresh to read the files back, and both FATs on the card must match.
+ */
+// Options: SD_BLOCK_CACHE SDSUPPORT POWER_LOSS_RECOVERY
+// Reference: -d SD_BLOCK_CACHE
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Marlin.h"
+#include "planner.h"
+#include "cardreader.h"
+#include "power_loss_recovery.h"
+
+void loop();
+void sim_setup();
+void sim_sd_format(const uint16_t clusters, const uint8_t cluster_blocks);
+extern std::vector<uint8_t> sim_sd;
+extern unsigned long sim_sd_reads, sim_sd_writes;
+extern FILE *sim_reference;
+extern bool sim_reference_build;
+
+extern uint8_t commands_in_queue;
+extern cmd_queue_index_t cmd_queue_index_r;
+
+#define CLUSTER_BLOCKS 8
+#define OTHER_EVERY 3     // Clusters of the print between those of the other file
+#define LOG_EVERY 20      // Commands between log lines
+#define RANDOM_OPS 5000
+#define READ_US 950       // CMD17, the data token and 512 bytes
+#define WRITE_US 1800     // CMD24, 512 bytes and the busy wait while the card programs
+
+static unsigned long failures;
+#define CHECK(COND, ...) do{ if (!(COND) && failures++ < 20) { printf("FAIL " __VA_ARGS__); printf("\n"); } }while(0)
+
+// The check's own mount of the card. Without USE_MULTIPLE_CARDS the cache of
+// SdVolume is static, so its files share the blocks cached with the firmware's.
+static Sd2Card sd2card;
+static SdVolume volume;
+static SdFile root;
+
+static bool mount() {
+  return sd2card.init(SPI_SPEED, SDSS) && volume.init(&sd2card) && (root.close(), root.openRoot(&volume));
+}
+
+static std::string read_file(SdFile &dir, const char * const name) {
+  SdFile f;
+  std::string data;
+  if (!f.open(&dir, name, O_READ)) return "(missing)";
+  char buf[512];
+  for (int16_t n; (n = f.read(buf, sizeof(buf))) > 0;) data.append(buf, n);
+  f.close();
+  return data;
+}
+
+// The FAT and its copy must match on the card
+static bool fats_match() {
+  const size_t fat = volume.fatStartBlock() * 512, bytes = volume.blocksPerFat() * 512;
+  return volume.fatCount() == 2 && !memcmp(&sim_sd[fat], &sim_sd[fat + bytes], bytes);
+}
+
+static std::string load(const char * const gcode) {
+  std::string data;
+  FILE *f = fopen(gcode, "rb");
+  if (!f) return data;
+  char buf[4096];
+  for (size_t n; (n = fread(buf, 1, sizeof(buf), f)) > 0;) data.append(buf, n);
+  fclose(f);
+  return data;
+}
+
+// The print with a cluster of OTHER.BIN after every OTHER_EVERY of its own
+static bool write_print(const std::string &data) {
+  SdFile print, other;
+  if (!print.open(&root, "PRINT.GCO", O_RDWR | O_CREAT | O_TRUNC) || !other.open(&root, "OTHER.BIN", O_RDWR | O_CREAT | O_TRUNC)) return false;
+  const size_t cluster = volume.blocksPerCluster() * 512;
+  const std::string filler(cluster, 'o');
+  for (size_t at = 0, n = 0; at < data.size(); at += cluster, n++) {
+    const size_t len = min(cluster, data.size() - at);
+    if (print.write(data.data() + at, len) != int16_t(len)) return false;
+    if (n % OTHER_EVERY == OTHER_EVERY - 1 && other.write(filler.data(), cluster) != int16_t(cluster)) return false;
+  }
+  return print.close() && other.close();
+}
+
+struct Counts { unsigned long reads, writes, commands, saves; };
+#if ENABLED(SD_BLOCK_CACHE)
+  static unsigned long hits, misses, fat_hits, fat_misses; // Of the print
+#endif
+
+// Print the file from the card as a host would start it, with the log
+static Counts print_file(const std::string &data, std::string &log_data) {
+  Counts c = { 0, 0, 0, 0 };
+  SdFile logs, log;
+  CHECK(logs.mkdir(&root, "LOGS") && log.open(&logs, "PRINT.LOG", O_RDWR | O_CREAT | O_TRUNC), "no log file");
+  char name[] = "print.gco";
+  card.openFile(name, true);
+  CHECK(card.isFileOpen(), "the print didn't open");
+  #if ENABLED(SD_BLOCK_CACHE)
+    SdVolume::resetCacheStats();
+  #endif
+  sim_sd_reads = sim_sd_writes = 0;
+  card.startFileprint();
+  while (card.sdprinting || commands_in_queue) {
+    const cmd_queue_index_t r = cmd_queue_index_r;
+    const uint8_t saves = job_recovery_info.valid_head;
+    loop();
+    if (job_recovery_info.valid_head != saves) c.saves++;
+    if (cmd_queue_index_r == r) continue;
+    if (!(++c.commands % LOG_EVERY)) {
+      char line[64];
+      sprintf(line, "%lu T:210.0 /210.0 B:60.0 /60.0 @:64 B@:127\n", c.commands);
+      CHECK(log.write(line, strlen(line)) == int16_t(strlen(line)), "log line %lu not written", c.commands);
+      log_data += line;
+    }
+  }
+  CHECK(log.close() && logs.close(), "the log didn't close");
+  c.reads = sim_sd_reads;
+  c.writes = sim_sd_writes;
+  #if ENABLED(SD_BLOCK_CACHE)
+    hits = SdVolume::cacheHits; misses = SdVolume::cacheMisses;
+    fat_hits = SdVolume::fatHits; fat_misses = SdVolume::fatMisses;
+  #endif
+  planner.synchronize();
+  CHECK(c.commands == size_t(std::count(data.begin(), data.end(), '\n')), "%lu commands run of %d", c.commands, int(std::count(data.begin(), data.end(), '\n')));
+  return c;
+}
+
+// Random reads, writes, seeks, syncs and reopens of three files, checked against copies
+static void random_ops(const unsigned seed) {
+  randomSeed(seed);
+  SdFile logs, files[3];
+  const char * const names[] = { "OPS1.BIN", "OPS2.BIN", "OPS3.BIN" };
+  SdFile * const dirs[] = { &root, &root, &logs };
+  std::string copies[3];
+  CHECK(logs.open(&root, "LOGS", O_READ), "no LOGS directory");
+  for (uint8_t i = 0; i < 3; i++) CHECK(files[i].open(dirs[i], names[i], O_RDWR | O_CREAT | O_TRUNC), "%s didn't open", names[i]);
+  char buf[3000], got[3000];
+  for (int step = 0; step < RANDOM_OPS && !failures; step++) {
+    const uint8_t i = random(3);
+    SdFile &f = files[i];
+    std::string &copy = copies[i];
+    const long op = random(100);
+    if (op < 30) {
+      const uint32_t pos = random(copy.size() + 1);
+      const uint16_t lengths[] = { 1, 7, 512, 600, uint16_t(1 + random(2000)) }, n = lengths[random(5)];
+      const int16_t read = f.seekSet(pos) ? f.read(got, n) : -1;
+      const std::string expected = copy.substr(pos, n);
+      CHECK(read == int16_t(expected.size()) && !memcmp(got, expected.data(), read), "step %d: read %d at %lu of %s", step, n, (unsigned long)pos, names[i]);
+    }
+    else if (op < 80) {
+      // Rewrites and appends, up to 60000 bytes
+      const uint32_t pos = random(2) && copy.size() < 60000 ? copy.size() : random(copy.size() + 1);
+      const uint16_t lengths[] = { 1, 40, 512, 640, uint16_t(1 + random(3000)) }, n = lengths[random(5)];
+      for (uint16_t b = 0; b < n; b++) buf[b] = random(256);
+      CHECK(f.seekSet(pos) && f.write(buf, n) == int16_t(n), "step %d: write %d at %lu of %s", step, n, (unsigned long)pos, names[i]);
+      if (copy.size() < pos + n) copy.resize(pos + n);
+      copy.replace(pos, n, buf, n);
+    }
+    else if (op < 90)
+      CHECK(f.sync(), "step %d: sync of %s", step, names[i]);
+    else
+      CHECK(f.close() && f.open(dirs[i], names[i], O_RDWR), "step %d: reopen of %s", step, names[i]);
+  }
+  for (uint8_t i = 0; i < 3; i++) CHECK(files[i].close(), "%s didn't close", names[i]);
+  logs.close();
+
+  // Read back from the card
+  CHECK(fats_match(), "the FAT copies differ after random operations");
+  CHECK(mount() && logs.open(&root, "LOGS", O_READ), "no volume to read back");
+  for (uint8_t i = 0; i < 3; i++) {
+    const std::string found = read_file(*dirs[i], names[i]);
+    CHECK(found == copies[i], "%s holds %d bytes, %d written", names[i], int(found.size()), int(copies[i].size()));
+  }
+  logs.close();
+}
+
+int sim_check(const char *gcode, const unsigned seed) {
+  sim_sd_format(4200, CLUSTER_BLOCKS);
+  sim_setup();
+  const std::string data = load(gcode);
+  CHECK(!data.empty(), "no %s", gcode);
+  CHECK(mount() && write_print(data), "the print wasn't written");
+  card.initsd();
+  CHECK(card.cardOK, "no SD card");
+  if (failures) return 1;
+
+  std::string log_data;
+  const Counts c = print_file(data, log_data);
+  CHECK(fats_match(), "the FAT copies differ after the print");
+  CHECK(mount(), "no volume to read back");
+  CHECK(read_file(root, "PRINT.GCO") == data, "the print changed");
+  SdFile logs;
+  CHECK(logs.open(&root, "LOGS", O_READ) && read_file(logs, "PRINT.LOG") == log_data, "the log doesn't hold the %d bytes written", int(log_data.size()));
+  logs.close();
+  random_ops(seed);
+
+  #define CARD_S(C) ((C).reads * READ_US + (C).writes * WRITE_US) / 1e6
+  if (sim_reference_build)
+    fprintf(sim_reference, "%lu %lu %lu %lu\n", c.reads, c.writes, c.commands, c.saves);
+  else {
+    Counts r = { 0, 0, 0, 0 };
+    CHECK(fscanf(sim_reference, "%lu %lu %lu %lu", &r.reads, &r.writes, &r.commands, &r.saves) == 4, "no reference counts");
+    printf("%d bytes of G-code, clusters of %d blocks, %lu commands, %lu recovery saves, a log line every %d commands\n",
+           int(data.size()), CLUSTER_BLOCKS, c.commands, c.saves, LOG_EVERY);
+    printf("%-16s %6lu reads %6lu writes %6.1fs of card time\n", "single block", r.reads, r.writes, CARD_S(r));
+    #if ENABLED(SD_BLOCK_CACHE)
+      char cache[24];
+      sprintf(cache, "FAT + %d block%s", SD_CACHE_BLOCKS, SD_CACHE_BLOCKS > 1 ? "s" : "");
+      printf("%-16s %6lu reads %6lu writes %6.1fs of card time  data %lu hits %lu misses  FAT %lu hits %lu misses\n",
+             cache, c.reads, c.writes, CARD_S(c), hits, misses, fat_hits, fat_misses);
+    #endif
+    CHECK(r.commands == c.commands && r.saves == c.saves, "the reference ran %lu commands and saved %lu times", r.commands, r.saves);
+  }
+  printf("%d random file operations checked\n", RANDOM_OPS);
+  printf("%lu failures\n", failures);
+  return failures ? 1 : 0;
+}
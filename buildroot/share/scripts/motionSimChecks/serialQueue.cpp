@@ -0,0 +1,308 @@
+/**
+ * motionSim.py --check serialQueue
+ *
+ * Check ZERO_COPY_COMMAND_QUEUE against the line buffer it replaces. The
+ * reference build reads serial lines into serial_line_buffer, the build checked
+ * assembles them in the free queue slot and queues the offsets of their
+ * parameters. Both get the same bytes through the USART receive interrupt, and
+ * injected and SD commands and queue clears between them, and
+ * process_next_command() runs what they queue. The replies (ok, Error: and
+ * Resend:) and, for each command run, its text and what the parser saw must
+ * be the same. Commands from the SD card and enqueue_and_echo_command() may
+ * wait longer for a free slot in the build checked, so only their own order
+ * must match.
+ *
+ * The edge cases of resends and line numbers are fixed scenarios. Then come
+ * random streams from a slicer-like host, with dropped, doubled and changed
+ * characters (--seed).
+ */
+// Options: ZERO_COPY_COMMAND_QUEUE BUFSIZE=4 SDSUPPORT
+// Reference: -d ZERO_COPY_COMMAND_QUEUE
+
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Marlin.h"
+#include "planner.h"
+#include "parser.h"
+#include "cardreader.h"
+
+void process_next_command();
+void get_available_commands();
+void sim_setup();
+void sim_serial_rx(const char *s, const size_t n);
+void sim_sd_format(const uint16_t clusters, const uint8_t cluster_blocks);
+extern void (*sim_serial_line)(const char *line);
+extern FILE *sim_reference;
+extern bool sim_reference_build;
+
+extern uint8_t commands_in_queue;
+extern cmd_queue_index_t cmd_queue_index_r;
+extern char command_queue[BUFSIZE][MAX_CMD_SIZE];
+
+#define FUZZ_STREAMS 300
+
+enum EventKind : char { RX, READ, RUN, INJECT, SD, CLEAR };
+struct Event { EventKind kind; std::string text; };
+typedef std::vector<Event> events_t;
+
+static std::vector<std::string> replies, serial_ran, other_ran;
+static std::vector<std::string> pending;  // Injected, waiting for room
+static std::multiset<std::string> others; // Injected and SD commands not run yet
+
+static void on_line(const char *line) {
+  if (!strncmp(line, "ok", 2) || !strncmp(line, "Error:", 6) || !strncmp(line, "Resend:", 7)) replies.push_back(line);
+}
+
+static std::string with_checksum(const std::string &line) {
+  uint8_t checksum = 0;
+  for (size_t i = 0; i < line.size(); i++) checksum ^= line[i];
+  return line + "*" + std::to_string(checksum) + "\n";
+}
+static std::string checksummed(const int n, const std::string &cmd) { return with_checksum("N" + std::to_string(n) + " " + cmd); }
+
+// What the parser saw, as the command handlers see it
+static std::string parsed() {
+  char out[32 * 26];
+  int n = sprintf(out, "%c%d", parser.command_letter, parser.codenum);
+  #if USE_GCODE_SUBCODES
+    n += sprintf(out + n, ".%d", parser.subcode);
+  #endif
+  for (char c = 'A'; c <= 'Z'; c++)
+    if (parser.seen(c)) n += parser.has_value() ? sprintf(out + n, " %c%g", c, parser.value_float()) : sprintf(out + n, " %c", c);
+  if (parser.string_arg) sprintf(out + n, " \"%s\"", parser.string_arg);
+  return out;
+}
+
+// process_next_command() and the dequeue after it, as loop() does
+static bool run_command() {
+  if (!commands_in_queue) return false;
+  process_next_command();
+  const std::string text = parser.command_ptr, ran = text + " | " + parsed();
+  const std::multiset<std::string>::iterator other = others.find(text);
+  if (other != others.end()) { others.erase(other); other_ran.push_back(ran); }
+  else serial_ran.push_back(ran);
+  if (commands_in_queue) {
+    --commands_in_queue;
+    cmd_queue_index_r = (cmd_queue_index_r + 1) % BUFSIZE;
+  }
+  return true;
+}
+
+static void read_commands() {
+  while (!pending.empty() && enqueue_and_echo_command(pending.front().c_str())) pending.erase(pending.begin());
+  get_available_commands();
+}
+
+static void print_sd_file(const events_t &events) {
+  char name[] = "lines.gco";
+  card.openFile(name, false);
+  for (size_t i = 0; i < events.size(); i++)
+    if (events[i].kind == SD) {
+      char buf[MAX_CMD_SIZE + 3];
+      strcpy(buf, events[i].text.c_str());
+      card.write_command(buf);
+      others.insert(events[i].text);
+    }
+  card.closefile();
+  card.openFile(name, true);
+  card.startFileprint();
+}
+
+static void finish() {
+  for (uint16_t i = 0; i < 1000 && (commands_in_queue || !pending.empty() || card.sdprinting || MYSERIAL0.available()); i++) {
+    read_commands();
+    while (run_command()) { /* nada */ }
+  }
+  planner.synchronize();
+}
+
+// Run the events and return the replies and the commands run
+static std::string run(const events_t &events) {
+  // End a line left by the last run and number the lines from 0
+  sim_serial_rx("\n", 1);
+  finish();
+  sim_serial_rx("M110 N0\n", 8);
+  finish();
+  replies.clear(); serial_ran.clear(); other_ran.clear(); others.clear();
+
+  bool sd_started = false;
+  for (size_t i = 0; i < events.size(); i++) {
+    const Event &e = events[i];
+    switch (e.kind) {
+      case RX: sim_serial_rx(e.text.data(), e.text.size()); break;
+      case READ: read_commands(); break;
+      case RUN: for (size_t n = e.text.size(); n--;) run_command(); break;
+      case INJECT: pending.push_back(e.text); others.insert(e.text); read_commands(); break;
+      case SD:
+        if (!sd_started) { print_sd_file(events); sd_started = true; }
+        read_commands();
+        break;
+      case CLEAR: clear_command_queue(); break;
+    }
+  }
+  finish();
+
+  std::string out;
+  for (size_t i = 0; i < replies.size(); i++) out += "reply " + replies[i] + "\n";
+  for (size_t i = 0; i < serial_ran.size(); i++) out += "serial " + serial_ran[i] + "\n";
+  for (size_t i = 0; i < other_ran.size(); i++) out += "other " + other_ran[i] + "\n";
+  return out;
+}
+
+// The reference build writes each transcript, the build checked compares its own
+static bool same(const std::string &name, const std::string &transcript, const bool verbose) {
+  if (sim_reference_build) {
+    fprintf(sim_reference, "%s\n%send\n", name.c_str(), transcript.c_str());
+    return true;
+  }
+  std::string expected, line;
+  for (int c; (c = fgetc(sim_reference)) != EOF;) {
+    if (c != '\n') { line += char(c); continue; }
+    if (line == "end") break;
+    expected += line + "\n";
+    line.clear();
+  }
+  const size_t n = expected.find('\n');
+  const bool ok = n != std::string::npos && expected.substr(0, n) == name && expected.substr(n + 1) == transcript;
+  if (!ok && verbose) printf("  reference:\n%s  checked:\n%s", expected.c_str(), transcript.c_str());
+  return ok;
+}
+
+static events_t stream(const std::vector<std::string> &lines, const size_t chunk=7, const size_t run_every=3) {
+  std::string data;
+  for (size_t i = 0; i < lines.size(); i++) data += lines[i];
+  events_t events;
+  for (size_t i = 0; i < data.size(); i += chunk) {
+    events.push_back({ RX, data.substr(i, chunk) });
+    events.push_back({ READ, "" });
+    if ((i / chunk) % run_every == 0) events.push_back({ RUN, "1" });
+  }
+  return events;
+}
+
+static std::vector<std::string> lines(std::initializer_list<std::string> l) { return std::vector<std::string>(l); }
+
+static std::vector<std::pair<std::string, events_t> > scenarios() {
+  std::vector<std::pair<std::string, events_t> > s;
+  const char * const cmds[] = { "M110", "G92 X0", "G1 X10 Y10 F3000", "G1 X20.5 Y-3 E.4", "M104 S200" };
+  std::vector<std::string> good;
+  for (int n = 0; n < 5; n++) good.push_back(checksummed(n, cmds[n]));
+  #define GOOD(A, B) std::vector<std::string>(good.begin() + (A), good.begin() + (B))
+  #define JOIN(A, B) [](std::vector<std::string> a, const std::vector<std::string> &b) { a.insert(a.end(), b.begin(), b.end()); return a; }(A, B)
+
+  s.push_back({ "good lines", stream(good) });
+  std::vector<std::string> bad = good;
+  bad[2].replace(bad[2].find("X10"), 3, "X11");
+  s.push_back({ "bad checksum", stream(bad) });
+  s.push_back({ "missing checksum", stream(JOIN(JOIN(GOOD(0, 2), lines({ "N2 G1 X10\n" })), GOOD(2, 5))) });
+  s.push_back({ "repeated line", stream(JOIN(JOIN(GOOD(0, 3), GOOD(2, 3)), GOOD(3, 5))) });
+  s.push_back({ "skipped line", stream(JOIN(GOOD(0, 2), GOOD(3, 5))) });
+  s.push_back({ "M110 with N", stream(JOIN(GOOD(0, 2), lines({ checksummed(7, "M110 N41"), checksummed(42, "G1 X1") }))) });
+  s.push_back({ "M110 N-1", stream(lines({ checksummed(-1, "M110"), checksummed(0, "G1 X1"), checksummed(1, "G1 X2") })) });
+  s.push_back({ "no line number", stream(lines({ "G92 X0\n", "G1 X5 Y5\n", "M117 Hello World\n", "M23 file.gco\n" })) });
+  s.push_back({ "comments", stream(lines({ checksummed(1, "G1 X1"), "; just a comment\n", "G1 X2 ; move\n", "  ; indented\n", "\n\r\n" })) });
+  s.push_back({ "escapes", stream(lines({ "M117 a\\;b\n", "G1 X\\1\n", "M118 E1 \\\\ ok\n" })) });
+  std::string spaced = checksummed(2, "G1 X2");
+  spaced.replace(spaced.find('*'), 1, " *");
+  s.push_back({ "many stars", stream(lines({ with_checksum("N1 G1 X1*2"), spaced, "N3 G1 X3 * 000\n" })) });
+  std::string many = "G1";
+  for (int i = 0; i < 40; i++) many += " X" + std::to_string(i);
+  s.push_back({ "long line", stream(lines({ checksummed(1, many), checksummed(2, "M400") })) });
+  s.push_back({ "leading spaces", stream(lines({ "   " + checksummed(1, "G1 X1"), "  G1 X2\n", checksummed(2, "G1  X 3 Y4") })) });
+  s.push_back({ "many parameters", stream(lines({ "G1 A1 B2 C3 D4 E5 F6 H7 I8 J9\n", "G1 X1 Y2 Z3 E4 F5 S6 P7\n" })) });
+  s.push_back({ "strings", stream(lines({ "M0 S5 You Win!\n", "G1 X5 -3 Y2\n", "G1-5\n", "G38.2 Z-5\n", "G 1 X2\n", "M32 P !/dir/file.g#\n", "G1 Xx\n" })) });
+  s.push_back({ "line numbers", stream(lines({ "N+1 G1 X1\n", "N-1 G1\n", "N G1 X1\n", "NG1 X1\n", "N1 G1 X1 *\n", with_checksum("N1G1X1"),
+                                               with_checksum("N 2 G1 X2"), with_checksum("N+3  G1 X3 Y3"), with_checksum("N\t4 G1 X4") })) });
+
+  std::string data;
+  for (size_t i = 0; i < good.size(); i++) data += good[i];
+  const size_t half = good[0].size() + 3;
+  s.push_back({ "injected mid-line", { { RX, data.substr(0, half) }, { READ, "" }, { INJECT, "G92 E0" }, { INJECT, "M105" },
+                                      { RUN, "1" }, { RX, data.substr(half) }, { READ, "" } } });
+  s.push_back({ "SD mid-line", { { RX, data.substr(0, half) }, { READ, "" }, { SD, "G1 X9" }, { SD, "G1 X8" }, { SD, "G1 X7" },
+                                { RUN, "11" }, { RX, data.substr(half) }, { READ, "" } } });
+  std::string full;
+  for (int n = 1; n <= BUFSIZE; n++) full += checksummed(n, "G1 X" + std::to_string(n));
+  full += "N" + std::to_string(BUFSIZE + 1) + " G1";
+  s.push_back({ "full queue", { { RX, full }, { READ, "" }, { READ, "" }, { INJECT, "M105" }, { RUN, "1" }, { READ, "" },
+                               { INJECT, "M105" }, { RX, " X5*0\n" }, { READ, "" } } });
+  s.push_back({ "clear mid-line", { { RX, data.substr(0, half) }, { READ, "" }, { RUN, "1" }, { INJECT, "G4" }, { CLEAR, "" },
+                                   { RX, data.substr(half) }, { READ, "" }, { RUN, "11" }, { CLEAR, "" } } });
+  return s;
+}
+
+// A host stream with line errors
+static events_t fuzz(std::mt19937 &rng) {
+  #define RANDOM(N) int(rng() % (N))
+  #define UNIFORM(A, B) ((A) + ((B) - (A)) * (rng() % 10000) / 10000.0)
+  std::vector<std::string> lines(1, checksummed(0, "M110"));
+  for (int n = 1, count = 5 + RANDOM(36); n < count; n++) {
+    char cmd[64];
+    switch (RANDOM(10)) {
+      case 0: sprintf(cmd, "G1 X%.3f Y%.3f E%.5f", UNIFORM(0, 2), UNIFORM(0, 2), UNIFORM(0, 0.1)); break;
+      case 1: sprintf(cmd, "G0 F9000 X%.2f Y%.2f", UNIFORM(0, 2), UNIFORM(0, 2)); break;
+      case 2: sprintf(cmd, "M104 S%d", RANDOM(251)); break;
+      case 3: strcpy(cmd, "G92 E0"); break;
+      case 4: sprintf(cmd, "M117 Layer %d", n); break;
+      case 5: strcpy(cmd, "G92 X Y"); break;
+      case 6: strcpy(cmd, "G38.2 Z-10"); break;
+      case 7: sprintf(cmd, "M110 N%d", n - 1); break;
+      case 8: strcpy(cmd, "G1 Z.2 F600"); break;
+      default: strcpy(cmd, "G1 E-0.08 F2400"); break;
+    }
+    std::string line = RANDOM(10) ? checksummed(n, cmd) : std::string(cmd) + "\n";
+    if (!RANDOM(10)) line = " ;\\"[RANDOM(3)] + line;
+    if (!RANDOM(4)) {
+      static const char changes[] = "0123456789 *NMGXE.-+;\\\t\n";
+      for (int i = 1 + RANDOM(3); i--;) {
+        const size_t at = RANDOM(line.size());
+        switch (RANDOM(3)) {
+          case 0: line.erase(at, 1); break;
+          case 1: line.insert(at, 1, line[at]); break;
+          default: line[at] = changes[RANDOM(sizeof(changes) - 1)];
+        }
+      }
+    }
+    lines.push_back(line);
+  }
+  const size_t chunk = 1 + RANDOM(30), run_every = 1 + RANDOM(4);
+  events_t events = stream(lines, chunk, run_every);
+  for (int i = RANDOM(4); i--;) {
+    const size_t at = RANDOM(events.size());
+    events.insert(events.begin() + at, RANDOM(2) ? Event({ CLEAR, "" }) : Event({ RUN, "11" }));
+  }
+  return events;
+}
+
+int sim_check(const char *, const unsigned seed) {
+  if (!sim_reference) { printf("The check needs its reference build\n"); return 2; }
+  sim_sd_format(4200, 4);
+  sim_setup();
+  sim_serial_line = on_line;
+  card.initsd();
+  if (!card.cardOK) { printf("No SD card\n"); return 1; }
+
+  printf("%s, BUFSIZE %d, MAX_CMD_SIZE %d\n", sim_reference_build ? "Reference" : "Checked", BUFSIZE, MAX_CMD_SIZE);
+  unsigned long failed = 0;
+  const std::vector<std::pair<std::string, events_t> > s = scenarios();
+  for (size_t i = 0; i < s.size(); i++) {
+    const std::string transcript = run(s[i].second);
+    const bool ok = same(s[i].first, transcript, true);
+    failed += !ok;
+    printf("%-20s %-8s %3d replies, %3d commands\n", s[i].first.c_str(), ok ? "ok" : "MISMATCH",
+           int(replies.size()), int(serial_ran.size() + other_ran.size()));
+  }
+
+  std::mt19937 rng(seed);
+  unsigned long fuzz_failed = 0;
+  for (int i = 0; i < FUZZ_STREAMS; i++) {
+    char name[16];
+    sprintf(name, "fuzz %d", i);
+    if (!same(name, run(fuzz(rng)), fuzz_failed < 3)) fuzz_failed++;
+  }
+  printf("fuzz: %lu of %d streams differ\n", fuzz_failed, FUZZ_STREAMS);
+  return failed || fuzz_failed ? 1 : 0;
+}
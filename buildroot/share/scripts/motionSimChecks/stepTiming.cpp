@@ -0,0 +1,259 @@
+/**
+ * motionSim.py --check stepTiming
+ *
+ * Compare the step times of PER_AXIS_STEP_TIMING with those of the Bresenham
+ * line tracer of the reference build. Random printing moves (--seed) in X, Y
+ * and E, now and then a Z move, each from rest to rest, are run and the step
+ * pulses of each axis recorded.
+ *
+ * Each step is compared with the time the line reaches it as the ISR traces
+ * the move: the events of a pass spread evenly over the interval before it,
+ * the passes being the ticks the fastest axis of the block steps at. The
+ * timing error and the jitter (the error of each interval between two steps
+ * of an axis) are given per axis, in microseconds, for both tracers, with the
+ * interrupts each takes. The fastest axis steps on the events with either,
+ * bunched by multistepping.
+ *
+ * A timed step off by more than 1/256 of an event, or outside the pass it
+ * belongs to, or an axis taking another count of steps than planned, is a
+ * failure. An interrupt takes the events due within 8us of its end along, so
+ * the steps and passes may be off by as many ticks as the longest interrupt
+ * ran, and that much more is allowed.
+ *
+ * It runs on the counted clock, so the pulses are at the ticks the ISR set
+ * and the ticks its reads of the clock took since.
+ */
+// Options: PER_AXIS_STEP_TIMING
+// Reference: -d PER_AXIS_STEP_TIMING
+// Slowdown: 0
+
+#include <cmath>
+#include <vector>
+
+#include "Marlin.h"
+#include "planner.h"
+#include "stepper.h"
+
+void loop();
+void sim_setup();
+extern void (*sim_isr_hook)(uint64_t tick);
+extern void (*sim_port_hook)(const SimPort &port, const uint8_t was, const uint64_t tick);
+extern FILE *sim_reference;
+extern bool sim_reference_build;
+
+extern uint8_t commands_in_queue;
+
+#define MOVES 200
+#define SPEED 60          // mm/s
+#define ACCEL 1500        // mm/s²
+#define MARGIN_TICKS 16   // Events this close to the end of an interrupt are taken in it
+#define TIMER_RATE 2000000.0
+#define AXES 4
+
+#define _PORT_OF(IO) DIO ## IO ## _WPORT
+#define _MASK_OF(IO) _BV(DIO ## IO ## _PIN)
+#define PORT_OF(IO) _PORT_OF(IO)
+#define MASK_OF(IO) _MASK_OF(IO)
+
+static unsigned long failures;
+#define CHECK(COND, ...) do{ if (!(COND) && failures++ < 20) { printf("FAIL " __VA_ARGS__); printf("\n"); } }while(0)
+
+static const struct { SimPort *port; uint8_t mask; bool invert; } step_pins[AXES] = {
+  { &PORT_OF(X_STEP_PIN), MASK_OF(X_STEP_PIN), INVERT_X_STEP_PIN },
+  { &PORT_OF(Y_STEP_PIN), MASK_OF(Y_STEP_PIN), INVERT_Y_STEP_PIN },
+  { &PORT_OF(Z_STEP_PIN), MASK_OF(Z_STEP_PIN), INVERT_Z_STEP_PIN },
+  { &PORT_OF(E0_STEP_PIN), MASK_OF(E0_STEP_PIN), INVERT_E_STEP_PIN }
+};
+
+struct Block {
+  uint32_t steps[AXES], events;
+  uint64_t start;                      // Tick of the ISR that took it up
+  std::vector<uint64_t> ticks[AXES];   // Step pulses of each axis
+};
+static std::vector<Block> blocks;
+static unsigned long interrupts;
+static uint16_t isr_ticks;             // The longest an interrupt ran, on the counted clock
+static bool was_busy;
+static uint8_t was_tail;
+
+static void on_port(const SimPort &port, const uint8_t was, const uint64_t tick) {
+  for (uint8_t a = 0; a < AXES; a++)
+    if (&port == step_pins[a].port && ((port ^ was) & step_pins[a].mask) && bool(port & step_pins[a].mask) != step_pins[a].invert) {
+      CHECK(!blocks.empty(), "%c stepped with no block", axis_codes[a]);
+      if (!blocks.empty()) blocks.back().ticks[a].push_back(tick);
+    }
+}
+
+// The block phase takes up a block with get_current_block(), which marks it busy
+static void on_isr(uint64_t tick) {
+  interrupts++;
+  NOLESS(isr_ticks, uint16_t(TCNT1));
+  const uint8_t tail = planner.block_buffer_tail;
+  const bool busy = planner.has_blocks_queued() && planner.block_buffer_nonbusy != tail;
+  if (busy && !(was_busy && tail == was_tail)) {
+    const block_t &b = planner.block_buffer[tail];
+    Block block;
+    for (uint8_t a = 0; a < AXES; a++) block.steps[a] = b.steps[a];
+    block.events = b.step_event_count;
+    block.start = tick;
+    blocks.push_back(block);
+  }
+  was_busy = busy;
+  was_tail = tail;
+}
+
+static void command(const char * const cmd) {
+  while (!enqueue_and_echo_command(cmd)) loop();
+}
+
+static void finish() {
+  while (commands_in_queue) loop();
+  planner.synchronize();
+}
+
+struct Stats {
+  unsigned long n, jn;
+  double err, err_max, jit, jit_max;       // Sums of squares and largest, in µs
+  void add(const double e, const double *const previous) {
+    n++;
+    err += e * e;
+    NOLESS(err_max, fabs(e));
+    if (previous) {
+      jn++;
+      jit += sq(e - *previous);
+      NOLESS(jit_max, fabs(e - *previous));
+    }
+  }
+  double err_rms() const { return n ? sqrt(err / n) : 0; }
+  double jit_rms() const { return jn ? sqrt(jit / jn) : 0; }
+  void write(FILE *f) const { fprintf(f, "%lu %lu %g %g %g %g\n", n, jn, err, err_max, jit, jit_max); }
+  bool read(FILE *f) { return fscanf(f, "%lu %lu %lg %lg %lg %lg", &n, &jn, &err, &err_max, &jit, &jit_max) == 6; }
+};
+
+struct Pass { uint64_t tick, interval; uint32_t first, events, multistep; };
+
+// The passes of a block, from the steps of its fastest axis
+static std::vector<Pass> passes_of(const Block &b, const std::vector<uint64_t> &fastest) {
+  std::vector<Pass> passes;
+  uint64_t previous = b.start;
+  for (size_t i = 0; i < fastest.size();) {
+    Pass p = { fastest[i], fastest[i] - previous, uint32_t(i), 0, 1 };
+    for (; i < fastest.size() && fastest[i] == p.tick; i++) p.events++;
+    // A short last pass keeps the multistepping of the one before
+    const uint32_t full = i < fastest.size() || passes.empty() ? p.events : max(p.events, passes.back().events);
+    while (p.multistep < full) p.multistep <<= 1;
+    passes.push_back(p);
+    previous = p.tick;
+  }
+  return passes;
+}
+
+// The pass the line reaches an event position in
+static const Pass &pass_at(const std::vector<Pass> &passes, const double pos) {
+  size_t lo = 0, hi = passes.size() - 1;
+  while (lo < hi) {
+    const size_t mid = (lo + hi + 1) / 2;
+    if (passes[mid].first < pos) lo = mid; else hi = mid - 1;
+  }
+  return passes[lo];
+}
+
+static double ideal(const Pass &p, const double pos) {
+  return p.tick - double(p.interval) + p.interval * (pos - p.first) / p.multistep;
+}
+
+int sim_check(const char *, const unsigned seed) {
+  randomSeed(seed);
+  sim_setup();
+  char cmd[64];
+  command("M92 X80 Y80 Z400 E93");
+  sprintf(cmd, "M201 X%d Y%d", ACCEL, ACCEL);
+  command(cmd);
+  sprintf(cmd, "M204 P%d", ACCEL);
+  command(cmd);
+  command("M211 S0");
+  command("G91");
+  command("M83");
+  finish();
+
+  sim_port_hook = on_port;
+  sim_isr_hook = on_isr;
+  for (int i = 0; i < MOVES; i++) {
+    const float length = 0.5f + random(19500) / 1000.0f, angle = random(6283) / 1000.0f;
+    if (random(100) < 5)
+      sprintf(cmd, "G1 Z%s F%d", random(2) ? "0.2" : "0.3", SPEED * 60);
+    else
+      sprintf(cmd, "G1 X%.3f Y%.3f E%.4f F%d", double(length * cos(angle)), double(length * sin(angle)), double(length * 0.033f), SPEED * 60);
+    command(cmd);
+    command("G4 P1");
+  }
+  finish();
+  sim_port_hook = NULL;
+  sim_isr_hook = NULL;
+
+  Stats stats[AXES], fastest;
+  memset(stats, 0, sizeof(stats));
+  memset(&fastest, 0, sizeof(fastest));
+  unsigned long passes = 0, timed = 0;
+  #if ENABLED(PER_AXIS_STEP_TIMING)
+    // An interrupt takes the events due before it ends, and its passes and steps are at the clock it has read
+    const uint32_t slack = MARGIN_TICKS + isr_ticks;
+  #endif
+  for (size_t i = 0; i < blocks.size(); i++) {
+    const Block &b = blocks[i];
+    uint8_t f = 0;
+    for (uint8_t a = 0; a < AXES; a++) {
+      CHECK(b.ticks[a].size() == b.steps[a], "block %d: %c took %d steps of %lu", int(i), axis_codes[a], int(b.ticks[a].size()), (unsigned long)b.steps[a]);
+      if (b.steps[a] == b.events) f = a;
+    }
+    if (b.ticks[f].size() != b.events) continue;
+    const std::vector<Pass> ps = passes_of(b, b.ticks[f]);
+    passes += ps.size();
+    for (uint8_t a = 0; a < AXES; a++) {
+      const uint32_t s = b.steps[a];
+      if (!s || b.ticks[a].size() != s) continue;
+      double previous = 0;
+      for (uint32_t k = 0; k < s; k++) {
+        // The line crosses the step where the Bresenham error turns positive
+        const double pos = (k + 0.5) * b.events / s;
+        const Pass &p = pass_at(ps, pos);
+        const double exact = ideal(p, pos), e = (b.ticks[a][k] - exact) * 1e6 / TIMER_RATE;
+        (a == f ? fastest : stats[a]).add(e, k ? &previous : NULL);
+        previous = e;
+        #if ENABLED(PER_AXIS_STEP_TIMING)
+          if (a == f) continue;
+          timed++;
+          const uint64_t tick = b.ticks[a][k];
+          CHECK(tick + slack >= p.tick - p.interval && tick <= p.tick + slack, "block %d: %c step at tick %lu, outside the pass from %lu to %lu",
+                int(i), axis_codes[a], (unsigned long)tick, (unsigned long)(p.tick - p.interval), (unsigned long)p.tick);
+          CHECK(fabs(tick - exact) <= p.interval / (256.0 * p.multistep) + 1 + slack,
+                "block %d: %c step at tick %lu, the line crosses it at %.1f", int(i), axis_codes[a], (unsigned long)tick, exact);
+        #endif
+      }
+    }
+  }
+
+  if (sim_reference_build) {
+    fprintf(sim_reference, "%lu\n", interrupts);
+    for (uint8_t a = 0; a < AXES; a++) stats[a].write(sim_reference);
+  }
+  else {
+    unsigned long ref_interrupts = 0;
+    Stats ref[AXES];
+    bool ok = fscanf(sim_reference, "%lu", &ref_interrupts) == 1;
+    for (uint8_t a = 0; a < AXES; a++) ok = ok && ref[a].read(sim_reference);
+    CHECK(ok, "no reference figures");
+    printf("%d blocks, %lu passes, %.2f s\n", int(blocks.size()), passes, blocks.empty() ? 0 : (blocks.back().start - blocks[0].start) / TIMER_RATE);
+    printf("Fastest axis of each block: error %.1f us RMS, jitter %.1f us RMS\n", fastest.err_rms(), fastest.jit_rms());
+    printf("Other axes     steps   error (us RMS / max)           jitter (us RMS / max)\n");
+    for (uint8_t a = 0; a < AXES; a++) {
+      if (!ok || !ref[a].n) continue;
+      printf("  %c        %8lu   %6.1f / %-7.1f -> %4.1f / %-5.1f  %6.1f / %-7.1f -> %4.1f / %-5.1f\n", axis_codes[a], stats[a].n,
+             ref[a].err_rms(), ref[a].err_max, stats[a].err_rms(), stats[a].err_max, ref[a].jit_rms(), ref[a].jit_max, stats[a].jit_rms(), stats[a].jit_max);
+      CHECK(ref[a].n == stats[a].n, "%c: %lu steps timed, %lu in the reference", axis_codes[a], stats[a].n, ref[a].n);
+    }
+    printf("Interrupts: %lu with Bresenham, %lu (%lu timed steps) with PER_AXIS_STEP_TIMING, the longest %u ticks\n", ref_interrupts, interrupts, timed, isr_ticks);
+  }
+  printf("%lu failures\n", failures);
+  return failures ? 1 : 0;
+}
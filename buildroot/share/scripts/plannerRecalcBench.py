@@ -0,0 +1,193 @@
+#!/usr/bin/env python
+
+""" Count the work Planner::recalculate() does per queued block.
+
+Feeds a long path of short segments (arcs joined by occasional corners) through
+a model of the planner queue, with the stepper always busy on the tail block and
+the queue kept full as in a long print. The full-scan recalculate() is compared
+with the version that stops at the first unchanged junction. For each buffer size
+it prints the junction and trapezoid evaluations and the blocks walked by the
+trapezoid pass per queued block, and checks that both versions hand the stepper
+identical entry and exit speeds.
+"""
+
+from __future__ import print_function, division
+
+import argparse
+import math
+import random
+
+parser = argparse.ArgumentParser(description=__doc__)
+parser.add_argument('-n', '--segments', type=int, default=20000, help='Number of segments (default=20000)')
+parser.add_argument('-b', '--buffer-sizes', default='16,32,64', help='BLOCK_BUFFER_SIZE values (default=16,32,64)')
+parser.add_argument('-l', '--length', type=float, default=0.5, help='Segment length in mm (default=0.5)')
+parser.add_argument('-f', '--feedrate', type=float, default=60, help='Feedrate in mm/s (default=60)')
+parser.add_argument('-a', '--acceleration', type=float, default=1000, help='Acceleration in mm/s^2 (default=1000)')
+parser.add_argument('-j', '--junction-deviation', type=float, default=0.02, help='Junction deviation in mm (default=0.02)')
+parser.add_argument('--seed', type=int, default=1, help='Random seed (default=1)')
+args = parser.parse_args()
+
+MIN_SQR = 0.05 ** 2 # sq(MINIMUM_PLANNER_SPEED)
+
+class Block(object):
+  def __init__(self, mm, accel, nominal_sqr, max_entry_sqr):
+    self.mm, self.accel, self.nominal_sqr, self.max_entry_sqr = mm, accel, nominal_sqr, max_entry_sqr
+    self.entry_sqr = MIN_SQR
+    self.nominal_length = nominal_sqr <= MIN_SQR + 2 * accel * mm
+    self.recalculate = True
+    self.trapezoid = None
+
+class Planner(object):
+  """ Mirror of the ring buffer and the passes in planner.cpp """
+  def __init__(self, size, incremental):
+    self.size, self.incremental = size, incremental
+    self.buf = [None] * size
+    self.head = self.tail = self.planned = 0
+    self.busy = None
+    self.evals = self.walked = 0
+
+  def mod(self, i):
+    return i % self.size
+
+  def is_busy(self, i):
+    return i == self.busy
+
+  def reverse_kernel(self, i, nxt):
+    cur = self.buf[i]
+    if cur.entry_sqr != cur.max_entry_sqr or (nxt is not None and nxt.recalculate):
+      new = cur.max_entry_sqr if cur.nominal_length else \
+        min(cur.max_entry_sqr, (nxt.entry_sqr if nxt is not None else MIN_SQR) + 2 * cur.accel * cur.mm)
+      if cur.entry_sqr != new:
+        cur.recalculate = True
+        if self.is_busy(i):
+          cur.recalculate = False
+        else:
+          cur.entry_sqr = new
+    self.evals += 1
+
+  def reverse_pass(self):
+    i = self.mod(self.head - 1)
+    if self.planned == self.head:
+      return self.planned
+    nxt = None
+    while i != self.planned:
+      self.reverse_kernel(i, nxt)
+      if self.incremental and not self.buf[i].recalculate:
+        return i
+      nxt = self.buf[i]
+      i = self.mod(i - 1)
+    return self.planned
+
+  def forward_kernel(self, prev, i):
+    cur = self.buf[i]
+    if prev is not None:
+      if not prev.nominal_length and prev.entry_sqr < cur.entry_sqr:
+        new = prev.entry_sqr + 2 * prev.accel * prev.mm
+        if new < cur.entry_sqr:
+          cur.recalculate = True
+          if self.is_busy(i):
+            cur.recalculate = False
+          else:
+            cur.entry_sqr = new
+            self.planned = i
+      if cur.entry_sqr == cur.max_entry_sqr:
+        self.planned = i
+
+  def forward_pass(self, start):
+    planned = self.planned
+    i = start if self.mod(start - planned) < self.mod(self.head - planned) else planned
+    prev, prev_i = None, None
+    while i != self.head:
+      if prev is None or not self.is_busy(prev_i):
+        self.forward_kernel(prev, i)
+        self.evals += 1
+      prev, prev_i = self.buf[i], i
+      i = self.mod(i + 1)
+
+  def trapezoids(self, start):
+    tail = self.tail
+    i = start if self.mod(start - tail) < self.mod(self.head - tail) else tail
+    cur = cur_i = nxt = None
+    while i != self.head:
+      self.walked += 1
+      nxt = self.buf[i]
+      if cur is not None and (cur.recalculate or nxt.recalculate):
+        if not self.is_busy(cur_i):
+          cur.trapezoid = (cur.entry_sqr, nxt.entry_sqr)
+          self.evals += 1
+        cur.recalculate = False
+      cur, cur_i = nxt, i
+      i = self.mod(i + 1)
+    if nxt is not None:
+      if not self.is_busy(cur_i):
+        nxt.trapezoid = (nxt.entry_sqr, MIN_SQR)
+        self.evals += 1
+      nxt.recalculate = False
+
+  def recalculate(self):
+    last = self.mod(self.head - 1)
+    start = last if self.incremental else self.tail
+    if last != self.planned:
+      start = self.reverse_pass() if self.incremental else (self.reverse_pass(), self.planned)[1]
+      self.forward_pass(start)
+    self.trapezoids(start if self.incremental else self.tail)
+
+  def pick(self):
+    # Stepper::isr() taking the tail block, as in Planner::get_current_block()
+    self.busy = self.tail
+    if self.tail == self.planned:
+      self.planned = self.mod(self.tail + 1)
+
+  def add(self, block):
+    done = None
+    if self.mod(self.head - self.tail) == self.size - 1:
+      done = self.buf[self.tail].trapezoid
+      self.tail = self.mod(self.tail + 1)
+      self.pick()
+    self.buf[self.head] = block
+    self.head = self.mod(self.head + 1)
+    self.recalculate()
+    if self.busy is None:
+      self.pick()
+    return done
+
+def path():
+  """ Unit direction vectors of a path of arcs with random radii, and corners """
+  random.seed(args.seed)
+  heading = 0.0
+  while True:
+    if random.random() < 0.1:
+      heading += random.uniform(-2.5, 2.5)
+      yield heading
+    radius = random.uniform(1.0, 50.0) * random.choice((-1, 1))
+    for _ in range(random.randint(5, 200)):
+      heading += args.length / radius
+      yield heading
+
+def junction_sqr(prev, heading, nominal_sqr):
+  if prev is None:
+    return 0.0
+  cos_theta = -math.cos(heading - prev)
+  if cos_theta > 0.999999:
+    return MIN_SQR
+  cos_theta = max(cos_theta, -0.999999)
+  sin_theta_d2 = math.sqrt(0.5 * (1 - cos_theta))
+  return min(args.acceleration * args.junction_deviation * sin_theta_d2 / (1 - sin_theta_d2), nominal_sqr)
+
+for size in [int(s) for s in args.buffer_sizes.split(',')]:
+  full, incremental = Planner(size, False), Planner(size, True)
+  mismatches, prev = 0, None
+  gen = path()
+  nominal_sqr = args.feedrate ** 2
+  for _ in range(args.segments):
+    heading = next(gen)
+    vj = junction_sqr(prev, heading, nominal_sqr)
+    prev = heading
+    a = full.add(Block(args.length, args.acceleration, nominal_sqr, vj))
+    b = incremental.add(Block(args.length, args.acceleration, nominal_sqr, vj))
+    if a != b:
+      mismatches += 1
+  print('BLOCK_BUFFER_SIZE %2d' % size)
+  for name, p in (('full', full), ('incremental', incremental)):
+    print('  %-12s %6.2f evals/block  %6.2f walked/block' % (name, p.evals / args.segments, p.walked / args.segments))
+  print('  mismatches %d' % mismatches)
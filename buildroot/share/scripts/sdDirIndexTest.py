@@ -0,0 +1,812 @@
+#!/usr/bin/env python
+
+""" Check SD_DIR_INDEX against FAT16 card images with many files.
+
+A card image is made with a root folder and a JOBS folder of many G-code
+files with long names, some of them in a subfolder, next to deleted and
+hidden entries and files that aren't listed. SdVolume (a single block
+cache), the SdBaseFile calls used by CardReader, and the index code of
+cardreader.cpp are mirrored over an emulated card that counts block reads:
+index_stamp(), index_build() with its shell sort of the records in the file,
+dir_index_open(), getfilename_sorted() and the M20 listing of lsIndexed().
+
+The index must hold every listed item, sorted as presort() sorts with each
+folder sorting, with the sizes and directory entries of the items. Opening
+it again must not write the card, while adding, removing, renaming or
+growing a listed file must build it again, and writing other files must
+not. M20 must list what lsDive() does, from the indexes there are, without
+writing the card. Then an LCD page is drawn from each place in the folder, cold, and the
+block reads are compared with the walk of presort() without SD_DIR_INDEX.
+"""
+
+from __future__ import print_function, division
+
+import argparse
+import random
+import struct
+import sys
+
+parser = argparse.ArgumentParser(description=__doc__)
+parser.add_argument('--files', type=int, default=600, help='G-code files in the JOBS folder (default=600)')
+parser.add_argument('--cluster', type=int, default=8, help='Blocks per cluster (default=8)')
+parser.add_argument('--rows', type=int, default=4, help='Rows of an LCD page (default=4)')
+parser.add_argument('--vfat', type=int, default=2, help='MAX_VFAT_ENTRIES, 5 with SCROLL_LONG_FILENAMES (default=2)')
+parser.add_argument('--limit', type=int, default=40, help='SDSORT_LIMIT of the presort() compared (default=40)')
+parser.add_argument('--seed', type=int, default=1, help='Random seed (default=1)')
+args = parser.parse_args()
+
+random.seed(args.seed)
+
+FILENAME_LENGTH = 13
+LONG_FILENAME_LENGTH = FILENAME_LENGTH * args.vfat + 1
+RECORD = 128 if LONG_FILENAME_LENGTH > 43 else 64
+INDEX_LONG = min(LONG_FILENAME_LENGTH, RECORD - 7 - FILENAME_LENGTH)
+RECORD_FMT = '<IHB%ds%ds%dx' % (FILENAME_LENGTH, INDEX_LONG, RECORD - 7 - FILENAME_LENGTH - INDEX_LONG)
+MAX_DIR_DEPTH = 10
+HEADER_FMT = '<4sBBbHI'
+INDEX_NAME = b'DIRINDEX' + b'BIN'
+EOC = 0xFFFF
+
+ATTR_READ_ONLY, ATTR_HIDDEN, ATTR_VOLUME, ATTR_DIR, ATTR_ARCHIVE, ATTR_LFN = 0x01, 0x02, 0x08, 0x10, 0x20, 0x0F
+DELETED, FREE = 0xE5, 0x00
+
+class Card(object):
+  """ A FAT16 image in memory, counting block reads and writes """
+  RESERVED, FAT_BLOCKS, ROOT_BLOCKS = 1, 64, 32
+
+  def __init__(self, clusters):
+    self.data_start = self.RESERVED + self.FAT_BLOCKS + self.ROOT_BLOCKS
+    self.clusters = clusters
+    self.image = bytearray((self.data_start + clusters * args.cluster) * 512)
+    struct.pack_into('<HH', self.image, self.RESERVED * 512, 0xFFF8, EOC)
+    self.reads = self.writes = 0
+
+  def block_of(self, cluster):
+    return self.data_start + (cluster - 2) * args.cluster
+
+  def read_block(self, block):
+    self.reads += 1
+    return bytearray(self.image[block * 512:(block + 1) * 512])
+
+  def write_block(self, block, data):
+    assert 0 < block < len(self.image) // 512, 'write of block %d' % block
+    self.writes += 1
+    self.image[block * 512:(block + 1) * 512] = data
+
+class SdVolume(object):
+  """ The single block cache and FAT of SdVolume.cpp """
+
+  def __init__(self, card):
+    self.card = card
+    self.block, self.buf, self.dirty = None, None, False
+    self.alloc_start = 2
+
+  def cache_flush(self):
+    if self.dirty:
+      self.card.write_block(self.block, self.buf)
+      self.dirty = False
+
+  def cache_raw_block(self, block, dirty=False):
+    if block != self.block:
+      self.cache_flush()
+      self.buf = self.card.read_block(block)
+      self.block = block
+    if dirty:
+      self.dirty = True
+    return self.buf
+
+  def cache_set_block_number(self, block, dirty):
+    self.block, self.dirty = block, dirty
+
+  def cache_drop(self):
+    """ A cold cache, as after other card work """
+    self.cache_flush()
+    self.block = None
+
+  def fat_get(self, cluster):
+    buf = self.cache_raw_block(Card.RESERVED + (cluster >> 8))
+    return struct.unpack_from('<H', bytes(buf), (cluster & 0xFF) * 2)[0]
+
+  def fat_put(self, cluster, value):
+    buf = self.cache_raw_block(Card.RESERVED + (cluster >> 8), True)
+    struct.pack_into('<H', buf, (cluster & 0xFF) * 2, value)
+
+  def alloc_cluster(self, cur):
+    """ allocContiguous() of one cluster """
+    bgn, set_start = (cur + 1, False) if cur else (self.alloc_start, True)
+    end, n = bgn, 0
+    while True:
+      assert n < self.card.clusters, 'card full'
+      if end > self.card.clusters + 1:
+        bgn = end = 2
+      if self.fat_get(end):
+        bgn = end + 1
+      elif end == bgn:
+        break
+      n += 1
+      end += 1
+    self.fat_put(end, EOC)
+    if cur:
+      self.fat_put(cur, bgn)
+    if set_start:
+      self.alloc_start = bgn + 1
+    return bgn
+
+  def free_chain(self, cluster):
+    self.alloc_start = 2
+    while True:
+      nxt = self.fat_get(cluster)
+      self.fat_put(cluster, 0)
+      cluster = nxt
+      if cluster >= 0xFFF8:
+        break
+
+class SdFile(object):
+  """ The SdBaseFile calls of CardReader: readDir(), open(), read(), write(), seekSet(), truncate() and sync() """
+
+  def __init__(self, vol, first=0, size=0, is_dir=False, fixed=None, entry=None):
+    self.vol, self.first, self.size, self.is_dir, self.fixed = vol, first, size, is_dir, fixed
+    self.entry = entry          # Block and index of the directory entry
+    self.pos = self.cluster = 0
+    self.dir_dirty = False
+
+  @staticmethod
+  def root(vol):
+    return SdFile(vol, size=Card.ROOT_BLOCKS * 512, is_dir=True, fixed=Card.RESERVED + Card.FAT_BLOCKS)
+
+  def rewind(self):
+    self.pos = self.cluster = 0
+
+  def block_of(self):
+    if self.fixed is not None:
+      return self.fixed + (self.pos >> 9)
+    return self.vol.card.block_of(self.cluster) + ((self.pos >> 9) & (args.cluster - 1))
+
+  def next_cluster(self):
+    """ The cluster of the byte at pos, at the start of a cluster """
+    if self.fixed is None and not self.pos & 0x1FF and not (self.pos >> 9) & (args.cluster - 1):
+      self.cluster = self.first if self.pos == 0 else self.vol.fat_get(self.cluster)
+
+  def read(self, n):
+    out = bytearray()
+    n = min(n, self.size - self.pos)
+    while n > 0:
+      self.next_cluster()
+      offset = self.pos & 0x1FF
+      k = min(512 - offset, n)
+      block = self.block_of()
+      if k == 512 and block != self.vol.block:
+        out += self.vol.card.read_block(block)
+      else:
+        out += self.vol.cache_raw_block(block)[offset:offset + k]
+      self.pos += k
+      n -= k
+    return out
+
+  def read_dir(self, longname):
+    """ readDir(): the next short entry, filling longname from its VFAT entries """
+    longname[0] = 0
+    while True:
+      if self.pos + 32 > self.size:
+        return None
+      d = self.read(32)
+      if d[0] == FREE:
+        return None
+      if d[0] == DELETED or d[0] == ord('.'):
+        longname[0] = 0
+        continue
+      if d[11] & 0x3F == ATTR_LFN:
+        seq = d[0] & 0x1F
+        if struct.unpack_from('<H', bytes(d), 26)[0] == 0 and 1 <= seq <= args.vfat:
+          n = (seq - 1) * FILENAME_LENGTH
+          chars = d[1:11] + d[14:26] + d[28:32]
+          for i in range(FILENAME_LENGTH):
+            longname[n + i] = chars[2 * i]
+          if d[0] & 0x40:
+            longname[n + FILENAME_LENGTH] = 0
+      if not d[11] & ATTR_VOLUME:
+        return d
+
+  def chain_size(self):
+    n, c = 0, self.first
+    while 2 <= c < 0xFFF8:
+      n += 1
+      c = self.vol.fat_get(c)
+    return n * args.cluster * 512
+
+  def open(self, name, create=False):
+    """ open() of an 8.3 name in this folder, with O_CREAT """
+    self.rewind()
+    empty = None
+    while self.pos + 32 <= self.size:
+      index = self.pos // 32
+      d = self.read(32)
+      if d[0] in (FREE, DELETED):
+        if empty is None:
+          empty = index
+        if d[0] == FREE:
+          break
+      elif bytes(d[:11]) == name:
+        return self.open_entry(index, d)
+    if not create or empty is None:
+      return None
+    block = self.entry_block(empty)
+    buf = self.vol.cache_raw_block(block, True)
+    at = (empty & 15) * 32
+    buf[at:at + 32] = name + bytes(bytearray([ATTR_ARCHIVE])) + b'\0' * 20
+    self.vol.cache_flush()
+    return self.open_entry(empty, buf[at:at + 32])
+
+  def entry_block(self, index):
+    if self.fixed is not None:
+      return self.fixed + index // 16
+    cluster = self.first
+    for _ in range((index * 32) // (512 * args.cluster)):
+      cluster = self.vol.fat_get(cluster)
+    return self.vol.card.block_of(cluster) + ((index * 32) >> 9) % args.cluster
+
+  def open_entry(self, index, d):
+    first, size = struct.unpack_from('<HI', bytes(d), 26)
+    f = SdFile(self.vol, first, size, bool(d[11] & ATTR_DIR), entry=(self.entry_block(index), index & 15))
+    if f.is_dir:
+      f.size = f.chain_size()
+    return f
+
+  def add_cluster(self):
+    self.cluster = self.vol.alloc_cluster(self.cluster)
+    if not self.first:
+      self.first = self.cluster
+      self.dir_dirty = True
+
+  def write(self, src):
+    src = bytearray(src)
+    n = len(src)
+    while src:
+      offset = self.pos & 0x1FF
+      if not offset and not (self.pos >> 9) & (args.cluster - 1):
+        if not self.cluster:
+          if not self.first:
+            self.add_cluster()
+          else:
+            self.cluster = self.first
+        else:
+          nxt = self.vol.fat_get(self.cluster)
+          if nxt >= 0xFFF8:
+            self.add_cluster()
+          else:
+            self.cluster = nxt
+      k = min(512 - offset, len(src))
+      block = self.block_of()
+      if k == 512:
+        if self.vol.block == block:
+          self.vol.cache_set_block_number(None, False)
+        self.vol.card.write_block(block, src[:512])
+      else:
+        if not offset and self.pos >= self.size:
+          self.vol.cache_flush()
+          self.vol.cache_set_block_number(block, True)
+          self.vol.buf = bytearray(512)
+        else:
+          self.vol.cache_raw_block(block, True)
+        self.vol.buf[offset:offset + k] = src[:k]
+      self.pos += k
+      src = src[k:]
+    if self.pos > self.size:
+      self.size = self.pos
+      self.dir_dirty = True
+    return n
+
+  def sync(self):
+    if self.dir_dirty:
+      block, i = self.entry
+      d = self.vol.cache_raw_block(block, True)
+      struct.pack_into('<HI', d, i * 32 + 26, self.first, self.size)
+      self.dir_dirty = False
+    self.vol.cache_flush()
+    return True
+
+  def seek_set(self, pos):
+    if pos > self.size:
+      return False
+    if self.fixed is not None or pos == 0:
+      self.pos, self.cluster = pos, 0
+      return True
+    shift = args.cluster.bit_length() - 1 + 9
+    n_cur, n_new = (self.pos - 1) >> shift, (pos - 1) >> shift
+    if n_new < n_cur or self.pos == 0:
+      self.cluster = self.first
+    else:
+      n_new -= n_cur
+    for _ in range(n_new):
+      self.cluster = self.vol.fat_get(self.cluster)
+    self.pos = pos
+    return True
+
+  def truncate(self):
+    """ truncate(0) """
+    if not self.size:
+      return True
+    self.seek_set(0)
+    self.vol.free_chain(self.first)
+    self.first = self.size = 0
+    self.dir_dirty = True
+    return self.sync()
+
+def cstr(buf):
+  buf = bytes(buf)
+  return buf[:buf.index(b'\0')] if b'\0' in buf else buf
+
+def to83(name):
+  base, _, ext = name.partition(b'.')
+  return base.ljust(8) + ext.ljust(3)
+
+def create_filename(d):
+  out = b''
+  for i in range(11):
+    if d[i] == 0x20:
+      continue
+    if i == 8:
+      out += b'.'
+    out += bytes(bytearray([d[i]]))
+  return out
+
+def is_listed(d, longname):
+  if d[0] in (DELETED, ord('.')) or longname[0] == ord('.'):
+    return False
+  if d[11] & ATTR_VOLUME or d[11] & ATTR_HIDDEN:
+    return False
+  return bool(d[11] & ATTR_DIR) or (d[8] == ord('G') and d[9] != ord('~'))
+
+def fnv(h, data):
+  for c in bytearray(data):
+    h = ((h ^ c) * 16777619) & 0xFFFFFFFF
+  return h
+
+def index_stamp(folder):
+  """ The stamp, and the entry of the index file if there is one """
+  h, entry, longname = 2166136261, None, bytearray(LONG_FILENAME_LENGTH + 13)
+  folder.rewind()
+  while True:
+    d = folder.read_dir(longname)
+    if d is None:
+      return h, entry
+    if bytes(d[:11]) == INDEX_NAME:
+      entry = folder.pos // 32 - 1
+    if is_listed(d, longname):
+      h = fnv(fnv(fnv(h, d[:18]), d[20:32]), cstr(longname))
+
+def pack_record(r):
+  return struct.pack(RECORD_FMT, r['size'], r['entry'], r['dir'], r['name'], r['long'])
+
+def unpack_record(buf):
+  size, entry, is_dir, name, long_ = struct.unpack(RECORD_FMT, bytes(buf))
+  return dict(size=size, entry=entry, dir=is_dir, name=cstr(name), long=cstr(long_))
+
+def index_record(index, nr, rec=None):
+  if not index.seek_set(512 + nr * RECORD):
+    return None
+  if rec is None:
+    buf = index.read(RECORD)
+    return unpack_record(buf) if len(buf) == RECORD else None
+  return index.write(pack_record(rec)) == RECORD
+
+def longest(r):
+  return (r['long'] or r['name']).lower()
+
+def index_after(a, b, folders):
+  if folders and a['dir'] != b['dir']:
+    return a['dir'] if folders > 0 else b['dir']
+  return longest(a) > longest(b)
+
+GAPS = (1750, 701, 301, 132, 57, 23, 10, 4, 1)
+
+def index_build(folder, index, stamp, folders):
+  index.truncate()
+  for _ in range(512 // RECORD):
+    index.write(b'\0' * RECORD)
+  n, longname = 0, bytearray(LONG_FILENAME_LENGTH + 13)
+  folder.rewind()
+  while True:
+    d = folder.read_dir(longname)
+    if d is None:
+      break
+    if not is_listed(d, longname):
+      continue
+    r = dict(size=struct.unpack_from('<I', bytes(d), 28)[0], entry=folder.pos // 32 - 1, dir=bool(d[11] & ATTR_DIR),
+             name=create_filename(d), long=cstr(longname)[:INDEX_LONG - 1])
+    index.write(pack_record(r))
+    n += 1
+  for gap in GAPS:
+    for i in range(gap, n):
+      tmp = index_record(index, i)
+      j = i
+      while j >= gap:
+        r = index_record(index, j - gap)
+        if not index_after(r, tmp, folders):
+          break
+        index_record(index, j, r)
+        j -= gap
+      if j != i:
+        index_record(index, j, tmp)
+  index.seek_set(0)
+  index.write(struct.pack(HEADER_FMT, b'MIDX', 1, RECORD, folders, n, stamp))
+  index.sync()
+  return n
+
+class Stats(object):
+  builds = 0
+
+def dir_index_open(folder, folders, build=True):
+  """ dir_index_open(): the index file and its count """
+  stamp, entry = index_stamp(folder)
+  if entry is None:
+    if not build:
+      return None, 0
+    index = folder.open(INDEX_NAME, create=True)
+  else:
+    folder.seek_set(entry * 32)
+    index = folder.open_entry(entry, folder.read(32))
+  if index is None:
+    return None, 0
+  head = index.read(struct.calcsize(HEADER_FMT))
+  if len(head) == struct.calcsize(HEADER_FMT):
+    magic, version, size, f, count, s = struct.unpack(HEADER_FMT, bytes(head))
+    if magic == b'MIDX' and version == 1 and size == RECORD and f == folders and s == stamp and index.size >= 512 + count * RECORD:
+      return index, count
+  if not build:
+    return None, 0
+  Stats.builds += 1
+  return index, index_build(folder, index, stamp, folders)
+
+def listed(folder):
+  """ The items lsDive() finds, in directory order, with long names cut as the index holds them """
+  out, longname = [], bytearray(LONG_FILENAME_LENGTH + 13)
+  folder.rewind()
+  while True:
+    d = folder.read_dir(longname)
+    if d is None:
+      return out
+    if is_listed(d, longname):
+      out.append(dict(size=struct.unpack_from('<I', bytes(d), 28)[0], entry=folder.pos // 32 - 1, dir=bool(d[11] & ATTR_DIR),
+                      name=create_filename(d), long=cstr(longname)[:INDEX_LONG - 1]))
+
+# Building the card image
+
+def lfn_checksum(short):
+  s = 0
+  for c in bytearray(short):
+    s = (((s & 1) << 7) + (s >> 1) + c) & 0xFF
+  return s
+
+def lfn_entries(name, short):
+  """ VFAT entries for a long name, last part first """
+  chars = [ord(c) for c in name] + [0]
+  chars += [0xFFFF] * (-len(chars) % 13)
+  parts = [chars[i:i + 13] for i in range(0, len(chars), 13)]
+  if len(name) % 13 == 0:
+    parts = parts[:-1] if parts[-1][0] == 0 and len(parts) > 1 else parts
+  out = []
+  for seq in range(len(parts), 0, -1):
+    p = parts[seq - 1]
+    e = bytearray(32)
+    e[0] = seq | (0x40 if seq == len(parts) else 0)
+    struct.pack_into('<5H', e, 1, *p[:5])
+    e[11], e[13] = ATTR_LFN, lfn_checksum(short)
+    struct.pack_into('<6H', e, 14, *p[5:11])
+    struct.pack_into('<2H', e, 28, *p[11:13])
+    out.append(bytes(e))
+  return out
+
+class Builder(object):
+  """ Lays out folders and files on a fresh card """
+
+  def __init__(self, card):
+    self.card = card
+    self.next_cluster = 2
+
+  def chain(self, clusters):
+    first = self.next_cluster
+    for c in range(first, first + clusters):
+      struct.pack_into('<H', self.card.image, Card.RESERVED * 512 + c * 2, c + 1 if c + 1 < first + clusters else EOC)
+    self.next_cluster += clusters
+    return first
+
+  def file_data(self, data):
+    if not data:
+      return 0
+    clusters = (len(data) + 512 * args.cluster - 1) // (512 * args.cluster)
+    first = self.chain(clusters)
+    at = self.card.block_of(first) * 512
+    self.card.image[at:at + len(data)] = data
+    return first
+
+  def folder(self, entries, fixed=None):
+    raw = b''.join(entries)
+    if fixed is not None:
+      assert len(raw) <= Card.ROOT_BLOCKS * 512, 'root too full'
+      self.card.image[fixed * 512:fixed * 512 + len(raw)] = raw
+      return 0
+    # Room for the index and a few more files
+    clusters = (len(raw) + 32 * 64) // (512 * args.cluster) + 1
+    first = self.chain(clusters)
+    at = self.card.block_of(first) * 512
+    self.card.image[at:at + len(raw)] = raw
+    return first
+
+def short_entry(short, attr, first, size):
+  e = bytearray(32)
+  e[0:11] = short
+  e[11] = attr
+  struct.pack_into('<HHHH', e, 14, random.randrange(0x10000), random.randrange(0x10000), 0, 0)
+  struct.pack_into('<HHHI', e, 22, random.randrange(0x10000), random.randrange(0x10000), first, size)
+  return bytes(e)
+
+WORDS = ['benchy', 'Bracket', 'calibration_cube', 'PLA', 'petg', 'v2', 'final', 'test', 'gear', 'Lid', 'box', '0.2mm', 'fast',
+         'spool_holder', 'Z', 'a', '_draft', 'hinge', 'vase', 'x', 'Tower', 'retraction']
+
+def random_name(i):
+  return '_'.join(random.choice(WORDS) for _ in range(random.randint(1, 4))) + ('_%d' % i if random.random() < 0.7 else '')
+
+def make_items(b, count, prefix, depth=0):
+  """ Entries of a folder of G-code files, other files, deleted and hidden entries """
+  entries, names = [], []
+  for i in range(count):
+    kind = random.random()
+    short = '%s%05d~1' % (prefix[:1], i)
+    if kind < 0.1:
+      short = '%s%07d' % (prefix[:1], i)  # An upper case 8.3 name, with no long name
+      ext, lfn = 'GCO', None
+    elif kind < 0.15:
+      ext, lfn = 'TXT', random_name(i) + '.txt'
+    elif kind < 0.18:
+      ext, lfn = 'GCO', '._' + random_name(i) + '.gcode'  # macOS resource fork
+    elif kind < 0.2:
+      ext, lfn = 'G~ ', None
+    else:
+      ext, lfn = 'GCO', random_name(i) + '.gcode'
+    short = short.encode('ascii') + ext.encode('ascii')
+    data = ('; %s\nG28\nG1 X10\n' % lfn).encode('ascii') * random.randint(1, 60)
+    attr = ATTR_ARCHIVE | (ATTR_HIDDEN if random.random() < 0.03 else 0)
+    if lfn:
+      entries += lfn_entries(lfn, short)
+    entries.append(short_entry(short, attr, b.file_data(data), len(data)))
+    if random.random() < 0.05:
+      # A deleted file, with its long name
+      dead = bytearray(short_entry(short, ATTR_ARCHIVE, 0, 0))
+      entries += [bytes(bytearray([DELETED])) + e[1:] for e in lfn_entries('deleted_' + random_name(i), bytes(dead[:11]))]
+      dead[0] = DELETED
+      entries.append(bytes(dead))
+    names.append(lfn)
+  if depth == 0:
+    for j in range(3):
+      sub = make_items(b, random.randint(0, 12), 'S%d' % j, depth + 1)
+      first = b.folder(sub)
+      entries += lfn_entries('Folder %s %d' % (random.choice(WORDS), j), ('SUBDIR~%d   ' % j).encode('ascii'))
+      entries.append(short_entry(('SUBDIR~%d   ' % j).encode('ascii'), ATTR_DIR, first, 0))
+  return entries
+
+def make_card():
+  card = Card(clusters=8 * args.files + 4000 // args.cluster + 200)
+  b = Builder(card)
+  jobs = make_items(b, args.files, 'J')
+  jobs_first = b.folder(jobs)
+  root = make_items(b, 30, 'R', depth=1)
+  root += lfn_entries('Print Jobs', b'JOBS       ')
+  root.append(short_entry(b'JOBS       ', ATTR_DIR, jobs_first, 0))
+  root.append(short_entry(b'BIN        ', ATTR_ARCHIVE, 0, 0))  # The power-loss recovery file
+  b.folder(root, fixed=Card.RESERVED + Card.FAT_BLOCKS)
+  return card
+
+# The checks
+
+failures = []
+
+def check(cond, msg):
+  if not cond:
+    failures.append(msg)
+  return cond
+
+def read_index(index, count):
+  return [index_record(index, i) for i in range(count)]
+
+def check_index(what, folder, folders):
+  index, count = dir_index_open(folder, folders)
+  if not check(index is not None, '%s: no index' % what):
+    return None, 0
+  items = listed(folder)
+  records = read_index(index, count)
+  check(count == len(items), '%s: %d records for %d items' % (what, count, len(items)))
+  key = lambda r: (r['entry'], r['name'], r['long'], r['size'], r['dir'])
+  check(sorted(map(key, records)) == sorted(map(key, items)), '%s: the records are not the items of the folder' % what)
+  for a, b in zip(records, records[1:]):
+    if not check(not index_after(a, b, folders), '%s: %r sorted before %r' % (what, longest(a), longest(b))):
+      break
+  check(not any(r['name'] == b'DIRINDEX.BIN' for r in records), '%s: the index lists itself' % what)
+  return index, count
+
+def old_presort_reads(folder, limit):
+  """ Block reads of presort() and a page without SD_DIR_INDEX: bubble sort, reading names as needed """
+  card = folder.vol.card
+  folder.vol.cache_drop()
+  start = card.reads
+  items = listed(folder)  # getnrfilenames()
+  n = min(len(items), limit)
+  order = list(range(n))
+
+  def getfilename(nr):
+    # lsDive() from the start of the folder to item nr
+    folder.rewind()
+    longname, cnt = bytearray(LONG_FILENAME_LENGTH + 13), 0
+    while True:
+      d = folder.read_dir(longname)
+      if d is None:
+        return None
+      if is_listed(d, longname):
+        if cnt == nr:
+          return dict(name=create_filename(d), long=cstr(longname), dir=bool(d[11] & ATTR_DIR))
+        cnt += 1
+
+  for i in range(n - 1, 0, -1):
+    swapped = False
+    for j in range(i):
+      a, b = getfilename(order[j]), getfilename(order[j + 1])
+      if index_after(a, b, -1):
+        order[j], order[j + 1] = order[j + 1], order[j]
+        swapped = True
+    if not swapped:
+      break
+  presort = card.reads - start
+  # A page: get_num_Files() walks the folder, then each row walks to its item
+  start = card.reads
+  listed(folder)
+  for row in range(args.rows):
+    getfilename(order[row] if row < n else row)
+  return presort, card.reads - start
+
+def ls_dive(folder, prepend):
+  """ lsDive() of M20: the listed files below a folder, in directory order """
+  out = []
+  for r in listed(folder):
+    if r['dir']:
+      out += ls_dive(folder.open(to83(r['name'])), (prepend or b'/') + r['name'] + b'/')
+    else:
+      out.append((prepend + r['name'], r['size']))
+  return out
+
+def ls_indexed(root):
+  """ lsIndexed(): folders with a valid index from it, the others with lsDive() """
+  out, path, next_rec, folder = [], [], [0], root
+  while True:
+    prepend = b'/' + b''.join(n + b'/' for n in path) if path else b''
+    index, count = dir_index_open(folder, -1, build=False)
+    if index is None and not next_rec[-1]:
+      out += ls_dive(folder, prepend)
+    reopen = False
+    while not reopen and next_rec[-1] < count:
+      r = index_record(index, next_rec[-1])
+      next_rec[-1] += 1
+      if r['dir']:
+        sub = folder.open(to83(r['name']))
+        if len(path) < MAX_DIR_DEPTH - 1 and sub is not None:
+          folder = sub
+          path.append(r['name'])
+          next_rec.append(0)
+        reopen = True
+      else:
+        out.append((prepend + r['name'], r['size']))
+    if reopen:
+      continue
+    if not path:
+      return out
+    # Back up to the parent, opened again from the root
+    path.pop()
+    next_rec.pop()
+    folder = root
+    for name in path:
+      folder = folder.open(to83(name))
+
+card = make_card()
+vol = SdVolume(card)
+root = SdFile.root(vol)
+jobs = root.open(b'JOBS       ')
+print('%d files in JOBS, %d items listed, long names up to %d characters' % (args.files, len(listed(jobs)), LONG_FILENAME_LENGTH - 1))
+
+# M20 on a card without indexes lists every folder and creates no index
+writes = card.writes
+check(sorted(ls_indexed(root)) == sorted(ls_dive(root, b'')), 'M20 without indexes differs from lsDive()')
+check(card.writes == writes and root.open(INDEX_NAME) is None and jobs.open(INDEX_NAME) is None, 'M20 created an index')
+
+# Each folder sorting builds a sorted index
+for folders in (0, 1, -1):
+  check_index('JOBS, folders %d' % folders, jobs, folders)
+check_index('root', root, -1)
+
+# Opening it again reads the folder and the header but writes nothing
+vol.cache_drop()
+builds, reads, writes = Stats.builds, card.reads, card.writes
+dir_index_open(jobs, -1)
+check(Stats.builds == builds and card.writes == writes, 'opening a valid index wrote the card')
+validate_reads = card.reads - reads
+folder_blocks = jobs.size // 512
+check_index('JOBS again', jobs, -1)
+
+# Writing a file that isn't listed leaves the index valid
+recovery = root.open(b'BIN        ')
+recovery.seek_set(0)
+recovery.write(bytearray(random.getrandbits(8) for _ in range(600)))
+recovery.sync()
+builds = Stats.builds
+check_index('root after a recovery save', root, -1)
+check(Stats.builds == builds, 'writing an unlisted file made the index stale')
+
+def changed(what, change):
+  change()
+  builds = Stats.builds
+  check_index('JOBS after %s' % what, jobs, -1)
+  check(Stats.builds == builds + 1, '%s left the index valid' % what)
+
+def add_file():
+  f = jobs.open(b'NEWJOB  GCO', create=True)
+  f.write(b'G28\n' * 100)
+  f.sync()
+
+def remove_file():
+  item = random.choice([i for i in listed(jobs) if not i['dir']])
+  block = jobs.entry_block(item['entry'])
+  vol.cache_raw_block(block, True)[(item['entry'] & 15) * 32] = DELETED
+  vol.cache_flush()
+
+def rename_file():
+  # Change the first letter of a long name in place, as a PC would
+  item = random.choice([i for i in listed(jobs) if i['long'] and not i['dir']])
+  at = item['entry'] - 1
+  buf = vol.cache_raw_block(jobs.entry_block(at), True)
+  struct.pack_into('<H', buf, (at & 15) * 32 + 1, ord('~'))
+  vol.cache_flush()
+
+def grow_file():
+  f = jobs.open(b'NEWJOB  GCO')
+  f.seek_set(f.size)
+  f.write(b'G1 X1\n')
+  f.sync()
+
+for what, change in (('adding a file', add_file), ('removing a file', remove_file),
+                     ('renaming a file', rename_file), ('writing a file', grow_file)):
+  changed(what, change)
+
+# An index cut short by a reset is built again
+index, count = dir_index_open(jobs, -1)
+index.seek_set(0)
+index.write(b'\0\0\0\0')
+index.sync()
+builds = Stats.builds
+check_index('JOBS after a cut build', jobs, -1)
+check(Stats.builds == builds + 1, 'an index without its header was used')
+
+# LCD pages, cold, from the index
+index, count = dir_index_open(jobs, -1)
+worst, total, pages = 0, 0, 0
+for top in range(0, count, args.rows):
+  vol.cache_drop()
+  start = card.reads
+  rows = [index_record(index, nr) for nr in range(top, min(top + args.rows, count))]
+  check(all(rows), 'page at %d: a record could not be read' % top)
+  worst = max(worst, card.reads - start)
+  total += card.reads - start
+  pages += 1
+check(worst <= 3, 'a page needed %d block reads' % worst)
+
+# M20 from the indexes there are lists what lsDive() does, and writes nothing
+writes = card.writes
+check(sorted(ls_indexed(root)) == sorted(ls_dive(root, b'')), 'M20 from the indexes differs from lsDive()')
+check(card.writes == writes, 'M20 wrote the card')
+
+presort, page = old_presort_reads(jobs, args.limit)
+print('index: %d block reads to check it against a folder of %d blocks, %d pages of %d rows read %.2f blocks on average and %d at most' % (
+  validate_reads, folder_blocks, pages, args.rows, total / max(pages, 1), worst))
+print('presort() of %d items: %d block reads, then %d for each page' % (min(count, args.limit), presort, page))
+
+for f in failures[:20]:
+  print('FAIL', f)
+print('%d failures' % len(failures))
+sys.exit(1 if failures else 0)
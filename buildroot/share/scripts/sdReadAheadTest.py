@@ -0,0 +1,386 @@
+#!/usr/bin/env python
+
+""" Check SD_READ_AHEAD on an emulated SD card backed by a file image.
+
+A G-code file (without one, a generated slicer-like print) is written into a
+FAT16 image file with its clusters partly fragmented. An emulated card serves
+CMD17, CMD18 and CMD12 from the image and checks that data is only read in
+sequence within a multiple block read and that other commands end it first.
+
+The read path of Sd2Card, SdVolume, SdBaseFile and CardReader is mirrored with
+and without the read-ahead: get() byte by byte, setIndex() to random places,
+FAT and directory reads in between, and read_ahead() from idle() while the
+planner is full. The bytes read must match the file. Card time is estimated
+for an AVR at SPI_FULL_SPEED, and the blocks read per second and the time the
+command reader was stalled on the card are printed for both paths.
+"""
+
+from __future__ import print_function, division
+
+import argparse
+import os
+import random
+import struct
+import sys
+import tempfile
+
+parser = argparse.ArgumentParser(description=__doc__)
+parser.add_argument('gcode', nargs='?', help='G-code file (default: a generated print)')
+parser.add_argument('--image', help='Keep the card image in this file (default: a temporary file)')
+parser.add_argument('--blocks', type=int, default=2, help='SD_READ_AHEAD_BLOCKS (default=2)')
+parser.add_argument('--cluster', type=int, default=8, help='Blocks per cluster (default=8)')
+parser.add_argument('--layers', type=int, default=40, help='Layers of the generated print (default=40)')
+parser.add_argument('--seeks', type=int, default=200, help='Random setIndex() checks (default=200)')
+parser.add_argument('--seed', type=int, default=1, help='Random seed (default=1)')
+args = parser.parse_args()
+
+random.seed(args.seed)
+
+# Estimated card timing in microseconds
+US = {
+  'command': 30,      # Command, argument, CRC and R1 response
+  'access': 350,      # Wait for the data token of a new read
+  'next': 40,         # Wait for the next data token of a multiple block read
+  'transfer': 600,    # 512 bytes and the CRC at F_CPU/2 with the loop overhead
+  'stop': 40          # CMD12, its stuff byte and busy
+}
+IDLE_US = 1000        # How often idle() runs while the planner is full
+
+CMD12, CMD17, CMD18 = 12, 17, 18
+
+def generated_print():
+  lines = ['M140 S60', 'M104 S210', 'M190 S60', 'M109 S210', 'G28', 'G92 E0']
+  x, y, e = 100.0, 100.0, 0.0
+  for layer in range(args.layers):
+    lines.append('G1 Z%.2f F600' % (0.2 + 0.2 * layer))
+    for _ in range(random.randint(3, 8)):
+      lines.append('G0 F9000 X%.3f Y%.3f' % (random.uniform(20, 180), random.uniform(20, 180)))
+      lines.append('G1 F%d' % random.choice((1800, 2700, 3600)))
+      for _ in range(random.randint(20, 120)):
+        x += random.uniform(-2, 2)
+        y += random.uniform(-2, 2)
+        e += random.uniform(0.01, 0.1)
+        lines.append('G1 X%.3f Y%.3f E%.5f' % (x, y, e))
+  return '\n'.join(lines) + '\n'
+
+class Image(object):
+  """ A FAT16 image holding one file, as a file on disk """
+  RESERVED, FAT_BLOCKS, ROOT_BLOCKS = 1, 64, 32
+
+  def __init__(self, data, path):
+    bpc = args.cluster
+    clusters = (len(data) + 512 * bpc - 1) // (512 * bpc)
+    # Mostly contiguous runs, some of them out of order
+    free = list(range(2, 2 + clusters * 2))
+    chain, run = [], []
+    while len(chain) < clusters:
+      start = random.choice(free)
+      n = min(random.randint(1, 6), clusters - len(chain))
+      run = [c for c in range(start, start + n) if c in free]
+      if not run:
+        continue
+      for c in run:
+        free.remove(c)
+      chain += run
+    self.first_cluster = chain[0]
+    self.data_start = self.RESERVED + self.FAT_BLOCKS + self.ROOT_BLOCKS
+    fat = [0] * (self.FAT_BLOCKS * 256)
+    fat[0], fat[1] = 0xFFF8, 0xFFFF
+    for a, b in zip(chain, chain[1:] + [0xFFFF]):
+      fat[a] = b
+    self.total = self.data_start + (2 + clusters * 2) * bpc
+    self.path = path
+    with open(path, 'wb') as f:
+      f.truncate(self.total * 512)
+      f.seek(self.RESERVED * 512)
+      f.write(struct.pack('<%dH' % len(fat), *fat))
+      f.seek((self.RESERVED + self.FAT_BLOCKS) * 512)
+      f.write(b'PRINT   GCO' + b'\0' * 21)
+      for i, c in enumerate(chain):
+        f.seek(self.block_of(c) * 512)
+        f.write(data[i * 512 * bpc:(i + 1) * 512 * bpc])
+
+  def block_of(self, cluster):
+    return self.data_start + (cluster - 2) * args.cluster
+
+class Card(object):
+  """ The emulated card, serving blocks of the image """
+
+  def __init__(self, image):
+    self.f = open(image.path, 'rb')
+    self.total = image.total
+    self.stream = None    # Next block of an open CMD18
+    self.us = 0
+    self.reads = self.commands = 0
+    self.errors = []
+
+  def command(self, cmd, arg):
+    self.commands += 1
+    self.us += US['command']
+    if cmd == CMD12:
+      if self.stream is None:
+        self.errors.append('CMD12 without a multiple block read')
+      self.stream = None
+      self.us += US['stop']
+      return
+    if self.stream is not None:
+      self.errors.append('CMD%d during a multiple block read' % cmd)
+    if cmd == CMD18:
+      self.stream = arg
+    elif cmd == CMD17:
+      self.single = arg
+
+  def data(self, streaming):
+    """ A data block of CMD17, or the next one of CMD18 """
+    block = self.stream if streaming else self.single
+    if streaming:
+      if self.stream is None:
+        self.errors.append('data without a read command')
+        return bytearray(512)
+      self.stream += 1
+    self.us += (US['next'] if streaming and self.reads and self.last == block - 1 else US['access']) + US['transfer']
+    self.reads += 1
+    self.last = block
+    if not 0 <= block < self.total:
+      self.errors.append('block %d out of range' % block)
+    self.f.seek(block * 512)
+    return bytearray(self.f.read(512))
+
+class Sd2Card(object):
+  """ Sd2Card.cpp, with the streaming of SD_READ_AHEAD """
+
+  def __init__(self, card):
+    self.card = card
+    self.streaming = False
+    self.stream_block = 0
+
+  def card_command(self, cmd, arg):
+    if self.streaming and cmd != CMD12:
+      self.read_stream_end()
+    self.card.command(cmd, arg)
+
+  def read_block(self, block):
+    self.card_command(CMD17, block)
+    return self.card.data(False)
+
+  def read_stream(self, block):
+    if not self.streaming or block != self.stream_block:
+      self.read_stream_end()
+      self.card_command(CMD18, block)
+      self.streaming, self.stream_block = True, block
+    self.stream_block += 1
+    return self.card.data(True)
+
+  def read_stream_end(self):
+    if self.streaming:
+      self.streaming = False
+      self.card_command(CMD12, 0)
+
+class SdVolume(object):
+  """ The single block cache of SdVolume """
+
+  def __init__(self, sd, image):
+    self.sd, self.image = sd, image
+    self.cache_block, self.cache = None, None
+
+  def cache_raw_block(self, block):
+    if block != self.cache_block:
+      self.cache = self.sd.read_block(block)
+      self.cache_block = block
+    return self.cache
+
+  def fat_get(self, cluster):
+    block = self.image.RESERVED + (cluster >> 8)
+    cache = self.cache_raw_block(block)
+    return struct.unpack_from('<H', bytes(cache), (cluster & 0xFF) * 2)[0]
+
+class SdBaseFile(object):
+  """ read(), readStream() and seekSet() of SdBaseFile """
+
+  def __init__(self, vol, image, size):
+    self.vol, self.first, self.size = vol, image.first_cluster, size
+    self.pos, self.cluster = 0, image.first_cluster
+
+  def block(self):
+    of_cluster = (self.pos >> 9) & (args.cluster - 1)
+    if (self.pos & 0x1FF) == 0 and of_cluster == 0:
+      self.cluster = self.first if self.pos == 0 else self.vol.fat_get(self.cluster)
+    return self.vol.image.block_of(self.cluster) + of_cluster
+
+  def read(self):
+    if self.pos >= self.size:
+      return -1
+    block = self.block()
+    c = self.vol.cache_raw_block(block)[self.pos & 0x1FF]
+    self.pos += 1
+    return c
+
+  def read_stream(self):
+    assert not self.pos & 0x1FF
+    if self.pos >= self.size:
+      return 0, None
+    block = self.block()
+    if block == self.vol.cache_block:
+      data = bytearray(self.vol.cache)
+    else:
+      data = self.vol.sd.read_stream(block)
+    n = min(self.size - self.pos, 512)
+    self.pos += n
+    return n, data
+
+  def seek_set(self, pos):
+    """ The cluster of the byte before pos, so a read at a boundary follows the chain """
+    if pos == 0:
+      self.pos = self.cluster = 0
+      return
+    shift = args.cluster.bit_length() - 1 + 9
+    n_cur, n_new = (self.pos - 1) >> shift, (pos - 1) >> shift
+    if n_new < n_cur or self.pos == 0:
+      self.cluster = self.first
+    else:
+      n_new -= n_cur
+    for _ in range(n_new):
+      self.cluster = self.vol.fat_get(self.cluster)
+    self.pos = pos
+
+class CardReader(object):
+  """ get(), setIndex() and read_ahead() of CardReader """
+
+  def __init__(self, file_, ahead):
+    self.file, self.ahead = file_, ahead
+    self.buffers = [None] * args.blocks
+    self.head = self.count = 0
+    self.ahead_pos = 0
+    self.stalls = self.stall_us = 0
+
+  def read_ahead_block(self):
+    if self.count >= args.blocks or self.file.pos >= self.file.size:
+      return False
+    n, data = self.file.read_stream()
+    if n <= 0:
+      return False
+    self.buffers[(self.head + self.count) % args.blocks] = data
+    self.count += 1
+    return True
+
+  def read_ahead(self):
+    if self.ahead:
+      self.read_ahead_block()
+
+  def get(self):
+    if not self.ahead:
+      start = card.us
+      c = self.file.read()
+      if card.us != start:
+        self.stalls += 1
+        self.stall_us += card.us - start
+      return c
+    if self.ahead_pos >= self.file.size:
+      return -1
+    if not self.count:
+      start = card.us
+      ok = self.read_ahead_block()
+      self.stalls += 1
+      self.stall_us += card.us - start
+      if not ok:
+        return -1
+    c = self.buffers[self.head][self.ahead_pos & 0x1FF]
+    self.ahead_pos += 1
+    if not self.ahead_pos & 0x1FF:
+      self.head = (self.head + 1) % args.blocks
+      self.count -= 1
+    return c
+
+  def set_index(self, index):
+    if self.ahead:
+      self.head = self.count = 0
+      self.ahead_pos = index
+      self.file.seek_set(index & ~0x1FF)
+    else:
+      self.file.seek_set(index)
+
+def move_us(line, state):
+  """ Time the planner needs for a line, which the main loop spends in idle() once it's full """
+  words = dict((w[0], w[1:]) for w in line.split()[1:] if w[:1].isalpha())
+  try:
+    if 'F' in words:
+      state['F'] = float(words['F'])
+    dist = 0.0
+    for axis in 'XYZ':
+      if axis in words:
+        dist += (float(words[axis]) - state[axis]) ** 2
+        state[axis] = float(words[axis])
+  except ValueError:
+    return 0
+  return int(1e6 * dist ** 0.5 / (state['F'] / 60)) if line.startswith(('G0', 'G1')) else 0
+
+def run(data, image, ahead):
+  global card
+  card = Card(image)
+  sd = Sd2Card(card)
+  vol = SdVolume(sd, image)
+  reader = CardReader(SdBaseFile(vol, image, len(data)), ahead)
+  failures = []
+
+  # Random places, as M26 and M32 return would set, with other card reads between
+  for _ in range(args.seeks):
+    pos = random.randrange(len(data))
+    reader.set_index(pos)
+    got = bytearray()
+    for _ in range(random.randint(1, 1500)):
+      c = reader.get()
+      if c < 0:
+        break
+      got.append(c)
+      if random.random() < 0.002:
+        vol.cache_raw_block(image.RESERVED + image.FAT_BLOCKS)  # A directory read for the LCD
+      if random.random() < 0.01:
+        reader.read_ahead()
+    if bytes(got) != data[pos:pos + len(got)]:
+      failures.append('setIndex(%d): read %r' % (pos, bytes(got[:40])))
+
+  # The whole print, with idle() reading ahead while the planner is full
+  reader.set_index(0)
+  card.us = card.reads = 0
+  reader.stalls = reader.stall_us = 0
+  got, line, state = bytearray(), bytearray(), {'X': 0.0, 'Y': 0.0, 'Z': 0.0, 'F': 1500.0}
+  loop_us = 0
+  while True:
+    c = reader.get()
+    if c < 0:
+      break
+    got.append(c)
+    if c != 10:
+      line.append(c)
+      continue
+    t = move_us(line.decode('ascii'), state)
+    loop_us += t
+    while t > 0:
+      reader.read_ahead()
+      t -= IDLE_US
+    line = bytearray()
+  if bytes(got) != data:
+    failures.append('the print read back differently (%d of %d bytes)' % (len(got), len(data)))
+  failures += card.errors
+  return failures, card.reads, card.us, reader.stalls, reader.stall_us, loop_us
+
+data = open(args.gcode, 'rb').read() if args.gcode else generated_print().encode('ascii')
+path = args.image or os.path.join(tempfile.mkdtemp(), 'card.img')
+image = Image(data, path)
+print('%d bytes in %d clusters of %d blocks, image %s' % (len(data), (len(data) + 512 * args.cluster - 1) // (512 * args.cluster), args.cluster, path))
+
+failures = []
+for ahead in (False, True):
+  fails, reads, card_us, stalls, stall_us, print_us = run(data, image, ahead)
+  failures += fails
+  print('%-10s %5d blocks read at %6.0f blk/s of card time, %5d stalls for %7.1fms in a %.0fs print' % (
+    'read-ahead' if ahead else 'cache', reads, reads * 1e6 / max(card_us, 1), stalls, stall_us / 1000.0, print_us / 1e6))
+
+if not args.image:
+  os.remove(path)
+  os.rmdir(os.path.dirname(path))
+
+for f in failures[:20]:
+  print('FAIL', f)
+print('%d failures' % len(failures))
+sys.exit(1 if failures else 0)
@@ -0,0 +1,396 @@
+#!/usr/bin/env python
+
+""" Stream G-code with the credit-based flow control of SERIAL_CREDITS (M941 S1).
+
+After M941 S1 each "ok" and "Resend:" carries R, the count of bytes the printer
+has taken from its RX buffer (modulo 65536). The sender keeps writing lines
+while its own count of bytes written, less R, fits in the window that M941
+reports (RX_BUFFER_SIZE - 1), so the RX buffer can't overrun however many lines
+are in flight. Each "ok" names its line with N. A "Resend:" whose R shows that
+the last copy of the line asked for was never taken is left over from lines
+already in flight, and is ignored.
+
+The loopback benchmark runs a mirror of get_serial_commands(), the command
+queue and ok_to_send() on a serial link of a fixed baud rate, with a reply
+latency on the host side and a time to run each command. A G-code file
+(without one, a curved path of short segments) is streamed one line per "ok"
+and with credits, and the lines per second are printed. With --error-rate
+bytes are corrupted on the way to the printer (at most one in a line, as the
+checksum can't catch every double error), and the commands run are checked
+against the file. With --port the file is sent to a printer, which needs
+pyserial.
+"""
+
+from __future__ import print_function, division
+
+import argparse
+import collections
+import difflib
+import math
+import random
+import sys
+import time
+
+parser = argparse.ArgumentParser(description=__doc__)
+parser.add_argument('gcode', nargs='?', help='G-code file (default: a curved path)')
+parser.add_argument('-b', '--baud', type=int, default=250000, help='Serial baud rate (default=250000)')
+parser.add_argument('-l', '--latency', type=float, default=2.0, help='Host turnaround per reply in ms (default=2)')
+parser.add_argument('-c', '--cmd-time', type=float, default=0.4, help='Time to run each command in ms (default=0.4)')
+parser.add_argument('-e', '--error-rate', type=float, default=0, help='Probability of a corrupted byte (default=0)')
+parser.add_argument('-n', '--segments', type=int, default=3000, help='Segments of the generated path (default=3000)')
+parser.add_argument('--rx', type=int, default=128, help='RX_BUFFER_SIZE (default=128)')
+parser.add_argument('--bufsize', type=int, default=4, help='BUFSIZE (default=4)')
+parser.add_argument('--port', help='Send the file to the printer on this serial port')
+parser.add_argument('--seed', type=int, default=1, help='Random seed (default=1)')
+args = parser.parse_args()
+
+MAX_CMD_SIZE = 96
+BLOCK_BUFFER_SIZE = 16
+TIMEOUT = 0.2 # Seconds without a reply before the sender ends a line that may have lost its newline
+
+def curved_path():
+  lines, x, y, heading, radius = ['G28', 'M83', 'G1 Z0.2 F3000'], 100.0, 100.0, 0.0, 20.0
+  for i in range(args.segments):
+    if i % 50 == 0:
+      radius = random.uniform(5, 60) * random.choice((-1, 1))
+    heading += 0.4 / radius
+    x += 0.4 * math.cos(heading)
+    y += 0.4 * math.sin(heading)
+    lines.append('G1 X%.3f Y%.3f E%.5f' % (x, y, 0.4 * 0.033))
+  return lines
+
+def clean(line):
+  return line.split(';', 1)[0].strip()[:MAX_CMD_SIZE - 12]
+
+def text_line(n, command):
+  line = 'N%d %s' % (n, command)
+  checksum = 0
+  for c in bytearray(line.encode()):
+    checksum ^= c
+  return ('%s*%d\n' % (line, checksum)).encode()
+
+def strtol(s):
+  """ The value strtol() would read, or 0 """
+  s = s.lstrip(' \t')
+  sign, i = 1, 0
+  if s[:1] in ('-', '+'):
+    sign, i = (-1 if s[0] == '-' else 1), 1
+  j = i
+  while j < len(s) and s[j] in '0123456789':
+    j += 1
+  return sign * int(s[i:j]) if j > i else 0
+
+def fields(words):
+  """ The numbers of the letter fields of a reply """
+  out = {}
+  for w in words:
+    if len(w) > 1 and w[0].isalpha() and w[1:].isdigit():
+      out[w[0]] = int(w[1:])
+  return out
+
+class CreditSender(object):
+  """ The reference sender: lines are written while their bytes fit in the window """
+
+  def __init__(self, commands, window, first=1):
+    self.lines = [text_line(first + i, c) for i, c in enumerate(commands)]
+    self.window, self.first = window, first
+    self.sent = self.consumed = 0 # Bytes written, and taken by the printer as last reported
+    self.next = self.acked = 0    # Next line to write, and lines acknowledged
+    self.starts = {}              # Offset of the last copy written of each line
+    self.resends = self.stale = 0
+
+  def start(self, r):
+    """ After the "ok" of M941 S1, which took all bytes written so far """
+    self.sent = self.consumed = r
+
+  def done(self):
+    return self.acked >= len(self.lines)
+
+  def write(self):
+    """ The next line to write, or None until there's room for it """
+    if self.next >= len(self.lines):
+      return None
+    line = self.lines[self.next]
+    if self.sent + len(line) - self.consumed > self.window:
+      return None
+    self.starts[self.next] = self.sent
+    self.sent += len(line)
+    self.next += 1
+    return line
+
+  def sync(self, r):
+    # R is 16 bits, and never more than a window behind the bytes written
+    self.consumed = max(self.consumed, self.sent - ((self.sent - r) & 0xFFFF))
+
+  def reply(self, text):
+    words = text.split()
+    if not words:
+      return
+    if words[0] == 'ok':
+      f = fields(words[1:])
+      if 'R' in f:
+        self.sync(f['R'])
+      if 'N' in f:
+        self.acked = max(self.acked, f['N'] - self.first + 1)
+    elif words[0] == 'Resend:':
+      f = fields(words[2:])
+      if 'R' in f:
+        self.sync(f['R'])
+      line = strtol(words[1]) - self.first
+      # Go back only if the printer took (some of) the last copy of the line
+      if self.starts.get(line, self.sent) < self.consumed:
+        self.next = line
+        self.resends += 1
+      else:
+        self.stale += 1
+
+  def timeout(self):
+    """ A newline ends a line that lost its own, so the printer answers it """
+    self.sent += 1
+    return b'\n'
+
+class PingPongSender(object):
+  """ One line per "ok", as most hosts send """
+
+  def __init__(self, commands, first=1):
+    self.lines = [text_line(first + i, c) for i, c in enumerate(commands)]
+    self.first, self.next, self.acked, self.waiting = first, 0, 0, False
+    self.resends = self.stale = 0
+
+  def done(self):
+    return self.acked >= len(self.lines)
+
+  def write(self):
+    if self.waiting or self.next >= len(self.lines):
+      return None
+    self.waiting = True
+    self.next += 1
+    return self.lines[self.next - 1]
+
+  def reply(self, text):
+    if text.startswith('ok'):
+      self.waiting = False
+      self.acked = self.next
+    elif text.startswith('Resend:'):
+      self.next = strtol(text.split()[1]) - self.first
+      self.resends += 1
+
+  def timeout(self):
+    return b'\n'
+
+class Firmware(object):
+  """ Mirror of get_serial_commands(), the command queue, ok_to_send() and flush_and_request_resend() """
+
+  def __init__(self, credits):
+    self.credits = credits
+    self.rx, self.consumed, self.overruns = collections.deque(), 0, 0
+    self.line, self.comment = bytearray(), False
+    self.last_n = 0
+    self.queue, self.run = [], []
+    self.replies = []
+
+  def receive(self, c):
+    """ The RX ISR, which drops bytes when the buffer is full """
+    if len(self.rx) >= args.rx - 1:
+      self.overruns += 1
+    else:
+      self.rx.append(c)
+
+  def read(self):
+    self.consumed += 1
+    return self.rx.popleft()
+
+  def credit(self):
+    return ' R%d' % (self.consumed & 0xFFFF) if self.credits else ''
+
+  def ok(self, command):
+    n = ' N%d' % strtol(command[1:]) if command.startswith('N') else ''
+    self.replies.append('ok%s P%d B%d%s' % (n, BLOCK_BUFFER_SIZE - 1, args.bufsize - len(self.queue), self.credit()))
+
+  def line_error(self, err):
+    self.replies.append('Error:%s%d' % (err, self.last_n))
+    # flush_and_request_resend()
+    self.consumed += len(self.rx)
+    self.rx.clear()
+    self.replies.append('Resend: %d%s' % (self.last_n + 1, self.credit()))
+    if not self.credits:
+      self.ok(self.queue[0] if self.queue else '')
+    self.line = bytearray()
+
+  def get_commands(self):
+    while len(self.queue) < args.bufsize and self.rx:
+      c = self.read()
+      if c in (10, 13):
+        self.comment = False
+        if not self.line:
+          continue
+        command = bytes(self.line).decode('latin-1').lstrip(' ')
+        self.line = bytearray()
+        if command.startswith('N'):
+          npos = 0
+          m110 = 'M110' in command
+          if m110 and command.find('N', 4) >= 0:
+            npos = command.find('N', 4)
+          n = strtol(command[npos + 1:])
+          if n != self.last_n + 1 and not m110:
+            return self.line_error('Line Number is not Last Line Number+1, Last Line: ')
+          apos = command.rfind('*')
+          if apos < 0:
+            return self.line_error('No Checksum with line number, Last Line: ')
+          checksum = 0
+          for b in bytearray(command[:apos].encode('latin-1')):
+            checksum ^= b
+          if strtol(command[apos + 1:]) != checksum:
+            return self.line_error('checksum mismatch, Last Line: ')
+          self.last_n = n
+        elif self.credits:
+          return self.line_error('No Checksum with line number, Last Line: ')
+        self.queue.append(command)
+      elif len(self.line) >= MAX_CMD_SIZE - 1:
+        pass
+      elif c == ord('\\'):
+        if self.rx:
+          c = self.read()
+          if not self.comment:
+            self.line.append(c)
+      else:
+        if c == ord(';'):
+          self.comment = True
+        if not self.comment:
+          self.line.append(c)
+
+  def finish(self):
+    """ The command at the front of the queue ran """
+    command = self.queue[0]
+    self.run.append(command.split('*')[0].split(' ', 1)[1] if command.startswith('N') else command)
+    self.ok(command)
+    self.queue.pop(0)
+
+def loopback(sender, credits):
+  """ Run the link one byte time at a time. Return the seconds taken. """
+  byte_time = 10 / args.baud
+  latency = args.latency / 1000 / byte_time
+  cmd_time = args.cmd_time / 1000 / byte_time
+  timeout = TIMEOUT / byte_time
+  fw = Firmware(credits)
+  to_printer = collections.deque()
+  tx, tx_left, to_host = collections.deque(), 0, collections.deque()
+  busy_until, running, last_reply, tick, corrupted = 0, False, 0, 0, False
+  while not sender.done() or fw.queue or running:
+    # Host to printer
+    if to_printer:
+      c = to_printer.popleft()
+      if not corrupted and random.random() < args.error_rate:
+        c ^= 1 << random.randint(0, 7)
+        corrupted = True
+      elif c == 10:
+        corrupted = False
+      fw.receive(c)
+    # The printer's loop: run a command, or read the queue full
+    if tick >= busy_until:
+      if running:
+        fw.finish()
+        running = False
+      fw.get_commands()
+      if fw.queue:
+        running, busy_until = True, tick + cmd_time
+    tx.extend(fw.replies)
+    fw.replies = []
+    # Printer to host
+    if not tx_left and tx:
+      tx_left = len(tx[0]) + 1
+    if tx_left:
+      tx_left -= 1
+      if not tx_left:
+        to_host.append((tick + latency, tx.popleft()))
+    # The host answers the replies that reached it, then writes what it may
+    while to_host and to_host[0][0] <= tick:
+      sender.reply(to_host.popleft()[1])
+      last_reply = tick
+    line = sender.write()
+    while line:
+      to_printer.extend(bytearray(line))
+      line = sender.write()
+    if tick - last_reply > timeout and not sender.done():
+      to_printer.extend(bytearray(sender.timeout()))
+      last_reply = tick
+    tick += 1
+  return tick * byte_time, fw
+
+def send(commands):
+  import serial
+  port = serial.Serial(args.port, args.baud, timeout=TIMEOUT)
+
+  def reply():
+    line = port.readline().decode(errors='replace').strip()
+    if line and not line.startswith('ok') and not line.startswith('Resend:'):
+      print(line)
+    return line
+
+  port.write(b'\nM115\n')
+  caps = []
+  while True:
+    line = reply()
+    if not line or line.startswith('ok'):
+      break
+    caps.append(line)
+  if 'Cap:SERIAL_CREDITS:1' not in caps:
+    sys.exit('The printer does not support SERIAL_CREDITS')
+  port.write(b'M110 N0\n')
+  while not reply().startswith('ok'):
+    pass
+  port.write(b'M941 S1\n')
+  window = None
+  while True:
+    line = reply()
+    if 'Credits W' in line:
+      window = fields(line.split()[1:])['W']
+    if line.startswith('ok'):
+      break
+  sender = CreditSender(commands + ['M941 S0'], window)
+  sender.start(fields(line.split())['R'])
+  start, last_reply = time.time(), time.time()
+  while not sender.done():
+    line = sender.write()
+    while line:
+      port.write(line)
+      line = sender.write()
+    text = reply()
+    if text:
+      sender.reply(text)
+      last_reply = time.time()
+    elif time.time() - last_reply > TIMEOUT:
+      port.write(sender.timeout())
+      last_reply = time.time()
+  seconds = time.time() - start
+  print('Sent %d lines in %.1fs, %.0f lines/s, %d resends' % (len(commands), seconds, len(commands) / seconds, sender.resends))
+
+random.seed(args.seed)
+if args.gcode:
+  with open(args.gcode) as f:
+    lines = f.read().splitlines()
+else:
+  lines = curved_path()
+commands = [c for c in (clean(l) for l in lines) if c]
+
+failures = []
+print('%d lines at %d baud, RX_BUFFER_SIZE %d, BUFSIZE %d, %.1fms reply latency, %.1fms per command:' % (
+  len(commands), args.baud, args.rx, args.bufsize, args.latency, args.cmd_time))
+for name, sender, credits in (('one line per ok', PingPongSender(commands), False),
+                              ('credits', CreditSender(commands, args.rx - 1), True)):
+  seconds, fw = loopback(sender, credits)
+  same = sum(b.size for b in difflib.SequenceMatcher(None, fw.run, commands, autojunk=False).get_matching_blocks())
+  print('  %-16s %6.2fs %7.0f lines/s  %d resends, %d stale, %d RX overruns, %d commands lost or stray' % (
+    name, seconds, len(commands) / seconds, sender.resends, sender.stale, fw.overruns, len(fw.run) + len(commands) - 2 * same))
+  # Without line numbers required, a line that lost its 'N' or was cut by a flush may run
+  if credits and fw.run != commands:
+    failures.append('credits: the commands run differ from the file')
+  if credits and fw.overruns:
+    failures.append('credits: the RX buffer overran')
+
+if args.port:
+  send(commands)
+
+for f in failures:
+  print('FAIL', f)
+sys.exit(1 if failures else 0)
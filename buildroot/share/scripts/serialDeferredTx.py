@@ -0,0 +1,370 @@
+#!/usr/bin/env python
+
+""" Model the main loop time blocked on serial output, with and without SERIAL_DEFERRED_TX.
+
+A printer streaming G-code answers every line with "ok" (or the ADVANCED_OK
+"ok N P B"), sends a temperature report every second, and with --echo also a
+position echo per line, as a debug build does. The main loop needs --line-us
+per line, and the UART sends a byte every 10 bits at --baud.
+
+The same output goes through three models of MarlinSerial:
+  tx0       TX_BUFFER_SIZE 0: every byte waits for the UART
+  ring      TX_BUFFER_SIZE bytes, with numbers formatted inline
+  deferred  SERIAL_DEFERRED_TX: records of SERIAL_DEFERRED_TX_SIZE bytes,
+            formatted into the TX buffer by idle() every --idle-us
+and for each the time blocked (less any formatting done while waiting), the
+longest wait and the formatting time spent on the main loop are printed, and
+the bytes sent are checked to be the same.
+
+Unless --no-check is given, format_record() is also taken out of
+Marlin/MarlinSerial.cpp and built with the host C++ compiler, next to
+printNumber() and printFloat(), to check both format numbers the same.
+"""
+
+from __future__ import print_function, division
+
+import argparse
+import os
+import random
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+parser.add_argument('-b', '--baud', type=int, default=250000, help='Baud rate (default=250000)')
+parser.add_argument('-n', '--lines', type=int, default=5000, help='Lines streamed (default=5000)')
+parser.add_argument('--line-us', type=int, default=700, help='Main loop time per line, in us (default=700)')
+parser.add_argument('--idle-us', type=int, default=200, help='Time between calls to idle(), in us (default=200)')
+parser.add_argument('--digit-us', type=float, default=40.0, help='Time to format a digit on the AVR, in us (default=40)')
+parser.add_argument('--tx-buffer', type=int, default=32, help='TX_BUFFER_SIZE of the ring and deferred models (default=32)')
+parser.add_argument('--deferred-size', type=int, default=128, help='SERIAL_DEFERRED_TX_SIZE (default=128)')
+parser.add_argument('--advanced-ok', action='store_true', help='Answer with "ok N P B"')
+parser.add_argument('--echo', action='store_true', help='Echo the position of each line')
+parser.add_argument('--no-check', action='store_true', help='Skip the host build of format_record()')
+parser.add_argument('--cxx', default=os.environ.get('CXX', 'c++'), help='Host C++ compiler (default=$CXX or c++)')
+parser.add_argument('--marlin', default=os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', '..', 'Marlin'),
+                    help='Path of the Marlin sources')
+parser.add_argument('--seed', type=int, default=1, help='Random seed (default=1)')
+args = parser.parse_args()
+
+DEFER_CHAR, DEFER_PGM, DEFER_LONG, DEFER_ULONG, DEFER_FLOAT = range(5)
+RECORD_SIZE = { DEFER_CHAR: 1, DEFER_PGM: 2, DEFER_LONG: 4, DEFER_ULONG: 4, DEFER_FLOAT: 4 }
+
+def f32(v):
+  return struct.unpack('<f', struct.pack('<f', v))[0]
+
+def format_number(item):
+  """ The text of a number, as printNumber() and printFloat() make it with floats """
+  kind, v = item[0], item[1]
+  if kind != DEFER_FLOAT:
+    return str(v)
+  digits = item[2]
+  out = ''
+  number = f32(v)
+  if number < 0.0:
+    out, number = '-', -number
+  rounding = f32(0.5)
+  for _ in range(digits):
+    rounding = f32(rounding * f32(0.1))
+  number = f32(number + rounding)
+  int_part = int(number)
+  remainder = f32(number - f32(int_part))
+  out += str(int_part)
+  if digits:
+    out += '.'
+    for _ in range(digits):
+      remainder = f32(remainder * 10.0)
+      d = int(remainder)
+      out += str(d)
+      remainder = f32(remainder - d)
+  return out
+
+def format_us(text):
+  """ AVR time to format a number: a division per digit, and float math per decimal """
+  return sum(1 for c in text if c.isdigit()) * args.digit_us
+
+#
+# The output of the streamed lines: a list of (time us, items) where an item is
+# (DEFER_PGM, text), (DEFER_CHAR, c), (DEFER_LONG, n) or (DEFER_FLOAT, v, digits)
+#
+def workload():
+  out = []
+  t = 0
+  next_report = 1000000
+  temp, bed = 205.0, 58.0
+  x = y = z = e = 0.0
+  for n in range(1, args.lines + 1):
+    t += args.line_us
+    items = []
+    if args.echo:
+      x, y, e = x + random.uniform(-2, 2), y + random.uniform(-2, 2), e + random.uniform(0.01, 0.1)
+      items += [(DEFER_PGM, 'echo:X:'), (DEFER_FLOAT, x, 2), (DEFER_PGM, ' Y:'), (DEFER_FLOAT, y, 2),
+                (DEFER_PGM, ' Z:'), (DEFER_FLOAT, z, 2), (DEFER_PGM, ' E:'), (DEFER_FLOAT, e, 2), (DEFER_CHAR, '\n')]
+    if args.advanced_ok:
+      items += [(DEFER_PGM, 'ok'), (DEFER_PGM, ' N'), (DEFER_LONG, n), (DEFER_PGM, ' P'), (DEFER_LONG, random.randint(0, 15)),
+                (DEFER_PGM, ' B'), (DEFER_LONG, random.randint(0, 3)), (DEFER_CHAR, '\n')]
+    else:
+      items += [(DEFER_PGM, 'ok\n')]
+    if t >= next_report:
+      next_report += 1000000
+      temp, bed = temp + random.uniform(-0.5, 0.5), bed + random.uniform(-0.2, 0.2)
+      items += [(DEFER_PGM, ' T:'), (DEFER_FLOAT, temp, 2), (DEFER_PGM, ' /'), (DEFER_FLOAT, 210.0, 2),
+                (DEFER_PGM, ' B:'), (DEFER_FLOAT, bed, 2), (DEFER_PGM, ' /'), (DEFER_FLOAT, 60.0, 2),
+                (DEFER_PGM, ' @:'), (DEFER_LONG, random.randint(0, 127)), (DEFER_PGM, ' B@:'), (DEFER_LONG, 0), (DEFER_CHAR, '\n')]
+    out.append(items)
+  return out
+
+class Uart(object):
+  """ A UART with a data register and a TX buffer of the given size drained by its ISR """
+  def __init__(self, tx_size):
+    self.byte_us = 10.0 * 1e6 / args.baud
+    self.size = tx_size
+    self.buffer = []
+    self.now = 0.0
+    self.free_at = 0.0    # When the data register is empty again
+    self.sent = []
+
+  def run_until(self, t):
+    while self.buffer and self.free_at <= t:
+      self.free_at = max(self.free_at, self.now) + self.byte_us
+      self.now = self.free_at - self.byte_us
+      self.sent.append(self.buffer.pop(0))
+    self.now = max(self.now, t)
+
+  def room(self):
+    return self.size - 1 - len(self.buffer) if self.size else (0 if self.free_at - self.byte_us > self.now else 1)
+
+  def put(self, c):
+    if self.size:
+      self.buffer.append(c)
+    else:
+      self.free_at = max(self.free_at, self.now) + self.byte_us
+      self.sent.append(c)
+
+  def wait_room(self):
+    """ Wait until a byte can be written, returning the time waited """
+    start = self.now
+    if self.size:
+      while not self.room():
+        self.run_until(self.free_at)
+    else:
+      self.now = max(self.now, self.free_at - self.byte_us)
+    return self.now - start
+
+class Stats(object):
+  def __init__(self, name):
+    self.name = name
+    self.blocked = 0.0
+    self.waits = 0
+    self.longest = 0.0
+    self.format_inline = 0.0
+    self.format_idle = 0.0
+
+  def wait(self, us):
+    if us > 0:
+      self.blocked += us
+      self.waits += 1
+      self.longest = max(self.longest, us)
+
+def run_blocking(lines, tx_size):
+  """ Output written by the main loop, waiting for room a byte at a time """
+  uart = Uart(tx_size)
+  stats = Stats('tx0' if not tx_size else 'ring')
+  t = 0.0
+  for items in lines:
+    t += args.line_us
+    uart.run_until(max(t, uart.now))
+    for item in items:
+      if item[0] in (DEFER_PGM, DEFER_CHAR):
+        text = item[1]
+      else:
+        text = format_number(item)
+        cost = format_us(text)
+        stats.format_inline += cost
+        uart.run_until(uart.now + cost)
+      for c in text:
+        stats.wait(uart.wait_room())
+        uart.put(c)
+    t = uart.now
+  uart.run_until(float('inf'))
+  return stats, ''.join(uart.sent), t
+
+class Deferred(object):
+  """ The record ring and pump() of SERIAL_DEFERRED_TX """
+  def __init__(self, uart, stats):
+    self.uart = uart
+    self.stats = stats
+    self.records = []     # (item, ring bytes)
+    self.used = 0
+    self.sent = 0         # defer_sent: characters of the first record already sent
+
+  def room(self):
+    return args.deferred_size - 1 - self.used
+
+  def pump(self):
+    while self.records:
+      room = self.uart.room()
+      if not room:
+        break
+      item, size = self.records[0]
+      if item[0] in (DEFER_PGM, DEFER_CHAR):
+        text = item[1]
+      else:
+        # Formatted again after a partial send, as the firmware does
+        text = format_number(item)
+        cost = format_us(text)
+        self.stats.format_idle += cost
+        self.uart.run_until(self.uart.now + cost)
+        room = self.uart.room()
+      while self.sent < len(text) and room:
+        self.uart.put(text[self.sent])
+        self.sent += 1
+        room -= 1
+      if self.sent < len(text):
+        break
+      self.sent = 0
+      self.records.pop(0)
+      self.used -= size
+
+  def defer(self, item):
+    size = 1 + RECORD_SIZE[item[0]]
+    if self.room() < size:
+      start, formatting = self.uart.now, self.stats.format_idle
+      while self.room() < size:
+        self.pump()
+        if self.room() < size:
+          self.uart.run_until(self.uart.free_at)
+      self.stats.wait(self.uart.now - start - (self.stats.format_idle - formatting))
+    self.records.append((item, size))
+    self.used += size
+
+def run_deferred(lines):
+  uart = Uart(args.tx_buffer)
+  stats = Stats('deferred')
+  ring = Deferred(uart, stats)
+  t = 0.0
+  for items in lines:
+    # idle() runs through the time of the line
+    end = t + args.line_us
+    while t < end:
+      t = min(end, t + args.idle_us)
+      uart.run_until(max(t, uart.now))
+      ring.pump()
+    t = max(t, uart.now)
+    for item in items:
+      # write() only queues a character behind records, or when the TX buffer is full
+      if item[0] == DEFER_CHAR and not ring.records and uart.room():
+        uart.put(item[1])
+      else:
+        ring.defer(item)
+    t = max(t, uart.now)
+  while ring.records:
+    uart.run_until(uart.now + args.idle_us)
+    ring.pump()
+  uart.run_until(float('inf'))
+  return stats, ''.join(uart.sent), t
+
+#
+# Host build of format_record(), compared with printNumber() and printFloat()
+#
+HARNESS = r'''
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define double float
+#define long int // 32 bits, as on the AVR
+#define FORCE_INLINE inline
+enum DeferredTag : uint8_t { DEFER_CHAR, DEFER_PGM, DEFER_LONG, DEFER_ULONG, DEFER_FLOAT };
+
+%(format_record)s
+
+static char out[64];
+static int out_len;
+struct Reference {
+  static void print(char c) { out[out_len++] = c; }
+  static void print(long n) { if (n < 0) { print('-'); n = -n; } printNumber(n, 10); }
+  static void print(unsigned long n) { printNumber(n, 10); }
+  static void printNumber(unsigned long n, const uint8_t base);
+  static void printFloat(double number, uint8_t digits);
+};
+%(reference)s
+
+int main() {
+  char line[128];
+  int failures = 0, count = 0;
+  while (fgets(line, sizeof(line), stdin)) {
+    const int kind = atoi(strtok(line, " "));
+    const char *value = strtok(NULL, " ");
+    const int digits = atoi(strtok(NULL, " \n"));
+    uint8_t raw[4];
+    long l = 0; unsigned long u = 0; float f = 0;
+    out_len = 0;
+    if (kind == DEFER_LONG) { l = atol(value); memcpy(raw, &l, 4); Reference::print(l); }
+    else if (kind == DEFER_ULONG) { u = strtoul(value, NULL, 10); memcpy(raw, &u, 4); Reference::print(u); }
+    else { f = strtof(value, NULL); memcpy(raw, &f, 4); Reference::printFloat(f, digits); }
+    char buf[44];
+    const uint8_t len = format_record(kind | digits << 3, raw, buf);
+    count++;
+    if (len != out_len || memcmp(buf, out, len)) {
+      if (failures++ < 20) printf("FAIL %%s: %%.*s, expected %%.*s\n", value, len, buf, out_len, out);
+    }
+  }
+  printf("%%d numbers, %%d failures\n", count, failures);
+  return failures != 0;
+}
+'''
+
+def extract(source, signature):
+  start = source.index(signature)
+  depth, i = 0, source.index('{', start)
+  while True:
+    if source[i] == '{':
+      depth += 1
+    elif source[i] == '}':
+      depth -= 1
+      if not depth:
+        return source[start:i + 1]
+    i += 1
+
+def check_format_record():
+  source = open(os.path.join(args.marlin, 'MarlinSerial.cpp')).read()
+  format_record = extract(source, 'static uint8_t format_record(')
+  reference = '\n'.join(re.sub(r'\bMarlinSerial::', 'Reference::', extract(source, sig))
+                        for sig in ('void MarlinSerial::printNumber(', 'void MarlinSerial::printFloat('))
+  numbers = ['%d 0 0' % DEFER_LONG, '%d -2147483647 0' % DEFER_LONG, '%d 4294967295 0' % DEFER_ULONG]
+  for _ in range(2000):
+    numbers.append('%d %d 0' % (DEFER_LONG, random.randint(-2**31 + 1, 2**31 - 1)))
+    numbers.append('%d %d 0' % (DEFER_ULONG, random.randint(0, 2**32 - 1)))
+    numbers.append('%d %r %d' % (DEFER_FLOAT, random.uniform(-1000, 1000), random.randint(0, 6)))
+  numbers += ['%d %r %d' % (DEFER_FLOAT, v, d) for v in (0.0, -0.0, 1.999, -1.999, 0.005, 123456.789, 4e9) for d in (0, 2, 3)]
+  tmp = tempfile.mkdtemp()
+  try:
+    src, exe = os.path.join(tmp, 'check.cpp'), os.path.join(tmp, 'check')
+    open(src, 'w').write(HARNESS % {'format_record': format_record, 'reference': reference})
+    subprocess.check_call([args.cxx, '-O1', '-w', '-o', exe, src])
+    p = subprocess.Popen([exe], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+    out = p.communicate(('\n'.join(numbers) + '\n').encode('ascii'))[0].decode('ascii')
+    print(out.strip())
+    return p.returncode == 0
+  finally:
+    shutil.rmtree(tmp)
+
+random.seed(args.seed)
+ok = True
+if not args.no_check:
+  ok = check_format_record()
+
+lines = workload()
+results = [run_blocking(lines, 0), run_blocking(lines, args.tx_buffer), run_deferred(lines)]
+print('%d lines at %d baud, %d us each: %d bytes sent' % (args.lines, args.baud, args.line_us, len(results[0][1])))
+for stats, sent, end in results:
+  print('%-9s blocked %8.1f ms in %6d waits, longest %7.0f us, formatting %7.1f ms inline %7.1f ms in idle(), done at %.0f ms' % (
+    stats.name, stats.blocked / 1000, stats.waits, stats.longest, stats.format_inline / 1000, stats.format_idle / 1000, end / 1000))
+  if sent != results[0][1]:
+    print('FAIL %s sent different bytes' % stats.name)
+    ok = False
+sys.exit(0 if ok else 1)
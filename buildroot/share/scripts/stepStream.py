@@ -0,0 +1,357 @@
+#!/usr/bin/env python
+
+""" Generate a binary step stream for G6 S3 (STEP_STREAM) from G-code.
+
+Plans G0/G1 and G6 moves as trapezoids that start and end at rest, computes the
+time of every step of every motor and compresses each motor's steps into
+(interval, count, add) chunks that Stepper::stream_isr() replays exactly. Without
+an input file a random path is generated.
+
+With --check the frames are run through a model of the serial link, the per-axis
+queues and stream_isr(), and the step times the firmware would produce are
+compared with the ideal ones. With --port the stream is sent to a printer, which
+needs pyserial.
+"""
+
+from __future__ import print_function, division
+
+import argparse
+import math
+import random
+import struct
+import sys
+
+parser = argparse.ArgumentParser(description=__doc__)
+parser.add_argument('gcode', nargs='?', help='G-code file (default: a random path)')
+parser.add_argument('-o', '--output', help='Write the binary stream to this file')
+parser.add_argument('--hangprinter', action='store_true', help='Axes are A B C D E and G6 moves are relative')
+parser.add_argument('--steps-per-mm', help='Steps per mm of each axis (default=80,80,400,93 or 80,80,80,80,93)')
+parser.add_argument('-a', '--acceleration', type=float, default=1000, help='Acceleration in mm/s^2 (default=1000)')
+parser.add_argument('-f', '--feedrate', type=float, default=3000, help='Feedrate in mm/min until one is given (default=3000)')
+parser.add_argument('-e', '--max-error', type=float, default=10, help='Largest step time error in us (default=10)')
+parser.add_argument('-q', '--queue', type=int, default=8, help='STEP_STREAM_QUEUE_SIZE (default=8)')
+parser.add_argument('-b', '--baud', type=int, default=250000, help='Serial baud rate (default=250000)')
+parser.add_argument('-n', '--moves', type=int, default=100, help='Moves of the random path (default=100)')
+parser.add_argument('--check', action='store_true', help='Simulate the firmware and compare step times')
+parser.add_argument('--port', help='Send the stream to the printer on this serial port')
+parser.add_argument('--seed', type=int, default=1, help='Random seed (default=1)')
+args = parser.parse_args()
+
+TIMER_RATE = 2000000          # STEPPER_TIMER_RATE of a 16MHz AVR
+IDLE_TICKS = TIMER_RATE // 1000
+FRAME_BYTES = 8
+RX_BUFFER_SIZE = 128          # Frames in flight are limited by the serial buffer
+ACK, NAK = 0x06, 0x15
+
+AXES = 'ABCDE' if args.hangprinter else 'XYZE'
+STEPS_PER_MM = [float(s) for s in (args.steps_per_mm or ('80,80,80,80,93' if args.hangprinter else '80,80,400,93')).split(',')]
+if len(STEPS_PER_MM) != len(AXES):
+  sys.exit('--steps-per-mm needs %d values' % len(AXES))
+MAX_ERROR = args.max_error * TIMER_RATE / 1000000
+
+def random_gcode():
+  random.seed(args.seed)
+  lines, e = [], 0.0
+  for _ in range(args.moves):
+    x, y, z = [random.uniform(0, 50) for _ in range(2)] + [random.uniform(0, 2)]
+    e += random.uniform(0, 5)
+    lines.append('G1 X%.3f Y%.3f Z%.3f E%.4f F%d' % (x, y, z, e, random.choice((1200, 3000, 6000, 9000))))
+  return lines
+
+def parse(lines):
+  """ Yield (delta steps per axis, length in mm, feedrate in mm/s) for each move """
+  pos = [0.0] * len(AXES)
+  steps = [0] * len(AXES)
+  relative = False
+  feedrate = args.feedrate / 60
+  for line in lines:
+    line = line.split(';')[0].strip().upper()
+    if not line:
+      continue
+    words = {}
+    for word in line.split():
+      try:
+        words[word[0]] = float(word[1:]) if len(word) > 1 else 0.0
+      except ValueError:
+        pass
+    code = words.get('G')
+    if code == 90:
+      relative = False
+    elif code == 91:
+      relative = True
+    elif code == 92:
+      for i, axis in enumerate(AXES):
+        if axis in words:
+          pos[i] = words[axis]
+          steps[i] = int(round(pos[i] * STEPS_PER_MM[i]))
+    elif code in (0, 1, 6):
+      if 'F' in words:
+        feedrate = words['F'] / 60
+      # G6 is relative on Hangprinter, as in gcode_G6()
+      rel = relative if code != 6 else (args.hangprinter or 'R' in words)
+      target = [(pos[i] + words[a] if rel else words[a]) if a in words else pos[i] for i, a in enumerate(AXES)]
+      delta = [t - p for t, p in zip(target, pos)]
+      moves = delta[:-1] if any(delta[:-1]) else delta[-1:]
+      length = math.sqrt(sum(d * d for d in moves))
+      new_steps = [int(round(t * STEPS_PER_MM[i])) for i, t in enumerate(target)]
+      pos = target
+      if length > 0:
+        yield [n - s for n, s in zip(new_steps, steps)], length, feedrate
+      steps = new_steps
+
+def step_times(moves):
+  """ Ideal (tick, negative) of every step of each axis """
+  out = [[] for _ in AXES]
+  t0 = 0.0
+  for delta, length, feedrate in moves:
+    accel = args.acceleration
+    v = min(feedrate, math.sqrt(accel * length))
+    d_acc = v * v / (2 * accel)
+    t_acc = v / accel
+    t_total = 2 * t_acc + (length - 2 * d_acc) / v
+
+    def time_at(s):
+      if s < d_acc:
+        return math.sqrt(2 * s / accel)
+      if s <= length - d_acc:
+        return t_acc + (s - d_acc) / v
+      return t_total - math.sqrt(2 * max(length - s, 0) / accel)
+
+    for i, n in enumerate(delta):
+      for k in range(abs(n)):
+        out[i].append(((t0 + time_at(length * (k + 0.5) / abs(n))) * TIMER_RATE, n < 0))
+    t0 += t_total
+  return out
+
+def play(start, interval, count, add):
+  """ Step times of a chunk as stream_isr() produces them """
+  t, times = start, []
+  for _ in range(count):
+    t += interval
+    times.append(t)
+    interval += add
+  return times
+
+def fit(times, start, first):
+  """ Longest (interval, count, add) chunk from times[first:] within MAX_ERROR """
+  def span(k):
+    return times[first + k - 1] - start
+
+  # Runs through the first step, through the k-th step and through two steps
+  first_interval = int(round(span(1)))
+  candidates = set([(first_interval, 0)])
+  left = len(times) - first
+  k = 2
+  while k <= left:
+    candidates.add((first_interval, int(round(2 * (span(k) - k * first_interval) / (k * (k - 1))))))
+    candidates.add((int(round(span(k) / k)), 0))
+    m = k // 2
+    add = 2 * (m * span(k) - k * span(m)) / (k * m * (k - m))
+    candidates.add((int(round(span(m) / m - add * (m - 1) / 2)), int(round(add))))
+    k *= 2
+
+  best = (max(1, min(first_interval, 0xFFFF)), 1, 0)
+  for interval, add in candidates:
+    if not (1 <= interval <= 0xFFFF and -0x8000 <= add <= 0x7FFF):
+      continue
+    t, iv, count = start, interval, 0
+    while count < min(left, 0xFFFF) and 1 <= iv <= 0xFFFF:
+      t += iv
+      if abs(t - times[first + count]) > MAX_ERROR:
+        break
+      count += 1
+      iv += add
+    if count > best[1]:
+      best = (interval, count, add)
+  return best
+
+def compress(steps):
+  """ Chunks (needed at tick, interval, count, add, negative) of one axis """
+  chunks, t, i = [], 0, 0
+  while i < len(steps):
+    negative = steps[i][1]
+    j = i
+    while j < len(steps) and steps[j][1] == negative:
+      j += 1
+    times = [s[0] for s in steps[i:j]]
+    k = 0
+    while k < len(times):
+      # Pure delays bridge gaps too long for one interval
+      while times[k] - t > 0xFFFF:
+        delay = 0xFFFF if times[k] - t >= 0x10000 else 0xFFFE
+        chunks.append((t, delay, 0, 0, negative))
+        t += delay
+      interval, count, add = fit(times, t, k)
+      chunks.append((t, interval, count, add, negative))
+      t = play(t, interval, count, add)[-1]
+      k += count
+    i = j
+  return chunks
+
+def frame(head, interval=0, count=0, add=0):
+  data = struct.pack('<BHHh', head, interval, count, add)
+  checksum = 0
+  for b in bytearray(data):
+    checksum ^= b
+  return data + struct.pack('<B', checksum)
+
+def frames(chunks):
+  """ All chunks in the order they are needed, with the start frame in front of the first full queue """
+  order = sorted((c[0], axis, c) for axis, axis_chunks in enumerate(chunks) for c in axis_chunks)
+  out, queued, started = [], [0] * len(AXES), False
+  for _, axis, (_, interval, count, add, negative) in order:
+    queued[axis] += 1
+    if not started and queued[axis] >= args.queue:
+      out.append((0xFE, None))
+      started = True
+    out.append((0xA0 | negative << 3 | axis, (interval, count, add, negative)))
+  out.append((0xFF, None))
+  return out
+
+class Firmware(object):
+  """ Mirror of Stepper::stream_isr() and the G6 S3 loop """
+  def __init__(self):
+    n = len(AXES)
+    self.queue = [[] for _ in range(n)]
+    self.wait, self.interval, self.add, self.left = [0] * n, [0] * n, [0] * n, [0] * n
+    self.negative = [False] * n
+    self.idle = [False] * n
+    self.elapsed = 0
+    self.running = False
+    self.underruns = 0
+    self.steps = [[] for _ in range(n)]
+
+  def full(self, axis):
+    return len(self.queue[axis]) >= args.queue - 1
+
+  def busy(self):
+    return any(self.left) or any(self.queue)
+
+  def isr(self, now):
+    if not self.running:
+      return IDLE_TICKS
+    nxt = IDLE_TICKS
+    for i in range(len(AXES)):
+      if self.idle[i]:
+        if not self.queue[i]:
+          continue
+        self.idle[i] = False
+        self.wait[i] = 0
+        self.underruns += 1
+      else:
+        self.wait[i] -= self.elapsed
+      if self.wait[i] <= 0:
+        if self.left[i]:
+          self.steps[i].append((now, self.negative[i]))
+          self.left[i] -= 1
+          if self.left[i]:
+            self.interval[i] += self.add[i]
+            self.wait[i] += self.interval[i]
+        if not self.left[i]:
+          if not self.queue[i]:
+            self.idle[i] = True
+            continue
+          interval, count, add, negative = self.queue[i].pop(0)
+          self.left[i], self.interval[i], self.add[i], self.negative[i] = count, interval, add, negative
+          self.wait[i] += interval
+      nxt = min(nxt, self.wait[i])
+    self.elapsed = max(nxt, 1)
+    return self.elapsed
+
+def simulate(stream):
+  """ Feed the frames over the serial link into the firmware, which plays them """
+  fw = Firmware()
+  frame_ticks = FRAME_BYTES * 10.0 * TIMER_RATE / args.baud
+  window = RX_BUFFER_SIZE // FRAME_BYTES
+  now, arrived, acked, f, start = 0.0, 0.0, [], 0, None
+  while True:
+    # The host sends a frame once the serial buffer has room for it, and
+    # the G6 S3 loop takes each arrived frame while its queue has room
+    while f < len(stream):
+      arrival = max(arrived, acked[f - window] if f >= window else 0.0) + frame_ticks
+      if arrival > now:
+        break
+      head, chunk = stream[f]
+      if chunk is None:
+        fw.running = True
+      elif fw.full(head & 0x07):
+        fw.running = True
+        break
+      else:
+        fw.queue[head & 0x07].append(chunk)
+      arrived = arrival
+      acked.append(now)
+      f += 1
+    if f == len(stream) and not fw.busy():
+      return fw
+    if fw.running:
+      if start is None:
+        start = now
+      now += fw.isr(now - start)
+    else:
+      now = arrival
+
+def send(stream):
+  import serial
+  port = serial.Serial(args.port, args.baud, timeout=5)
+  port.write(b'G6 S3\n')
+  while True:
+    line = port.readline()
+    if not line:
+      sys.exit('No reply to G6 S3')
+    if line.strip() == b'STREAM':
+      break
+  in_flight, window = 0, RX_BUFFER_SIZE // FRAME_BYTES
+  for i, (head, chunk) in enumerate(stream):
+    port.write(frame(head, *chunk[:3]) if chunk else frame(head))
+    in_flight += 1
+    while in_flight >= window or (i == len(stream) - 1 and in_flight):
+      reply = port.read(1)
+      if reply != struct.pack('<B', ACK):
+        sys.exit('Stream aborted by the printer' if reply else 'No ACK from the printer')
+      in_flight -= 1
+  print(port.readline().decode().strip())
+
+if args.gcode:
+  with open(args.gcode) as f:
+    lines = f.read().splitlines()
+else:
+  lines = random_gcode()
+gcode_bytes = sum(len(l) + 1 for l in lines)
+
+ideal = step_times(parse(lines))
+chunks = [compress(s) for s in ideal]
+stream = frames(chunks)
+data = b''.join(frame(h, *c[:3]) if c else frame(h) for h, c in stream)
+
+total_steps = sum(len(s) for s in ideal)
+total_chunks = sum(len(c) for c in chunks)
+duration = max(s[-1][0] for s in ideal if s) / TIMER_RATE if total_steps else 0
+print('%d moves, %d steps, %d chunks (%.1f steps per chunk), %d bytes (G-code %d bytes)' % (
+  sum(1 for l in lines if l.split(';')[0].strip()), total_steps, total_chunks,
+  total_steps / max(total_chunks, 1), len(data), gcode_bytes))
+if duration:
+  print('%.2fs of motion needs %.0f bytes/s, %.1f%% of %d baud' % (
+    duration, len(data) / duration, 100.0 * len(data) * 10 / duration / args.baud, args.baud))
+
+if args.output:
+  with open(args.output, 'wb') as f:
+    f.write(data)
+
+if args.check:
+  fw = simulate(stream)
+  errors, bad = [], 0
+  for axis, (want, got) in enumerate(zip(ideal, fw.steps)):
+    if len(want) != len(got) or any(w[1] != g[1] for w, g in zip(want, got)):
+      print('axis %s: %d steps expected, %d played' % (AXES[axis], len(want), len(got)))
+      bad += 1
+      continue
+    errors += [(g[0] - w[0]) * 1000000.0 / TIMER_RATE for w, g in zip(want, got)]
+  if errors:
+    print('step timing: max error %.2fus, rms %.2fus, %d underruns' % (
+      max(abs(e) for e in errors), math.sqrt(sum(e * e for e in errors) / len(errors)), fw.underruns))
+  if bad or fw.underruns:
+    sys.exit(1)
+
+if args.port:
+  send(stream)
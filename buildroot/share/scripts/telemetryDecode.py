@@ -0,0 +1,289 @@
+#!/usr/bin/env python
+
+""" Decode the binary telemetry frames of BINARY_TELEMETRY (M942).
+
+Frames come mixed with the text output of the printer. Each frame is 0xB6, a
+sequence number, the payload length, the payload and a CRC-16 (LE) of the
+sequence number to the payload. The payload is the time in ms (u32), a group
+mask (u8, bit 7 for a key frame) and each group of the mask, as its length and
+its fields:
+  0 hotends   temperature * 10 (i16) and target (i16) of each hotend
+  1 pwm       heater PWM (u8) of each hotend
+  2 bed       temperature * 10 (i16), target (i16) and PWM (u8)
+  3 queues    planned moves (u8) and queued commands (u8)
+  4 position  X, Y, Z and E in microns (i32)
+  5 sd        file position (u32) and size (u32)
+  6 fans      speed (u8) of each fan
+A frame other than a key frame only holds the groups that changed, so after a
+lost frame nothing is printed until the next key frame.
+
+Read a printer with --port (and --interval to send M942 P<ms> first), or a
+captured byte stream from a file. With --simulate, frames of a modelled print
+are encoded as the firmware does, mixed with text, corrupted at --error-rate and
+decoded again, to check the decoder and to compare the bytes sent with the text
+of M105, M114 and M27 reports holding the same values.
+"""
+
+from __future__ import print_function, division
+
+import argparse
+import json
+import random
+import struct
+import sys
+import time
+
+SYNC = 0xB6
+GROUPS = ('hotends', 'pwm', 'bed', 'queues', 'position', 'sd', 'fans')
+
+def crc16(data, crc=0):
+  """ The CRC-16 (XMODEM) of crc16() in Marlin/utility.cpp """
+  for b in bytearray(data):
+    crc ^= b << 8
+    for _ in range(8):
+      crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+  return crc
+
+def decode_group(g, data):
+  """ The values of a group, from its fields """
+  data = bytes(data)
+  if g == 0:
+    v = struct.unpack('<%dh' % (len(data) // 2), data)
+    return [{'temp': v[i] / 10.0, 'target': v[i + 1]} for i in range(0, len(v), 2)]
+  if g == 1 or g == 6:
+    return list(bytearray(data))
+  if g == 2:
+    t, target, pwm = struct.unpack('<hhB', data)
+    return {'temp': t / 10.0, 'target': target, 'pwm': pwm}
+  if g == 3:
+    moves, commands = struct.unpack('<BB', data)
+    return {'moves': moves, 'commands': commands}
+  if g == 4:
+    return dict(zip('XYZE', (v / 1000.0 for v in struct.unpack('<4i', data))))
+  if g == 5:
+    pos, size = struct.unpack('<II', data)
+    return {'pos': pos, 'size': size}
+  return list(bytearray(data))
+
+class Decoder(object):
+  """ Split a byte stream into text lines and telemetry states """
+  def __init__(self):
+    self.buffer = bytearray()
+    self.text = bytearray()
+    self.state = None       # Groups, once a key frame came
+    self.seq = None
+    self.frames = self.bad = self.lost = self.skipped = 0
+
+  def feed(self, data):
+    """ Return a list of ('text', line) and ('telemetry', state) """
+    self.buffer += bytearray(data)
+    out = []
+    while self.buffer:
+      b = self.buffer[0]
+      if b == SYNC:
+        if len(self.buffer) < 3 or len(self.buffer) < self.buffer[2] + 5:
+          break   # Wait for the rest of the frame
+        length = self.buffer[2]
+        frame = self.buffer[:length + 5]
+        if crc16(frame[1:length + 3]) == frame[length + 3] | frame[length + 4] << 8 and length >= 5:
+          del self.buffer[:length + 5]
+          state = self.frame(frame[1], frame[3:length + 3])
+          if state is not None:
+            out.append(('telemetry', state))
+          continue
+        self.bad += 1   # Not a frame after all, so it is text
+      del self.buffer[0]
+      if b == 10:
+        out.append(('text', self.text.decode('latin-1').rstrip('\r')))
+        self.text = bytearray()
+      else:
+        self.text.append(b)
+    return out
+
+  def frame(self, seq, payload):
+    self.frames += 1
+    if self.seq is not None and seq != (self.seq + 1) & 0xFF:
+      self.lost += (seq - self.seq - 1) & 0xFF
+      self.state = None   # A change may have been lost
+    self.seq = seq
+    ms, mask = struct.unpack('<IB', bytes(payload[:5]))
+    groups, p = {}, 5
+    for g in range(len(GROUPS)):
+      if mask & (1 << g):
+        length = payload[p]
+        groups[GROUPS[g]] = decode_group(g, payload[p + 1:p + 1 + length])
+        p += 1 + length
+    if mask & 0x80:
+      self.state = {}
+    elif self.state is None:
+      self.skipped += 1
+      return None
+    self.state.update(groups)
+    state = dict(self.state)
+    state['ms'] = ms
+    state['seq'] = seq
+    state['key'] = bool(mask & 0x80)
+    return state
+
+def show(state):
+  parts = ['%8.3fs' % (state['ms'] / 1000.0)]
+  for i, h in enumerate(state.get('hotends', [])):
+    pwm = state.get('pwm', [0] * (i + 1))[i]
+    parts.append('T%d:%.1f/%d@%d' % (i, h['temp'], h['target'], pwm))
+  if 'bed' in state:
+    parts.append('B:%.1f/%d@%d' % (state['bed']['temp'], state['bed']['target'], state['bed']['pwm']))
+  if 'queues' in state:
+    parts.append('moves:%d cmds:%d' % (state['queues']['moves'], state['queues']['commands']))
+  if 'position' in state:
+    parts.append('X:%.3f Y:%.3f Z:%.3f E:%.3f' % tuple(state['position'][a] for a in 'XYZE'))
+  if 'sd' in state and state['sd']['size']:
+    parts.append('SD:%d/%d' % (state['sd']['pos'], state['sd']['size']))
+  if state.get('fans'):
+    parts.append('fans:' + ','.join(str(f) for f in state['fans']))
+  return ' '.join(parts)
+
+#
+# A model of report_telemetry() in Marlin_main.cpp, for --simulate
+#
+class Encoder(object):
+  def __init__(self, key_frames):
+    self.key_frames = key_frames
+    self.countdown = 0
+    self.seq = 0
+    self.last = {}
+
+  def fields(self, g, s):
+    if g == 0:
+      return b''.join(struct.pack('<hh', int(t * 10), target) for t, target in s['hotends'])
+    if g == 1:
+      return bytes(bytearray(s['pwm']))
+    if g == 2:
+      return struct.pack('<hhB', int(s['bed'][0] * 10), s['bed'][1], s['bed'][2])
+    if g == 3:
+      return struct.pack('<BB', *s['queues'])
+    if g == 4:
+      return struct.pack('<4i', *[int(round(v * 1000)) for v in s['position']])
+    if g == 5:
+      return struct.pack('<II', *s['sd'])
+    return bytes(bytearray(s['fans']))
+
+  def frame(self, ms, s):
+    key = not self.countdown
+    self.countdown = self.key_frames - 1 if key else self.countdown - 1
+    mask, body = 0x80 if key else 0, b''
+    for g in range(len(GROUPS)):
+      f = self.fields(g, s)
+      if not f:
+        continue
+      if key or self.last.get(g) != f:
+        self.last[g] = f
+        mask |= 1 << g
+        body += struct.pack('<B', len(f)) + f
+    payload = struct.pack('<IB', ms, mask) + body
+    head = struct.pack('<BB', self.seq, len(payload)) + payload
+    self.seq = (self.seq + 1) & 0xFF
+    crc = crc16(head)
+    return struct.pack('<B', SYNC) + head + struct.pack('<H', crc)
+
+def text_report(s):
+  """ The M105, M114 and M27 text holding the same values """
+  out = 'ok T:%.2f /%.2f B:%.2f /%.2f @:%d B@:%d\n' % (s['hotends'][0][0], s['hotends'][0][1], s['bed'][0], s['bed'][1], s['pwm'][0], s['bed'][2])
+  out += 'X:%.2f Y:%.2f Z:%.2f E:%.2f Count X:%d Y:%d Z:%d\nok\n' % (tuple(s['position']) + tuple(int(v * 80) for v in s['position'][:3]))
+  out += 'SD printing byte %d/%d\nok\n' % s['sd']
+  return out
+
+def simulate(args):
+  random.seed(args.seed)
+  enc = Encoder(args.key_frames)
+  sent = bytearray()
+  frame_bytes = text_bytes = 0
+  temp, bed, e, sdpos = 205.0, 59.5, 0.0, 0
+  x, y, z = 100.0, 100.0, 0.2
+  for n in range(args.simulate):
+    temp += random.uniform(-0.3, 0.3)
+    bed += random.uniform(-0.1, 0.1)
+    if random.random() < 0.8:   # Moving
+      x, y = x + random.uniform(-10, 10), y + random.uniform(-10, 10)
+      e += random.uniform(0.1, 1.0)
+      sdpos += random.randint(200, 2000)
+    if random.random() < 0.02:
+      z += 0.2
+    s = {'hotends': [(round(temp, 1), 210)], 'pwm': [random.randint(60, 90)], 'bed': (round(bed, 1), 60, random.choice((0, 127))),
+         'queues': (random.randint(10, 15), random.randint(2, 4)), 'position': [round(v, 3) for v in (x, y, z, e)],
+         'sd': (sdpos, 5000000), 'fans': [255]}
+    frame = enc.frame(n * args.interval, s)
+    frame_bytes += len(frame)
+    text_bytes += len(text_report(s))
+    sent += bytearray(frame) + b'ok\n' * random.randint(0, 30)
+
+  # What a clean link gives, to check the decoding of a noisy one against
+  truth = {}
+  for kind, value in Decoder().feed(bytes(sent)):
+    if kind == 'telemetry':
+      truth[value['ms']] = value
+
+  received = bytearray(sent)
+  for i in range(len(received)):
+    if random.random() < args.error_rate:
+      received[i] ^= 1 << random.randint(0, 7)
+  dec, states, pos = Decoder(), [], 0
+  while pos < len(received):
+    n = random.randint(1, 64)
+    states += [value for kind, value in dec.feed(received[pos:pos + n]) if kind == 'telemetry']
+    pos += n
+  wrong = sum(1 for st in states if truth.get(st['ms']) != st)
+
+  print('%d frames: %d bytes, %.1f per frame with a key frame every %d' % (
+    args.simulate, frame_bytes, frame_bytes / args.simulate, args.key_frames))
+  print('The same values as M105, M114 and M27 text: %d bytes, %.1f per report' % (text_bytes, text_bytes / args.simulate))
+  print('With %g of the bytes corrupted: %d frames decoded, %d lost, %d skipped waiting for a key frame, %d wrong' % (
+    args.error_rate, len(states), dec.lost, dec.skipped, wrong))
+  return wrong == 0 and len(truth) == args.simulate
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('source', nargs='?', help='File with a captured byte stream (default: stdin)')
+  parser.add_argument('-p', '--port', help='Serial port of the printer')
+  parser.add_argument('-b', '--baud', type=int, default=250000, help='Baud rate (default=250000)')
+  parser.add_argument('-i', '--interval', type=int, default=1000, help='Send M942 P<interval> first with --port, and the interval of --simulate (default=1000)')
+  parser.add_argument('--json', action='store_true', help='Print each state as a line of JSON')
+  parser.add_argument('--text', action='store_true', help='Print the text lines too')
+  parser.add_argument('--simulate', type=int, metavar='FRAMES', help='Encode, corrupt and decode the frames of a modelled print')
+  parser.add_argument('--key-frames', type=int, default=10, help='TELEMETRY_KEY_FRAMES of --simulate (default=10)')
+  parser.add_argument('--error-rate', type=float, default=1e-4, help='Bytes corrupted by --simulate (default=1e-4)')
+  parser.add_argument('--seed', type=int, default=1, help='Random seed (default=1)')
+  args = parser.parse_args()
+
+  if args.simulate:
+    sys.exit(0 if simulate(args) else 1)
+
+  dec = Decoder()
+  def output(items):
+    for kind, value in items:
+      if kind == 'telemetry':
+        print(json.dumps(value, sort_keys=True) if args.json else show(value))
+      elif args.text:
+        print('<', value)
+    sys.stdout.flush()
+
+  if args.port:
+    import serial
+    port = serial.Serial(args.port, args.baud, timeout=0.1)
+    time.sleep(2)   # Boards that reset on connect
+    port.write(('M942 P%d\n' % args.interval).encode('ascii'))
+    try:
+      while True:
+        output(dec.feed(port.read(256)))
+    except KeyboardInterrupt:
+      port.write(b'M942 S0\n')
+  else:
+    f = open(args.source, 'rb') if args.source else getattr(sys.stdin, 'buffer', sys.stdin)
+    while True:
+      data = f.read(4096)
+      if not data:
+        break
+      output(dec.feed(data))
+  print('%d frames, %d lost, %d skipped waiting for a key frame' % (dec.frames, dec.lost, dec.skipped), file=sys.stderr)
+
+if __name__ == '__main__':
+  main()